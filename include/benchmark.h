@@ -0,0 +1,83 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+const size_t BENCH_POINTS_COUNT = 200000;
+const double BENCH_X_MIN = 0.1;
+const double BENCH_X_MAX = 1.1;
+
+const unsigned BENCH_RANDOM_SEED = 1337;
+const size_t BENCH_RANDOM_EXPR_COUNT = 500;
+const size_t BENCH_RANDOM_POINTS_COUNT = 100;
+const unsigned BENCH_RANDOM_EXPR_DEPTH = 6;
+
+const size_t BENCH_TREE_NODES_LIMIT = 500000;  ///< Stop growing derivative trees after this size
+
+const size_t BENCH_DEEP_TREE_DEPTH = 1000000;
+
+const size_t BENCH_GRID_POINTS_COUNT = 100000000;
+const size_t BENCH_GRID_SLAB_POINTS  = 10000000;    ///< Grid is evaluated by slabs to limit memory
+const size_t BENCH_GRID_MAX_RUNS      = 16;
+
+const size_t BENCH_SERIES_CHECK_ORDER = 10;       ///< Orders compared with symbolic derivatives
+const size_t BENCH_SERIES_MAX_ORDER   = 200;
+const double BENCH_SERIES_TOLERANCE   = 1e-12;    ///< Relative error of coefficients of polynomial returned by TaylorExpansion()
+
+const char * const BENCH_NARRATION_FILE = "/dev/null";
+const size_t BENCH_NARRATION_MIN_TERMS = 16;
+const size_t BENCH_NARRATION_MAX_TERMS = 256;
+const size_t BENCH_BUDGET_MAX_TERMS = 4096;         ///< Unlimited report is measured up to BENCH_NARRATION_MAX_TERMS
+
+const size_t BENCH_SIMPLIFY_TERMS = 4096;       ///< Terms of sum differentiated before simplification
+const size_t BENCH_SIMPLIFY_DEPTH = 1000;       ///< Nesting of expression that needs one pass per level
+
+const size_t BENCH_NARY_MIN_TERMS = 1024;
+const size_t BENCH_NARY_MAX_TERMS = 16384;
+const size_t BENCH_NARY_MIN_ORDER = 64;         ///< Taylor polynomials longer than old 64-leaf limit of foldConstants()
+const size_t BENCH_NARY_MAX_ORDER = 1024;
+const size_t BENCH_NARY_POINTS_COUNT = 1000;
+const size_t BENCH_POWER_TERM_LENGTH = 32;      ///< Enough for one term of powerSumString()
+
+const size_t BENCH_LIKE_TERMS_ORDER = 8;        ///< Taylor order, derivatives without collection grow exponentially
+const double BENCH_LIKE_TERMS_POINT = 0.5;
+const double BENCH_LIKE_TERMS_TOLERANCE = 1e-9;
+
+const size_t BENCH_REWRITE_ORDER = 5;
+const size_t BENCH_REWRITE_MAX_EXTRA_RULES = 4096;  ///< Rules that never match
+const size_t BENCH_REWRITE_RULES_STEP = 8;
+const size_t BENCH_REWRITE_FIRST_EXPONENT = 1001;
+const size_t BENCH_REWRITE_PATTERN_LENGTH = 32;
+const size_t BENCH_REWRITE_REPEATS = 5;
+
+const size_t BENCH_EGRAPH_POINTS_COUNT = 100000;
+const size_t BENCH_EGRAPH_TAYLOR_ORDER = 10;
+const size_t BENCH_EGRAPH_DERIVATIVE_ORDER = 3;   ///< Derivative of corpus is taken with simplification
+const double BENCH_EGRAPH_TOLERANCE = 1e-9;
+
+const size_t BENCH_POLYNOMIAL_MIN_TERMS = 16;
+const size_t BENCH_POLYNOMIAL_MAX_TERMS = 1024;
+const size_t BENCH_POLYNOMIAL_POINTS_COUNT = 10000;
+const double BENCH_POLYNOMIAL_TOLERANCE = 1e-9;
+
+const size_t BENCH_TAYLOR_FORM_MIN_ORDER = 8;
+const size_t BENCH_TAYLOR_FORM_MAX_ORDER = 64;
+const size_t BENCH_TAYLOR_FORM_POINTS_COUNT = 100000;
+const double BENCH_TAYLOR_FORM_RADIUS = 0.5;      ///< Polynomial is evaluated on [point - radius, point + radius]
+
+const size_t BENCH_GRADIENT_MIN_VARIABLES = 20;
+const size_t BENCH_GRADIENT_MAX_VARIABLES = 50;
+const size_t BENCH_GRADIENT_VARIABLES_STEP = 15;
+const size_t BENCH_GRADIENT_POINTS_COUNT = 1000;
+
+const size_t BENCH_REVERSE_MIN_VARIABLES = 5;
+const size_t BENCH_REVERSE_MAX_VARIABLES = 50;
+const size_t BENCH_REVERSE_VARIABLES_STEP = 15;
+const size_t BENCH_REVERSE_POINTS_COUNT = 10000;
+
+const size_t BENCH_REENTRANT_TASKS_COUNT = 100;
+const size_t BENCH_REENTRANT_TASK_POINTS = 2000;
+
+/// @brief Run performance benchmarks of evaluation backends and print results to stdout
+/// @return false if any self-check of results failed or benchmark expressions can't be built
+bool runBenchmarks(TungstenContext_t *context);
+
+#endif
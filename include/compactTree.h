@@ -0,0 +1,51 @@
+#ifndef COMPACT_TREE_H
+#define COMPACT_TREE_H
+
+/*
+Compact representation of expression tree: nodes are stored in one array
+and address each other by 32-bit indices, numbers are kept in separate array.
+Nodes are stored in post-order (children before parents, root is the last node),
+so most traversals are a single linear pass over contiguous memory.
+Node takes 16 bytes instead of 80 bytes of Node_t, parent links are optional.
+*/
+
+const uint32_t COMPACT_NULL = UINT32_MAX;
+
+typedef struct {
+    uint8_t type;           ///< enum ElemType
+    uint8_t op;             ///< enum OperatorType if type is OPERATOR
+    uint32_t value;         ///< Index in numbers for NUMBER, variable index for VARIABLE
+    uint32_t left;
+    uint32_t right;
+} CompactNode_t;
+
+typedef struct {
+    CompactNode_t *nodes;
+    uint32_t size;
+    uint32_t capacity;
+
+    double *numbers;
+    uint32_t numbersCount;
+    uint32_t numbersCapacity;
+
+    uint32_t *parents;      ///< Parent of every node or NULL if parents are not stored
+    double *values;         ///< Scratch buffer for compactEvaluate(), allocated on first use
+} CompactTree_t;
+
+/// @brief Convert pointer-based tree to compact form
+/// @param withParents Store parent links
+TungstenStatus_t treeToCompact(const Node_t *tree, CompactTree_t *compact, bool withParents);
+
+/// @brief Convert compact tree back to Node_t tree
+Node_t *compactToTree(const CompactTree_t *compact);
+
+/// @brief Root of compact tree
+uint32_t compactRoot(const CompactTree_t *compact);
+
+/// @brief Evaluate compact tree in one linear pass
+double compactEvaluate(TungstenContext_t *context, CompactTree_t *compact);
+
+/// @brief Free memory of compact tree
+TungstenStatus_t deleteCompact(CompactTree_t *compact);
+
+#endif
@@ -1,13 +1,37 @@
 #ifndef DERIVATIVE_H
 #define DERIVATIVE_H
 
+/// Polynomial subtree is differentiated on coefficients if its derivative has at most that many nodes per node
+const size_t DERIVATIVE_POLYNOMIAL_MAX_GROWTH = 2;
+/// Without placeholders (unlimited budget.maxNodes) bigger derivatives are not printed in Taylor report
+const size_t TAYLOR_REPORT_MAX_FORMULA_NODES = 10000;
+
 Node_t *derivativeBase(TexContext_t *tex, TungstenContext_t *context, Node_t *expr, int variable);
 
 Node_t *derivative(TexContext_t *tex, TungstenContext_t *context, Node_t *expr, const char *variable);
 
+/// @brief How TaylorExpansion() computes coefficients
+enum TaylorBackend {
+    TAYLOR_SYMBOLIC,    ///< Derivatives are built symbolically and narrated
+    TAYLOR_SERIES,      ///< Truncated power series arithmetic, cheap for high orders
+};
+
+/// @brief Form of tree returned by TaylorExpansion(), report always shows sum of powers
+enum TaylorForm {
+    TAYLOR_SUM,         ///< c0 + c1*(x-a) + c2*(x-a)^2 + ..., one pow() per member
+    TAYLOR_HORNER,      ///< c0 + (x-a)*(c1 + (x-a)*(c2 + ...)), no pow() calls, for plotting and evaluation
+};
+
+typedef struct {
+    enum TaylorBackend backend;
+    enum TaylorForm form;
+} TaylorOptions_t;
+
+/// @brief Taylor polynomial of expr around point with nmemb members
+/// @param options Options or NULL for defaults
 Node_t *TaylorExpansion(TexContext_t *tex, TungstenContext_t *context,
                         Node_t *expr, const char *variable,
-                        double point, size_t nmemb);
+                        double point, size_t nmemb, const TaylorOptions_t *options);
 
 
 #endif
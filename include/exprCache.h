@@ -0,0 +1,113 @@
+#ifndef EXPR_CACHE_H
+#define EXPR_CACHE_H
+
+/*
+Memo cache of derivatives and simplified forms.
+Entry is keyed by (subtree, variable, rules, operation) and found by structural hash of subtree,
+which every node keeps up to date (see updateNodeInfo()), so lookup costs O(1) plus
+comparison of trees on hit. Keys and results are copied to own arena of cache, so they
+survive deleting of original trees and resetting of other arenas.
+Memory is bounded by number of stored nodes, least recently used entries are evicted first.
+Storing entry costs about as much as computing it, so tree is admitted to cache only when it
+misses the second time: one-off subtrees are never copied.
+derivativeBase() and simplifyExpression() use current cache of thread. Default cache of thread
+is released when thread exits, another cache can be selected for a job:
+
+    ExprCache_t cache = exprCacheCtor(EXPR_CACHE_DEFAULT_NODES);
+    ExprCache_t *previous = exprCacheSelect(&cache);
+    ... differentiate, simplify ...
+    exprCacheSelect(previous);
+    exprCacheDtor(&cache);
+*/
+
+const size_t EXPR_CACHE_DEFAULT_NODES = 1 << 20;    ///< Limit of nodes in keys and results of default cache
+const size_t EXPR_CACHE_KEY_FRACTION  = 16;         ///< Key takes at most 1/16 of cache
+const size_t EXPR_CACHE_START_BUCKETS_COUNT = 1024;
+const size_t EXPR_CACHE_SEEN_COUNT = 4096;          ///< Hashes of missed trees remembered by admission filter
+
+/// Inner subtrees of derivative are cached only with size in this range: small ones are differentiated
+/// faster than copied, copying big ones in every node makes derivative quadratic on deep trees
+const size_t EXPR_CACHE_MIN_SUBTREE_NODES = 16;
+const size_t EXPR_CACHE_MAX_SUBTREE_NODES = 1024;
+
+enum CacheOperation {
+    CACHE_DERIVATIVE,
+    CACHE_SIMPLIFY,
+};
+
+typedef struct CacheEntry_t {
+    uint64_t hash;                  ///< Hash of key mixed with operation and variable
+    enum CacheOperation operation;
+    int variable;                   ///< Variable of derivative, NULL_VARIABLE for other operations
+    uint64_t rules;                 ///< Rewrite rules of simplification (see RewriteRules_t::hash), 0 for other operations
+    Node_t *key;
+    Node_t *value;
+    size_t nodes;                   ///< Nodes in key and value
+
+    CacheEntry_t *next;             ///< Next entry in hash bucket
+    CacheEntry_t *newer;            ///< Neighbours in LRU list
+    CacheEntry_t *older;
+} CacheEntry_t;
+
+typedef struct {
+    size_t hits;
+    size_t misses;
+    size_t insertions;
+    size_t evictions;
+    size_t rejections;              ///< Insertions of trees missed for the first time
+    size_t collisions;              ///< Equal hashes of different trees
+} ExprCacheStats_t;
+
+typedef struct {
+    CacheEntry_t **buckets;
+    size_t bucketsCount;
+    size_t entriesCount;
+
+    CacheEntry_t *newest;
+    CacheEntry_t *oldest;
+
+    size_t nodesCount;
+    size_t maxNodes;                ///< 0 disables cache
+
+    uint64_t *seen;                 ///< Admission filter: hashes of missed entries by hash % EXPR_CACHE_SEEN_COUNT
+
+    NodeArena_t arena;              ///< Nodes of keys and values
+    ExprCacheStats_t stats;
+} ExprCache_t;
+
+/// @brief Create empty cache
+/// @param maxNodes Limit of nodes stored in keys and values, 0 creates disabled cache
+ExprCache_t exprCacheCtor(size_t maxNodes);
+
+/// @brief Delete all entries and release memory
+TungstenStatus_t exprCacheDtor(ExprCache_t *cache);
+
+/// @brief Delete all entries, statistics are kept
+TungstenStatus_t exprCacheClear(ExprCache_t *cache);
+
+/// @brief Make cache current for calling thread
+/// @param cache Cache or NULL for default cache of thread
+/// @return Previous current cache
+ExprCache_t *exprCacheSelect(ExprCache_t *cache);
+
+/// @brief Current cache of calling thread
+ExprCache_t *exprCacheCurrent();
+
+/// @brief Find result of operation on tree
+/// @param rules Hash of rewrite rules for CACHE_SIMPLIFY: results of other rules are not found, 0 for derivatives
+/// @return Copy of result in current arena or NULL
+Node_t *exprCacheFind(ExprCache_t *cache, enum CacheOperation operation, int variable, uint64_t rules,
+                      const Node_t *key);
+
+/// @brief Check if result of operation on tree will be stored by exprCacheInsert().
+/// Tree is remembered by admission filter if not, so it is admitted next time.
+/// Lets caller skip copying of key that is changed in place by operation
+bool exprCacheAdmit(ExprCache_t *cache, enum CacheOperation operation, int variable, uint64_t rules,
+                    const Node_t *key);
+
+/// @brief Remember result of operation on tree, both trees are copied.
+/// Entry is stored only if the same insertion was rejected before
+TungstenStatus_t exprCacheInsert(ExprCache_t *cache, enum CacheOperation operation, int variable, uint64_t rules,
+                                 const Node_t *key, const Node_t *value);
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef EXPR_COMPILER_H
+#define EXPR_COMPILER_H
+
+/*
+Compiled form of expression: tree is flattened into postfix program for stack machine.
+Tree stays symbolic form, program is what hot loops should run.
+Example: sin(x) * 2 -> {VAR x, SIN, NUM 2, MUL}
+*/
+
+/// Instruction codes: operators keep values from enum OperatorType, loads go after them
+enum InstrCode {
+    INSTR_ADD  = ADD,
+    INSTR_SUB  = SUB,
+    INSTR_MUL  = MUL,
+    INSTR_DIV  = DIV,
+    INSTR_POW  = POW,
+    INSTR_SIN  = SIN,
+    INSTR_COS  = COS,
+    INSTR_SINH = SINH,
+    INSTR_COSH = COSH,
+    INSTR_TAN  = TAN,
+    INSTR_CTG  = CTG,
+    INSTR_LOG  = LOG,
+    INSTR_LOGN = LOGN,
+    INSTR_NUMBER,       ///< push constant
+    INSTR_VARIABLE      ///< push value of variable
+};
+
+typedef struct {
+    enum InstrCode code;
+    union {
+        double number;  ///< INSTR_NUMBER
+        int var;        ///< INSTR_VARIABLE
+    } arg;
+} Instruction_t;
+
+typedef struct {
+    Instruction_t *code;
+    size_t size;
+    size_t capacity;
+
+    size_t stackSize;   ///< Maximum depth of value stack
+    double *stack;      ///< Value stack, allocated once in compileExpression()
+} CompiledExpr_t;
+
+/// @brief Compile expression tree into linear program
+TungstenStatus_t compileExpression(const Node_t *expr, CompiledExpr_t *compiled);
+
+/// @brief Evaluate compiled expression, result is bit-identical to evaluate()
+double evaluateCompiled(TungstenContext_t *context, const CompiledExpr_t *compiled);
+
+/// @brief Reentrant evaluateCompiled(): variables and value stack are supplied by caller
+/// @param values Values of variables indexed by variable index
+/// @param stack Array of compiled->stackSize elements owned by calling thread
+double evaluateCompiledWith(const CompiledExpr_t *compiled, const double *values, double *stack);
+
+/*
+Batch evaluation: program is executed one instruction at a time over blocks of points.
+Every slot of value stack holds BATCH_BLOCK_SIZE values (structure of arrays),
+so each instruction is a tight loop that compiler can vectorize.
+*/
+const size_t BATCH_BLOCK_SIZE = 256;
+
+/// @brief Values of one variable for every point of batch
+typedef struct {
+    int var;                ///< Index of variable in context
+    const double *values;   ///< Array of pointsCount values
+} BatchVariable_t;
+
+/// @brief Evaluate compiled expression in pointsCount points
+/// @param inputs Variables that change from point to point, others are taken from context
+/// @param result Array of pointsCount values to write results
+TungstenStatus_t evaluateBatch(TungstenContext_t *context, const CompiledExpr_t *compiled,
+                               const BatchVariable_t *inputs, size_t inputsCount,
+                               double *result, size_t pointsCount);
+
+/// @brief Free memory of compiled expression
+TungstenStatus_t deleteCompiled(CompiledExpr_t *compiled);
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef EXPR_DAG_H
+#define EXPR_DAG_H
+
+/*
+Hash-consed expression DAG: structurally equal subexpressions are stored once.
+Every node is interned by (type, value, left, right), so equal subtrees are the same pointer
+and derivative rules can reuse operands instead of copying them.
+Nodes live in arena of the store and are released all at once by dagDtor().
+DAG nodes are ordinary Node_t without parent links, so functions that only read trees
+(evaluate(), compileExpression(), copyTree(), etc.) work on them; copyTree() converts DAG back to tree.
+Size of DAG node is size of its expanded tree, so copies of big DAGs can be exponentially big.
+Functions that relink or free their argument (simplifyExpression(), deleteTree(), etc.)
+must never get interned nodes. Instead interning constructors fold constants and drop
+neutral elements, so DAG is always simplified without simplifyExpression().
+Gradient, Jacobian and Hessian are built in one pass over the expression, partial derivatives
+share all common subexpressions and are evaluated together by dagEvaluateMany():
+
+    int variables[] = {...};    // see resolveVariables()
+    Node_t *gradient[count];
+    dagGradient(&dag, expr, variables, count, gradient);
+    dagEvaluateMany(&dag, context, gradient, count, values);
+*/
+
+const size_t DAG_CHUNK_SIZE = 1024;          ///< Nodes in one arena chunk
+const size_t DAG_START_BUCKETS_COUNT = 1024;
+const size_t DAG_MAX_EXPANDED_SIZE = SIZE_MAX / 2;  ///< Sizes of nodes saturate at this value
+
+typedef struct DagNode_t {
+    Node_t node;            ///< Must be first member: DagNode_t * is used as Node_t *
+    uint64_t hash;
+    size_t id;              ///< Sequential number, children always have smaller ids
+    DagNode_t *next;        ///< Next node in hash bucket
+} DagNode_t;
+
+typedef struct {
+    DagNode_t **chunks;         ///< Arena: node with id is chunks[id / DAG_CHUNK_SIZE][id % DAG_CHUNK_SIZE]
+    size_t chunksCount;
+    size_t size;                ///< Number of interned nodes
+
+    DagNode_t **buckets;
+    size_t bucketsCount;
+
+    Node_t **derivatives[VARIABLE_TABLE_SIZE];  ///< Memoized derivatives by node id for every variable
+    size_t derivativesSize[VARIABLE_TABLE_SIZE];
+
+    double *values;             ///< Memoized values by node id
+    size_t *valueStamps;        ///< values[id] is valid if valueStamps[id] == evalStamp
+    size_t valuesSize;
+    size_t evalStamp;
+} ExprDag_t;
+
+/// @brief Create empty DAG store
+/// @return TA_MEMORY_ERROR if memory has run out, store can be destructed anyway and interns nothing
+TungstenStatus_t dagCtor(ExprDag_t *dag);
+
+/// @brief Free all nodes of DAG store
+TungstenStatus_t dagDtor(ExprDag_t *dag);
+
+/// @brief Get interned node, creating it if there is no equal one
+/// Children must be interned in the same store
+Node_t *dagNode(ExprDag_t *dag, enum ElemType type, int iVal, double dVal, Node_t *left, Node_t *right);
+
+/// @brief Intern whole tree (tree is not changed)
+Node_t *dagInternTree(ExprDag_t *dag, const Node_t *tree);
+
+/// @brief Derivative of interned expression, memoized for every subexpression
+Node_t *dagDerivative(ExprDag_t *dag, Node_t *expr, int variable);
+
+/// @brief Partial derivatives of interned expressions with respect to several variables.
+/// Every node reachable from exprs is visited once in topological order and differentiated
+/// with respect to all variables it depends on
+/// @param partials Array of exprsCount * variablesCount elements, partials[i * variablesCount + j] = d exprs[i] / d variables[j]
+TungstenStatus_t dagJacobian(ExprDag_t *dag, Node_t *const *exprs, size_t exprsCount,
+                             const int *variables, size_t variablesCount, Node_t **partials);
+
+/// @brief Gradient of interned expression, see dagJacobian()
+/// @param partials Array of variablesCount elements
+TungstenStatus_t dagGradient(ExprDag_t *dag, Node_t *expr, const int *variables, size_t variablesCount,
+                             Node_t **partials);
+
+/// @brief Hessian of interned expression: Jacobian of its gradient
+/// @param gradient Array of variablesCount elements for gradient or NULL
+/// @param hessian Array of variablesCount * variablesCount elements
+TungstenStatus_t dagHessian(ExprDag_t *dag, Node_t *expr, const int *variables, size_t variablesCount,
+                            Node_t **gradient, Node_t **hessian);
+
+/// @brief Evaluate interned expression, each shared subexpression is evaluated once
+double dagEvaluate(ExprDag_t *dag, TungstenContext_t *context, Node_t *expr);
+
+/// @brief Evaluate several interned expressions, subexpressions shared between them are evaluated once
+TungstenStatus_t dagEvaluateMany(ExprDag_t *dag, TungstenContext_t *context, Node_t *const *exprs, size_t count,
+                                 double *values);
+
+#endif
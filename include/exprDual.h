@@ -0,0 +1,28 @@
+#ifndef EXPR_DUAL_H
+#define EXPR_DUAL_H
+
+/*
+Forward mode automatic differentiation on dual numbers a + a' e, e^2 = 0.
+Every value carries its derivative with respect to one variable,
+so f and f' are computed in one pass without building derivative tree.
+Value part is always the same as evaluate() gives.
+*/
+
+typedef struct {
+    double value;
+    double derivative;
+} Dual_t;
+
+/// @brief Apply operator to dual numbers, right is ignored for unary operators
+Dual_t dualOperation(enum OperatorType op, Dual_t left, Dual_t right);
+
+/// @brief Value and derivative of expression with respect to variable at current values of context
+Dual_t evaluateDual(TungstenContext_t *context, const Node_t *expr, int variable);
+
+/// @brief Batch evaluation of value and derivative with respect to variable, see evaluateBatch()
+/// @param values, derivatives Arrays of pointsCount elements for results
+TungstenStatus_t evaluateBatchDual(TungstenContext_t *context, const CompiledExpr_t *compiled, int variable,
+                                   const BatchVariable_t *inputs, size_t inputsCount,
+                                   double *values, double *derivatives, size_t pointsCount);
+
+#endif
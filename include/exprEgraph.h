@@ -0,0 +1,66 @@
+#ifndef EXPR_EGRAPH_H
+#define EXPR_EGRAPH_H
+
+/*
+Optimizer of expressions for numeric evaluation by equality saturation.
+Tree is loaded into e-graph: classes of equal expressions, where every e-node is an operator
+applied to classes, so equal subtrees are stored once. Rewrites (commutativity, associativity,
+factoring, merging of powers, logarithms and fractions, powers with integer exponent as
+multiplications) only add e-nodes and merge classes, nothing is ever removed, so all forms
+found so far are kept at once. Constants are folded in every class. Saturation stops when rules
+add nothing new or limits of nodes, iterations or time are reached, then the cheapest tree is
+extracted by cost of evaluation, where POW, logarithms and trigonometry are far more expensive
+than ADD and MUL. Rewrites keep values on domain of original expression, ln(a) + ln(b) = ln(a*b)
+is defined where original is not.
+
+    EgraphStats_t stats = {};
+    expr = optimizeExpression(expr, EGRAPH_DEFAULT_LIMITS, &stats);
+    compileExpression(expr, &program);
+*/
+
+const size_t EGRAPH_START_CAPACITY = 1024;
+const int EGRAPH_MAX_EXPANDED_POWER = 16;      ///< x^16 is at most 15 multiplications
+
+/// @brief Cost of one operation in evaluate(), numbers and variables cost nothing
+const double EGRAPH_OPERATION_COST[] = {
+    1,      ///< ADD
+    1,      ///< SUB
+    1,      ///< MUL
+    4,      ///< DIV
+    40,     ///< POW
+    30,     ///< SIN
+    30,     ///< COS
+    40,     ///< SINH
+    40,     ///< COSH
+    35,     ///< TAN
+    40,     ///< CTG
+    60,     ///< LOG
+    30,     ///< LOGN
+};
+
+typedef struct {
+    size_t maxNodes;            ///< E-nodes, tree bigger than that is not optimized
+    size_t maxIterations;       ///< Passes of all rules over e-graph
+    double maxTimeMs;
+} EgraphLimits_t;
+
+const EgraphLimits_t EGRAPH_DEFAULT_LIMITS = {20000, 32, 200};
+
+typedef struct {
+    double costBefore;
+    double costAfter;
+    size_t iterations;
+    size_t nodes;               ///< E-nodes in the end
+    size_t classes;
+    bool saturated;             ///< Rules found nothing new before limits
+} EgraphStats_t;
+
+/// @brief Cost of evaluation of tree, operation of n-ary node with k operands is counted k - 1 times
+double expressionCost(const Node_t *node);
+
+/// @brief Find the cheapest tree equal to given one, see EGRAPH_OPERATION_COST
+/// @param stats Statistics or NULL
+/// @return Optimized tree, node is deleted then; node itself if there is no memory or it is too big
+Node_t *optimizeExpression(Node_t *node, EgraphLimits_t limits, EgraphStats_t *stats);
+
+#endif
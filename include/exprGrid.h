@@ -0,0 +1,30 @@
+#ifndef EXPR_GRID_H
+#define EXPR_GRID_H
+
+/*
+Parallel evaluation of compiled expression over dense grid.
+Grid is split into tasks of GRID_TASK_POINTS consecutive points which are run on thread pool.
+Every worker computes coordinates of its points into its own buffers (per-thread variable bindings),
+variables that are not grid axes are only read from context, so context is never changed.
+Every point is computed by the same code whatever thread runs it,
+so results don't depend on number of threads.
+*/
+
+const size_t GRID_MAX_AXES    = 4;
+const size_t GRID_TASK_POINTS = 16 * BATCH_BLOCK_SIZE;
+
+/// @brief Axis of grid: count points min + i * (max - min) / count
+typedef struct {
+    int var;                ///< Index of variable in context
+    double min;
+    double max;
+    size_t count;
+} GridAxis_t;
+
+/// @brief Evaluate compiled expression in all points of grid
+/// @param axes Axes of grid, the first axis changes fastest in result
+/// @param result Array of product of axes counts values
+TungstenStatus_t evaluateGrid(ThreadPool_t *pool, TungstenContext_t *context, const CompiledExpr_t *compiled,
+                              const GridAxis_t *axes, size_t axesCount, double *result);
+
+#endif
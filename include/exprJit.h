@@ -0,0 +1,38 @@
+#ifndef EXPR_JIT_H
+#define EXPR_JIT_H
+
+/*
+Native x86-64 backend: compiled program is translated into SSE2 machine code
+in mmap'd executable memory. Transcendental operations call libm, so results match evaluate().
+Generated function reads variables directly from TungstenContext_t::variables.
+JIT is disabled on other platforms or by defining DISABLE_JIT, then evaluateJit() falls back to evaluate()
+*/
+
+#if defined(__x86_64__) && defined(__unix__) && !defined(DISABLE_JIT)
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+typedef double (*JitFunction_t)(const variable_t *variables);
+
+typedef struct {
+    const Node_t *expr;         ///< Expression for fallback to evaluate()
+    JitFunction_t function;     ///< NULL if JIT is not available for this expression
+
+    void *code;                 ///< Executable memory
+    size_t codeSize;            ///< Size of mapped memory
+} JitExpr_t;
+
+/// @brief Translate expression into machine code
+/// Succeeds even if JIT is not supported: evaluateJit() will use evaluate()
+/// Expression must outlive jit
+TungstenStatus_t compileJit(const Node_t *expr, JitExpr_t *jit);
+
+/// @brief Evaluate expression using native code or evaluate() as fallback
+double evaluateJit(TungstenContext_t *context, const JitExpr_t *jit);
+
+/// @brief Unmap executable memory
+TungstenStatus_t deleteJit(JitExpr_t *jit);
+
+#endif
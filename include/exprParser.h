@@ -29,6 +29,9 @@ Func   ::=["sin" "cos" "tg" "ctg" "ln"]'(' Expr ')'
 Var    ::=['a'-'z''_']+ ['a'-'z''_''0'-'9']*
 
 Num    ::=strtod() (any valid floating point number)
+
+Parser keeps operators and operands in explicit stacks instead of recursion,
+so nesting depth and length of expression are limited only by memory.
 */
 
 #define SyntaxError(context, ret, ...)                                      \
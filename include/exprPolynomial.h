@@ -0,0 +1,58 @@
+#ifndef EXPR_POLYNOMIAL_H
+#define EXPR_POLYNOMIAL_H
+
+/*
+Dense polynomials in one variable: p(x) = c[0] + c[1] x + ... + c[degree] x^degree.
+Subtree built of numbers, the variable, +, -, *, division by constant and natural
+constant powers is converted to array of coefficients, subtrees without variables are
+evaluated to numbers. Evaluation is Horner's scheme without pow() calls, derivative,
+sum and product are computed on coefficients in O(degree) and O(degree^2), so tree
+is built back only for printing:
+
+    Polynomial_t poly = {};
+    if (polynomialFromTree(expr, variable, &poly) == TA_SUCCESS)
+        value = polynomialEvaluate(&poly, x);
+    polynomialDtor(&poly);
+*/
+
+const size_t POLYNOMIAL_MAX_DEGREE = 4096;       ///< Bigger powers are left to trees
+
+typedef struct {
+    int variable;
+    size_t degree;              ///< Coefficients above degree are zero, degree of zero polynomial is 0
+    double *coefficients;
+    size_t capacity;
+} Polynomial_t;
+
+/// @brief Zero polynomial with memory for given degree
+TungstenStatus_t polynomialCtor(Polynomial_t *poly, int variable, size_t capacityDegree);
+
+/// @brief Free memory of polynomial
+TungstenStatus_t polynomialDtor(Polynomial_t *poly);
+
+/// @brief Convert tree to polynomial in variable
+/// @param poly Polynomial constructed by caller or zero-initialized, its coefficients are replaced
+/// @return TA_SYNTAX_ERROR if tree isn't polynomial in variable or its degree exceeds POLYNOMIAL_MAX_DEGREE
+TungstenStatus_t polynomialFromTree(const Node_t *node, int variable, Polynomial_t *poly);
+
+/// @brief Sum of c[k] * x^k from the highest power, zero terms are skipped
+Node_t *polynomialToTree(const Polynomial_t *poly);
+
+/// @brief Value by Horner's scheme
+double polynomialEvaluate(const Polynomial_t *poly, double x);
+
+/// @brief result = first + second, result can be one of arguments
+TungstenStatus_t polynomialAdd(const Polynomial_t *first, const Polynomial_t *second, Polynomial_t *result);
+
+/// @brief result = first * second, result must not be one of arguments
+TungstenStatus_t polynomialMul(const Polynomial_t *first, const Polynomial_t *second, Polynomial_t *result);
+
+/// @brief result = poly', result can be poly
+TungstenStatus_t polynomialDerivative(const Polynomial_t *poly, Polynomial_t *result);
+
+/// @brief Derivative of polynomial subtree as tree
+/// @param maxNodes Limit of result size: expanded (x+1)^100 is bigger than its derivative by rules
+/// @return Derivative or NULL if node isn't polynomial in variable, result is too big or memory has run out
+Node_t *polynomialDerivativeTree(const Node_t *node, int variable, size_t maxNodes);
+
+#endif
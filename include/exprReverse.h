@@ -0,0 +1,60 @@
+#ifndef EXPR_REVERSE_H
+#define EXPR_REVERSE_H
+
+/*
+Reverse mode automatic differentiation: evaluation of tree records every operation
+with its arguments and result on tape, then one backward sweep accumulates adjoints
+df/dv of all entries from the root to the leaves, so value and partial derivatives
+by all variables cost a few evaluations whatever the number of variables is.
+N-ary operands are accumulated from left to right as in evaluate(), so values are identical.
+Tape keeps its memory between calls, evaluation of trees not bigger than previous ones
+allocates nothing:
+
+    ReverseTape_t tape = reverseTapeCtor();
+    for (...)
+        evaluateGradient(&tape, context, expr, &value, gradient);
+    reverseTapeDtor(&tape);
+*/
+
+typedef struct {
+    double value;
+    double adjoint;         ///< Derivative of result by this entry, filled by backward sweep
+    uint32_t left;          ///< Entry of left argument, variable index for INSTR_VARIABLE
+    uint32_t right;         ///< Entry of right argument, the same as left for unary operators
+    uint8_t code;           ///< enum InstrCode
+    bool active;            ///< Depends on variables, inactive entries pass no adjoint to arguments
+} TapeEntry_t;
+
+/// @brief Operator node, number of its recorded arguments and entry of accumulated arguments
+typedef struct {
+    const Node_t *node;
+    unsigned evaluatedArgs;
+    uint32_t accumulated;
+} TapeFrame_t;
+
+typedef struct {
+    TapeEntry_t *entries;
+    size_t size;
+    size_t capacity;
+
+    TapeFrame_t *frames;        ///< Traversal stack, kept between calls as entries are
+    size_t framesCapacity;
+} ReverseTape_t;
+
+/// @brief Empty tape, memory is taken on first evaluation
+ReverseTape_t reverseTapeCtor();
+
+/// @brief Free memory of tape
+TungstenStatus_t reverseTapeDtor(ReverseTape_t *tape);
+
+/// @brief Value and partial derivatives by all variables at current values of context
+/// @param gradient Array of context->variablesCount elements, gradient[var] is derivative by variable var
+TungstenStatus_t evaluateGradient(ReverseTape_t *tape, TungstenContext_t *context, const Node_t *expr,
+                                  double *value, double *gradient);
+
+/// @brief Reentrant evaluateGradient(): values of variables are taken from values[var]
+/// @param gradient Array of variablesCount elements, all variables of expr must be less than variablesCount
+TungstenStatus_t evaluateGradientWith(ReverseTape_t *tape, const Node_t *expr, const double *values,
+                                      size_t variablesCount, double *value, double *gradient);
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef EXPR_REWRITE_H
+#define EXPR_REWRITE_H
+
+/*
+Rewrite rules of simplifier written as tables of strings:
+
+    {"a * 1", "a"}, {"sin(a)^2 + cos(a)^2", "1"}, {"(a^b)^c", "a^(b*c)", isIntegerC}
+
+Variables a, b, c, d of pattern are wildcards, each matches any subtree, repeated wildcard
+matches only equal subtrees. Numbers of subject are compared exactly, so "a * 0" doesn't match 1e-13 * x.
+Table is compiled once into discrimination tree: trie over pre-order of patterns,
+where operator or number is an edge keyed by (type, value, number of operands) and
+wildcard is a separate edge that skips whole subtree. One walk of trie over subject finds
+all rules that can match it, every step is one lookup in hash table of edges, so cost of
+matching depends on size of patterns and not on their count. Candidates are checked
+exactly, the first rule of table wins. Commutative operators of pattern with two operands
+are compiled in both orders. Sum or product with more operands is matched by pairs of its
+operands: sin(x)^2 + y + cos(x)^2 = 1 + y.
+simplifyExpression() and removeNeutralOperations() use current rules of thread:
+
+    RewriteRules_t rules = {};
+    rewriteRulesCtor(&rules, table, count);
+    RewriteRules_t *previous = rewriteRulesSelect(&rules);
+    ... simplify ...
+    rewriteRulesSelect(previous);
+    rewriteRulesDtor(&rules);
+*/
+
+const size_t REWRITE_MAX_WILDCARDS = 4;             ///< a, b, c, d
+const size_t REWRITE_MAX_PATTERN_NODES = 16;
+const size_t REWRITE_MAX_CANDIDATES = 16;           ///< Rules checked exactly for one node
+const size_t REWRITE_MAX_COMMUTATIVE_NODES = 3;     ///< Pattern has at most 2^3 variants
+const size_t REWRITE_MAX_PAIRED_OPERANDS = 64;      ///< Bigger sums and products are not searched for pairs
+const size_t REWRITE_START_EDGES_CAPACITY = 64;
+
+/// @brief Additional check of matched subtrees
+/// @param wildcards Subtrees matched by a, b, c, d, NULL for wildcards missing in pattern
+typedef bool (*RewriteCondition_t)(Node_t *const *wildcards);
+
+typedef struct {
+    const char *pattern;
+    const char *replacement;
+    RewriteCondition_t condition;   ///< NULL if pattern is enough
+    const char *texComment;         ///< Introduction of step in report, NULL for default one
+} RewriteRule_t;
+
+/// @brief Pattern of rule with fixed order of commutative operands
+typedef struct {
+    size_t rule;                    ///< Index in table
+    Node_t *pattern;
+    Node_t *replacement;            ///< Shared by variants of rule
+} RewriteVariant_t;
+
+typedef struct {
+    uint32_t wildcard;              ///< State after wildcard edge, 0 if there is none
+    uint32_t firstMatch;            ///< Head of list of variants ending here, 0 if there are none
+} RewriteState_t;
+
+/// @brief Edge of discrimination tree, empty if child is 0 (root is never a child)
+typedef struct {
+    uint32_t parent;
+    uint32_t child;
+    enum ElemType type;
+    uint64_t value;
+    size_t arity;
+} RewriteEdge_t;
+
+/// @brief Item of list of variants ending in state, index 0 is unused
+typedef struct {
+    uint32_t variant;
+    uint32_t next;
+} RewriteMatch_t;
+
+typedef struct {
+    const RewriteRule_t *table;     ///< Must outlive compiled rules
+    size_t rulesCount;
+
+    RewriteVariant_t *variants;
+    size_t variantsCount;
+    size_t variantsCapacity;
+
+    RewriteState_t *states;         ///< State 0 is root
+    size_t statesCount;
+    size_t statesCapacity;
+
+    RewriteEdge_t *edges;           ///< Open addressing by (parent, key), capacity is power of 2
+    size_t edgesCount;
+    size_t edgesCapacity;
+
+    RewriteMatch_t *matches;
+    size_t matchesCount;
+    size_t matchesCapacity;
+
+    NodeArena_t arena;              ///< Nodes of patterns and replacements
+    uint64_t hash;                  ///< Identity of rule set, keys simplified trees in memo cache
+} RewriteRules_t;
+
+/// @brief Compile table of rules
+/// @return TA_SYNTAX_ERROR if pattern can't be parsed, uses unknown wildcard or is too big
+TungstenStatus_t rewriteRulesCtor(RewriteRules_t *rules, const RewriteRule_t *table, size_t count);
+
+/// @brief Release memory of compiled rules
+TungstenStatus_t rewriteRulesDtor(RewriteRules_t *rules);
+
+/// @brief Rules of simplifier: neutral operations and trigonometric and logarithmic identities,
+/// compiled on first call and shared by all threads
+const RewriteRules_t *defaultRewriteRules();
+
+/// @brief Make rules current for calling thread
+/// @param rules Rules or NULL for default rules
+/// @return Previous current rules
+const RewriteRules_t *rewriteRulesSelect(const RewriteRules_t *rules);
+
+/// @brief Current rules of calling thread
+const RewriteRules_t *rewriteRulesCurrent();
+
+/// @brief Called for every new operator node of replacement bottom-up, returns simplified node
+typedef Node_t *(*RewriteFinish_t)(TexContext_t *tex, TungstenContext_t *context, Node_t *node, size_t depth,
+                                   bool *changedTree);
+
+/// @brief Replace node by the first rule that matches it.
+/// Matched subtrees are moved to replacement, other nodes are deleted
+/// @param depth Depth of node in tree for narration budget
+/// @param finish Simplifier of new nodes, called without narration, can be NULL
+/// @return Replacement or node itself if no rule matches
+Node_t *rewriteNode(TexContext_t *tex, TungstenContext_t *context, const RewriteRules_t *rules, Node_t *node,
+                    size_t depth, bool *changedTree, RewriteFinish_t finish);
+
+#endif
@@ -14,7 +14,6 @@ const char * const DEFAULT_NODE_COLOR   = "#000000";
 const size_t DUMP_BUFFER_SIZE = 128;
 const size_t PREFIX_PARSER_BUFFER_SIZE = 32;
 
-const size_t EXPR_TREE_MAX_LIST_COUNT = 64;
 const size_t EXPR_TREE_MAX_SUBST_COUNT = 64;
 const double DOUBLE_EPSILON = 1e-12; //epsilon for comparing doubles
 
@@ -43,7 +42,7 @@ enum OperatorType {
 typedef struct {
     enum OperatorType opCode;
     bool binary;            ///< Has two arguments
-    bool commutative;       ///< a # b = b # a
+    bool commutative;       ///< a # b = b # a, such operator can be n-ary
     const char *str;        ///< string to write in dump
     const char *texStr;     ///< string to write in tex
     unsigned priority;      ///< Priority of operation (bigger = executes first) (affects only tex)
@@ -109,6 +108,13 @@ typedef struct Node_t {
 
     Node_t *left;
     Node_t *right;
+
+    Node_t **operands;      ///< Operands of n-ary commutative operator, left and right are NULL then
+    size_t operandsCount;   ///< 0 for nodes with left and right
+
+    uint64_t hash;          ///< Structural hash of subtree, see updateNodeInfo()
+    size_t size;            ///< Nodes in subtree
+    uint64_t varMask;       ///< Bit i is set if subtree depends on variable i
 } Node_t;
 
 /*==========================TunsgtenAlgebra context==========================*/
@@ -119,14 +125,45 @@ TungstenContext_t TungstenCtor();
 TungstenStatus_t TungstenDtor(TungstenContext_t *context);
 
 /*============================Node manipulations===================================*/
-/// @brief Create node of given type
+/// @brief Create node of given type, memory is taken from current node arena
 Node_t *createNode(enum ElemType type, int iVal, double dVal, Node_t *left, Node_t *right);
 
-/// @brief Delete tree recursively
+/// @brief Create n-ary node of commutative operator, pointers to operands are copied
+/// @return Node or NULL, operands are not deleted then
+Node_t *createNaryNode(enum OperatorType op, Node_t *const *operands, size_t count);
+
+/// @brief Append operand to n-ary node in amortized O(1), array of operands grows twice when it is full.
+/// Hashes of ancestors are not updated
+TungstenStatus_t appendOperand(Node_t *node, Node_t *operand);
+
+/// @brief Delete tree recursively, nodes are returned to their arena
 TungstenStatus_t deleteTree(Node_t *node);
 
 /// @brief Create copy of tree recursively
-Node_t *copyTree(Node_t *node);
+Node_t *copyTree(const Node_t *node);
+
+/// @brief Count nodes in tree
+size_t countNodes(const Node_t *node);
+
+/// @brief Recompute hash, size and variables mask of node from its children in O(number of children).
+/// createNode() and copyTree() keep them valid, code that relinks or changes nodes must call it bottom-up
+void updateNodeInfo(Node_t *node);
+
+/// @brief Check if tree depends on variable in O(1) using mask of root
+bool hasVariable(const Node_t *node, int variable);
+
+/// @brief Compare trees structurally, numbers are compared bitwise
+bool equalTrees(const Node_t *first, const Node_t *second);
+
+/// @brief Total structural order of trees: numbers < variables < operators, then values and operands
+/// in pre-order. Returns 0 only for equal trees, so it defines canonical order of commutative operands
+int compareTrees(const Node_t *first, const Node_t *second);
+
+/// @brief Combine hash with value
+uint64_t hashMix(uint64_t hash, uint64_t value);
+
+/// @brief Bits of node value for hashing and exact comparison
+uint64_t nodeValueBits(enum ElemType type, union NodeValue value);
 
 
 /*=========================Creating expressions from strings===================*/
@@ -143,6 +180,11 @@ Node_t *parseExpressionPrefix(TungstenContext_t *context, const char *expression
 /// @brief Evaluate given expression
 double evaluate(TungstenContext_t *context, const Node_t *node);
 
+/// @brief Evaluate expression with values of variables supplied by caller.
+/// Doesn't touch context, so one expression can be evaluated by several threads at once
+/// @param values Values of variables indexed by variable index (see resolveVariables(), getVariableValues())
+double evaluateWith(const Node_t *node, const double *values);
+
 double calculateOperation(enum OperatorType op, double left, double right);
 
 
@@ -159,9 +201,18 @@ TungstenStatus_t dumpTree(TungstenContext_t *context, Node_t *node, bool minifie
 /// @brief Print equation in LaTeX form with $
 int exprTexDump(TexContext_t *tex, TungstenContext_t *context, Node_t *node);
 
-/// @brief Print equation in LaTeX form without $
+/// @brief Print equation in LaTeX form without $.
+/// Subtrees bigger than tex->budget.maxNodes are printed as placeholders \mathcal{E}_k
 int exprTexDumpRecursive(TexContext_t *tex, TungstenContext_t *context, Node_t *node);
 
+/// @brief Name subtrees of node that will be printed as placeholders and print their definitions.
+/// Called by narrating code before paragraph with formulas of node
+void exprTexDefine(TexContext_t *tex, TungstenContext_t *context, Node_t *node);
+
+/// @brief Print definitions of placeholders that were printed without exprTexDefine().
+/// Must be called after paragraph with formulas while printed trees are alive
+void exprTexFlush(TexContext_t *tex, TungstenContext_t *context);
+
 /// @brief Plot graph using pgfplots
 /// yMax is maximum module value of y
 TungstenStatus_t plotExprGraph(TexContext_t *tex, TungstenContext_t *context,
@@ -173,12 +224,27 @@ TungstenStatus_t plotExprGraph(TexContext_t *tex, TungstenContext_t *context,
 /// @brief Fold constants in tree
 Node_t *foldConstants(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool *changedTree);
 
-/// @brief Remove neutral operations such as *1, +0, ^1, etc.
+/// @brief Remove neutral operations such as *1, +0, ^1, etc. and apply identities of current rewrite rules
+/// (see exprRewrite.h)
 Node_t *removeNeutralOperations(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool *changedTree);
 
-/// @brief Combine foldConstants() and removeNeutralOperations() while tree can be simplified
+/// @brief Sort operands of sums and products in canonical order and collect like terms:
+/// x + x = 2*x, x * x = x^2, x^a * x^b = x^(a+b). Numbers must be already folded
+Node_t *collectLikeTerms(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool *changedTree);
+
+/// @brief Simplify tree with the rules of foldConstants(), collectLikeTerms() and removeNeutralOperations()
+/// in one post-order pass, every node is visited once
 Node_t *simplifyExpression(TexContext_t *tex, TungstenContext_t *context, Node_t *node);
 
+typedef struct {
+    size_t calls;           ///< Simplified trees, cache hits are not counted
+    size_t visited;         ///< Nodes visited by simplifyExpression()
+    size_t rewrites;        ///< Folded constants and removed neutral operations
+} SimplifyStats_t;
+
+/// @brief Counters of simplifications in calling thread, can be reset by caller
+SimplifyStats_t *simplifyStats();
+
 
 /*=====================NameTable functions==========================*/
 size_t insertVariable(TungstenContext_t *tungsten, const char *buffer);
@@ -193,6 +259,15 @@ const char *getVariableName(TungstenContext_t *tungsten, int varIdx);
 
 double getVariableByName(TungstenContext_t *tungsten, const char *variableName);
 
+/// @brief Find indices of variables once, so values can be passed in dense vector
+/// @param indices Array of count indices, NULL_VARIABLE for unknown names
+/// @return Number of found variables
+size_t resolveVariables(TungstenContext_t *tungsten, const char *const *names, size_t count, int *indices);
+
+/// @brief Copy values of all variables of context to dense vector indexed by variable index
+/// @param values Array of at least VARIABLE_TABLE_SIZE elements
+void getVariableValues(const TungstenContext_t *tungsten, double *values);
+
 
 /*===================================================================*/
 
@@ -0,0 +1,98 @@
+#ifndef NODE_ARENA_H
+#define NODE_ARENA_H
+
+/*
+Pool allocator for Node_t.
+Nodes are cut from big chunks aligned to their size, so owner arena of any node is found
+by masking its address. deleteTree() returns nodes to free list of owner arena,
+nodeArenaReset() releases all nodes of arena at once without touching them.
+Every thread has its own default arena, released when thread exits,
+and can switch to another one, e.g. arena of a job:
+
+    NodeArena_t job = nodeArenaCtor();
+    NodeArena_t *previous = nodeArenaSelect(&job);
+    ... parse, differentiate, simplify ...
+    nodeArenaSelect(previous);
+    nodeArenaDtor(&job);        // all trees of the job are gone
+
+Operand arrays of n-ary nodes are allocated by operandsAlloc() from system allocator,
+but belong to owner arena of their node, so nodeArenaReset() releases them together with nodes
+even if they were allocated while another arena was current.
+
+Nodes must be deleted by the thread that uses their arena.
+*/
+
+const size_t NODE_ARENA_CHUNK_SIZE = 64 * 1024;     ///< Size and alignment of chunk in bytes
+
+typedef struct NodeChunk_t {
+    struct NodeArena_t *arena;  ///< Owner of nodes in chunk
+    NodeChunk_t *next;
+} NodeChunk_t;
+
+/// @brief Header of operands array, arrays of arena are linked to be released with it
+typedef struct OperandsBlock_t {
+    struct NodeArena_t *arena;
+    OperandsBlock_t *prev;
+    OperandsBlock_t *next;
+    size_t capacity;
+} OperandsBlock_t;
+
+typedef struct {
+    size_t allocations;         ///< Nodes created
+    size_t releases;            ///< Nodes returned one by one
+    size_t bulkReleases;        ///< Nodes released by nodeArenaReset() or nodeArenaDtor()
+    size_t chunks;              ///< Chunks requested from system allocator
+    size_t liveNodes;           ///< Nodes in use now
+    size_t peakNodes;           ///< Maximum of liveNodes
+} NodeArenaStats_t;
+
+typedef struct NodeArena_t {
+    NodeChunk_t *chunks;        ///< All chunks in order of usage
+    NodeChunk_t *current;       ///< Chunk used for bump allocation
+    size_t used;                ///< Nodes taken from current chunk
+    Node_t *freeList;           ///< Released nodes linked through left pointer
+    OperandsBlock_t *operands;  ///< Operand arrays of n-ary nodes
+
+    NodeArenaStats_t stats;
+} NodeArena_t;
+
+/// @brief Create empty arena, memory is requested on first allocation
+NodeArena_t nodeArenaCtor();
+
+/// @brief Release all nodes and return chunks to system
+TungstenStatus_t nodeArenaDtor(NodeArena_t *arena);
+
+/// @brief Same as nodeArenaDtor() but without report to log, for destructors that run at thread exit
+TungstenStatus_t nodeArenaRelease(NodeArena_t *arena);
+
+/// @brief Release all nodes in O(1), chunks are kept for reuse
+TungstenStatus_t nodeArenaReset(NodeArena_t *arena);
+
+/// @brief Make arena current for calling thread
+/// @param arena Arena or NULL for default arena of thread
+/// @return Previous current arena
+NodeArena_t *nodeArenaSelect(NodeArena_t *arena);
+
+/// @brief Current arena of calling thread
+NodeArena_t *nodeArenaCurrent();
+
+/// @brief Allocate zeroed node from current arena
+Node_t *nodeAlloc();
+
+/// @brief Return node and its operands array to owner arena
+void nodeFree(Node_t *node);
+
+/// @brief Allocate zeroed array of operands for n-ary node in owner arena of node
+Node_t **operandsAlloc(Node_t *node, size_t capacity);
+
+/// @brief Change capacity of operands array of node, like realloc() it can move array
+/// @return New array or NULL, then old array is kept in node
+Node_t **operandsRealloc(Node_t *node, size_t capacity);
+
+/// @brief Number of operands that fit into array
+size_t operandsCapacity(Node_t **operands);
+
+/// @brief Return operands array to its owner arena
+void operandsFree(Node_t **operands);
+
+#endif
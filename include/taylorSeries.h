@@ -0,0 +1,23 @@
+#ifndef TAYLOR_SERIES_H
+#define TAYLOR_SERIES_H
+
+/*
+Truncated power series arithmetic (Taylor mode automatic differentiation).
+Every value of compiled program is replaced by coefficients a[0..order] of series
+a(t) = a[0] + a[1] t + ... + a[order] t^order, where variable = point + t.
+Operators propagate coefficients by standard recurrences, e.g. for c = a * b
+c[n] = sum(a[k] * b[n - k]), so all Taylor coefficients of expression are computed
+in O(order^2 * nodes) without building derivative trees.
+*/
+
+/// @brief Coefficients of Taylor series of expr around point
+/// @param variable Index of variable of expansion, other variables are taken from context
+/// @param coefficients Array of order + 1 elements, coefficients[k] = f^(k)(point) / k!
+TungstenStatus_t taylorSeries(TungstenContext_t *context, const Node_t *expr, int variable,
+                              double point, size_t order, double *coefficients);
+
+/// @brief The same as taylorSeries() for already compiled expression
+TungstenStatus_t taylorSeriesCompiled(TungstenContext_t *context, const CompiledExpr_t *compiled, int variable,
+                                      double point, size_t order, double *coefficients);
+
+#endif
@@ -9,18 +9,69 @@ enum TexStatus {
     TEX_ERROR
 };
 
+/// @brief Limits of step-by-step narration, 0 means unlimited
+typedef struct {
+    size_t maxSteps;        ///< Steps narrated by one operation, the rest is summarized
+    size_t maxDepth;        ///< Steps on deeper levels of tree are not narrated
+    size_t maxNodes;        ///< Bigger subtrees are printed as named placeholders
+} TexBudget_t;
+
+const TexBudget_t TEX_DEFAULT_BUDGET = {100, 8, 40};
+const size_t TEX_START_PLACEHOLDERS_CAPACITY = 64;
+
+/// @brief Name of subtree printed as placeholder
+typedef struct {
+    uint64_t hash;          ///< Structural hash of subtree
+    size_t name;            ///< Index of placeholder, 0 for empty slot
+} TexPlaceholder_t;
+
+struct Node_t;
+
 typedef struct {
     char fileName[TEX_MAX_FILENAME_SIZE];
     FILE *file;
 
     bool active;
     enum TexStatus status;
+    size_t written;                     ///< Bytes printed to file
+
+    TexBudget_t budget;
+    size_t steps;                       ///< Steps narrated since last texSummary()
+    size_t skippedSteps;                ///< Steps skipped since last texSummary()
+
+    TexPlaceholder_t *placeholders;     ///< Open addressing table of named subtrees
+    size_t placeholdersCount;
+    size_t placeholdersCapacity;
+
+    struct Node_t **pending;            ///< Named subtrees printed before their definitions
+    size_t pendingCount;
+    size_t pendingCapacity;
 } TexContext_t;
 
 const char * const DEFAULT_TEX_FILE_NAME = "article.tex";
 
 TexContext_t texInit(const char *name);
 
+/// @brief Check if report is written. NULL tex selects compute-only mode for one call,
+/// inactive tex (e.g. zero-initialized) for every call that uses it.
+/// Narrating code must check it before building anything for the report
+bool texNarrating(const TexContext_t *tex);
+
+/// @brief Check budget and count step of narration
+/// @param depth Depth of step in tree, 0 if it is not a step of tree traversal
+/// @return Whether step must be narrated
+bool texStep(TexContext_t *tex, size_t depth);
+
+/// @brief Print how many steps were skipped since last summary and start counting again
+void texSummary(TexContext_t *tex);
+
+/// @brief Name of placeholder of subtree with given hash, 0 if there is no such placeholder
+size_t texFindPlaceholder(const TexContext_t *tex, uint64_t hash);
+
+/// @brief Create new placeholder for subtree with given hash
+/// @return Name of placeholder, 0 if there is no memory
+size_t texAddPlaceholder(TexContext_t *tex, uint64_t hash);
+
 int texPrintf(TexContext_t *tex, const char *fmt, ...);
 enum TexStatus texClose(TexContext_t *tex);
 
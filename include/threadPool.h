@@ -0,0 +1,73 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+/*
+Thread pool with work stealing.
+threadPoolRun() splits tasks 0..tasksCount-1 into equal contiguous ranges, one per worker.
+Worker takes tasks from the front of its own range, when it is empty worker steals
+the back half of range of another worker, so expensive parts of job are shared
+by all threads. Calling thread works as worker 0.
+Which worker runs a task is not deterministic, so task results must not depend on it.
+*/
+
+const size_t THREAD_POOL_CACHE_LINE = 64;
+
+/// @brief Task of job
+/// @param arg Argument of job
+/// @param task Index of task
+/// @param worker Index of worker in [0, threadsCount), e.g. to use its scratch memory
+typedef void (*PoolTask_t)(void *arg, size_t task, size_t worker);
+
+/// @brief Tasks range of worker, aligned to cache line to avoid false sharing
+typedef struct alignas(THREAD_POOL_CACHE_LINE) {
+    pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+
+    struct ThreadPool_t *pool;
+    size_t worker;
+
+    size_t executed;            ///< Tasks executed by worker in current job
+    size_t steals;              ///< Successful steals of worker in current job
+    size_t stolen;              ///< Tasks stolen by worker from others in current job
+} PoolQueue_t;
+
+typedef struct {
+    size_t jobs;
+    size_t tasks;
+    size_t steals;
+    size_t stolenTasks;
+} ThreadPoolStats_t;
+
+typedef struct ThreadPool_t {
+    size_t threadsCount;        ///< Workers including calling thread
+    pthread_t *threads;         ///< threadsCount - 1 started threads
+    PoolQueue_t *queues;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeUp;
+    pthread_cond_t finished;
+    size_t generation;          ///< Number of started jobs
+    size_t busyWorkers;
+    bool stop;
+
+    PoolTask_t task;
+    void *arg;
+
+    ThreadPoolStats_t stats;
+} ThreadPool_t;
+
+/// @brief Number of online processors
+size_t threadPoolDefaultThreads();
+
+/// @brief Start threads of pool
+/// @param threadsCount Number of workers including calling thread or 0 for threadPoolDefaultThreads()
+TungstenStatus_t threadPoolCtor(ThreadPool_t *pool, size_t threadsCount);
+
+/// @brief Stop threads and free memory of pool
+TungstenStatus_t threadPoolDtor(ThreadPool_t *pool);
+
+/// @brief Run tasksCount tasks on all workers and wait for them
+TungstenStatus_t threadPoolRun(ThreadPool_t *pool, PoolTask_t task, void *arg, size_t tasksCount);
+
+#endif
@@ -1,15 +1,104 @@
-static Node_t *createOperatorNode(enum OperatorType op, Node_t *left, Node_t *right) {
+static inline Node_t *createOperatorNode(enum OperatorType op, Node_t *left, Node_t *right) {
     return createNode(OPERATOR, op, 0, left, right);
 }
 
-static Node_t *createNumberNode(double number) {
+static inline Node_t *createNumberNode(double number) {
     return createNode(NUMBER, 0, number, NULL, NULL);
 }
 
+/// @brief Exact zero test: small but nonzero numbers (e.g. high order Taylor coefficients) are meaningful
+static inline bool isZero(double value) {
+    return fpclassify(value) == FP_ZERO;
+}
+
+static inline bool isNumberNode(const Node_t *node, double number) {
+    return node && node->type == NUMBER && isZero(node->value.number - number);
+}
+
+/// @brief Result of folding that is one of operands, the other one is deleted
+static inline Node_t *keepOperand(Node_t *kept, Node_t *dropped) {
+    deleteTree(dropped);
+    return kept;
+}
+
+/// @brief Operator node of two operands, both are deleted if one of them is NULL or memory has run out
+static inline Node_t *joinOperatorNode(enum OperatorType op, Node_t *left, Node_t *right) {
+    Node_t *result = (left && right) ? createOperatorNode(op, left, right) : NULL;
+    if (!result) {
+        deleteTree(left);
+        deleteTree(right);
+    }
+    return result;
+}
+
+/// @brief Operator node with constant folding and removal of neutral operations at construction time,
+/// the same rules as dagOperator(). Dropped operands are deleted, number operand is reused for result.
+/// Both operands are deleted if one of them is NULL or memory has run out
+static inline Node_t *foldOperatorNode(enum OperatorType op, Node_t *left, Node_t *right) {
+    bool binary = operators[op].binary;
+    if (!left || (binary && !right)) {
+        deleteTree(left);
+        deleteTree(right);
+        return NULL;
+    }
+
+    if (left->type == NUMBER && (!binary || right->type == NUMBER)) {
+        left->value.number = calculateOperation(op, left->value.number, (binary) ? right->value.number : 0);
+        updateNodeInfo(left);
+        return keepOperand(left, right);
+    }
+
+    switch(op) {
+        case ADD:
+            if (isNumberNode(left, 0))  return keepOperand(right, left);
+            if (isNumberNode(right, 0)) return keepOperand(left, right);
+            break;
+        case SUB:
+            if (isNumberNode(right, 0)) return keepOperand(left, right);
+            break;
+        case MUL:
+            if (isNumberNode(left, 0)  || isNumberNode(right, 1)) return keepOperand(left, right);
+            if (isNumberNode(right, 0) || isNumberNode(left, 1))  return keepOperand(right, left);
+            break;
+        case DIV:
+            if (isNumberNode(left, 0) || isNumberNode(right, 1)) return keepOperand(left, right);
+            break;
+        case POW:
+            if (isNumberNode(right, 1) || isNumberNode(left, 1) || isNumberNode(left, 0))
+                return keepOperand(left, right);
+            if (isNumberNode(right, 0)) {
+                right->value.number = 1;
+                updateNodeInfo(right);
+                return keepOperand(right, left);
+            }
+            break;
+        case SIN:
+        case COS:
+        case SINH:
+        case COSH:
+        case TAN:
+        case CTG:
+        case LOG:
+        case LOGN:
+        default:
+            break;
+    }
+
+    Node_t *result = createOperatorNode(op, left, right);
+    if (!result) {
+        deleteTree(left);
+        deleteTree(right);
+    }
+    return result;
+}
+
 #define OPR_(op, left, right) createOperatorNode(op, left, right)
 #define NUM_(num) createNumberNode(num)
 
 #define VAR_(variable)createNode(VARIABLE, variable, 0, NULL, NULL)
 
+/// Operator node that folds constants and neutral operations, see foldOperatorNode()
+#define FOLD_(op, left, right) foldOperatorNode(op, left, right)
 
-
+/// Operator node that deletes its operands on failure, see joinOperatorNode()
+#define JOIN_(op, left, right) joinOperatorNode(op, left, right)
@@ -0,0 +1,66 @@
+#ifndef TREE_STACK_H
+#define TREE_STACK_H
+
+/*
+Growable stacks for iterative tree traversals.
+TREE_STACK_DEFINE(Name, Type) defines Name_t - stack of Type - and functions
+    Name##Ctor(buffer, capacity)  - stack that starts in caller buffer (e.g. local array) or on heap if NULL
+    Name##Push(stack, elem)       - false if memory ended
+    Name##Pop(stack), Name##Top(stack), Name##Dtor(stack)
+Starting in local buffer avoids heap allocations for shallow trees,
+deep trees move stack to heap, so traversals have no depth limit.
+*/
+
+const size_t TREE_STACK_MIN_CAPACITY = 64;
+
+#define TREE_STACK_DEFINE(Name, Type)                                                   \
+typedef struct {                                                                        \
+    Type *data;                                                                         \
+    size_t size;                                                                        \
+    size_t capacity;                                                                    \
+    bool onHeap;                                                                        \
+} Name##_t;                                                                             \
+                                                                                        \
+static inline Name##_t Name##Ctor(Type *buffer, size_t capacity) {                      \
+    Name##_t stack = {buffer, 0, (buffer) ? capacity : 0, false};                       \
+    return stack;                                                                       \
+}                                                                                       \
+                                                                                        \
+static inline bool Name##Push(Name##_t *stack, Type elem) {                             \
+    if (stack->size == stack->capacity) {                                               \
+        size_t newCapacity = (stack->capacity > TREE_STACK_MIN_CAPACITY / 2) ?          \
+                              stack->capacity * 2 : TREE_STACK_MIN_CAPACITY;            \
+        Type *newData = NULL;                                                           \
+        if (stack->onHeap)                                                              \
+            newData = (Type *) realloc(stack->data, newCapacity * sizeof(Type));        \
+        else {                                                                          \
+            newData = (Type *) malloc(newCapacity * sizeof(Type));                      \
+            if (newData && stack->size)                                                 \
+                memcpy(newData, stack->data, stack->size * sizeof(Type));               \
+        }                                                                               \
+        if (!newData) return false;                                                     \
+        stack->data = newData;                                                          \
+        stack->capacity = newCapacity;                                                  \
+        stack->onHeap = true;                                                           \
+    }                                                                                   \
+    stack->data[stack->size++] = elem;                                                  \
+    return true;                                                                        \
+}                                                                                       \
+                                                                                        \
+static inline Type Name##Pop(Name##_t *stack) {                                         \
+    assert(stack->size);                                                                \
+    return stack->data[--stack->size];                                                  \
+}                                                                                       \
+                                                                                        \
+static inline Type *Name##Top(Name##_t *stack) {                                        \
+    assert(stack->size);                                                                \
+    return stack->data + stack->size - 1;                                               \
+}                                                                                       \
+                                                                                        \
+static inline void Name##Dtor(Name##_t *stack) {                                        \
+    if (stack->onHeap)                                                                  \
+        free(stack->data);                                                              \
+    *stack = {};                                                                        \
+}
+
+#endif
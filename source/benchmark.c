@@ -0,0 +1,1807 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "utils.h"
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "derivative.h"
+#include "exprCompiler.h"
+#include "exprJit.h"
+#include "exprDag.h"
+#include "nodeArena.h"
+#include "compactTree.h"
+#include "threadPool.h"
+#include "exprGrid.h"
+#include "taylorSeries.h"
+#include "exprDual.h"
+#include "exprCache.h"
+#include "exprRewrite.h"
+#include "exprEgraph.h"
+#include "exprPolynomial.h"
+#include "exprReverse.h"
+#include "benchmark.h"
+#include "treeDSL.h"
+
+static size_t benchFailedChecks = 0;    ///< Self-checks failed in current runBenchmarks()
+
+/// @brief Count failed self-check, returns ok for printing verdict
+static bool benchPassed(bool ok) {
+    if (!ok)
+        benchFailedChecks++;
+    return ok;
+}
+
+static double getTimeMs() {
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec * 1000.0 + (double) time.tv_nsec / 1e6;
+}
+
+/// @brief Tree of TaylorExpansion() of given expression
+static Node_t *benchTaylorTree(TungstenContext_t *context, const char *exprStr, size_t order) {
+    TexContext_t tex = {};
+    Node_t *expr = parseExpression(context, exprStr);
+    if (!expr) return NULL;
+
+    Node_t *taylor = TaylorExpansion(&tex, context, expr, "x", 0, order, NULL);
+    deleteTree(expr);
+    return taylor;
+}
+
+/// @brief Tree of not simplified derivative of given order
+static Node_t *benchDerivativeTree(TungstenContext_t *context, const char *exprStr, size_t order) {
+    TexContext_t tex = {};
+    Node_t *expr = parseExpression(context, exprStr);
+    if (!expr) return NULL;
+
+    for (size_t idx = 0; idx < order; idx++) {
+        Node_t *diff = derivative(&tex, context, expr, "x");
+        deleteTree(expr);
+        expr = diff;
+    }
+    return expr;
+}
+
+/// @brief Compare evaluate() with evaluateCompiled() and evaluateBatch() on grid of x values
+static void benchEvaluation(TungstenContext_t *context, const char *name, const Node_t *expr) {
+    assert(expr);
+
+    double *values   = (double *) calloc(BENCH_POINTS_COUNT, sizeof(double));
+    double *compiled = (double *) calloc(BENCH_POINTS_COUNT, sizeof(double));
+    double *batch    = (double *) calloc(BENCH_POINTS_COUNT, sizeof(double));
+    double *jitted   = (double *) calloc(BENCH_POINTS_COUNT, sizeof(double));
+    double *xValues  = (double *) calloc(BENCH_POINTS_COUNT, sizeof(double));
+    double step = (BENCH_X_MAX - BENCH_X_MIN) / BENCH_POINTS_COUNT;
+    for (size_t idx = 0; idx < BENCH_POINTS_COUNT; idx++)
+        xValues[idx] = BENCH_X_MIN + step * (double) idx;
+
+    double startTime = getTimeMs();
+    for (size_t idx = 0; idx < BENCH_POINTS_COUNT; idx++) {
+        setVariable(context, "x", xValues[idx]);
+        values[idx] = evaluate(context, expr);
+    }
+    double treeTime = getTimeMs() - startTime;
+
+    CompiledExpr_t program = {};
+    startTime = getTimeMs();
+    compileExpression(expr, &program);
+    double compileTime = getTimeMs() - startTime;
+
+    startTime = getTimeMs();
+    for (size_t idx = 0; idx < BENCH_POINTS_COUNT; idx++) {
+        setVariable(context, "x", xValues[idx]);
+        compiled[idx] = evaluateCompiled(context, &program);
+    }
+    double compiledTime = getTimeMs() - startTime;
+
+    BatchVariable_t input = {findVariable(context, "x"), xValues};
+    startTime = getTimeMs();
+    evaluateBatch(context, &program, &input, 1, batch, BENCH_POINTS_COUNT);
+    double batchTime = getTimeMs() - startTime;
+
+    JitExpr_t jit = {};
+    compileJit(expr, &jit);
+    startTime = getTimeMs();
+    for (size_t idx = 0; idx < BENCH_POINTS_COUNT; idx++) {
+        setVariable(context, "x", xValues[idx]);
+        jitted[idx] = evaluateJit(context, &jit);
+    }
+    double jitTime = getTimeMs() - startTime;
+
+    bool identical = (memcmp(values, compiled, BENCH_POINTS_COUNT * sizeof(double)) == 0) &&
+                     (memcmp(values, batch,    BENCH_POINTS_COUNT * sizeof(double)) == 0) &&
+                     (memcmp(values, jitted,   BENCH_POINTS_COUNT * sizeof(double)) == 0);
+
+    printf("%-24s %8zu %12.2lf %12.2lf %12.2lf %12.2lf %10.3lf %8.2lfx %8.2lfx %8.2lfx %s\n",
+           name, countNodes(expr), treeTime, compiledTime, batchTime, jitTime, compileTime,
+           treeTime / compiledTime, treeTime / batchTime, treeTime / jitTime,
+           benchPassed(identical) ? "identical" : "MISMATCH");
+
+    deleteJit(&jit);
+    deleteCompiled(&program);
+    free(values);
+    free(compiled);
+    free(batch);
+    free(jitted);
+    free(xValues);
+}
+
+/// @brief Random expression with variable x
+static Node_t *benchRandomTree(TungstenContext_t *context, unsigned depth) {
+    if (depth == 0 || rand() % 4 == 0) {
+        if (rand() % 2)
+            return VAR_((int) insertVariable(context, "x"));
+        return NUM_((rand() % 600 - 300) / 100.0);
+    }
+
+    enum OperatorType op = operators[(size_t) rand() % ARRAY_SIZE(operators)].opCode;
+    Node_t *left  = benchRandomTree(context, depth - 1);
+    Node_t *right = (operators[op].binary) ? benchRandomTree(context, depth - 1) : NULL;
+    return OPR_(op, left, right);
+}
+
+static bool sameDouble(double a, double b) {
+    return (isnan(a) && isnan(b)) || memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+/// @brief Cross-check JIT against tree walk on random expressions
+static void checkJit(TungstenContext_t *context) {
+    srand(BENCH_RANDOM_SEED);
+
+    size_t mismatches = 0;
+    for (size_t exprIdx = 0; exprIdx < BENCH_RANDOM_EXPR_COUNT; exprIdx++) {
+        Node_t *expr = benchRandomTree(context, BENCH_RANDOM_EXPR_DEPTH);
+        JitExpr_t jit = {};
+        compileJit(expr, &jit);
+
+        for (size_t pointIdx = 0; pointIdx < BENCH_RANDOM_POINTS_COUNT; pointIdx++) {
+            setVariable(context, "x", (rand() % 2000 - 1000) / 100.0);
+            if (!sameDouble(evaluate(context, expr), evaluateJit(context, &jit)))
+                mismatches++;
+        }
+
+        deleteJit(&jit);
+        deleteTree(expr);
+    }
+
+    printf("JIT cross-check (%s): %zu random expressions x %zu points, %zu mismatches\n",
+           (JIT_SUPPORTED) ? "native" : "fallback",
+           BENCH_RANDOM_EXPR_COUNT, BENCH_RANDOM_POINTS_COUNT, mismatches);
+    benchPassed(mismatches == 0);
+}
+
+/// @brief Repeated derivatives: tree + simplifyExpression() vs hash-consed DAG
+static void benchTaylorDag(TungstenContext_t *context, const char *exprStr, size_t order) {
+    TexContext_t tex = {};
+    // tree derivatives are counted in their own arena
+    NodeArena_t job = nodeArenaCtor();
+    NodeArena_t *previousArena = nodeArenaSelect(&job);
+    Node_t *tree = parseExpression(context, exprStr);
+    nodeArenaSelect(previousArena);
+    if (!tree) {
+        nodeArenaDtor(&job);
+        return;
+    }
+
+    int var = findVariable(context, "x");
+    setVariable(context, "x", BENCH_X_MIN);
+
+    ExprDag_t dag = {};
+    dagCtor(&dag);
+    Node_t *dagExpr = dagInternTree(&dag, tree);
+
+    printf("\nDerivatives of %s at x = %lg: tree vs DAG (time in ms, memory in KiB)\n", exprStr, BENCH_X_MIN);
+    printf("%5s %10s %10s %10s %10s %10s %10s %10s %10s %s\n",
+           "order", "raw nodes", "allocs", "nodes", "memory", "time", "dag nodes", "memory", "time", "values");
+
+    double treeTime = 0, dagTime = 0;
+    bool treeStopped = false;
+    for (size_t curOrder = 1; curOrder <= order && dagExpr; curOrder++) {
+        double startTime = getTimeMs();
+        dagExpr = dagDerivative(&dag, dagExpr, var);
+        if (!benchPassed(dagExpr))
+            break;
+        double dagValue = dagEvaluate(&dag, context, dagExpr);
+        dagTime += getTimeMs() - startTime;
+
+        double treeValue = 0;
+        size_t treeNodes = 0, rawNodes = 0, allocations = 0;
+        if (!treeStopped) {
+            nodeArenaSelect(&job);
+            allocations = job.stats.allocations;
+            startTime = getTimeMs();
+            Node_t *diff = derivative(&tex, context, tree, "x");
+            rawNodes = countNodes(diff);
+            deleteTree(tree);
+            tree = simplifyExpression(&tex, context, diff);
+            treeValue = evaluate(context, tree);
+            treeTime += getTimeMs() - startTime;
+            allocations = job.stats.allocations - allocations;
+            nodeArenaSelect(previousArena);
+
+            treeNodes = countNodes(tree);
+            treeStopped = treeNodes > BENCH_TREE_NODES_LIMIT;
+        }
+
+        if (treeNodes) {
+            printf("%5zu %10zu %10zu %10zu %10zu %10.2lf %10zu %10zu %10.2lf %s\n", curOrder, rawNodes, allocations,
+                   treeNodes, treeNodes * sizeof(Node_t) / 1024, treeTime,
+                   dag.size, dag.size * sizeof(DagNode_t) / 1024, dagTime,
+                   benchPassed(fabs(treeValue - dagValue) <= 1e-9 * fabs(treeValue) + 1e-9) ? "equal" : "DIFFERENT");
+        } else {
+            printf("%5zu %10s %10s %10s %10s %10s %10zu %10zu %10.2lf\n", curOrder, "-", "-", "-", "-", "-",
+                   dag.size, dag.size * sizeof(DagNode_t) / 1024, dagTime);
+        }
+    }
+
+    deleteTree(tree);
+    nodeArenaDtor(&job);
+    dagDtor(&dag);
+}
+
+/// @brief Node allocation through job arena vs system allocator
+static void benchArena(TungstenContext_t *context, const char *exprStr, size_t order) {
+    NodeArena_t job = nodeArenaCtor();
+    NodeArena_t *previous = nodeArenaSelect(&job);
+
+    double startTime = getTimeMs();
+    Node_t *diff = benchDerivativeTree(context, exprStr, order);
+    double buildTime = getTimeMs() - startTime;
+    size_t nodesCount = countNodes(diff);
+
+    startTime = getTimeMs();
+    deleteTree(diff);
+    double deleteTime = getTimeMs() - startTime;
+
+    diff = benchDerivativeTree(context, exprStr, order);
+    startTime = getTimeMs();
+    nodeArenaReset(&job);
+    double resetTime = getTimeMs() - startTime;
+
+    nodeArenaSelect(previous);
+    NodeArenaStats_t stats = job.stats;
+    nodeArenaDtor(&job);
+
+    // same number of nodes through calloc/free for reference
+    Node_t **nodes = (Node_t **) calloc(nodesCount, sizeof(Node_t *));
+    startTime = getTimeMs();
+    for (size_t idx = 0; idx < nodesCount; idx++)
+        nodes[idx] = (Node_t *) calloc(1, sizeof(Node_t));
+    for (size_t idx = 0; idx < nodesCount; idx++)
+        free(nodes[idx]);
+    double systemTime = getTimeMs() - startTime;
+    free(nodes);
+
+    printf("\nNode arena: derivative of order %zu of %s, %zu nodes in result\n", order, exprStr, nodesCount);
+    printf("allocations = %zu, releases = %zu, bulk releases = %zu, peak = %zu, chunks = %zu (%zu nodes per system allocation)\n",
+           stats.allocations, stats.releases, stats.bulkReleases, stats.peakNodes, stats.chunks,
+           stats.allocations / ((stats.chunks) ? stats.chunks : 1));
+    printf("build = %.2lf ms, deleteTree() = %.3lf ms, nodeArenaReset() = %.3lf ms, calloc+free of %zu nodes = %.2lf ms\n",
+           buildTime, deleteTime, resetTime, nodesCount, systemTime);
+}
+
+/// @brief Pointer-based tree vs compact index-based tree
+static void benchCompact(TungstenContext_t *context, const char *exprStr, size_t order) {
+    Node_t *tree = benchDerivativeTree(context, exprStr, order);
+    if (!tree) return;
+
+    CompactTree_t compact = {};
+    if (treeToCompact(tree, &compact, false) != TA_SUCCESS) {
+        deleteTree(tree);
+        return;
+    }
+
+    Node_t *restored = compactToTree(&compact);
+    size_t nodesCount = countNodes(tree);
+    size_t pointsCount = BENCH_POINTS_COUNT / 100;
+    double step = (BENCH_X_MAX - BENCH_X_MIN) / (double) pointsCount;
+
+    bool identical = true;
+    double treeTime = 0, compactTime = 0;
+    for (size_t idx = 0; idx < pointsCount; idx++) {
+        setVariable(context, "x", BENCH_X_MIN + step * (double) idx);
+
+        double startTime = getTimeMs();
+        double treeValue = evaluate(context, tree);
+        treeTime += getTimeMs() - startTime;
+
+        startTime = getTimeMs();
+        double compactValue = compactEvaluate(context, &compact);
+        compactTime += getTimeMs() - startTime;
+
+        identical = identical && sameDouble(treeValue, compactValue) &&
+                                 sameDouble(treeValue, evaluate(context, restored));
+    }
+
+    size_t compactMemory = compact.size * sizeof(CompactNode_t) + compact.numbersCount * sizeof(double);
+    printf("\nCompact tree: derivative of order %zu of %s, %zu nodes\n", order, exprStr, nodesCount);
+    printf("memory: Node_t = %zu KiB, compact = %zu KiB (+%zu KiB with parents)\n",
+           nodesCount * sizeof(Node_t) / 1024, compactMemory / 1024, compact.size * sizeof(uint32_t) / 1024);
+    printf("evaluation of %zu points: evaluate() = %.2lf ms, compactEvaluate() = %.2lf ms, %.2lfx, round trip %s\n",
+           pointsCount, treeTime, compactTime, treeTime / compactTime, benchPassed(identical) ? "identical" : "MISMATCH");
+
+    deleteTree(restored);
+    deleteCompact(&compact);
+    deleteTree(tree);
+}
+
+/// @brief String of count repetitions of pattern between prefix and suffix
+static char *repeatString(const char *prefix, const char *pattern, size_t count, const char *suffix) {
+    size_t prefixLen = strlen(prefix), patternLen = strlen(pattern), suffixLen = strlen(suffix);
+    char *str = (char *) calloc(prefixLen + patternLen * count + suffixLen + 1, sizeof(char));
+    if (!str) return NULL;
+
+    char *pos = str;
+    memcpy(pos, prefix, prefixLen);                         pos += prefixLen;
+    for (size_t idx = 0; idx < count; idx++, pos += patternLen)
+        memcpy(pos, pattern, patternLen);
+    memcpy(pos, suffix, suffixLen);
+
+    return str;
+}
+
+/// @brief String x+x^2*2+3+x^3*2+3+... with count terms after x, terms are not like each other
+static char *powerSumString(size_t count) {
+    char *str = (char *) calloc((count + 1) * BENCH_POWER_TERM_LENGTH, sizeof(char));
+    if (!str) return NULL;
+
+    char *pos = str;
+    pos += sprintf(pos, "x");
+    for (size_t power = 2; power < count + 2; power++)
+        pos += sprintf(pos, "+x^%zu*2+3", power);
+
+    return str;
+}
+
+/// @brief Traversals of tree of depth BENCH_DEEP_TREE_DEPTH, recursive versions overflow stack here
+static void benchDeepTree(TungstenContext_t *context, const char *name, const char *exprStr, bool differentiate) {
+    TexContext_t tex = {};
+
+    double startTime = getTimeMs();
+    Node_t *expr = parseExpression(context, exprStr);
+    double parseTime = getTimeMs() - startTime;
+    if (!expr) {
+        benchPassed(false);
+        printf("%-26s parse FAILED\n", name);
+        return;
+    }
+
+    setVariable(context, "x", BENCH_X_MAX);
+    startTime = getTimeMs();
+    double value = evaluate(context, expr);
+    double evalTime = getTimeMs() - startTime;
+
+    startTime = getTimeMs();
+    Node_t *copy = copyTree(expr);
+    double copyTime = getTimeMs() - startTime;
+    size_t nodesCount = countNodes(copy);
+
+    CompiledExpr_t compiled = {};
+    bool identical = (compileExpression(copy, &compiled) == TA_SUCCESS) &&
+                     sameDouble(value, evaluateCompiled(context, &compiled)) &&
+                     sameDouble(value, evaluate(context, copy));
+    deleteCompiled(&compiled);
+
+    double diffTime = 0, neutralTime = 0;
+    size_t diffNodes = 0;
+    if (differentiate) {
+        startTime = getTimeMs();
+        Node_t *diff = derivative(&tex, context, expr, "x");
+        diffTime = getTimeMs() - startTime;
+        diffNodes = countNodes(diff);
+
+        startTime = getTimeMs();
+        diff = removeNeutralOperations(&tex, context, diff, NULL);
+        neutralTime = getTimeMs() - startTime;
+        deleteTree(diff);
+    }
+
+    startTime = getTimeMs();
+    deleteTree(copy);
+    double deleteTime = getTimeMs() - startTime;
+    deleteTree(expr);
+
+    printf("%-26s %9zu %9.1lf %9.1lf %9.1lf %9.1lf %9.1lf %9.1lf %10zu %10s\n",
+           name, nodesCount, parseTime, evalTime, copyTime, deleteTime, diffTime, neutralTime, diffNodes,
+           benchPassed(identical) ? "ok" : "MISMATCH");
+}
+
+static void benchDeepTrees(TungstenContext_t *context) {
+    printf("\nTrees of depth %zu (time in ms)\n", BENCH_DEEP_TREE_DEPTH);
+    printf("%-26s %9s %9s %9s %9s %9s %9s %9s %10s %10s\n",
+           "expression", "nodes", "parse", "evaluate", "copy", "delete", "diff", "neutral", "diff nodes", "compiled");
+
+    char *sum      = repeatString("x",     "+x*1", BENCH_DEEP_TREE_DEPTH, "");
+    char *chain    = repeatString("x",     "-sin(x)", BENCH_DEEP_TREE_DEPTH, "");
+    char *brackets = repeatString("",      "(",    BENCH_DEEP_TREE_DEPTH, "x");
+    char *sines    = repeatString("",      "sin(", BENCH_DEEP_TREE_DEPTH, "x");
+    char *powers   = repeatString("",      "1^",   BENCH_DEEP_TREE_DEPTH, "x");
+    char *constant = repeatString("x*",    "1^",   BENCH_DEEP_TREE_DEPTH, "1");
+    if (sum && chain && brackets && sines && powers && constant) {
+        char *bracketsEnd = repeatString(brackets, ")", BENCH_DEEP_TREE_DEPTH, "");
+        char *sinesEnd    = repeatString(sines,    ")", BENCH_DEEP_TREE_DEPTH, "");
+
+        benchDeepTree(context, "x+x*1+...+x*1",     sum,    true);
+        // subtraction is not flattened and cosines are not like terms, so derivative stays as deep as tree
+        benchDeepTree(context, "x-sin(x)-...-sin(x)", chain, true);
+        if (bracketsEnd) benchDeepTree(context, "((...(x)...))", bracketsEnd, true);
+        if (sinesEnd)    benchDeepTree(context, "sin(sin(...(x)...))", sinesEnd, false);
+        // derivative of 1^1^...^x copies the whole power at every level, so it has quadratic size
+        benchDeepTree(context, "1^1^...^x",         powers, false);
+        benchDeepTree(context, "x*1^1^...^1",       constant, true);
+
+        free(bracketsEnd);
+        free(sinesEnd);
+    }
+
+    free(sum);
+    free(chain);
+    free(brackets);
+    free(sines);
+    free(powers);
+    free(constant);
+}
+
+/// @brief Hash of bits of values to compare results of different runs
+static uint64_t hashValues(const double *values, size_t count) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t idx = 0; idx < count; idx++) {
+        uint64_t bits = 0;
+        memcpy(&bits, values + idx, sizeof(bits));
+        hash = (hash ^ bits) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/// @brief Two-dimensional grid on pool vs evaluateCompiled() in every point
+static bool checkGrid2D(ThreadPool_t *pool, TungstenContext_t *context) {
+    Node_t *expr = parseExpression(context, "x^y + sin(x*y) / ln(x+y+2)");
+    CompiledExpr_t compiled = {};
+    if (!expr || compileExpression(expr, &compiled) != TA_SUCCESS) {
+        deleteTree(expr);
+        return false;
+    }
+
+    GridAxis_t axes[2] = {{findVariable(context, "x"), BENCH_X_MIN, BENCH_X_MAX, 300},
+                          {findVariable(context, "y"), -1, 1, 200}};
+    double *values = (double *) calloc(axes[0].count * axes[1].count, sizeof(double));
+    bool identical = values && evaluateGrid(pool, context, &compiled, axes, 2, values) == TA_SUCCESS;
+
+    for (size_t yIdx = 0; yIdx < axes[1].count && identical; yIdx++) {
+        for (size_t xIdx = 0; xIdx < axes[0].count && identical; xIdx++) {
+            setVariable(context, "x", axes[0].min + (axes[0].max - axes[0].min) / (double) axes[0].count * (double) xIdx);
+            setVariable(context, "y", axes[1].min + (axes[1].max - axes[1].min) / (double) axes[1].count * (double) yIdx);
+            identical = sameDouble(values[yIdx * axes[0].count + xIdx], evaluateCompiled(context, &compiled));
+        }
+    }
+
+    free(values);
+    deleteCompiled(&compiled);
+    deleteTree(expr);
+    return identical;
+}
+
+/// @brief Scaling of evaluateGrid() with number of threads
+static void benchGrid(TungstenContext_t *context, const char *exprStr) {
+    Node_t *expr = parseExpression(context, exprStr);
+    CompiledExpr_t compiled = {};
+    if (!expr || compileExpression(expr, &compiled) != TA_SUCCESS) {
+        deleteTree(expr);
+        return;
+    }
+
+    double *values = (double *) calloc(BENCH_GRID_SLAB_POINTS, sizeof(double));
+    if (!values) {
+        deleteCompiled(&compiled);
+        deleteTree(expr);
+        return;
+    }
+
+    size_t processors = threadPoolDefaultThreads();
+    printf("\nGrid of %zu points of %s on thread pool, %zu processors (time in ms)\n",
+           BENCH_GRID_POINTS_COUNT, exprStr, processors);
+    printf("%8s %10s %9s %9s %12s %18s\n", "threads", "time", "speedup", "steals", "stolen tasks", "hash");
+
+    size_t slabsCount = BENCH_GRID_POINTS_COUNT / BENCH_GRID_SLAB_POINTS;
+    double slabWidth = (BENCH_X_MAX - BENCH_X_MIN) / (double) slabsCount;
+    double singleTime = 0;
+    uint64_t singleHash = 0;
+
+    // more threads than processors in the last run check determinism even on one core
+    size_t threadsCounts[BENCH_GRID_MAX_RUNS] = {};
+    size_t runsCount = 0;
+    for (size_t threads = 1; threads < processors && runsCount < BENCH_GRID_MAX_RUNS - 2; threads *= 2)
+        threadsCounts[runsCount++] = threads;
+    threadsCounts[runsCount++] = processors;
+    threadsCounts[runsCount++] = 2 * processors;
+
+    for (size_t run = 0; run < runsCount; run++) {
+        size_t threads = threadsCounts[run];
+        ThreadPool_t pool = {};
+        if (threadPoolCtor(&pool, threads) != TA_SUCCESS)
+            break;
+
+        uint64_t hash = 0;
+        double startTime = getTimeMs();
+        for (size_t slab = 0; slab < slabsCount; slab++) {
+            GridAxis_t axis = {findVariable(context, "x"), BENCH_X_MIN + slabWidth * (double) slab,
+                               BENCH_X_MIN + slabWidth * (double) (slab + 1), BENCH_GRID_SLAB_POINTS};
+            evaluateGrid(&pool, context, &compiled, &axis, 1, values);
+            hash = hash * 31 + hashValues(values, BENCH_GRID_SLAB_POINTS);
+        }
+        double time = getTimeMs() - startTime;
+
+        if (threads == 1) {
+            singleTime = time;
+            singleHash = hash;
+        }
+
+        printf("%8zu %10.1lf %8.2lfx %9zu %12zu %18llx %s\n", threads, time, singleTime / time,
+               pool.stats.steals, pool.stats.stolenTasks, (unsigned long long) hash,
+               benchPassed(hash == singleHash) ? "" : "MISMATCH");
+
+        if (threads == processors)
+            printf("2D grid vs evaluateCompiled(): %s\n", benchPassed(checkGrid2D(&pool, context)) ? "identical" : "MISMATCH");
+
+        threadPoolDtor(&pool);
+    }
+
+    free(values);
+    deleteCompiled(&compiled);
+    deleteTree(expr);
+}
+
+typedef struct {
+    const Node_t *expr;
+    const CompiledExpr_t *compiled;
+    const double *baseValues;   ///< Values of variables from context
+    int xVar;
+    int yVar;
+
+    double **stacks;            ///< Value stack of compiled expression for every worker
+    double *treeResult;
+    double *compiledResult;
+} ReentrantJob_t;
+
+static void benchPoint(size_t point, double *x, double *y) {
+    *x = BENCH_X_MIN + (BENCH_X_MAX - BENCH_X_MIN) * (double) (point % 1000) / 1000;
+    *y = (double) (point / 1000) / 100;
+}
+
+static void reentrantTask(void *arg, size_t task, size_t worker) {
+    ReentrantJob_t *job = (ReentrantJob_t *) arg;
+
+    double values[VARIABLE_TABLE_SIZE] = {};
+    memcpy(values, job->baseValues, sizeof(values));
+
+    for (size_t point = task * BENCH_REENTRANT_TASK_POINTS; point < (task + 1) * BENCH_REENTRANT_TASK_POINTS; point++) {
+        benchPoint(point, values + job->xVar, values + job->yVar);
+        job->treeResult[point]     = evaluateWith(job->expr, values);
+        job->compiledResult[point] = evaluateCompiledWith(job->compiled, values, job->stacks[worker]);
+    }
+}
+
+/// @brief evaluateWith() vs setVariable() + evaluate(), then the same expression on all threads at once
+static void benchReentrant(TungstenContext_t *context, const char *exprStr) {
+    Node_t *expr = parseExpression(context, exprStr);
+    CompiledExpr_t compiled = {};
+    if (!expr || compileExpression(expr, &compiled) != TA_SUCCESS) {
+        deleteTree(expr);
+        return;
+    }
+
+    const char *names[] = {"x", "y"};
+    int vars[ARRAY_SIZE(names)] = {};
+    if (resolveVariables(context, names, ARRAY_SIZE(names), vars) != ARRAY_SIZE(names)) {
+        deleteCompiled(&compiled);
+        deleteTree(expr);
+        return;
+    }
+
+    size_t pointsCount = BENCH_REENTRANT_TASKS_COUNT * BENCH_REENTRANT_TASK_POINTS;
+    double *expected = (double *) calloc(3 * pointsCount, sizeof(double));
+    double values[VARIABLE_TABLE_SIZE] = {};
+    getVariableValues(context, values);
+
+    double startTime = getTimeMs();
+    for (size_t point = 0; point < pointsCount; point++) {
+        double x = 0, y = 0;
+        benchPoint(point, &x, &y);
+        setVariable(context, "x", x);
+        setVariable(context, "y", y);
+        expected[point] = evaluate(context, expr);
+    }
+    double sharedTime = getTimeMs() - startTime;
+
+    double withSum = 0;
+    startTime = getTimeMs();
+    for (size_t point = 0; point < pointsCount; point++) {
+        benchPoint(point, values + vars[0], values + vars[1]);
+        withSum += evaluateWith(expr, values);
+    }
+    double withTime = getTimeMs() - startTime;
+
+    ThreadPool_t pool = {};
+    bool identical = false;
+    if (threadPoolCtor(&pool, 0) == TA_SUCCESS) {
+        double **stacks = (double **) calloc(pool.threadsCount, sizeof(double *));
+        for (size_t worker = 0; worker < pool.threadsCount; worker++)
+            stacks[worker] = (double *) calloc(compiled.stackSize, sizeof(double));
+
+        ReentrantJob_t job = {expr, &compiled, values, vars[0], vars[1], stacks,
+                              expected + pointsCount, expected + 2 * pointsCount};
+        threadPoolRun(&pool, reentrantTask, &job, BENCH_REENTRANT_TASKS_COUNT);
+
+        identical = true;
+        for (size_t point = 0; point < pointsCount; point++)
+            identical = identical && sameDouble(expected[point], job.treeResult[point]) &&
+                                     sameDouble(expected[point], job.compiledResult[point]);
+
+        for (size_t worker = 0; worker < pool.threadsCount; worker++)
+            free(stacks[worker]);
+        free(stacks);
+    }
+
+    printf("\nReentrant evaluation of %s in %zu points (time in ms)\n", exprStr, pointsCount);
+    printf("setVariable() + evaluate() = %.2lf, evaluateWith() = %.2lf, %.2lfx (sum %g)\n",
+           sharedTime, withTime, sharedTime / withTime, withSum);
+    printf("evaluateWith() and evaluateCompiledWith() on %zu threads at once: %s\n",
+           pool.threadsCount, benchPassed(identical) ? "identical" : "MISMATCH");
+
+    threadPoolDtor(&pool);
+    free(expected);
+    deleteCompiled(&compiled);
+    deleteTree(expr);
+}
+
+/// @brief Taylor coefficients by power series vs symbolic derivatives on DAG
+static void benchTaylorSeries(TungstenContext_t *context, const char *exprStr, double point) {
+    Node_t *expr = parseExpression(context, exprStr);
+    if (!expr) return;
+
+    int var = (int) insertVariable(context, "x");
+    setVariable(context, "x", point);
+
+    double symbolic[BENCH_SERIES_CHECK_ORDER + 1] = {};
+    double series[BENCH_SERIES_MAX_ORDER + 1] = {};
+
+    ExprDag_t dag = {};
+    dagCtor(&dag);
+    Node_t *dagCurrent = dagInternTree(&dag, expr);
+    double factorial = 1;
+    double startTime = getTimeMs();
+    for (size_t order = 0; order <= BENCH_SERIES_CHECK_ORDER; order++) {
+        if (order) {
+            dagCurrent = dagDerivative(&dag, dagCurrent, var);
+            factorial *= (double) order;
+        }
+        if (!benchPassed(dagCurrent))
+            break;
+        symbolic[order] = dagEvaluate(&dag, context, dagCurrent) / factorial;
+    }
+    double symbolicTime = getTimeMs() - startTime;
+    dagDtor(&dag);
+
+    startTime = getTimeMs();
+    taylorSeries(context, expr, var, point, BENCH_SERIES_CHECK_ORDER, series);
+    double seriesTime = getTimeMs() - startTime;
+
+    double maxError = 0;
+    for (size_t order = 0; order <= BENCH_SERIES_CHECK_ORDER; order++) {
+        double error = fabs(series[order] - symbolic[order]) / fmax(1, fabs(symbolic[order]));
+        if (!(error <= maxError))
+            maxError = error;
+    }
+
+    printf("\nTaylor coefficients of %s at %lg\n", exprStr, point);
+    printf("order %zu: symbolic on DAG = %.3lf ms, power series = %.3lf ms, max relative difference = %.2e\n",
+           BENCH_SERIES_CHECK_ORDER, symbolicTime, seriesTime, maxError);
+
+    for (size_t order = 50; order <= BENCH_SERIES_MAX_ORDER; order *= 2) {
+        startTime = getTimeMs();
+        taylorSeries(context, expr, var, point, order, series);
+        printf("order %zu: power series = %.3lf ms, c[%zu] = %lg\n", order, getTimeMs() - startTime, order, series[order]);
+    }
+
+    deleteTree(expr);
+}
+
+/// @brief Maximum relative error of coefficients of Taylor polynomial of 1/(2-x) at 0, they are 2^-(k+1)
+/// and fall below DOUBLE_EPSILON after k = 40, so all of them reach caller only if no small coefficient is dropped
+/// @return Error or NAN if polynomial has wrong degree or memory has run out
+static double benchTaylorClosedFormError(TungstenContext_t *context, Node_t *expr, int var, size_t order,
+                                         enum TaylorForm form) {
+    TexContext_t tex = {};
+    TaylorOptions_t options = {TAYLOR_SERIES, form};
+    Node_t *taylor = TaylorExpansion(&tex, context, expr, "x", 0, order + 1, &options);
+
+    Polynomial_t poly = {};
+    double maxError = NAN;
+    if (taylor && polynomialFromTree(taylor, var, &poly) == TA_SUCCESS && poly.degree == order) {
+        maxError = 0;
+        for (size_t k = 0; k <= order; k++) {
+            double expected = ldexp(1, -(int) k - 1);
+            maxError = fmax(maxError, fabs(poly.coefficients[k] - expected) / expected);
+        }
+    }
+
+    polynomialDtor(&poly);
+    deleteTree(taylor);
+    return maxError;
+}
+
+/// @brief Coefficients of high order Taylor polynomials compared with closed form
+static void benchTaylorClosedForm(TungstenContext_t *context) {
+    const char *exprStr = "1 / (2 - x)";
+    Node_t *expr = parseExpression(context, exprStr);
+    if (!expr) return;
+    int var = findVariable(context, "x");
+
+    printf("\nTaylor polynomial of %s at 0 by power series vs closed form c[k] = 2^-(k+1)\n", exprStr);
+    printf("%6s %14s %14s %6s\n", "order", "sum rel err", "horner rel err", "value");
+    for (size_t order = 50; order <= BENCH_SERIES_MAX_ORDER; order *= 2) {
+        double sumError    = benchTaylorClosedFormError(context, expr, var, order, TAYLOR_SUM);
+        double hornerError = benchTaylorClosedFormError(context, expr, var, order, TAYLOR_HORNER);
+        bool ok = sumError <= BENCH_SERIES_TOLERANCE && hornerError <= BENCH_SERIES_TOLERANCE;
+        printf("%6zu %14.2e %14.2e %6s\n", order, sumError, hornerError, benchPassed(ok) ? "ok" : "WRONG");
+    }
+
+    deleteTree(expr);
+}
+
+/// @brief f and f' on grid: symbolic derivative + two batches vs one batch of dual numbers
+static void benchDual(TungstenContext_t *context, const char *exprStr) {
+    TexContext_t tex = {};
+    Node_t *expr = parseExpression(context, exprStr);
+    if (!expr) return;
+
+    int var = findVariable(context, "x");
+    double *memory = (double *) calloc(5 * BENCH_POINTS_COUNT, sizeof(double));
+    double *xCoords = memory,
+           *values = xCoords + BENCH_POINTS_COUNT, *derivatives = values + BENCH_POINTS_COUNT,
+           *dualValues = derivatives + BENCH_POINTS_COUNT, *dualDerivatives = dualValues + BENCH_POINTS_COUNT;
+
+    double step = (BENCH_X_MAX - BENCH_X_MIN) / BENCH_POINTS_COUNT;
+    for (size_t idx = 0; idx < BENCH_POINTS_COUNT; idx++)
+        xCoords[idx] = BENCH_X_MIN + step * (double) idx;
+    BatchVariable_t input = {var, xCoords};
+
+    CompiledExpr_t compiled = {}, compiledDiff = {};
+
+    double startTime = getTimeMs();
+    Node_t *diff = derivative(&tex, context, expr, "x");
+    diff = simplifyExpression(&tex, context, diff);
+    compileExpression(expr, &compiled);
+    compileExpression(diff, &compiledDiff);
+    double buildTime = getTimeMs() - startTime;
+
+    startTime = getTimeMs();
+    evaluateBatch(context, &compiled, &input, 1, values, BENCH_POINTS_COUNT);
+    evaluateBatch(context, &compiledDiff, &input, 1, derivatives, BENCH_POINTS_COUNT);
+    double symbolicTime = getTimeMs() - startTime;
+
+    startTime = getTimeMs();
+    evaluateBatchDual(context, &compiled, var, &input, 1, dualValues, dualDerivatives, BENCH_POINTS_COUNT);
+    double dualTime = getTimeMs() - startTime;
+
+    bool identical = true;
+    double maxError = 0;
+    for (size_t idx = 0; idx < BENCH_POINTS_COUNT; idx++) {
+        identical = identical && sameDouble(values[idx], dualValues[idx]);
+        double error = fabs(derivatives[idx] - dualDerivatives[idx]) / fmax(1, fabs(derivatives[idx]));
+        if (error > maxError)
+            maxError = error;
+
+        if (idx % (BENCH_POINTS_COUNT / 10) == 0) {
+            setVariable(context, "x", xCoords[idx]);
+            Dual_t point = evaluateDual(context, expr, var);
+            identical = identical && sameDouble(point.value, dualValues[idx]) &&
+                                     sameDouble(point.derivative, dualDerivatives[idx]);
+        }
+    }
+
+    printf("\nf and f' of %s in %zu points (time in ms)\n", exprStr, BENCH_POINTS_COUNT);
+    printf("derivative() + simplify + compile = %.2lf, two batches = %.2lf, dual numbers batch = %.2lf, %.2lfx\n",
+           buildTime, symbolicTime, dualTime, (buildTime + symbolicTime) / dualTime);
+    printf("values %s, max relative difference of derivatives = %.2e, f' tree has %zu nodes\n",
+           benchPassed(identical) ? "identical" : "MISMATCH", maxError, countNodes(diff));
+
+    deleteCompiled(&compiled);
+    deleteCompiled(&compiledDiff);
+    deleteTree(diff);
+    deleteTree(expr);
+    free(memory);
+}
+
+/// @brief Derivatives of given order with simplification after every step, as user requests them
+static Node_t *benchSimplifiedDerivative(TungstenContext_t *context, const char *exprStr, size_t order) {
+    TexContext_t tex = {};
+    Node_t *expr = parseExpression(context, exprStr);
+    if (!expr) return NULL;
+
+    for (size_t idx = 0; idx < order; idx++) {
+        Node_t *diff = derivative(&tex, context, expr, "x");
+        deleteTree(expr);
+        expr = simplifyExpression(&tex, context, diff);
+    }
+    return expr;
+}
+
+static void benchCache(TungstenContext_t *context, const char *exprStr, size_t order) {
+    ExprCache_t disabled = exprCacheCtor(0), cache = exprCacheCtor(EXPR_CACHE_DEFAULT_NODES);
+
+    ExprCache_t *previous = exprCacheSelect(&disabled);
+    double startTime = getTimeMs();
+    Node_t *reference = benchSimplifiedDerivative(context, exprStr, order);
+    double uncachedTime = getTimeMs() - startTime;
+
+    // the first run only passes admission filter, the second one fills cache, the third one hits
+    exprCacheSelect(&cache);
+    const size_t runsCount = 3;
+    double times[runsCount] = {};
+    ExprCacheStats_t stats[runsCount + 1] = {};
+    bool identical = reference;
+    for (size_t run = 0; run < runsCount; run++) {
+        startTime = getTimeMs();
+        Node_t *diff = benchSimplifiedDerivative(context, exprStr, order);
+        times[run] = getTimeMs() - startTime;
+        stats[run + 1] = cache.stats;
+
+        identical = identical && diff && equalTrees(reference, diff);
+        deleteTree(diff);
+    }
+    exprCacheSelect(previous);
+
+    printf("\nMemo cache: derivatives up to order %zu of %s with simplification, %zu nodes in result\n",
+           order, exprStr, countNodes(reference));
+    printf("no cache = %.2lf ms", uncachedTime);
+    for (size_t run = 0; run < runsCount; run++)
+        printf(", run %zu = %.2lf ms (%zu hits, %zu misses)", run + 1, times[run],
+               stats[run + 1].hits - stats[run].hits, stats[run + 1].misses - stats[run].misses);
+    printf("\n%zu entries, %zu nodes, %zu rejected by admission filter, %zu evictions, %zu collisions, results %s\n",
+           cache.entriesCount, cache.nodesCount, cache.stats.rejections, cache.stats.evictions, cache.stats.collisions,
+           benchPassed(identical) ? "identical" : "MISMATCH");
+
+    deleteTree(reference);
+    exprCacheDtor(&disabled);
+    exprCacheDtor(&cache);
+}
+
+/// @brief Previous scheme of simplification: whole-tree passes until nothing changes
+/// @param collect Collect like terms, without it the scheme simplifies as before like-term collection
+static Node_t *simplifyByPasses(TungstenContext_t *context, Node_t *expr, size_t *passes, size_t *visited,
+                                bool collect) {
+    bool changedTree = true;
+    while (changedTree) {
+        changedTree = false;
+        *visited += expr->size;
+        expr = foldConstants(NULL, context, expr, &changedTree);
+        if (collect) {
+            *visited += expr->size;
+            expr = collectLikeTerms(NULL, context, expr, &changedTree);
+        }
+        *visited += expr->size;
+        expr = removeNeutralOperations(NULL, context, expr, &changedTree);
+        (*passes)++;
+    }
+    return expr;
+}
+
+static void benchSimplify(TungstenContext_t *context, const char *name, char *exprStr, bool differentiate) {
+    Node_t *expr = (exprStr) ? parseExpression(context, exprStr) : NULL;
+    free(exprStr);
+    if (!expr) {
+        benchPassed(false);
+        printf("%-30s parse FAILED\n", name);
+        return;
+    }
+    if (differentiate) {
+        Node_t *diff = derivative(NULL, context, expr, "x");
+        deleteTree(expr);
+        expr = diff;
+    }
+
+    Node_t *copy = copyTree(expr);
+    size_t nodesCount = expr->size;
+
+    size_t passes = 0, passesVisited = 0;
+    double startTime = getTimeMs();
+    expr = simplifyByPasses(context, expr, &passes, &passesVisited, true);
+    double passesTime = getTimeMs() - startTime;
+
+    *simplifyStats() = {};
+    startTime = getTimeMs();
+    copy = simplifyExpression(NULL, context, copy);
+    double worklistTime = getTimeMs() - startTime;
+    SimplifyStats_t stats = *simplifyStats();
+
+    // one more whole-tree pass must find nothing to simplify
+    bool changedTree = false;
+    copy = foldConstants(NULL, context, copy, &changedTree);
+    copy = collectLikeTerms(NULL, context, copy, &changedTree);
+    copy = removeNeutralOperations(NULL, context, copy, &changedTree);
+
+    printf("%-30s %9zu %7zu %11zu %10.2lf %11zu %9zu %10.2lf %9s\n", name, nodesCount, passes, passesVisited,
+           passesTime, stats.visited, stats.rewrites, worklistTime,
+           benchPassed(equalTrees(expr, copy) && !changedTree) ? "ok" : "MISMATCH");
+
+    deleteTree(expr);
+    deleteTree(copy);
+}
+
+static void benchSimplifyPasses(TungstenContext_t *context) {
+    printf("\nSimplification: whole-tree passes until fixpoint vs one pass of simplifyExpression() (time in ms)\n");
+    printf("%-30s %9s %7s %11s %10s %11s %9s %10s %9s\n", "expression", "nodes", "passes", "visited", "time",
+           "one pass", "rewrites", "time", "fixpoint");
+
+    ExprCache_t disabled = exprCacheCtor(0);
+    ExprCache_t *previous = exprCacheSelect(&disabled);
+
+    benchSimplify(context, "(sin(x)+sin(x)*x^2/ln(x+2)+...)'",
+                  repeatString("sin(x)", "+sin(x)*x^2/ln(x+2)", BENCH_SIMPLIFY_TERMS - 1, ""), true);
+
+    // every level is folded only after neutral operation inside it is removed
+    char *nested = repeatString("", "x^(", BENCH_SIMPLIFY_DEPTH, "x^0+2");
+    char *nestedStr = (nested) ? repeatString(nested, "-3)+2", BENCH_SIMPLIFY_DEPTH, "") : NULL;
+    benchSimplify(context, "x^(...x^(x^0+2-3)+2...-3)+2", nestedStr, false);
+    free(nested);
+
+    exprCacheSelect(previous);
+    exprCacheDtor(&disabled);
+}
+
+/// @brief Sizes of derivatives of every order that are simplified without and with like-term collection
+static void benchLikeTerms(TungstenContext_t *context, const char *exprStr, size_t maxOrder) {
+    printf("\nLike terms: derivatives of %s simplified without and with collection (time in ms)\n", exprStr);
+    printf("%-6s %11s %10s %11s %10s %7s %9s\n", "order", "nodes", "time", "collected", "time", "ratio", "value");
+
+    ExprCache_t disabled = exprCacheCtor(0);
+    ExprCache_t *previous = exprCacheSelect(&disabled);
+
+    Node_t *plain = parseExpression(context, exprStr);
+    Node_t *collected = (plain) ? copyTree(plain) : NULL;
+    setVariable(context, "x", BENCH_LIKE_TERMS_POINT);
+
+    for (size_t order = 1; order <= maxOrder && plain && collected; order++) {
+        double startTime = getTimeMs();
+        Node_t *diff = derivative(NULL, context, plain, "x");
+        size_t passes = 0, visited = 0;
+        if (diff)
+            diff = simplifyByPasses(context, diff, &passes, &visited, false);
+        double plainTime = getTimeMs() - startTime;
+        deleteTree(plain);
+        plain = diff;
+
+        startTime = getTimeMs();
+        diff = derivative(NULL, context, collected, "x");
+        if (diff)
+            diff = simplifyExpression(NULL, context, diff);
+        double collectedTime = getTimeMs() - startTime;
+        deleteTree(collected);
+        collected = diff;
+
+        if (!plain || !collected) break;
+
+        double plainValue = evaluate(context, plain), collectedValue = evaluate(context, collected);
+        bool sameValue = fabs(plainValue - collectedValue) <= BENCH_LIKE_TERMS_TOLERANCE * fmax(1, fabs(plainValue));
+        printf("%-6zu %11zu %10.2lf %11zu %10.2lf %7.1lf %9s\n", order, plain->size, plainTime,
+               collected->size, collectedTime, (double) plain->size / (double) collected->size,
+               benchPassed(sameValue) ? "ok" : "MISMATCH");
+    }
+
+    deleteTree(plain);
+    deleteTree(collected);
+    exprCacheSelect(previous);
+    exprCacheDtor(&disabled);
+}
+
+/// @brief Rules of simplifier for derivatives and extraCount rules ln(a^K) = K*ln(a) with odd K,
+/// that never match, but share path in discrimination tree with ln(a^3)
+static RewriteRule_t *benchRewriteTable(size_t extraCount, char **strings, size_t *count) {
+    static const RewriteRule_t BASE_RULES[] = {
+        {"a + 0", "a", NULL, NULL}, {"a - 0", "a", NULL, NULL}, {"a * 1", "a", NULL, NULL},
+        {"a * 0", "0", NULL, NULL}, {"a ^ 1", "a", NULL, NULL}, {"a ^ 0", "1", NULL, NULL},
+        {"0 - a", "(-1) * a", NULL, NULL}, {"ln(a ^ 3)", "3 * ln(a)", NULL, NULL},
+    };
+    const size_t baseCount = sizeof(BASE_RULES) / sizeof(RewriteRule_t);
+
+    RewriteRule_t *table = (RewriteRule_t *) calloc(baseCount + extraCount, sizeof(RewriteRule_t));
+    *strings = (char *) calloc(2 * extraCount + 1, BENCH_REWRITE_PATTERN_LENGTH);
+    if (!table || !*strings) {
+        free(table);
+        free(*strings);
+        return NULL;
+    }
+
+    memcpy(table, BASE_RULES, sizeof(BASE_RULES));
+    for (size_t idx = 0; idx < extraCount; idx++) {
+        char *pattern = *strings + 2 * idx * BENCH_REWRITE_PATTERN_LENGTH;
+        char *replacement = pattern + BENCH_REWRITE_PATTERN_LENGTH;
+        size_t exponent = BENCH_REWRITE_FIRST_EXPONENT + 2 * idx;
+        snprintf(pattern, BENCH_REWRITE_PATTERN_LENGTH, "ln(a ^ %zu)", exponent);
+        snprintf(replacement, BENCH_REWRITE_PATTERN_LENGTH, "%zu * ln(a)", exponent);
+
+        RewriteRule_t rule = {pattern, replacement, NULL, NULL};
+        table[baseCount + idx] = rule;
+    }
+    *count = baseCount + extraCount;
+    return table;
+}
+
+/// @brief Simplification of the same derivative with growing number of rewrite rules,
+/// time per node stays flat because rules are matched by discrimination tree
+static void benchRewriteRules(TungstenContext_t *context, const char *exprStr, size_t order) {
+    Node_t *diff = benchDerivativeTree(context, exprStr, order);
+    if (!diff) return;
+
+    printf("\nRewrite rules: derivative of order %zu of %s, %zu nodes, simplified with growing rule table\n",
+           order, exprStr, diff->size);
+    printf("%-7s %8s %11s %10s %12s %10s\n", "rules", "states", "compile ms", "simplify", "ns per node", "result");
+
+    // every repeat must be timed, not found in memo cache
+    ExprCache_t disabled = exprCacheCtor(0);
+    ExprCache_t *previousCache = exprCacheSelect(&disabled);
+
+    Node_t *reference = NULL;
+    for (size_t extraCount = 0; extraCount <= BENCH_REWRITE_MAX_EXTRA_RULES;
+         extraCount = (extraCount) ? extraCount * BENCH_REWRITE_RULES_STEP : BENCH_REWRITE_RULES_STEP) {
+        char *strings = NULL;
+        size_t rulesCount = 0;
+        RewriteRule_t *table = benchRewriteTable(extraCount, &strings, &rulesCount);
+        if (!table) break;
+
+        RewriteRules_t rules = {};
+        double startTime = getTimeMs();
+        TungstenStatus_t status = rewriteRulesCtor(&rules, table, rulesCount);
+        double compileTime = getTimeMs() - startTime;
+
+        // every row starts with fresh arena, so free lists of previous rows don't slow it down
+        NodeArena_t arena = nodeArenaCtor();
+        NodeArena_t *previousArena = nodeArenaSelect(&arena);
+        const RewriteRules_t *previousRules = rewriteRulesSelect(&rules);
+        double simplifyTime = 0;
+        size_t visited = 0;
+        bool identical = status == TA_SUCCESS;
+        for (size_t repeat = 0; repeat < BENCH_REWRITE_REPEATS && identical; repeat++) {
+            Node_t *expr = copyTree(diff);
+            if (!expr) break;
+
+            size_t visitedBefore = simplifyStats()->visited;
+            startTime = getTimeMs();
+            expr = simplifyExpression(NULL, context, expr);
+            simplifyTime += getTimeMs() - startTime;
+            visited += simplifyStats()->visited - visitedBefore;
+
+            if (!reference) {
+                nodeArenaSelect(previousArena);
+                reference = copyTree(expr);
+                nodeArenaSelect(&arena);
+            }
+            identical = reference && equalTrees(reference, expr);
+            deleteTree(expr);
+        }
+        nodeArenaSelect(previousArena);
+        nodeArenaDtor(&arena);
+        rewriteRulesSelect(previousRules);
+
+        printf("%-7zu %8zu %11.2lf %10.2lf %12.1lf %10s\n", rules.rulesCount, rules.statesCount, compileTime,
+               simplifyTime / BENCH_REWRITE_REPEATS, (visited) ? simplifyTime * 1e6 / (double) visited : 0,
+               benchPassed(identical) ? "identical" : "MISMATCH");
+
+        rewriteRulesDtor(&rules);
+        free(table);
+        free(strings);
+    }
+
+    deleteTree(reference);
+    deleteTree(diff);
+    exprCacheSelect(previousCache);
+    exprCacheDtor(&disabled);
+}
+
+/// @brief Simplify tree until it is found in memo cache, then simplify it with other rules: cached result
+/// of default rules must not be returned
+static void benchRewriteCache(TungstenContext_t *context) {
+    const char *exprStr = "sin(x)^2 + cos(x)^2 + x";
+    Node_t *expr = parseExpression(context, exprStr);
+    if (!expr) return;
+
+    ExprCache_t cache = exprCacheCtor(EXPR_CACHE_DEFAULT_NODES);
+    ExprCache_t *previousCache = exprCacheSelect(&cache);
+
+    // the second miss is admitted to cache, the third call hits
+    Node_t *defaultResult = NULL;
+    for (size_t repeat = 0; repeat < 3; repeat++) {
+        deleteTree(defaultResult);
+        defaultResult = simplifyExpression(NULL, context, copyTree(expr));
+    }
+    size_t hits = cache.stats.hits;
+
+    static const RewriteRule_t NO_IDENTITY_RULES[] = {{"a * 1", "a", NULL, NULL}};
+    RewriteRules_t rules = {};
+    Node_t *otherResult = NULL;
+    if (rewriteRulesCtor(&rules, NO_IDENTITY_RULES, sizeof(NO_IDENTITY_RULES) / sizeof(RewriteRule_t)) == TA_SUCCESS) {
+        const RewriteRules_t *previousRules = rewriteRulesSelect(&rules);
+        otherResult = simplifyExpression(NULL, context, copyTree(expr));
+        rewriteRulesSelect(previousRules);
+    }
+
+    bool ok = hits && defaultResult && otherResult && !equalTrees(defaultResult, otherResult);
+    printf("\nMemo cache and rewrite rules: %s simplified with default rules is %zu nodes, "
+           "without trigonometric identity %zu nodes: %s\n", exprStr, (defaultResult) ? defaultResult->size : 0,
+           (otherResult) ? otherResult->size : 0, benchPassed(ok) ? "ok" : "STALE");
+
+    deleteTree(defaultResult);
+    deleteTree(otherResult);
+    rewriteRulesDtor(&rules);
+    exprCacheSelect(previousCache);
+    exprCacheDtor(&cache);
+    deleteTree(expr);
+}
+
+/// @brief Optimize one expression of e-graph corpus and compare evaluation before and after
+static void benchEgraphRow(TungstenContext_t *context, const char *name, Node_t *expr) {
+    Node_t *optimized = copyTree(expr);
+    if (!optimized) return;
+
+    EgraphStats_t stats = {};
+    double startTime = getTimeMs();
+    optimized = optimizeExpression(optimized, EGRAPH_DEFAULT_LIMITS, &stats);
+    double optimizeTime = getTimeMs() - startTime;
+
+    double step = (BENCH_X_MAX - BENCH_X_MIN) / BENCH_EGRAPH_POINTS_COUNT;
+    double originalTime = 0, optimizedTime = 0;
+    bool sameValue = true;
+    for (size_t idx = 0; idx < BENCH_EGRAPH_POINTS_COUNT; idx++) {
+        setVariable(context, "x", BENCH_X_MIN + step * (double) idx);
+        startTime = getTimeMs();
+        double original = evaluate(context, expr);
+        originalTime += getTimeMs() - startTime;
+
+        startTime = getTimeMs();
+        double value = evaluate(context, optimized);
+        optimizedTime += getTimeMs() - startTime;
+
+        // optimized form can be defined where original is not: ln(a) + ln(b) = ln(a*b)
+        if (isfinite(original))
+            sameValue = sameValue && fabs(original - value) <= BENCH_EGRAPH_TOLERANCE * fmax(1, fabs(original));
+    }
+
+    printf("%-30s %6zu %6zu %7.0lf %7.0lf %7zu %5zu%s %8.2lf %8.1lf %8.1lf %7.2lf %6s\n", name,
+           countNodes(expr), countNodes(optimized), stats.costBefore, stats.costAfter, stats.nodes, stats.iterations,
+           (stats.saturated) ? "s" : " ", optimizeTime,
+           originalTime * 1e6 / BENCH_EGRAPH_POINTS_COUNT, optimizedTime * 1e6 / BENCH_EGRAPH_POINTS_COUNT,
+           originalTime / optimizedTime, benchPassed(sameValue) ? "ok" : "MISMATCH");
+    deleteTree(optimized);
+}
+
+/// @brief Cheapest forms found by equality saturation, "s" marks saturated e-graphs
+static void benchEgraph(TungstenContext_t *context) {
+    printf("\nE-graph optimizer: evaluation cost and time of one evaluation in %zu points (time in ns)\n",
+           BENCH_EGRAPH_POINTS_COUNT);
+    printf("%-30s %6s %6s %7s %7s %7s %6s %8s %8s %8s %7s %6s\n", "expression", "nodes", "after", "cost",
+           "after", "e-nodes", "iters", "opt ms", "before", "after", "speedup", "value");
+
+    const char * const corpus[] = {
+        "x^4*3 + x^4*5 + x^3*2 + x^2",
+        "ln(x+2) + ln(x+3) - ln(x+4)",
+        "sin(x)/cos(x) * x^2 + x^2 / 7",
+        "(x+1)^3 / (x+1)^2 + x^5 * x^(-3)",
+        "ch(x)*x^6 - sh(x)*x^6",
+    };
+    for (size_t idx = 0; idx < sizeof(corpus) / sizeof(corpus[0]); idx++) {
+        Node_t *expr = parseExpression(context, corpus[idx]);
+        if (!expr) continue;
+        benchEgraphRow(context, corpus[idx], expr);
+        deleteTree(expr);
+    }
+
+    Node_t *taylor = benchTaylorTree(context, "sin(x)*cos(x) + ln(x+2)", BENCH_EGRAPH_TAYLOR_ORDER);
+    if (taylor) {
+        benchEgraphRow(context, "taylor of sin(x)*cos(x)+...", taylor);
+        deleteTree(taylor);
+    }
+
+    Node_t *diff = benchSimplifiedDerivative(context, "x^2*sin(x)*cos(x)", BENCH_EGRAPH_DERIVATIVE_ORDER);
+    if (diff) {
+        benchEgraphRow(context, "derivative of x^2*sin(x)*cos(x)", diff);
+        deleteTree(diff);
+    }
+}
+
+/// @brief Compare tree of polynomial with its coefficients: evaluation and derivative
+static void benchPolynomialRow(TungstenContext_t *context, const char *name, size_t terms, Node_t *expr) {
+    int var = findVariable(context, "x");
+    Polynomial_t poly = {};
+    double startTime = getTimeMs();
+    if (polynomialFromTree(expr, var, &poly) != TA_SUCCESS) {
+        printf("%-24s %6zu: not a polynomial\n", name, terms);
+        return;
+    }
+    double convertTime = getTimeMs() - startTime;
+
+    double step = (BENCH_X_MAX - BENCH_X_MIN) / BENCH_POLYNOMIAL_POINTS_COUNT;
+    double evaluateTime = 0, hornerTime = 0;
+    bool sameValue = true;
+    for (size_t idx = 0; idx < BENCH_POLYNOMIAL_POINTS_COUNT; idx++) {
+        double x = BENCH_X_MIN + step * (double) idx;
+        setVariable(context, "x", x);
+        startTime = getTimeMs();
+        double value = evaluate(context, expr);
+        evaluateTime += getTimeMs() - startTime;
+
+        startTime = getTimeMs();
+        double horner = polynomialEvaluate(&poly, x);
+        hornerTime += getTimeMs() - startTime;
+
+        sameValue = sameValue && fabs(value - horner) <= BENCH_POLYNOMIAL_TOLERANCE * fmax(1, fabs(value));
+    }
+
+    startTime = getTimeMs();
+    Node_t *diff = derivative(NULL, context, expr, "x");
+    diff = (diff) ? simplifyExpression(NULL, context, diff) : NULL;
+    double diffTime = getTimeMs() - startTime;
+
+    Polynomial_t diffPoly = {};
+    startTime = getTimeMs();
+    polynomialDerivative(&poly, &diffPoly);
+    double coefsTime = getTimeMs() - startTime;
+
+    printf("%-24s %6zu %7zu %6zu %8.3lf %9.2lf %8.2lf %7.2lf %9.3lf %6zu %9.4lf %6s\n", name, terms,
+           countNodes(expr), poly.degree, convertTime, evaluateTime, hornerTime, evaluateTime / hornerTime,
+           diffTime, (diff) ? countNodes(diff) : 0, coefsTime, benchPassed(sameValue) ? "ok" : "MISMATCH");
+
+    deleteTree(diff);
+    polynomialDtor(&diffPoly);
+    polynomialDtor(&poly);
+}
+
+/// @brief Polynomials as trees and as dense coefficients
+static void benchPolynomials(TungstenContext_t *context) {
+    printf("\nPolynomials: tree vs coefficients, evaluation in %zu points (time in ms)\n",
+           BENCH_POLYNOMIAL_POINTS_COUNT);
+    printf("%-24s %6s %7s %6s %8s %9s %8s %7s %9s %6s %9s %6s\n", "expression", "terms", "nodes", "degree",
+           "convert", "evaluate", "horner", "speedup", "diff tree", "nodes", "diff coef", "value");
+
+    ExprCache_t disabled = exprCacheCtor(0);
+    ExprCache_t *previous = exprCacheSelect(&disabled);
+
+    for (size_t terms = BENCH_POLYNOMIAL_MIN_TERMS; terms <= BENCH_POLYNOMIAL_MAX_TERMS; terms *= 4) {
+        char *exprStr = powerSumString(terms - 1);
+        Node_t *expr = (exprStr) ? parseExpression(context, exprStr) : NULL;
+        free(exprStr);
+        if (!expr) break;
+
+        benchPolynomialRow(context, "x+x^2*2+3+...", terms, expr);
+        deleteTree(expr);
+    }
+
+    const TaylorOptions_t series = {TAYLOR_SERIES};
+    for (size_t order = BENCH_POLYNOMIAL_MIN_TERMS; order <= BENCH_POLYNOMIAL_MAX_TERMS; order *= 4) {
+        Node_t *expr = parseExpression(context, "sin(x)*cos(x) + ln(x+2)");
+        if (!expr) break;
+
+        TexContext_t tex = {};
+        Node_t *taylor = TaylorExpansion(&tex, context, expr, "x", 0, order, &series);
+        if (taylor)
+            benchPolynomialRow(context, "taylor of sin(x)*cos(x)+", order, taylor);
+        deleteTree(taylor);
+        deleteTree(expr);
+    }
+
+    exprCacheSelect(previous);
+    exprCacheDtor(&disabled);
+}
+
+/// @brief Time of evaluate() of expr in points around center
+static double benchEvaluateAround(TungstenContext_t *context, const Node_t *expr, double center, double *values) {
+    double step = 2 * BENCH_TAYLOR_FORM_RADIUS / BENCH_TAYLOR_FORM_POINTS_COUNT;
+    double startTime = getTimeMs();
+    for (size_t idx = 0; idx < BENCH_TAYLOR_FORM_POINTS_COUNT; idx++) {
+        setVariable(context, "x", center - BENCH_TAYLOR_FORM_RADIUS + step * (double) idx);
+        values[idx] = evaluate(context, expr);
+    }
+    return getTimeMs() - startTime;
+}
+
+/// @brief TaylorExpansion() returned as sum of powers and in Horner form
+static void benchTaylorForms(TungstenContext_t *context, const char *exprStr, double point) {
+    printf("\nTaylor polynomial of %s around %lg: sum of powers vs Horner form, "
+           "evaluation in %zu points (time in ms)\n", exprStr, point, BENCH_TAYLOR_FORM_POINTS_COUNT);
+    printf("%6s %9s %9s %10s %10s %8s %12s\n", "order", "sum nodes", "horner", "sum", "horner", "speedup",
+           "max rel diff");
+
+    double *sumValues    = (double *) calloc(BENCH_TAYLOR_FORM_POINTS_COUNT, sizeof(double));
+    double *hornerValues = (double *) calloc(BENCH_TAYLOR_FORM_POINTS_COUNT, sizeof(double));
+    Node_t *expr = parseExpression(context, exprStr);
+
+    for (size_t order = BENCH_TAYLOR_FORM_MIN_ORDER; order <= BENCH_TAYLOR_FORM_MAX_ORDER && expr && sumValues &&
+                                                     hornerValues; order *= 2) {
+        TexContext_t tex = {};
+        TaylorOptions_t options = {TAYLOR_SERIES, TAYLOR_SUM};
+        Node_t *sum = TaylorExpansion(&tex, context, expr, "x", point, order, &options);
+        options.form = TAYLOR_HORNER;
+        Node_t *horner = TaylorExpansion(&tex, context, expr, "x", point, order, &options);
+
+        if (sum && horner) {
+            double sumTime    = benchEvaluateAround(context, sum,    point, sumValues);
+            double hornerTime = benchEvaluateAround(context, horner, point, hornerValues);
+
+            double maxDiff = 0;
+            for (size_t idx = 0; idx < BENCH_TAYLOR_FORM_POINTS_COUNT; idx++)
+                maxDiff = fmax(maxDiff, fabs(sumValues[idx] - hornerValues[idx]) / fmax(1, fabs(sumValues[idx])));
+
+            printf("%6zu %9zu %9zu %10.2lf %10.2lf %8.2lf %12.2e\n", order, countNodes(sum), countNodes(horner),
+                   sumTime, hornerTime, sumTime / hornerTime, maxDiff);
+        }
+        deleteTree(sum);
+        deleteTree(horner);
+    }
+
+    deleteTree(expr);
+    free(sumValues);
+    free(hornerValues);
+}
+
+/// @brief Rosenbrock function of variables x1..xcount plus ln(1 + x1^2 + ... ), whose partials share the sum
+static char *gradientString(size_t count) {
+    char *str = (char *) calloc(2 * count * BENCH_POWER_TERM_LENGTH, sizeof(char));
+    if (!str) return NULL;
+
+    char *pos = str;
+    for (size_t idx = 1; idx < count; idx++)
+        pos += sprintf(pos, "100*(x%zu-x%zu^2)^2+(1-x%zu)^2+", idx + 1, idx, idx);
+    pos += sprintf(pos, "ln(1");
+    for (size_t idx = 1; idx <= count; idx++)
+        pos += sprintf(pos, "+x%zu^2", idx);
+    sprintf(pos, ")");
+    return str;
+}
+
+/// @brief Set x1..xcount around given shift
+static void setGradientPoint(TungstenContext_t *context, const int *variables, size_t count, double shift) {
+    for (size_t idx = 0; idx < count; idx++)
+        context->variables[variables[idx]].number = shift + BENCH_X_MIN * (double) (idx % 7);
+}
+
+/// @brief Gradient by independent derivative() calls vs one pass on DAG, and Hessian on DAG
+static void benchGradientRow(TungstenContext_t *context, size_t count) {
+    char *exprStr = gradientString(count);
+    Node_t *expr = (exprStr) ? parseExpression(context, exprStr) : NULL;
+    free(exprStr);
+
+    int *variables = (int *) calloc(count, sizeof(int));
+    Node_t **trees = (Node_t **) calloc(count, sizeof(Node_t *));
+    Node_t **partials = (Node_t **) calloc(count * (count + 1), sizeof(Node_t *));
+    double *treeValues = (double *) calloc(count, sizeof(double));
+    double *dagValues = (double *) calloc(count * count, sizeof(double));
+    if (!expr || !variables || !trees || !partials || !treeValues || !dagValues) {
+        deleteTree(expr);
+        free(variables); free(trees); free(partials); free(treeValues); free(dagValues);
+        return;
+    }
+
+    char name[BENCH_POWER_TERM_LENGTH] = "";
+    for (size_t idx = 0; idx < count; idx++) {
+        snprintf(name, BENCH_POWER_TERM_LENGTH, "x%zu", idx + 1);
+        variables[idx] = findVariable(context, name);
+    }
+
+    // k independent derivatives, each copies shared subtrees
+    TexContext_t tex = {};
+    size_t treeNodes = 0;
+    double startTime = getTimeMs();
+    for (size_t idx = 0; idx < count; idx++) {
+        snprintf(name, BENCH_POWER_TERM_LENGTH, "x%zu", idx + 1);
+        trees[idx] = simplifyExpression(&tex, context, derivative(&tex, context, expr, name));
+        treeNodes += (trees[idx]) ? countNodes(trees[idx]) : 0;
+    }
+    double treeBuildTime = getTimeMs() - startTime;
+
+    ExprDag_t dag = {};
+    dagCtor(&dag);
+    startTime = getTimeMs();
+    Node_t *dagExpr = dagInternTree(&dag, expr);
+    size_t exprNodes = dag.size;
+    bool ok = dagExpr && dagGradient(&dag, dagExpr, variables, count, partials) == TA_SUCCESS;
+    double gradientBuildTime = getTimeMs() - startTime;
+    size_t gradientNodes = dag.size - exprNodes;
+
+    startTime = getTimeMs();
+    ok = ok && dagJacobian(&dag, partials, count, variables, count, partials + count) == TA_SUCCESS;
+    double hessianBuildTime = getTimeMs() - startTime;
+    size_t hessianNodes = dag.size - exprNodes - gradientNodes;
+
+    double treeTime = 0, gradientTime = 0, hessianTime = 0, maxDiff = 0;
+    for (size_t point = 0; point < BENCH_GRADIENT_POINTS_COUNT && ok; point++) {
+        setGradientPoint(context, variables, count, BENCH_X_MIN * (double) point / BENCH_GRADIENT_POINTS_COUNT);
+
+        startTime = getTimeMs();
+        for (size_t idx = 0; idx < count; idx++)
+            treeValues[idx] = (trees[idx]) ? evaluate(context, trees[idx]) : NAN;
+        treeTime += getTimeMs() - startTime;
+
+        startTime = getTimeMs();
+        dagEvaluateMany(&dag, context, partials, count, dagValues);
+        gradientTime += getTimeMs() - startTime;
+
+        for (size_t idx = 0; idx < count; idx++)
+            maxDiff = fmax(maxDiff, fabs(treeValues[idx] - dagValues[idx]) / fmax(1, fabs(treeValues[idx])));
+
+        startTime = getTimeMs();
+        dagEvaluateMany(&dag, context, partials + count, count * count, dagValues);
+        hessianTime += getTimeMs() - startTime;
+    }
+
+    printf("%9zu %10zu %9.2lf %9.2lf %10zu %9.2lf %9.2lf %10zu %9.2lf %9.2lf %12.2e\n", count,
+           treeNodes, treeBuildTime, treeTime * 1e3 / BENCH_GRADIENT_POINTS_COUNT,
+           gradientNodes, gradientBuildTime, gradientTime * 1e3 / BENCH_GRADIENT_POINTS_COUNT,
+           hessianNodes, hessianBuildTime, hessianTime * 1e3 / BENCH_GRADIENT_POINTS_COUNT, (ok) ? maxDiff : NAN);
+
+    for (size_t idx = 0; idx < count; idx++)
+        deleteTree(trees[idx]);
+    dagDtor(&dag);
+    deleteTree(expr);
+    free(variables); free(trees); free(partials); free(treeValues); free(dagValues);
+}
+
+static void benchGradient(TungstenContext_t *context) {
+    printf("\nGradient of Rosenbrock + ln(1 + sum of squares): derivative() per variable vs one pass on DAG, "
+           "Hessian on DAG (build in ms, evaluation of all partials in us)\n");
+    printf("%9s %10s %9s %9s %10s %9s %9s %10s %9s %9s %12s\n", "variables", "tree nodes", "build", "evaluate",
+           "dag nodes", "build", "evaluate", "hess nodes", "build", "evaluate", "max rel diff");
+
+    ExprCache_t disabled = exprCacheCtor(0);
+    ExprCache_t *previous = exprCacheSelect(&disabled);
+
+    for (size_t count = BENCH_GRADIENT_MIN_VARIABLES; count <= BENCH_GRADIENT_MAX_VARIABLES;
+         count += BENCH_GRADIENT_VARIABLES_STEP)
+        benchGradientRow(context, count);
+
+    exprCacheSelect(previous);
+    exprCacheDtor(&disabled);
+}
+
+/// @brief Value and gradient in one point by reverse tape vs evaluate(), shared DAG gradient and dual numbers
+static void benchReverseRow(TungstenContext_t *context, size_t count) {
+    char *exprStr = gradientString(count);
+    Node_t *expr = (exprStr) ? parseExpression(context, exprStr) : NULL;
+    free(exprStr);
+
+    int *variables = (int *) calloc(count, sizeof(int));
+    Node_t **partials = (Node_t **) calloc(count, sizeof(Node_t *));
+    double *gradient = (double *) calloc(VARIABLE_TABLE_SIZE, sizeof(double));
+    double *dagValues = (double *) calloc(2 * count, sizeof(double));
+    if (!expr || !variables || !partials || !gradient || !dagValues) {
+        deleteTree(expr);
+        free(variables); free(partials); free(gradient); free(dagValues);
+        return;
+    }
+    double *dualValues = dagValues + count;
+
+    char name[BENCH_POWER_TERM_LENGTH] = "";
+    for (size_t idx = 0; idx < count; idx++) {
+        snprintf(name, BENCH_POWER_TERM_LENGTH, "x%zu", idx + 1);
+        variables[idx] = findVariable(context, name);
+    }
+
+    ExprDag_t dag = {};
+    dagCtor(&dag);
+    Node_t *dagExpr = dagInternTree(&dag, expr);
+    bool ok = dagExpr && dagGradient(&dag, dagExpr, variables, count, partials) == TA_SUCCESS;
+
+    // warming up: tape takes its memory once
+    ReverseTape_t tape = reverseTapeCtor();
+    double value = 0;
+    setGradientPoint(context, variables, count, 0);
+    ok = ok && evaluateGradient(&tape, context, expr, &value, gradient) == TA_SUCCESS;
+    const TapeEntry_t *entries = tape.entries;
+    size_t capacity = tape.capacity;
+
+    double evaluateTime = 0, reverseTime = 0, dagTime = 0, dualTime = 0, maxDiff = 0;
+    bool valuesIdentical = true;
+    for (size_t point = 0; point < BENCH_REVERSE_POINTS_COUNT && ok; point++) {
+        setGradientPoint(context, variables, count, BENCH_X_MIN * (double) point / BENCH_REVERSE_POINTS_COUNT);
+
+        double startTime = getTimeMs();
+        double plainValue = evaluate(context, expr);
+        evaluateTime += getTimeMs() - startTime;
+
+        startTime = getTimeMs();
+        evaluateGradient(&tape, context, expr, &value, gradient);
+        reverseTime += getTimeMs() - startTime;
+
+        startTime = getTimeMs();
+        dagEvaluateMany(&dag, context, partials, count, dagValues);
+        dagTime += getTimeMs() - startTime;
+
+        startTime = getTimeMs();
+        for (size_t idx = 0; idx < count; idx++)
+            dualValues[idx] = evaluateDual(context, expr, variables[idx]).derivative;
+        dualTime += getTimeMs() - startTime;
+
+        if (memcmp(&plainValue, &value, sizeof(double)) != 0)
+            valuesIdentical = false;
+        for (size_t idx = 0; idx < count; idx++) {
+            double partial = gradient[variables[idx]];
+            maxDiff = fmax(maxDiff, fabs(partial - dagValues[idx])  / fmax(1, fabs(dagValues[idx])));
+            maxDiff = fmax(maxDiff, fabs(partial - dualValues[idx]) / fmax(1, fabs(dualValues[idx])));
+        }
+    }
+
+    double scale = 1e3 / BENCH_REVERSE_POINTS_COUNT;
+    bool noAllocations = tape.entries == entries && tape.capacity == capacity;
+    printf("%9zu %8zu %9.2lf %9.2lf %7.2lfx %9.2lf %9.2lf %12.2e %9s %6s\n", count, tape.size,
+           evaluateTime * scale, reverseTime * scale, reverseTime / evaluateTime, dagTime * scale, dualTime * scale,
+           (ok) ? maxDiff : NAN, benchPassed(valuesIdentical) ? "identical" : "DIFFERENT", benchPassed(noAllocations) ? "none" : "GROWN");
+
+    reverseTapeDtor(&tape);
+    dagDtor(&dag);
+    deleteTree(expr);
+    free(variables); free(partials); free(gradient); free(dagValues);
+}
+
+static void benchReverse(TungstenContext_t *context) {
+    printf("\nValue and gradient of Rosenbrock + ln(1 + sum of squares) in one point: "
+           "evaluate() vs reverse tape, evaluation of DAG gradient and dual numbers per variable (time in us)\n");
+    printf("%9s %8s %9s %9s %8s %9s %9s %12s %9s %6s\n", "variables", "entries", "evaluate", "reverse", "ratio",
+           "dag", "dual", "max rel diff", "value", "allocs");
+
+    for (size_t count = BENCH_REVERSE_MIN_VARIABLES; count <= BENCH_REVERSE_MAX_VARIABLES;
+         count += BENCH_REVERSE_VARIABLES_STEP)
+        benchReverseRow(context, count);
+}
+
+/// @brief Evaluate long sum with tree walk and bytecode, print row of n-ary benchmark
+static void benchNaryRow(TungstenContext_t *context, const char *name, size_t terms, Node_t *expr,
+                         double simplifyTime, size_t allocations) {
+    CompiledExpr_t program = {};
+    bool identical = compileExpression(expr, &program) == TA_SUCCESS;
+
+    double step = (BENCH_X_MAX - BENCH_X_MIN) / BENCH_NARY_POINTS_COUNT, evaluateTime = 0;
+    for (size_t idx = 0; idx < BENCH_NARY_POINTS_COUNT && identical; idx++) {
+        setVariable(context, "x", BENCH_X_MIN + step * (double) idx);
+        double startTime = getTimeMs();
+        double value = evaluate(context, expr);
+        evaluateTime += getTimeMs() - startTime;
+
+        double compiled = evaluateCompiled(context, &program);
+        identical = memcmp(&value, &compiled, sizeof(double)) == 0;
+    }
+    deleteCompiled(&program);
+
+    printf("%-30s %8zu %9zu %9zu %10.2lf %11zu %10.2lf %9s\n", name, terms, countNodes(expr), expr->operandsCount,
+           simplifyTime, allocations, evaluateTime, benchPassed(identical) ? "identical" : "MISMATCH");
+}
+
+static void benchNarySums(TungstenContext_t *context) {
+    printf("\nLong sums in n-ary nodes: simplification and evaluation in %zu points (time in ms)\n",
+           BENCH_NARY_POINTS_COUNT);
+    printf("%-30s %8s %9s %9s %10s %11s %10s %9s\n", "expression", "terms", "nodes", "operands", "simplify",
+           "allocations", "evaluate", "bytecode");
+
+    ExprCache_t disabled = exprCacheCtor(0);
+    ExprCache_t *previous = exprCacheSelect(&disabled);
+
+    for (size_t terms = BENCH_NARY_MIN_TERMS; terms <= BENCH_NARY_MAX_TERMS; terms *= 4) {
+        char *exprStr = powerSumString(terms - 1);
+        Node_t *expr = (exprStr) ? parseExpression(context, exprStr) : NULL;
+        free(exprStr);
+        if (!expr) break;
+
+        NodeArena_t job = nodeArenaCtor();
+        NodeArena_t *previousArena = nodeArenaSelect(&job);
+        double startTime = getTimeMs();
+        expr = simplifyExpression(NULL, context, expr);
+        double simplifyTime = getTimeMs() - startTime;
+        nodeArenaSelect(previousArena);
+
+        benchNaryRow(context, "x+x^2*2+3+...", terms, expr, simplifyTime, job.stats.allocations);
+        deleteTree(expr);
+        nodeArenaDtor(&job);
+    }
+
+    const TaylorOptions_t series = {TAYLOR_SERIES};
+    for (size_t order = BENCH_NARY_MIN_ORDER; order <= BENCH_NARY_MAX_ORDER; order *= 4) {
+        Node_t *expr = parseExpression(context, "1/(1-x)");
+        if (!expr) break;
+
+        TexContext_t tex = {};
+        NodeArena_t job = nodeArenaCtor();
+        NodeArena_t *previousArena = nodeArenaSelect(&job);
+        double startTime = getTimeMs();
+        Node_t *taylor = TaylorExpansion(&tex, context, expr, "x", 0, order, &series);
+        double taylorTime = getTimeMs() - startTime;
+        nodeArenaSelect(previousArena);
+
+        if (taylor)
+            benchNaryRow(context, "taylor of 1/(1-x)", order, taylor, taylorTime,
+                         job.stats.allocations);
+        deleteTree(taylor);
+        deleteTree(expr);
+        nodeArenaDtor(&job);
+    }
+
+    exprCacheSelect(previous);
+    exprCacheDtor(&disabled);
+}
+
+/// @brief Time of derivative() and simplifyExpression() of expr with given narration
+static double benchNarratedDerivative(TexContext_t *tex, TungstenContext_t *context, Node_t *expr, size_t *nodesCount) {
+    double startTime = getTimeMs();
+    Node_t *diff = derivative(tex, context, expr, "x");
+    diff = simplifyExpression(tex, context, diff);
+    double time = getTimeMs() - startTime;
+
+    *nodesCount = countNodes(diff);
+    deleteTree(diff);
+    return time;
+}
+
+static void benchNarration(TungstenContext_t *context) {
+    printf("\nDerivative + simplification with report to %s vs compute-only (time in ms)\n", BENCH_NARRATION_FILE);
+    printf("%8s %10s %12s %12s %12s %10s\n", "terms", "nodes", "report", "inactive", "NULL tex", "speedup");
+
+    // memo cache would hide repeated work
+    ExprCache_t disabled = exprCacheCtor(0);
+    ExprCache_t *previous = exprCacheSelect(&disabled);
+
+    for (size_t terms = BENCH_NARRATION_MIN_TERMS; terms <= BENCH_NARRATION_MAX_TERMS; terms *= 4) {
+        char *exprStr = repeatString("sin(x)", "+sin(x)*x^2/ln(x+2)", terms - 1, "");
+        Node_t *expr = (exprStr) ? parseExpression(context, exprStr) : NULL;
+        free(exprStr);
+        if (!expr) break;
+
+        TexContext_t report = texInit(BENCH_NARRATION_FILE), inactive = {};
+        size_t reportNodes = 0, inactiveNodes = 0, computeNodes = 0;
+        double reportTime   = benchNarratedDerivative(&report,   context, expr, &reportNodes);
+        double inactiveTime = benchNarratedDerivative(&inactive, context, expr, &inactiveNodes);
+        double computeTime  = benchNarratedDerivative(NULL,      context, expr, &computeNodes);
+        if (report.file)
+            fclose(report.file);
+
+        printf("%8zu %10zu %12.2lf %12.2lf %12.2lf %9.1lfx%s\n", terms, countNodes(expr),
+               reportTime, inactiveTime, computeTime, reportTime / computeTime,
+               benchPassed(reportNodes == computeNodes && inactiveNodes == computeNodes) ? "" : " MISMATCH");
+        deleteTree(expr);
+    }
+
+    exprCacheSelect(previous);
+    exprCacheDtor(&disabled);
+}
+
+/// @brief Narrate derivative and simplification with given budget
+/// @return Time in ms, size of report is written to bytes
+static double benchBudgetReport(TungstenContext_t *context, Node_t *expr, TexBudget_t budget, size_t *bytes) {
+    TexContext_t report = texInit(BENCH_NARRATION_FILE);
+    report.budget = budget;
+    size_t headerBytes = report.written;
+
+    size_t nodesCount = 0;
+    double time = benchNarratedDerivative(&report, context, expr, &nodesCount);
+
+    *bytes = report.written - headerBytes;
+    if (report.file)
+        fclose(report.file);
+    free(report.placeholders);
+    free(report.pending);
+    return time;
+}
+
+static void benchNarrationBudget(TungstenContext_t *context) {
+    printf("\nReport of derivative + simplification: default budget {%zu steps, depth %zu, %zu nodes} vs unlimited\n",
+           TEX_DEFAULT_BUDGET.maxSteps, TEX_DEFAULT_BUDGET.maxDepth, TEX_DEFAULT_BUDGET.maxNodes);
+    printf("%8s %10s %12s %12s %12s %12s %14s\n",
+           "terms", "nodes", "budget, KB", "budget, ms", "full, KB", "full, ms", "budget B/node");
+
+    ExprCache_t disabled = exprCacheCtor(0);
+    ExprCache_t *previous = exprCacheSelect(&disabled);
+    const TexBudget_t unlimited = {};
+
+    for (size_t terms = BENCH_NARRATION_MIN_TERMS; terms <= BENCH_BUDGET_MAX_TERMS; terms *= 4) {
+        char *exprStr = repeatString("sin(x)", "+sin(x)*x^2/ln(x+2)", terms - 1, "");
+        Node_t *expr = (exprStr) ? parseExpression(context, exprStr) : NULL;
+        free(exprStr);
+        if (!expr) break;
+
+        size_t nodesCount = countNodes(expr);
+        size_t budgetBytes = 0;
+        double budgetTime = benchBudgetReport(context, expr, TEX_DEFAULT_BUDGET, &budgetBytes);
+
+        printf("%8zu %10zu %12.1lf %12.2lf ", terms, nodesCount, (double) budgetBytes / 1024, budgetTime);
+        if (terms <= BENCH_NARRATION_MAX_TERMS) {
+            size_t fullBytes = 0;
+            double fullTime = benchBudgetReport(context, expr, unlimited, &fullBytes);
+            printf("%12.1lf %12.2lf ", (double) fullBytes / 1024, fullTime);
+        } else {
+            printf("%12s %12s ", "-", "-");
+        }
+        printf("%14.1lf\n", (double) budgetBytes / (double) nodesCount);
+
+        deleteTree(expr);
+    }
+
+    exprCacheSelect(previous);
+    exprCacheDtor(&disabled);
+}
+
+bool runBenchmarks(TungstenContext_t *context) {
+    assert(context);
+    benchFailedChecks = 0;
+
+    printf("Evaluation of %zu points: tree walk vs bytecode vs batch vs JIT (time in ms)\n", BENCH_POINTS_COUNT);
+    printf("%-24s %8s %12s %12s %12s %12s %10s %9s %9s %9s\n",
+           "expression", "nodes", "evaluate", "compiled", "batch", "jit", "compile", "compiled", "batch", "jit");
+
+    Node_t *taylor = benchTaylorTree(context, "sin(x)*cos(x) + ln(x+2)", 10);
+    Node_t *diff   = benchDerivativeTree(context, "sin(x)^x / ln(x+2)", 2);
+    if (!taylor || !diff) {
+        deleteTree(taylor);
+        deleteTree(diff);
+        return false;
+    }
+
+    benchEvaluation(context, "taylor, 10 members", taylor);
+    benchEvaluation(context, "second derivative", diff);
+
+    checkJit(context);
+
+    benchTaylorDag(context, "sin(x)^x / ln(x+2)", 10);
+
+    benchDual(context, "sin(x)^x / ln(x+2)");
+    benchDual(context, "tg(x) * ch(x) + ctg(x+1) - sh(x)^2 + cos(x)^3 * 2^x");
+
+    benchTaylorSeries(context, "sin(x)^x / ln(x+2)", 0.5);
+    benchTaylorSeries(context, "tg(x) * ch(x) + ctg(x+1) - sh(x)^2 + cos(x)^3", 0.3);
+    benchTaylorSeries(context, "ln(x^2+3) / (1 + x) + (x+1)^x - x^3 * sin(x)", 0);
+    benchTaylorClosedForm(context);
+
+    benchCache(context, "sin(x)^x / ln(x+2)", 4);
+    benchCache(context, "(x^2+1)^(x^2+1) * sin(x^2+1) / (x^2+1)", 3);
+
+    benchNarration(context);
+    benchNarrationBudget(context);
+
+    benchSimplifyPasses(context);
+    benchNarySums(context);
+    benchLikeTerms(context, "x^2*sin(x)*cos(x)", BENCH_LIKE_TERMS_ORDER);
+    benchLikeTerms(context, "tg(x)", BENCH_LIKE_TERMS_ORDER);
+
+    benchRewriteRules(context, "ln(x^3) * x^2 / (x + 1)", BENCH_REWRITE_ORDER);
+    benchRewriteCache(context);
+
+    benchEgraph(context);
+
+    benchPolynomials(context);
+    benchTaylorForms(context, "sin(x)*cos(x) + ln(x+2)", 0);
+    benchTaylorForms(context, "sin(x)*cos(x) + ln(x+2)", 0.5);
+
+    benchGradient(context);
+    benchReverse(context);
+
+    benchArena(context, "sin(x)^x / ln(x+2)", 4);
+
+    benchCompact(context, "sin(x)^x / ln(x+2)", 4);
+
+    benchDeepTrees(context);
+
+    benchGrid(context, "x^sin(7*x) + ln(x+2) * cos(x) / x");
+
+    benchReentrant(context, "x^y + sin(x*y) / ln(x+y+2)");
+
+    deleteTree(taylor);
+    deleteTree(diff);
+
+    if (benchFailedChecks)
+        printf("\n%zu self-checks FAILED\n", benchFailedChecks);
+    return benchFailedChecks == 0;
+}
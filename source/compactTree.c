@@ -0,0 +1,274 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "compactTree.h"
+#include "treeStack.h"
+
+static TungstenStatus_t reserveCompact(void **array, uint32_t *capacity, uint32_t size, size_t elemSize) {
+    if (size < *capacity)
+        return TA_SUCCESS;
+
+    uint32_t newCapacity = (*capacity) ? *capacity * 2 : 64;
+    void *newArray = realloc(*array, newCapacity * elemSize);
+    if (!newArray)
+        return TA_MEMORY_ERROR;
+
+    *array = newArray;
+    *capacity = newCapacity;
+    return TA_SUCCESS;
+}
+
+/// @brief Append node after its operands
+/// @return Index of node or COMPACT_NULL on error
+static uint32_t pushCompact(CompactTree_t *compact, CompactNode_t compactNode) {
+    if (compact->size == COMPACT_NULL ||
+        reserveCompact((void **) &compact->nodes, &compact->capacity,
+                       compact->size, sizeof(CompactNode_t)) != TA_SUCCESS)
+        return COMPACT_NULL;
+
+    compact->nodes[compact->size] = compactNode;
+    return compact->size++;
+}
+
+/// @brief Append number or variable
+static uint32_t pushCompactLeaf(CompactTree_t *compact, const Node_t *node) {
+    CompactNode_t compactNode = {};
+    compactNode.type = (uint8_t) node->type;
+    compactNode.left = compactNode.right = COMPACT_NULL;
+
+    if (node->type == NUMBER) {
+        if (reserveCompact((void **) &compact->numbers, &compact->numbersCapacity,
+                           compact->numbersCount, sizeof(double)) != TA_SUCCESS)
+            return COMPACT_NULL;
+
+        compactNode.value = compact->numbersCount;
+        compact->numbers[compact->numbersCount++] = node->value.number;
+    } else {
+        assert(node->type == VARIABLE);
+        compactNode.value = (uint32_t) node->value.var;
+    }
+
+    return pushCompact(compact, compactNode);
+}
+
+/// @brief Operator waiting for its operands
+typedef struct {
+    const Node_t *node;
+    size_t next;            ///< Operands appended so far
+    uint32_t left;          ///< Left operand, for n-ary operator chain of appended operands
+    uint32_t right;
+} CompactFrame_t;
+
+TREE_STACK_DEFINE(CompactStack, CompactFrame_t)
+
+static inline size_t compactOperandsCount(const Node_t *node) {
+    return (node->operandsCount) ? node->operandsCount : (node->right) ? 2 : 1;
+}
+
+static inline const Node_t *compactOperand(const Node_t *node, size_t idx) {
+    if (node->operandsCount) return node->operands[idx];
+    return (idx == 0) ? node->left : node->right;
+}
+
+/// @brief Give appended operand to waiting operator
+/// @return Index of new chain node for n-ary operator, operand itself otherwise, COMPACT_NULL on error
+static uint32_t takeOperand(CompactTree_t *compact, CompactFrame_t *frame, uint32_t operand) {
+    if (frame->next == 1) {
+        frame->left = operand;
+        return operand;
+    }
+
+    if (!frame->node->operandsCount) {
+        frame->right = operand;
+        return operand;
+    }
+
+    // compact form is binary: a + b + c is stored as (a + b) + c
+    CompactNode_t chain = {OPERATOR, (uint8_t) frame->node->value.op, 0, frame->left, operand};
+    frame->left = pushCompact(compact, chain);
+    return frame->left;
+}
+
+/// @brief Append tree in post-order
+/// @return Index of root or COMPACT_NULL on error
+static uint32_t appendCompact(CompactTree_t *compact, const Node_t *tree) {
+    assert(tree);
+
+    if (tree->type != OPERATOR)
+        return pushCompactLeaf(compact, tree);
+
+    CompactFrame_t buffer[TREE_STACK_MIN_CAPACITY] = {};
+    CompactStack_t stack = CompactStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+
+    CompactFrame_t root = {tree, 0, COMPACT_NULL, COMPACT_NULL};
+    uint32_t appended = (CompactStackPush(&stack, root)) ? 0 : COMPACT_NULL;
+    while (stack.size && appended != COMPACT_NULL) {
+        CompactFrame_t *frame = CompactStackTop(&stack);
+
+        if (frame->next < compactOperandsCount(frame->node)) {
+            const Node_t *operand = compactOperand(frame->node, frame->next++);
+            if (operand->type == OPERATOR) {
+                CompactFrame_t operandFrame = {operand, 0, COMPACT_NULL, COMPACT_NULL};
+                appended = (CompactStackPush(&stack, operandFrame)) ? 0 : COMPACT_NULL;
+                continue;
+            }
+
+            appended = pushCompactLeaf(compact, operand);
+            if (appended != COMPACT_NULL)
+                appended = takeOperand(compact, frame, appended);
+            continue;
+        }
+
+        CompactFrame_t done = CompactStackPop(&stack);
+        if (done.node->operandsCount) {
+            appended = done.left;
+        } else {
+            CompactNode_t compactNode = {OPERATOR, (uint8_t) done.node->value.op, 0, done.left, done.right};
+            appended = pushCompact(compact, compactNode);
+        }
+
+        if (stack.size && appended != COMPACT_NULL)
+            appended = takeOperand(compact, CompactStackTop(&stack), appended);
+    }
+
+    CompactStackDtor(&stack);
+    return appended;
+}
+
+TungstenStatus_t treeToCompact(const Node_t *tree, CompactTree_t *compact, bool withParents) {
+    assert(tree);
+    assert(compact);
+
+    *compact = {};
+
+    if (appendCompact(compact, tree) == COMPACT_NULL) {
+        logPrint(L_ZERO, 1, "Failed to convert tree[%p] to compact form\n", tree);
+        deleteCompact(compact);
+        return TA_MEMORY_ERROR;
+    }
+
+    if (withParents) {
+        compact->parents = (uint32_t *) calloc(compact->size, sizeof(uint32_t));
+        if (!compact->parents) {
+            deleteCompact(compact);
+            return TA_MEMORY_ERROR;
+        }
+
+        compact->parents[compact->size - 1] = COMPACT_NULL;
+        for (uint32_t idx = 0; idx < compact->size; idx++) {
+            const CompactNode_t *node = compact->nodes + idx;
+            if (node->left  != COMPACT_NULL) compact->parents[node->left]  = idx;
+            if (node->right != COMPACT_NULL) compact->parents[node->right] = idx;
+        }
+    }
+
+    logPrint(L_DEBUG, 0, "Tree[%p] -> compact: %u nodes, %u numbers\n", tree, compact->size, compact->numbersCount);
+    return TA_SUCCESS;
+}
+
+uint32_t compactRoot(const CompactTree_t *compact) {
+    assert(compact);
+    return (compact->size) ? compact->size - 1 : COMPACT_NULL;
+}
+
+Node_t *compactToTree(const CompactTree_t *compact) {
+    assert(compact);
+    if (compact->size == 0) return NULL;
+
+    // children are always before parents, so every node is built after its subtrees
+    Node_t **built = (Node_t **) calloc(compact->size, sizeof(Node_t *));
+    if (!built)
+        return NULL;
+
+    for (uint32_t idx = 0; idx < compact->size; idx++) {
+        const CompactNode_t *node = compact->nodes + idx;
+        Node_t *left  = (node->left  != COMPACT_NULL) ? built[node->left]  : NULL,
+               *right = (node->right != COMPACT_NULL) ? built[node->right] : NULL;
+
+        switch((enum ElemType) node->type) {
+            case NUMBER:
+                built[idx] = createNode(NUMBER, 0, compact->numbers[node->value], NULL, NULL);
+                break;
+            case VARIABLE:
+                built[idx] = createNode(VARIABLE, (int) node->value, 0, NULL, NULL);
+                break;
+            case OPERATOR:
+                built[idx] = createNode(OPERATOR, node->op, 0, left, right);
+                break;
+            default:
+                assert(0);
+                break;
+        }
+
+        if (!built[idx]) {
+            // subtrees that are not attached to parent yet hold all nodes built so far
+            logPrint(L_ZERO, 1, "Not enough memory to convert compact tree to Node_t tree\n");
+            for (uint32_t builtIdx = 0; builtIdx < idx; builtIdx++) {
+                if (!built[builtIdx]->parent)
+                    deleteTree(built[builtIdx]);
+            }
+            free(built);
+            return NULL;
+        }
+    }
+
+    Node_t *root = built[compact->size - 1];
+    free(built);
+    return root;
+}
+
+double compactEvaluate(TungstenContext_t *context, CompactTree_t *compact) {
+    assert(context);
+    assert(compact);
+    assert(compact->size);
+
+    if (!compact->values) {
+        compact->values = (double *) calloc(compact->size, sizeof(double));
+        if (!compact->values) {
+            logPrint(L_ZERO, 1, "Not enough memory to evaluate compact tree\n");
+            return 0;
+        }
+    }
+
+    double *values = compact->values;
+    for (uint32_t idx = 0; idx < compact->size; idx++) {
+        const CompactNode_t *node = compact->nodes + idx;
+        switch((enum ElemType) node->type) {
+            case NUMBER:
+                values[idx] = compact->numbers[node->value];
+                break;
+            case VARIABLE:
+                values[idx] = context->variables[node->value].number;
+                break;
+            case OPERATOR:
+                values[idx] = calculateOperation((enum OperatorType) node->op, values[node->left],
+                                                 (node->right != COMPACT_NULL) ? values[node->right] : 0);
+                break;
+            default:
+                assert(0);
+                break;
+        }
+    }
+
+    return values[compact->size - 1];
+}
+
+TungstenStatus_t deleteCompact(CompactTree_t *compact) {
+    if (!compact) return TA_NULL_PTR;
+
+    free(compact->nodes);
+    free(compact->numbers);
+    free(compact->parents);
+    free(compact->values);
+    *compact = {};
+
+    return TA_SUCCESS;
+}
@@ -2,36 +2,74 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 
 #include "hashTable.h"
 #include "tex.h"
 #include "logger.h"
 #include "exprTree.h"
+#include "nodeArena.h"
+#include "exprCache.h"
 #include "derivative.h"
+#include "exprDag.h"
+#include "exprCompiler.h"
+#include "taylorSeries.h"
+#include "exprPolynomial.h"
+#include "treeStack.h"
 
 #include "treeDSL.h"
 
-static bool hasVariable(Node_t *node, int variable) {
-    assert(node);
-
-    if (node->type == NUMBER) return false;
-    if (node->type == VARIABLE) return (node->value.var == variable);
-
-    if (operators[node->value.op].binary)
-        return hasVariable(node->left, variable) || hasVariable(node->right, variable);
-    else
-        return hasVariable(node->left, variable);
+/// @brief Which derivatives of operands derivativeOperator() needs
+static void derivativeOperands(Node_t *expr, int variable, bool *needLeft, bool *needRight) {
+    switch(expr->value.op) {
+        case POW:
+            *needLeft  = hasVariable(expr->left,  variable);
+            *needRight = hasVariable(expr->right, variable);
+            break;
+        case LOG:
+            *needLeft  = false;
+            *needRight = true;
+            break;
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+        case SIN:
+        case COS:
+        case SINH:
+        case COSH:
+        case TAN:
+        case CTG:
+        case LOGN:
+        default:
+            *needLeft  = true;
+            *needRight = operators[expr->value.op].binary;
+            break;
+    }
 }
 
-
 /*=======DSL FOR DERIVATIVES==================*/
-#define dL_ derivativeBase(tex, context, expr->left, variable)
-#define dR_ derivativeBase(tex, context, expr->right, variable)
+#define dL_ diffLeft
+#define dR_ diffRight
 #define cL_ copyTree(expr->left)
 #define cR_ copyTree(expr->right)
 
-static Node_t *derivativeOperator(TexContext_t *tex, TungstenContext_t *context, Node_t *expr, int variable) {
-    assert(tex);
+/// @brief diff * factor or factor * diff, factor is copied only if diff isn't zero
+static Node_t *productTerm(Node_t *diff, Node_t *factor, bool diffFirst) {
+    if (!diff || isNumberNode(diff, 0))
+        return diff;
+
+    return (diffFirst) ? FOLD_(MUL, diff, copyTree(factor)) : FOLD_(MUL, copyTree(factor), diff);
+}
+
+/// @brief Build derivative of operator from derivatives of its operands.
+/// Nodes are built by FOLD_, so multiplications by 0 and 1, additions of 0 and constant
+/// subexpressions are never created
+/// @param diffLeft, diffRight Derivatives requested by derivativeOperands(), NULL for others.
+/// For POW NULL derivative means that operand doesn't depend on variable
+static Node_t *derivativeOperator(TungstenContext_t *context, Node_t *expr, Node_t *diffLeft, Node_t *diffRight) {
     assert(context);
     assert(expr);
 
@@ -39,29 +77,35 @@ static Node_t *derivativeOperator(TexContext_t *tex, TungstenContext_t *context,
 
     switch(expr->value.op) {
         case ADD:
-            result = OPR_(ADD, dL_, dR_);
+            result = FOLD_(ADD, dL_, dR_);
             break;
         case SUB:
-            result = OPR_(SUB, dL_, dR_);
+            result = FOLD_(SUB, dL_, dR_);
             break;
         case MUL:
-            result = OPR_(ADD,  OPR_(MUL, dL_, cR_),
-                                OPR_(MUL, cL_, dR_));
+            result = FOLD_(ADD, productTerm(dL_, expr->right, true),
+                                productTerm(dR_, expr->left, false));
             break;
         case DIV:
         {
-            Node_t *nominator = OPR_(SUB,   OPR_(MUL, dL_, cR_),
-                                            OPR_(MUL, cL_, dR_));
-            Node_t *denominator = OPR_(POW, cR_, NUM_(2));
-            result = OPR_(DIV, nominator, denominator);
+            if (isNumberNode(dR_, 0)) {
+                // constant denominator: (f/c)' = f'/c
+                deleteTree(dR_);
+                result = FOLD_(DIV, dL_, cR_);
+                break;
+            }
+            Node_t *nominator = FOLD_(SUB,  productTerm(dL_, expr->right, true),
+                                            productTerm(dR_, expr->left, false));
+            Node_t *denominator = FOLD_(POW, cR_, NUM_(2));
+            result = FOLD_(DIV, nominator, denominator);
             break;
         }
         case POW:
         {
             //base ^ power
             logPrint(L_EXTRA, 0, "Derivative: pow operator\n");
-            bool noVarBase  = !hasVariable(expr->left, variable);
-            bool noVarPower = !hasVariable(expr->right, variable);
+            bool noVarBase  = !diffLeft;
+            bool noVarPower = !diffRight;
             logPrint(L_EXTRA, 0, "Derivative: noVarBase = %d, noVarPower = %d\n", noVarBase, noVarPower);
 
             if (noVarPower) {
@@ -69,104 +113,372 @@ static Node_t *derivativeOperator(TexContext_t *tex, TungstenContext_t *context,
                     result = NUM_(0);
                 else {
                     // d(f^n) = d(f)*n*f^(n-1)
-                    Node_t *tempTree = OPR_(POW, cL_, OPR_(SUB, cR_, NUM_(1) ) );
+                    Node_t *tempTree = FOLD_(POW, cL_, FOLD_(SUB, cR_, NUM_(1) ) );
 
-                    result = OPR_(MUL, OPR_(MUL, dL_, cR_), tempTree);
+                    result = FOLD_(MUL, FOLD_(MUL, dL_, cR_), tempTree);
                 }
             } else {
                 if (noVarBase) {
                     //d(a^f) = a^f * ln(a) * d(f)
-                    result = OPR_(MUL, OPR_(MUL, copyTree(expr), dR_),
-                                        OPR_(LOGN, cL_, NULL) );
+                    result = FOLD_(MUL, FOLD_(MUL, copyTree(expr), dR_),
+                                        FOLD_(LOGN, cL_, NULL) );
                 } else {
                     //d(g^f) = d( e^(f*ln(g)) ) = g^f * d( f*ln(g) ) = g^f * (df*ln(g) + f*dg/g)
-                    Node_t *tempTree = OPR_(ADD, OPR_(MUL, dR_,
-                                                           OPR_(LOGN, cL_, NULL) ),
-                                                 OPR_(DIV, OPR_(MUL, cR_, dL_),
-                                                           cL_)
+                    Node_t *tempTree = FOLD_(ADD, FOLD_(MUL, dR_,
+                                                             FOLD_(LOGN, cL_, NULL) ),
+                                                  FOLD_(DIV, FOLD_(MUL, cR_, dL_),
+                                                             cL_)
                                             );
-                    result = OPR_(MUL, copyTree(expr), tempTree);
+                    result = FOLD_(MUL, copyTree(expr), tempTree);
                 }
             }
             break;
         }
         case SIN:
-            result = OPR_(MUL, OPR_(COS, cL_, NULL), dL_);
+            result = FOLD_(MUL, FOLD_(COS, cL_, NULL), dL_);
             break;
         case COS:
-            result = OPR_(MUL, OPR_(SIN, cL_, NULL),
-                                OPR_(MUL, NUM_(-1), dL_));
+            result = FOLD_(MUL, FOLD_(SIN, cL_, NULL),
+                                FOLD_(MUL, NUM_(-1), dL_));
             break;
         case SINH:
-            result = OPR_(MUL, OPR_(COSH, cL_, NULL), dL_);
+            result = FOLD_(MUL, FOLD_(COSH, cL_, NULL), dL_);
             break;
         case COSH:
-            result = OPR_(MUL, OPR_(SINH, cL_, NULL), dL_);
+            result = FOLD_(MUL, FOLD_(SINH, cL_, NULL), dL_);
             break;
         case TAN:
-            result = OPR_(MUL, dL_,
-                               OPR_(POW, OPR_(COS, cL_, NULL), NUM_(-2) ) );
+            result = FOLD_(MUL, dL_,
+                                FOLD_(POW, FOLD_(COS, cL_, NULL), NUM_(-2) ) );
             break;
         case CTG:
-            result = OPR_(MUL, OPR_(MUL, NUM_(-1), dL_),
-                                OPR_(POW, OPR_(SIN, cL_, NULL), NUM_(-2) ) );
+            result = FOLD_(MUL, FOLD_(MUL, NUM_(-1), dL_),
+                                FOLD_(POW, FOLD_(SIN, cL_, NULL), NUM_(-2) ) );
             break;
         case LOG:
-            result = OPR_(DIV, dR_,
-                                OPR_(MUL, cR_, OPR_(LOGN, cL_, NULL) ) );
+            result = FOLD_(DIV, dR_,
+                                FOLD_(MUL, cR_, FOLD_(LOGN, cL_, NULL) ) );
             break;
         case LOGN:
-            result = OPR_(DIV, dL_, cL_);
+            result = FOLD_(DIV, dL_, cL_);
             break;
         default:
             logPrint(L_ZERO, 1, "Unknown operator type %d\n", expr->value.op);
+            deleteTree(dL_);
+            deleteTree(dR_);
             break;
     }
 
     return result;
 }
 
-/// @brief Create derivative of expr with respect to variable
-/// @param expr expression tree
-/// @param variable derivative variable
-/// @return Derivative tree
-Node_t *derivativeBase(TexContext_t *tex, TungstenContext_t *context, Node_t *expr, int variable) {
+/// @brief Product of copies of operands [begin, end) of n-ary product
+static Node_t *copyFactors(Node_t *expr, size_t begin, size_t end, Node_t **factors) {
+    if (end - begin == 1)
+        return copyTree(expr->operands[begin]);
+
+    size_t copied = 0;
+    for (; begin + copied < end; copied++) {
+        factors[copied] = copyTree(expr->operands[begin + copied]);
+        if (!factors[copied])
+            break;
+    }
+
+    Node_t *product = (begin + copied == end) ? createNaryNode(MUL, factors, copied) : NULL;
+    if (!product) {
+        for (size_t idx = 0; idx < copied; idx++)
+            deleteTree(factors[idx]);
+    }
+    return product;
+}
+
+/// @brief Derivative of product of operands [begin, end), halves are differentiated separately:
+/// (L * R)' = L' * R + L * R'. Every operand is copied O(log(count)) times, whatever the shape
+/// of binary products flattened into n-ary node was
+/// @return Derivative or NULL if it is zero or memory has run out
+static Node_t *derivativeProduct(Node_t *expr, Node_t **diffs, size_t begin, size_t end,
+                                 Node_t **factors, bool *memoryOk) {
+    if (end - begin == 1) {
+        Node_t *diff = diffs[begin];
+        diffs[begin] = NULL;
+        return diff;
+    }
+
+    size_t middle = begin + (end - begin) / 2;
+    Node_t *diffLeft  = derivativeProduct(expr, diffs, begin, middle, factors, memoryOk);
+    Node_t *diffRight = derivativeProduct(expr, diffs, middle, end, factors, memoryOk);
+
+    Node_t *result = NULL;
+    if (diffLeft && *memoryOk)
+        result = JOIN_(MUL, diffLeft, copyFactors(expr, middle, end, factors));
+    else
+        deleteTree(diffLeft);
+
+    if (diffRight && *memoryOk && (result || !diffLeft)) {
+        Node_t *term = JOIN_(MUL, copyFactors(expr, begin, middle, factors), diffRight);
+        result = (result) ? JOIN_(ADD, result, term) : term;
+    } else
+        deleteTree(diffRight);
+
+    if ((diffLeft || diffRight) && !result)
+        *memoryOk = false;
+    return result;
+}
+
+/// @brief Derivative of n-ary sum or product
+/// @param diffs Derivatives of operands, NULL for operands without variable. They are used in result
+static Node_t *derivativeNary(Node_t *expr, Node_t **diffs) {
+    size_t count = expr->operandsCount;
+
+    if (expr->value.op == ADD) {
+        Node_t **terms = (Node_t **) calloc(count, sizeof(Node_t *));
+        if (!terms) {
+            logPrint(L_ZERO, 1, "Not enough memory to differentiate n-ary node[%p]\n", expr);
+            return NULL;
+        }
+
+        size_t termsCount = 0;
+        for (size_t idx = 0; idx < count; idx++) {
+            if (diffs[idx])
+                terms[termsCount++] = diffs[idx];
+        }
+
+        Node_t *result = NULL;
+        if (termsCount == 0)
+            result = NUM_(0);
+        else if (termsCount == 1)
+            result = terms[0];
+        else
+            result = createNaryNode(ADD, terms, termsCount);
+
+        if (result) {
+            for (size_t idx = 0; idx < count; idx++)
+                diffs[idx] = NULL;
+        }
+        free(terms);
+        return result;
+    }
+
+    Node_t **factors = (Node_t **) calloc(count, sizeof(Node_t *));
+    bool memoryOk = factors;
+
+    Node_t *result = NULL;
+    if (memoryOk)
+        result = derivativeProduct(expr, diffs, 0, count, factors, &memoryOk);
+    if (memoryOk && !result)
+        result = NUM_(0);
+
+    if (!result)
+        logPrint(L_ZERO, 1, "Not enough memory to differentiate n-ary node[%p]\n", expr);
+
+    free(factors);
+    return result;
+}
+
+static void derivativeNarrateStart(TexContext_t *tex, TungstenContext_t *context, Node_t *expr) {
+    if (!texNarrating(tex)) return;
+
     const char *statements[] = {
         "Нужно найти производную выражения: ",
         "Вычислим производную от: ",
         "Для дальнейших вычислений продиффиренцируем: "
     };
     const size_t statementsCnt = sizeof(statements) / sizeof(statements[0]);
+    exprTexDefine(tex, context, expr);
     texPrintf(tex, statements[rand() % statementsCnt]);
     exprTexDump(tex, context, expr);
     texPrintf(tex, "\n\n");
+    exprTexFlush(tex, context);
+}
 
-    Node_t *result = NULL;
-    switch (expr->type) {
-        case VARIABLE:
-            if (expr->value.var == variable)
-                result = NUM_(1);
-            else
-                result = NUM_(0);
-
-            break;
-        case NUMBER:
-            result = NUM_(0);
-            break;
-        case OPERATOR:
-            result = derivativeOperator(tex, context, expr, variable);
-            break;
-        default:
-            logPrint(L_ZERO, 1, "Unknown expression type %d\n", expr->type);
-            break;
-    }
+static void derivativeNarrateResult(TexContext_t *tex, TungstenContext_t *context, Node_t *expr, Node_t *result) {
+    if (!texNarrating(tex) || !result) return;
 
+    exprTexDefine(tex, context, expr);
+    exprTexDefine(tex, context, result);
     texPrintf(tex, "$$(");
     exprTexDumpRecursive(tex, context, expr);
     texPrintf(tex, ")' = ");
     exprTexDumpRecursive(tex, context, result);
     texPrintf(tex, "$$\n\n");
+    exprTexFlush(tex, context);
+}
+
+/// @brief Whether derivative of subtree is looked up in memo cache, the whole expression always is
+static bool cachedSubtree(Node_t *expr, Node_t *subtree) {
+    return subtree == expr || (subtree->size >= EXPR_CACHE_MIN_SUBTREE_NODES &&
+                               subtree->size <= EXPR_CACHE_MAX_SUBTREE_NODES);
+}
+
+static bool isArithmetic(const Node_t *node) {
+    return node->type == OPERATOR && operators[node->value.op].binary && node->value.op != LOG;
+}
+
+/// @brief Whether subtree is the top of region of arithmetic operators, only such nodes are tried
+/// as polynomials, so failed attempts cost O(nodes) in total
+static bool polynomialCandidate(Node_t *expr, Node_t *subtree) {
+    return isArithmetic(subtree) && (subtree == expr || !subtree->parent || !isArithmetic(subtree->parent));
+}
+
+/// @brief Node being differentiated
+typedef struct {
+    Node_t *expr;
+    unsigned state;         ///< 0 - not visited, 1 - left operand is differentiated, 2 - right operand
+    bool needLeft;
+    bool needRight;
+    bool narrated;          ///< Step fits into narration budget
+    Node_t *diffLeft;
+    Node_t *diffRight;
+    Node_t **diffs;         ///< Derivatives of operands of n-ary node, state - 1 is the next operand
+} DiffFrame_t;
+
+TREE_STACK_DEFINE(DiffStack, DiffFrame_t)
+
+/// @brief Create derivative of expr with respect to variable
+/// @param expr expression tree
+/// @param variable derivative variable
+/// @return Derivative tree
+Node_t *derivativeBase(TexContext_t *tex, TungstenContext_t *context, Node_t *expr, int variable) {
+    assert(expr);
+
+    DiffFrame_t buffer[TREE_STACK_MIN_CAPACITY] = {};
+    DiffStack_t stack = DiffStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+
+    DiffFrame_t root = {expr};
+    bool memoryOk = DiffStackPush(&stack, root);
+    Node_t *result = NULL;
+    ExprCache_t *cache = exprCacheCurrent();
+
+    // explicit stack instead of recursion: derivatives of operands are stored in frame of operator
+    while (stack.size && memoryOk) {
+        DiffFrame_t *frame = DiffStackTop(&stack);
+        Node_t *current = frame->expr;
+        Node_t *currentResult = NULL;
+
+        if (frame->state == 0) {
+            frame->narrated = texStep(tex, stack.size - 1);
+            if (frame->narrated)
+                derivativeNarrateStart(tex, context, current);
+        }
+
+        switch (current->type) {
+            case VARIABLE:
+                if (current->value.var == variable)
+                    currentResult = NUM_(1);
+                else
+                    currentResult = NUM_(0);
+
+                break;
+            case NUMBER:
+                currentResult = NUM_(0);
+                break;
+            case OPERATOR:
+                if (frame->state == 0) {
+                    // constant subtree is not traversed at all
+                    if (!hasVariable(current, variable)) {
+                        currentResult = NUM_(0);
+                        break;
+                    }
+
+                    if (cachedSubtree(expr, current)) {
+                        currentResult = exprCacheFind(cache, CACHE_DERIVATIVE, variable, 0, current);
+                        if (currentResult)
+                            break;
+                    }
+
+                    // polynomial is differentiated on coefficients, if its expanded form isn't too big
+                    if (current->varMask == (1ull << variable) && polynomialCandidate(expr, current)) {
+                        currentResult = polynomialDerivativeTree(current, variable,
+                                                                 DERIVATIVE_POLYNOMIAL_MAX_GROWTH * current->size);
+                        if (currentResult)
+                            break;
+                    }
+
+                    if (current->operandsCount) {
+                        frame->diffs = (Node_t **) calloc(current->operandsCount, sizeof(Node_t *));
+                        memoryOk = frame->diffs;
+                        frame->state = 1;
+                        continue;
+                    }
+
+                    derivativeOperands(current, variable, &frame->needLeft, &frame->needRight);
+                    frame->state = 1;
+                    if (frame->needLeft) {
+                        DiffFrame_t left = {current->left};
+                        memoryOk = DiffStackPush(&stack, left);
+                        continue;
+                    }
+                }
+                if (current->operandsCount) {
+                    // operands without variable are skipped, their derivatives stay NULL
+                    while (frame->state <= current->operandsCount &&
+                           !hasVariable(current->operands[frame->state - 1], variable))
+                        frame->state++;
+
+                    if (frame->state <= current->operandsCount) {
+                        DiffFrame_t operand = {current->operands[frame->state++ - 1]};
+                        memoryOk = DiffStackPush(&stack, operand);
+                        continue;
+                    }
+
+                    currentResult = derivativeNary(current, frame->diffs);
+                    for (size_t operandIdx = 0; operandIdx < current->operandsCount; operandIdx++)
+                        deleteTree(frame->diffs[operandIdx]);
+                    free(frame->diffs);
+                    frame->diffs = NULL;
+                    if (currentResult && cachedSubtree(expr, current))
+                        exprCacheInsert(cache, CACHE_DERIVATIVE, variable, 0, current, currentResult);
+                    break;
+                }
+                if (frame->state == 1) {
+                    frame->state = 2;
+                    if (frame->needRight) {
+                        DiffFrame_t right = {current->right};
+                        memoryOk = DiffStackPush(&stack, right);
+                        continue;
+                    }
+                }
+
+                currentResult = derivativeOperator(context, current, frame->diffLeft, frame->diffRight);
+                if (currentResult && cachedSubtree(expr, current))
+                    exprCacheInsert(cache, CACHE_DERIVATIVE, variable, 0, current, currentResult);
+                break;
+            default:
+                logPrint(L_ZERO, 1, "Unknown expression type %d\n", current->type);
+                break;
+        }
+
+        if (frame->narrated)
+            derivativeNarrateResult(tex, context, current, currentResult);
+
+        DiffStackPop(&stack);
+        if (stack.size) {
+            DiffFrame_t *parent = DiffStackTop(&stack);
+            if (parent->diffs)
+                parent->diffs[parent->state - 2] = currentResult;
+            else if (parent->state == 1)
+                parent->diffLeft = currentResult;
+            else
+                parent->diffRight = currentResult;
+        } else {
+            result = currentResult;
+        }
+    }
+
+    if (!memoryOk) {
+        logPrint(L_ZERO, 1, "Not enough memory to differentiate expression[%p]\n", expr);
+        for (size_t idx = 0; idx < stack.size; idx++) {
+            DiffFrame_t *frame = stack.data + idx;
+            deleteTree(frame->diffLeft);
+            deleteTree(frame->diffRight);
+            for (size_t operandIdx = 0; frame->diffs && operandIdx < frame->expr->operandsCount; operandIdx++)
+                deleteTree(frame->diffs[operandIdx]);
+            free(frame->diffs);
+        }
+    }
 
+    DiffStackDtor(&stack);
+    texSummary(tex);
     return result;
 }
 
@@ -185,21 +497,19 @@ Node_t *derivative(TexContext_t *tex, TungstenContext_t *context, Node_t *expr,
     return derivativeBase(tex, context, expr, varIdx);
 }
 
-Node_t *TaylorExpansion(TexContext_t *tex, TungstenContext_t *context,
-                        Node_t *expr, const char *variable,
-                        double point, size_t nmemb) {
-
-    Node_t *current = copyTree(expr);
-    current = simplifyExpression(tex, context, current);
-    texPrintf(tex, "Оттейлорим функцию ");
-    exprTexDump(tex, context, current);
-    texPrintf(tex, "\n\n");
-
-    size_t varIdx = findVariable(context, variable);
-    setVariable(context, variable, point);
+/// @brief Taylor coefficients from derivatives built on hash-consed DAG, so shared subexpressions are never copied
+static TungstenStatus_t taylorSymbolic(TexContext_t *tex, TungstenContext_t *context, Node_t *expr, int varIdx,
+                                       double point, size_t nmemb, double *coefficients) {
+    ExprDag_t dag = {};
+    dagCtor(&dag);
+    Node_t *dagCurrent = dagInternTree(&dag, expr);
+    if (!dagCurrent) {
+        logPrint(L_ZERO, 1, "Not enough memory to intern tree[%p] for Taylor expansion\n", expr);
+        dagDtor(&dag);
+        return TA_MEMORY_ERROR;
+    }
 
-    double curVal = evaluate(context, current);
-    Node_t *taylor = NUM_(curVal);
+    coefficients[0] = dagEvaluate(&dag, context, dagCurrent);
 
     //TODO: 64 -> constant
     // char firstCol[64] = "", secondCol[64] = "";
@@ -212,63 +522,171 @@ Node_t *TaylorExpansion(TexContext_t *tex, TungstenContext_t *context,
     double factorial = 1;
 
     for (unsigned membPower = 1; membPower < nmemb; membPower++) {
-        tex->active = false;
-        Node_t *toDelete = current;
-
-        current = derivative(tex, context, current, variable);
-        deleteTree(toDelete);
-        tex->active = true;
-
-
-        curVal = evaluate(context, current);
+        dagCurrent = dagDerivative(&dag, dagCurrent, varIdx);
+        if (!dagCurrent) {
+            logPrint(L_ZERO, 1, "Not enough memory for derivative of order %u of tree[%p]\n", membPower, expr);
+            dagDtor(&dag);
+            return TA_MEMORY_ERROR;
+        }
+        double curVal = dagEvaluate(&dag, context, dagCurrent);
 
         // sprintf(firstCol, "$f^{(%d)}(%lg)$", membPower, point);
         // sprintf(secondCol, "$%lg$", curVal);
         // texAddTableLine(tex, membPower != (nmemb - 1), 2, firstCol, secondCol);
 
         factorial *= membPower;
-        double coefficient = curVal / factorial;
+        coefficients[membPower] = curVal / factorial;
+
+        if (!texStep(tex, 0))
+            continue;
+
+        // expanded size of DAG grows exponentially, without placeholders it is checked before printing
+        if (!tex->budget.maxNodes && dagCurrent->size > TAYLOR_REPORT_MAX_FORMULA_NODES) {
+            texPrintf(tex, "$ f^{(%d)}(x) $ содержит %zu узлов и не приводится\n\n", membPower, dagCurrent->size);
+        } else {
+            // DAG is already simplified and is printed as is: shared subtrees get one placeholder
+            exprTexDefine(tex, context, dagCurrent);
+            texPrintf(tex, "$ f^{(%d)}(x) = ", membPower);
+            exprTexDumpRecursive(tex, context, dagCurrent);
+            texPrintf(tex, " $\n\n");
+            exprTexFlush(tex, context);
+        }
 
+        texPrintf(tex, "\\[ f^{(%d)}(%lg) = %lg \\]\n\n", membPower, point, curVal);
+    }
+
+    logPrint(L_DEBUG, 0, "Taylor: DAG has %zu nodes\n", dag.size);
+    dagDtor(&dag);
+    // texEndTable(tex);
+
+    return TA_SUCCESS;
+}
+
+/// @brief Taylor coefficients by truncated power series arithmetic
+static TungstenStatus_t taylorFromSeries(TexContext_t *tex, TungstenContext_t *context, Node_t *expr, int varIdx,
+                                         double point, size_t nmemb, double *coefficients) {
+    TungstenStatus_t status = taylorSeries(context, expr, varIdx, point, nmemb - 1, coefficients);
+    if (status != TA_SUCCESS)
+        return status;
+
+    double factorial = 1;
+    for (unsigned membPower = 1; membPower < nmemb && texNarrating(tex); membPower++) {
+        factorial *= membPower;
+        if (texStep(tex, 0))
+            texPrintf(tex, "\\[ f^{(%d)}(%lg) = %lg \\]\n\n", membPower, point, coefficients[membPower] * factorial);
+    }
+
+    return TA_SUCCESS;
+}
+
+/// @brief Taylor polynomial as simplified sum of c_k * (x - point)^k
+static Node_t *taylorSumTree(TungstenContext_t *context, const double *coefficients, size_t nmemb,
+                             int varIdx, double point) {
+    Node_t *taylor = NUM_(coefficients[0]);
+    for (unsigned membPower = 1; membPower < nmemb; membPower++) {
         taylor = OPR_(ADD,
                         taylor,
                         OPR_(MUL,
-                                NUM_(coefficient),
+                                NUM_(coefficients[membPower]),
                                 OPR_(POW,
                                         OPR_(SUB, VAR_(varIdx), NUM_(point)),
                                         NUM_(membPower)
                                     )
                             )
                      );
+    }
 
-        tex->active = false;
-        current = simplifyExpression(tex, context, current);
-        tex->active = true;
-        DUMP_TREE(context, current, 0);
-        texPrintf(tex, "$ f^{(%d)}(x) = ", membPower);
-        exprTexDumpRecursive(tex, context, current);
-        texPrintf(tex, " $\n\n");
+    DUMP_TREE(context, taylor, false);
+    taylor = simplifyExpression(NULL, context, taylor);
+    DUMP_TREE(context, taylor, false);
+    return taylor;
+}
 
-        texPrintf(tex, "\\[ f^{(%d)}(%lg) = %lg \\]\n\n", membPower, point, curVal);
+/// @brief Taylor polynomial in Horner form c0 + t*(c1 + t*(c2 + ...)), t = x - point or x if point is 0.
+/// Coefficients that sum form simplifies to zero are skipped the same way
+static Node_t *taylorHornerTree(TungstenContext_t *context, const double *coefficients, size_t nmemb,
+                                int varIdx, double point) {
+    while (nmemb > 1 && isZero(coefficients[nmemb - 1]))
+        nmemb--;
+
+    Node_t *taylor = NUM_(coefficients[nmemb - 1]);
+    for (size_t membPower = nmemb - 1; membPower > 0 && taylor; membPower--) {
+        Node_t *shift = (fabs(point) < DOUBLE_EPSILON) ? VAR_(varIdx) : OPR_(SUB, VAR_(varIdx), NUM_(point));
+        taylor = JOIN_(MUL, shift, taylor);
+
+        double coefficient = coefficients[membPower - 1];
+        if (!isZero(coefficient))
+            taylor = JOIN_(ADD, NUM_(coefficient), taylor);
     }
 
-    // texEndTable(tex);
-    deleteTree(current);
+    if (!taylor)
+        logPrint(L_ZERO, 1, "Not enough memory to build Taylor polynomial\n");
+    DUMP_TREE(context, taylor, false);
+    return taylor;
+}
 
+Node_t *TaylorExpansion(TexContext_t *tex, TungstenContext_t *context,
+                        Node_t *expr, const char *variable,
+                        double point, size_t nmemb, const TaylorOptions_t *options) {
+    TaylorOptions_t defaultOptions = {};
+    if (!options)
+        options = &defaultOptions;
 
+    if (nmemb == 0)
+        nmemb = 1;
 
-    tex->active = false;
-    DUMP_TREE(context, taylor, false);
-    taylor = simplifyExpression(tex, context, taylor);
-    DUMP_TREE(context, taylor, false);
+    Node_t *current = copyTree(expr);
+    current = simplifyExpression(tex, context, current);
+    exprTexDefine(tex, context, current);
+    texPrintf(tex, "Оттейлорим функцию ");
+    exprTexDump(tex, context, current);
+    texPrintf(tex, "\n\n");
+    exprTexFlush(tex, context);
 
-    tex->active = true;
+    int varIdx = findVariable(context, variable);
+    if (varIdx == NULL_VARIABLE)
+        varIdx = (int) insertVariable(context, variable);
+    setVariable(context, variable, point);
 
+    double *coefficients = (double *) calloc(nmemb, sizeof(double));
+    if (!coefficients) {
+        deleteTree(current);
+        return NULL;
+    }
 
-    texPrintf(tex, " Имеем $");
-    exprTexDumpRecursive(tex, context, expr);
-    texPrintf(tex, " = ");
-    exprTexDumpRecursive(tex, context, taylor);
-    texPrintf(tex, " + o(x^{%d}) $\n\n", nmemb - 1);
+    TungstenStatus_t status = TA_SUCCESS;
+    if (options->backend == TAYLOR_SERIES)
+        status = taylorFromSeries(tex, context, current, varIdx, point, nmemb, coefficients);
+    else
+        status = taylorSymbolic(tex, context, current, varIdx, point, nmemb, coefficients);
+
+    deleteTree(current);
+    texSummary(tex);
+    if (status != TA_SUCCESS) {
+        free(coefficients);
+        return NULL;
+    }
+
+    Node_t *taylor = (options->form == TAYLOR_HORNER) ? taylorHornerTree(context, coefficients, nmemb, varIdx, point)
+                                                      : taylorSumTree(context, coefficients, nmemb, varIdx, point);
+    // report shows the usual sum of powers whatever form is returned
+    Node_t *report = taylor;
+    if (options->form == TAYLOR_HORNER && texNarrating(tex))
+        report = taylorSumTree(context, coefficients, nmemb, varIdx, point);
+    free(coefficients);
+
+    if (report) {
+        exprTexDefine(tex, context, expr);
+        exprTexDefine(tex, context, report);
+        texPrintf(tex, " Имеем $");
+        exprTexDumpRecursive(tex, context, expr);
+        texPrintf(tex, " = ");
+        exprTexDumpRecursive(tex, context, report);
+        texPrintf(tex, " + o(x^{%d}) $\n\n", nmemb - 1);
+        exprTexFlush(tex, context);
+    }
+    if (report != taylor)
+        deleteTree(report);
 
     return taylor;
 }
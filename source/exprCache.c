@@ -0,0 +1,278 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "nodeArena.h"
+#include "exprCache.h"
+
+static void releaseCache(ExprCache_t *cache);
+
+/// @brief Default cache of thread, its entries and arena are returned to system when thread exits
+typedef struct DefaultCache_t {
+    ExprCache_t cache;
+
+    // log can be closed at thread exit, so cache is released without report
+    ~DefaultCache_t() { releaseCache(&cache); }
+} DefaultCache_t;
+
+static thread_local DefaultCache_t defaultCache = {{NULL, 0, 0, NULL, NULL, 0, EXPR_CACHE_DEFAULT_NODES}};
+static thread_local ExprCache_t *currentCache = NULL;
+
+ExprCache_t exprCacheCtor(size_t maxNodes) {
+    ExprCache_t cache = {};
+    cache.maxNodes = maxNodes;
+    return cache;
+}
+
+/// @brief Free all entries, nodes of entries must be released with arena
+static void releaseEntries(ExprCache_t *cache) {
+    CacheEntry_t *entry = cache->newest;
+    while (entry) {
+        CacheEntry_t *older = entry->older;
+        free(entry);
+        entry = older;
+    }
+
+    free(cache->buckets);
+    free(cache->seen);
+    cache->seen = NULL;
+    cache->buckets = NULL;
+    cache->bucketsCount = 0;
+    cache->entriesCount = 0;
+    cache->newest = cache->oldest = NULL;
+    cache->nodesCount = 0;
+}
+
+/// @brief Return all memory of cache to system, stats are kept
+static void releaseCache(ExprCache_t *cache) {
+    if (currentCache == cache)
+        currentCache = NULL;
+
+    releaseEntries(cache);
+    nodeArenaRelease(&cache->arena);
+
+    ExprCacheStats_t stats = cache->stats;
+    *cache = {};
+    cache->stats = stats;
+}
+
+TungstenStatus_t exprCacheDtor(ExprCache_t *cache) {
+    if (!cache) return TA_NULL_PTR;
+
+    logPrint(L_DEBUG, 0, "ExprCache[%p]: %zu hits, %zu misses, %zu insertions, %zu evictions\n",
+             cache, cache->stats.hits, cache->stats.misses, cache->stats.insertions, cache->stats.evictions);
+
+    releaseCache(cache);
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t exprCacheClear(ExprCache_t *cache) {
+    if (!cache) return TA_NULL_PTR;
+
+    releaseEntries(cache);
+    nodeArenaReset(&cache->arena);
+    return TA_SUCCESS;
+}
+
+ExprCache_t *exprCacheSelect(ExprCache_t *cache) {
+    ExprCache_t *previous = exprCacheCurrent();
+    currentCache = cache;
+    return previous;
+}
+
+ExprCache_t *exprCacheCurrent() {
+    return (currentCache) ? currentCache : &defaultCache.cache;
+}
+
+static uint64_t entryHash(enum CacheOperation operation, int variable, uint64_t rules, const Node_t *key) {
+    return hashMix(hashMix(hashMix(key->hash, (uint64_t) operation), (uint64_t) variable), rules);
+}
+
+static bool cacheable(ExprCache_t *cache, const Node_t *key) {
+    return cache->maxNodes && key->size <= cache->maxNodes / EXPR_CACHE_KEY_FRACTION;
+}
+
+static void unlinkLru(ExprCache_t *cache, CacheEntry_t *entry) {
+    if (entry->newer) entry->newer->older = entry->older;
+    else              cache->newest       = entry->older;
+
+    if (entry->older) entry->older->newer = entry->newer;
+    else              cache->oldest       = entry->newer;
+
+    entry->newer = entry->older = NULL;
+}
+
+static void pushNewest(ExprCache_t *cache, CacheEntry_t *entry) {
+    entry->older = cache->newest;
+    entry->newer = NULL;
+    if (cache->newest)
+        cache->newest->newer = entry;
+    else
+        cache->oldest = entry;
+    cache->newest = entry;
+}
+
+static CacheEntry_t *findEntry(ExprCache_t *cache, uint64_t hash, enum CacheOperation operation, int variable,
+                               uint64_t rules, const Node_t *key) {
+    if (!cache->buckets)
+        return NULL;
+
+    for (CacheEntry_t *entry = cache->buckets[hash % cache->bucketsCount]; entry; entry = entry->next) {
+        if (entry->hash != hash || entry->operation != operation || entry->variable != variable || entry->rules != rules ||
+            entry->key->size != key->size)
+            continue;
+
+        if (equalTrees(entry->key, key))
+            return entry;
+        cache->stats.collisions++;
+    }
+
+    return NULL;
+}
+
+Node_t *exprCacheFind(ExprCache_t *cache, enum CacheOperation operation, int variable, uint64_t rules,
+                      const Node_t *key) {
+    assert(cache);
+    assert(key);
+
+    if (!cacheable(cache, key))
+        return NULL;
+
+    CacheEntry_t *entry = findEntry(cache, entryHash(operation, variable, rules, key), operation, variable, rules, key);
+    if (!entry) {
+        cache->stats.misses++;
+        return NULL;
+    }
+
+    cache->stats.hits++;
+    unlinkLru(cache, entry);
+    pushNewest(cache, entry);
+
+    return copyTree(entry->value);
+}
+
+static void removeEntry(ExprCache_t *cache, CacheEntry_t *entry) {
+    CacheEntry_t **slot = cache->buckets + entry->hash % cache->bucketsCount;
+    while (*slot != entry)
+        slot = &(*slot)->next;
+    *slot = entry->next;
+
+    unlinkLru(cache, entry);
+
+    cache->nodesCount -= entry->nodes;
+    cache->entriesCount--;
+
+    deleteTree(entry->key);
+    deleteTree(entry->value);
+    free(entry);
+}
+
+static TungstenStatus_t cacheRehash(ExprCache_t *cache) {
+    size_t newCount = (cache->bucketsCount) ? cache->bucketsCount * 2 : EXPR_CACHE_START_BUCKETS_COUNT;
+    CacheEntry_t **newBuckets = (CacheEntry_t **) calloc(newCount, sizeof(CacheEntry_t *));
+    if (!newBuckets)
+        return TA_MEMORY_ERROR;
+
+    for (size_t bucketIdx = 0; bucketIdx < cache->bucketsCount; bucketIdx++) {
+        CacheEntry_t *entry = cache->buckets[bucketIdx];
+        while (entry) {
+            CacheEntry_t *next = entry->next;
+            size_t newIdx = entry->hash % newCount;
+            entry->next = newBuckets[newIdx];
+            newBuckets[newIdx] = entry;
+            entry = next;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = newBuckets;
+    cache->bucketsCount = newCount;
+    return TA_SUCCESS;
+}
+
+bool exprCacheAdmit(ExprCache_t *cache, enum CacheOperation operation, int variable, uint64_t rules,
+                    const Node_t *key) {
+    assert(cache);
+    assert(key);
+
+    if (!cacheable(cache, key))
+        return false;
+
+    if (!cache->seen) {
+        cache->seen = (uint64_t *) calloc(EXPR_CACHE_SEEN_COUNT, sizeof(uint64_t));
+        if (!cache->seen)
+            return false;
+    }
+
+    uint64_t hash = entryHash(operation, variable, rules, key);
+    uint64_t *seen = cache->seen + hash % EXPR_CACHE_SEEN_COUNT;
+    if (*seen != hash) {
+        *seen = hash;
+        cache->stats.rejections++;
+        return false;
+    }
+
+    return true;
+}
+
+TungstenStatus_t exprCacheInsert(ExprCache_t *cache, enum CacheOperation operation, int variable, uint64_t rules,
+                                 const Node_t *key, const Node_t *value) {
+    assert(cache);
+    assert(key);
+    assert(value);
+
+    if (!cacheable(cache, key) || key->size + value->size > cache->maxNodes)
+        return TA_SUCCESS;
+
+    uint64_t hash = entryHash(operation, variable, rules, key);
+    if (!exprCacheAdmit(cache, operation, variable, rules, key) || findEntry(cache, hash, operation, variable, rules, key))
+        return TA_SUCCESS;
+
+    if (cache->entriesCount >= cache->bucketsCount && cacheRehash(cache) != TA_SUCCESS)
+        return TA_MEMORY_ERROR;
+
+    CacheEntry_t *entry = (CacheEntry_t *) calloc(1, sizeof(CacheEntry_t));
+    if (!entry)
+        return TA_MEMORY_ERROR;
+
+    NodeArena_t *previous = nodeArenaSelect(&cache->arena);
+    entry->key   = copyTree(key);
+    entry->value = copyTree(value);
+    nodeArenaSelect(previous);
+
+    if (!entry->key || !entry->value) {
+        deleteTree(entry->key);
+        deleteTree(entry->value);
+        free(entry);
+        return TA_MEMORY_ERROR;
+    }
+
+    entry->hash = hash;
+    entry->operation = operation;
+    entry->variable = variable;
+    entry->rules = rules;
+    entry->nodes = key->size + value->size;
+
+    size_t bucketIdx = hash % cache->bucketsCount;
+    entry->next = cache->buckets[bucketIdx];
+    cache->buckets[bucketIdx] = entry;
+    pushNewest(cache, entry);
+
+    cache->entriesCount++;
+    cache->nodesCount += entry->nodes;
+    cache->stats.insertions++;
+
+    while (cache->nodesCount > cache->maxNodes) {
+        removeEntry(cache, cache->oldest);
+        cache->stats.evictions++;
+    }
+
+    return TA_SUCCESS;
+}
@@ -0,0 +1,346 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "exprCompiler.h"
+#include "treeStack.h"
+
+const size_t COMPILED_START_CAPACITY = 16;
+
+static TungstenStatus_t pushInstruction(CompiledExpr_t *compiled, Instruction_t instr) {
+    if (compiled->size == compiled->capacity) {
+        size_t newCapacity = (compiled->capacity) ? compiled->capacity * 2 : COMPILED_START_CAPACITY;
+        Instruction_t *newCode = (Instruction_t *) realloc(compiled->code, newCapacity * sizeof(Instruction_t));
+        if (!newCode)
+            return TA_MEMORY_ERROR;
+
+        compiled->code = newCode;
+        compiled->capacity = newCapacity;
+    }
+
+    compiled->code[compiled->size++] = instr;
+    return TA_SUCCESS;
+}
+
+typedef struct {
+    const Node_t *node;
+    bool operandsDone;
+    size_t compiledOperands;    ///< Operands of n-ary node emitted so far
+} CompileFrame_t;
+
+TREE_STACK_DEFINE(CompileStack, CompileFrame_t)
+
+/// @brief Emit postfix code for tree, post-order traversal with explicit stack
+static TungstenStatus_t compileTree(CompiledExpr_t *compiled, const Node_t *tree) {
+    assert(tree);
+
+    CompileFrame_t buffer[TREE_STACK_MIN_CAPACITY] = {};
+    CompileStack_t stack = CompileStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+
+    CompileFrame_t root = {tree, false};
+    TungstenStatus_t status = CompileStackPush(&stack, root) ? TA_SUCCESS : TA_MEMORY_ERROR;
+
+    // current depth of value stack
+    size_t depth = 0;
+    while (stack.size && status == TA_SUCCESS) {
+        CompileFrame_t *frame = CompileStackTop(&stack);
+        const Node_t *node = frame->node;
+        Instruction_t instr = {};
+
+        switch(node->type) {
+            case NUMBER:
+                instr.code = INSTR_NUMBER;
+                instr.arg.number = node->value.number;
+                depth++;
+                break;
+            case VARIABLE:
+                instr.code = INSTR_VARIABLE;
+                instr.arg.var = node->value.var;
+                depth++;
+                break;
+            case OPERATOR:
+                if (node->operandsCount) {
+                    // a + b + c is compiled as a b + c +, so value stack is as deep as for binary chain;
+                    // frame is visited once before operands and once after every operand
+                    if (frame->compiledOperands >= 2) {
+                        depth--;
+                        instr.code = (enum InstrCode) node->value.op;
+                        status = pushInstruction(compiled, instr);
+                    }
+
+                    if (frame->compiledOperands < node->operandsCount) {
+                        CompileFrame_t operand = {node->operands[frame->compiledOperands++], false};
+                        if (status == TA_SUCCESS && !CompileStackPush(&stack, operand))
+                            status = TA_MEMORY_ERROR;
+                    } else
+                        CompileStackPop(&stack);
+                    continue;
+                }
+
+                if (!frame->operandsDone) {
+                    frame->operandsDone = true;
+
+                    CompileFrame_t left = {node->left, false}, right = {node->right, false};
+                    bool pushed = true;
+                    if (operators[node->value.op].binary)
+                        pushed = CompileStackPush(&stack, right);
+                    pushed = pushed && CompileStackPush(&stack, left);
+
+                    if (!pushed)
+                        status = TA_MEMORY_ERROR;
+                    continue;
+                }
+
+                if (operators[node->value.op].binary)
+                    depth--;
+
+                instr.code = (enum InstrCode) node->value.op;
+                break;
+            default:
+                assert(0);
+                break;
+        }
+
+        CompileStackPop(&stack);
+
+        if (depth > compiled->stackSize)
+            compiled->stackSize = depth;
+
+        status = pushInstruction(compiled, instr);
+    }
+
+    CompileStackDtor(&stack);
+    return status;
+}
+
+TungstenStatus_t compileExpression(const Node_t *expr, CompiledExpr_t *compiled) {
+    assert(expr);
+    assert(compiled);
+
+    *compiled = {};
+
+    TungstenStatus_t status = compileTree(compiled, expr);
+    if (status == TA_SUCCESS) {
+        compiled->stack = (double *) calloc(compiled->stackSize, sizeof(double));
+        if (!compiled->stack)
+            status = TA_MEMORY_ERROR;
+    }
+
+    if (status != TA_SUCCESS) {
+        logPrint(L_ZERO, 1, "Failed to compile expression[%p]\n", expr);
+        deleteCompiled(compiled);
+        return status;
+    }
+
+    logPrint(L_DEBUG, 0, "Compiled expression[%p]: %zu instructions, stack size = %zu\n",
+                         expr, compiled->size, compiled->stackSize);
+    return TA_SUCCESS;
+}
+
+/// @brief Run program with values of variables from values or from context if values is NULL
+static double runProgram(const TungstenContext_t *context, const double *values,
+                         const CompiledExpr_t *compiled, double *stack) {
+    //top points to last pushed value
+    double *top = stack - 1;
+    const Instruction_t *instr = compiled->code,
+                        *end   = compiled->code + compiled->size;
+
+    //each case must compute exactly the same as calculateOperation()
+    for (; instr < end; instr++) {
+        switch(instr->code) {
+            case INSTR_NUMBER:
+                *++top = instr->arg.number;
+                break;
+            case INSTR_VARIABLE:
+                *++top = (values) ? values[instr->arg.var] : context->variables[instr->arg.var].number;
+                break;
+            case INSTR_ADD:
+                top--; *top = top[0] + top[1];
+                break;
+            case INSTR_SUB:
+                top--; *top = top[0] - top[1];
+                break;
+            case INSTR_MUL:
+                top--; *top = top[0] * top[1];
+                break;
+            case INSTR_DIV:
+                top--; *top = top[0] / top[1];
+                break;
+            case INSTR_POW:
+                top--; *top = pow(top[0], top[1]);
+                break;
+            case INSTR_LOG:
+                top--; *top = log(top[1]) / log(top[0]);
+                break;
+            case INSTR_SIN:
+                *top = sin(*top);
+                break;
+            case INSTR_COS:
+                *top = cos(*top);
+                break;
+            case INSTR_SINH:
+                *top = sinh(*top);
+                break;
+            case INSTR_COSH:
+                *top = cosh(*top);
+                break;
+            case INSTR_TAN:
+                *top = tan(*top);
+                break;
+            case INSTR_CTG:
+                *top = 1/tan(*top);
+                break;
+            case INSTR_LOGN:
+                *top = log(*top);
+                break;
+            default:
+                LOG_PRINT(L_ZERO, 1, "Instruction %d is not implemented\n", instr->code);
+                return 0;
+        }
+    }
+
+    return *top;
+}
+
+double evaluateCompiled(TungstenContext_t *context, const CompiledExpr_t *compiled) {
+    assert(context);
+    assert(compiled);
+
+    return runProgram(context, NULL, compiled, compiled->stack);
+}
+
+double evaluateCompiledWith(const CompiledExpr_t *compiled, const double *values, double *stack) {
+    assert(compiled);
+    assert(values);
+    assert(stack);
+
+    return runProgram(NULL, values, compiled, stack);
+}
+
+TungstenStatus_t deleteCompiled(CompiledExpr_t *compiled) {
+    if (!compiled) return TA_NULL_PTR;
+
+    free(compiled->code);
+    free(compiled->stack);
+    *compiled = {};
+
+    return TA_SUCCESS;
+}
+
+/*=====================Batch evaluation=============================*/
+
+#define BATCH_UNARY_(expr)                                  \
+    for (size_t idx = 0; idx < count; idx++) {              \
+        double arg = top[idx];                              \
+        top[idx] = (expr);                                  \
+    }
+
+#define BATCH_BINARY_(expr)                                 \
+    top -= BATCH_BLOCK_SIZE;                                \
+    for (size_t idx = 0; idx < count; idx++) {              \
+        double left = top[idx], right = top[idx + BATCH_BLOCK_SIZE]; \
+        top[idx] = (expr);                                  \
+    }
+
+/// @brief Evaluate program for one block of count <= BATCH_BLOCK_SIZE points
+/// @param varInputs Array of pointers to values of each variable or NULL if variable is constant in batch
+static void evaluateBlock(TungstenContext_t *context, const CompiledExpr_t *compiled,
+                          const double **varInputs, size_t offset,
+                          double *stack, double *result, size_t count) {
+    //top points to the first value of the block on top of stack
+    double *top = stack - BATCH_BLOCK_SIZE;
+    const Instruction_t *instr = compiled->code,
+                        *end   = compiled->code + compiled->size;
+
+    //each case must compute exactly the same as calculateOperation()
+    for (; instr < end; instr++) {
+        switch(instr->code) {
+            case INSTR_NUMBER:
+            {
+                top += BATCH_BLOCK_SIZE;
+                double number = instr->arg.number;
+                for (size_t idx = 0; idx < count; idx++)
+                    top[idx] = number;
+                break;
+            }
+            case INSTR_VARIABLE:
+            {
+                top += BATCH_BLOCK_SIZE;
+                const double *values = varInputs[instr->arg.var];
+                if (values) {
+                    memcpy(top, values + offset, count * sizeof(double));
+                } else {
+                    double value = context->variables[instr->arg.var].number;
+                    for (size_t idx = 0; idx < count; idx++)
+                        top[idx] = value;
+                }
+                break;
+            }
+            case INSTR_ADD:  BATCH_BINARY_(left + right);                break;
+            case INSTR_SUB:  BATCH_BINARY_(left - right);                break;
+            case INSTR_MUL:  BATCH_BINARY_(left * right);                break;
+            case INSTR_DIV:  BATCH_BINARY_(left / right);                break;
+            case INSTR_POW:  BATCH_BINARY_(pow(left, right));            break;
+            case INSTR_LOG:  BATCH_BINARY_(log(right) / log(left));      break;
+            case INSTR_SIN:  BATCH_UNARY_(sin(arg));                     break;
+            case INSTR_COS:  BATCH_UNARY_(cos(arg));                     break;
+            case INSTR_SINH: BATCH_UNARY_(sinh(arg));                    break;
+            case INSTR_COSH: BATCH_UNARY_(cosh(arg));                    break;
+            case INSTR_TAN:  BATCH_UNARY_(tan(arg));                     break;
+            case INSTR_CTG:  BATCH_UNARY_(1/tan(arg));                   break;
+            case INSTR_LOGN: BATCH_UNARY_(log(arg));                     break;
+            default:
+                LOG_PRINT(L_ZERO, 1, "Instruction %d is not implemented\n", instr->code);
+                memset(top, 0, count * sizeof(double));
+                break;
+        }
+    }
+
+    memcpy(result, top, count * sizeof(double));
+}
+
+#undef BATCH_UNARY_
+#undef BATCH_BINARY_
+
+TungstenStatus_t evaluateBatch(TungstenContext_t *context, const CompiledExpr_t *compiled,
+                               const BatchVariable_t *inputs, size_t inputsCount,
+                               double *result, size_t pointsCount) {
+    assert(context);
+    assert(compiled);
+    assert(result);
+    assert(inputs || inputsCount == 0);
+
+    //resolving variables once for whole batch
+    const double *varInputs[VARIABLE_TABLE_SIZE] = {};
+    for (size_t inputIdx = 0; inputIdx < inputsCount; inputIdx++) {
+        int var = inputs[inputIdx].var;
+        if (var < 0 || (size_t) var >= context->variablesCount) {
+            logPrint(L_ZERO, 1, "Batch evaluation: unknown variable %d\n", var);
+            return TA_NULL_PTR;
+        }
+        varInputs[var] = inputs[inputIdx].values;
+    }
+
+    double *stack = (double *) calloc(compiled->stackSize * BATCH_BLOCK_SIZE, sizeof(double));
+    if (!stack)
+        return TA_MEMORY_ERROR;
+
+    for (size_t offset = 0; offset < pointsCount; offset += BATCH_BLOCK_SIZE) {
+        size_t count = pointsCount - offset;
+        if (count > BATCH_BLOCK_SIZE)
+            count = BATCH_BLOCK_SIZE;
+
+        evaluateBlock(context, compiled, varInputs, offset, stack, result + offset, count);
+    }
+
+    free(stack);
+    return TA_SUCCESS;
+}
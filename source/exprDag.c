@@ -0,0 +1,677 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "exprDag.h"
+#include "treeStack.h"
+
+TungstenStatus_t dagCtor(ExprDag_t *dag) {
+    if (!dag) return TA_NULL_PTR;
+
+    *dag = {};
+    dag->buckets = (DagNode_t **) calloc(DAG_START_BUCKETS_COUNT, sizeof(DagNode_t *));
+    if (!dag->buckets) {
+        logPrint(L_ZERO, 1, "DAG[%p]: failed to allocate hash table\n", dag);
+        return TA_MEMORY_ERROR;
+    }
+
+    dag->bucketsCount = DAG_START_BUCKETS_COUNT;
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t dagDtor(ExprDag_t *dag) {
+    if (!dag) return TA_NULL_PTR;
+
+    logPrint(L_DEBUG, 0, "DAG[%p]: deleting %zu nodes\n", dag, dag->size);
+
+    for (size_t chunkIdx = 0; chunkIdx < dag->chunksCount; chunkIdx++)
+        free(dag->chunks[chunkIdx]);
+    free(dag->chunks);
+    free(dag->buckets);
+
+    for (size_t var = 0; var < VARIABLE_TABLE_SIZE; var++)
+        free(dag->derivatives[var]);
+
+    free(dag->values);
+    free(dag->valueStamps);
+
+    *dag = {};
+    return TA_SUCCESS;
+}
+
+static inline const DagNode_t *dagCast(const Node_t *node) {
+    return (const DagNode_t *) node;
+}
+
+TREE_STACK_DEFINE(DagStack, Node_t *)
+
+static uint64_t nodeHash(enum ElemType type, union NodeValue value, const Node_t *left, const Node_t *right) {
+    uint64_t hash = hashMix((uint64_t) type, nodeValueBits(type, value));
+    hash = hashMix(hash, (left)  ? dagCast(left)->id  + 1 : 0);
+    hash = hashMix(hash, (right) ? dagCast(right)->id + 1 : 0);
+    return hash;
+}
+
+/// @brief Bucket of hash: low bits of hashMix() of sequential ids are poorly mixed, so they are finalized first
+static size_t dagBucket(uint64_t hash, size_t bucketsCount) {
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash % bucketsCount;
+}
+
+static TungstenStatus_t dagRehash(ExprDag_t *dag) {
+    size_t newCount = dag->bucketsCount * 2;
+    DagNode_t **newBuckets = (DagNode_t **) calloc(newCount, sizeof(DagNode_t *));
+    if (!newBuckets)
+        return TA_MEMORY_ERROR;
+
+    for (size_t bucketIdx = 0; bucketIdx < dag->bucketsCount; bucketIdx++) {
+        DagNode_t *node = dag->buckets[bucketIdx];
+        while (node) {
+            DagNode_t *next = node->next;
+            size_t newIdx = dagBucket(node->hash, newCount);
+            node->next = newBuckets[newIdx];
+            newBuckets[newIdx] = node;
+            node = next;
+        }
+    }
+
+    free(dag->buckets);
+    dag->buckets = newBuckets;
+    dag->bucketsCount = newCount;
+    return TA_SUCCESS;
+}
+
+static DagNode_t *dagAllocNode(ExprDag_t *dag) {
+    size_t chunkIdx = dag->size / DAG_CHUNK_SIZE;
+    if (chunkIdx == dag->chunksCount) {
+        DagNode_t **newChunks = (DagNode_t **) realloc(dag->chunks, (dag->chunksCount + 1) * sizeof(DagNode_t *));
+        if (!newChunks)
+            return NULL;
+        dag->chunks = newChunks;
+
+        dag->chunks[chunkIdx] = (DagNode_t *) calloc(DAG_CHUNK_SIZE, sizeof(DagNode_t));
+        if (!dag->chunks[chunkIdx])
+            return NULL;
+        dag->chunksCount++;
+    }
+
+    DagNode_t *node = dag->chunks[chunkIdx] + dag->size % DAG_CHUNK_SIZE;
+    node->id = dag->size++;
+    return node;
+}
+
+/// @brief Find or create node without any simplifications
+static Node_t *dagInternNode(ExprDag_t *dag, enum ElemType type, union NodeValue value, Node_t *left, Node_t *right) {
+    // store that failed to construct has no hash table
+    if (!dag->buckets)
+        return NULL;
+
+    uint64_t hash = nodeHash(type, value, left, right);
+    uint64_t bits = nodeValueBits(type, value);
+
+    for (DagNode_t *node = dag->buckets[dagBucket(hash, dag->bucketsCount)]; node; node = node->next) {
+        if (node->hash == hash && node->node.type == type &&
+            node->node.left == left && node->node.right == right &&
+            nodeValueBits(type, node->node.value) == bits)
+            return &node->node;
+    }
+
+    if (dag->size >= dag->bucketsCount && dagRehash(dag) != TA_SUCCESS)
+        return NULL;
+
+    DagNode_t *node = dagAllocNode(dag);
+    if (!node) {
+        logPrint(L_ZERO, 1, "DAG[%p]: failed to allocate node\n", dag);
+        return NULL;
+    }
+
+    node->node.type = type;
+    node->node.value = value;
+    node->node.left = left;
+    node->node.right = right;
+    node->hash = hash;
+    updateNodeInfo(&node->node);
+    // expanded size grows exponentially with order of derivative, so it saturates instead of wrapping
+    size_t leftSize  = (left)  ? left->size  : 0,
+           rightSize = (right) ? right->size : 0;
+    if (leftSize >= DAG_MAX_EXPANDED_SIZE || rightSize >= DAG_MAX_EXPANDED_SIZE - leftSize)
+        node->node.size = DAG_MAX_EXPANDED_SIZE;
+
+    size_t bucketIdx = dagBucket(hash, dag->bucketsCount);
+    node->next = dag->buckets[bucketIdx];
+    dag->buckets[bucketIdx] = node;
+
+    return &node->node;
+}
+
+/// @brief Exact comparison, the same as isNumberNode() of treeDSL.h
+static bool isEqualDouble(double a, double b) {
+    return fpclassify(b - a) == FP_ZERO;
+}
+
+static bool isNumber(const Node_t *node, double number) {
+    return node && node->type == NUMBER && isEqualDouble(node->value.number, number);
+}
+
+static Node_t *dagNumber(ExprDag_t *dag, double number) {
+    union NodeValue value = {};
+    value.number = number;
+    return dagInternNode(dag, NUMBER, value, NULL, NULL);
+}
+
+/// @brief Operator node with constant folding and removal of neutral operations
+static Node_t *dagOperator(ExprDag_t *dag, enum OperatorType op, Node_t *left, Node_t *right) {
+    assert(left);
+    bool binary = operators[op].binary;
+
+    if (left->type == NUMBER && (!binary || right->type == NUMBER))
+        return dagNumber(dag, calculateOperation(op, left->value.number, (binary) ? right->value.number : 0));
+
+    switch(op) {
+        case ADD:
+            if (isNumber(left, 0))  return right;
+            if (isNumber(right, 0)) return left;
+            break;
+        case SUB:
+            if (isNumber(right, 0)) return left;
+            break;
+        case MUL:
+            if (isNumber(left, 0)  || isNumber(right, 1)) return left;
+            if (isNumber(right, 0) || isNumber(left, 1))  return right;
+            break;
+        case DIV:
+            if (isNumber(left, 0) || isNumber(right, 1)) return left;
+            break;
+        case POW:
+            if (isNumber(right, 1)) return left;
+            if (isNumber(right, 0) || isNumber(left, 1)) return dagNumber(dag, 1);
+            if (isNumber(left, 0))  return left;
+            break;
+        case SIN:
+        case COS:
+        case SINH:
+        case COSH:
+        case TAN:
+        case CTG:
+        case LOG:
+        case LOGN:
+        default:
+            break;
+    }
+
+    union NodeValue value = {};
+    value.op = op;
+    return dagInternNode(dag, OPERATOR, value, left, (binary) ? right : NULL);
+}
+
+Node_t *dagNode(ExprDag_t *dag, enum ElemType type, int iVal, double dVal, Node_t *left, Node_t *right) {
+    assert(dag);
+
+    union NodeValue value = {};
+    switch(type) {
+        case OPERATOR:
+            return dagOperator(dag, (enum OperatorType) iVal, left, right);
+        case VARIABLE:
+            value.var = iVal;
+            return dagInternNode(dag, VARIABLE, value, NULL, NULL);
+        case NUMBER:
+            return dagNumber(dag, dVal);
+        default:
+            assert(0);
+            return NULL;
+    }
+}
+
+/// @brief Tree node and number of its interned children
+typedef struct {
+    const Node_t *node;
+    size_t internedArgs;
+} InternFrame_t;
+
+TREE_STACK_DEFINE(InternStack, InternFrame_t)
+
+Node_t *dagInternTree(ExprDag_t *dag, const Node_t *tree) {
+    assert(dag);
+    assert(tree);
+
+    InternFrame_t framesBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    Node_t *resultsBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    InternStack_t frames  = InternStackCtor(framesBuffer, TREE_STACK_MIN_CAPACITY);
+    DagStack_t    results = DagStackCtor(resultsBuffer, TREE_STACK_MIN_CAPACITY);
+
+    InternFrame_t root = {tree, 0};
+    bool memoryOk = InternStackPush(&frames, root);
+
+    // post-order traversal: interned children are on top of results stack when their parent is interned
+    while (frames.size && memoryOk) {
+        InternFrame_t *frame = InternStackTop(&frames);
+        const Node_t *current = frame->node;
+
+        if (current->operandsCount) {
+            // DAG keeps only binary nodes: a + b + c is interned as (a + b) + c
+            if (frame->internedArgs >= 2) {
+                Node_t *right = DagStackPop(&results);
+                Node_t *left  = DagStackPop(&results);
+                Node_t *sum   = dagOperator(dag, current->value.op, left, right);
+                memoryOk = sum && DagStackPush(&results, sum);
+            }
+
+            if (!memoryOk)
+                break;
+            if (frame->internedArgs < current->operandsCount) {
+                InternFrame_t child = {current->operands[frame->internedArgs++], 0};
+                memoryOk = InternStackPush(&frames, child);
+            } else
+                InternStackPop(&frames);
+            continue;
+        }
+
+        size_t childrenCount = (current->right) ? 2 : (current->left) ? 1 : 0;
+        if (frame->internedArgs < childrenCount) {
+            InternFrame_t child = {(frame->internedArgs == 0) ? current->left : current->right, 0};
+            frame->internedArgs++;
+            memoryOk = InternStackPush(&frames, child);
+            continue;
+        }
+
+        Node_t *right = (current->right) ? DagStackPop(&results) : NULL;
+        Node_t *left  = (current->left)  ? DagStackPop(&results) : NULL;
+        Node_t *node  = dagNode(dag, current->type, current->value.var, current->value.number, left, right);
+        memoryOk = node && DagStackPush(&results, node);
+        InternStackPop(&frames);
+    }
+
+    Node_t *result = (memoryOk) ? DagStackPop(&results) : NULL;
+    if (!memoryOk)
+        logPrint(L_ZERO, 1, "DAG[%p]: not enough memory to intern tree[%p]\n", dag, tree);
+
+    InternStackDtor(&frames);
+    DagStackDtor(&results);
+    return result;
+}
+
+/*=======DSL FOR DAG DERIVATIVES==================*/
+#define OPR_(op, left, right) dagOperator(dag, op, left, right)
+#define NUM_(num) dagNumber(dag, num)
+#define dL_ dagDerivative(dag, left, variable)
+#define dR_ dagDerivative(dag, right, variable)
+
+/// @brief Same rules as derivativeOperator(), but operands are shared instead of copied.
+/// Derivatives of operands must be memoized already, so dL_ and dR_ don't go deeper
+static Node_t *dagDerivativeOperator(ExprDag_t *dag, Node_t *expr, int variable) {
+    Node_t *left = expr->left, *right = expr->right;
+    Node_t *result = NULL;
+
+    switch(expr->value.op) {
+        case ADD:
+            result = OPR_(ADD, dL_, dR_);
+            break;
+        case SUB:
+            result = OPR_(SUB, dL_, dR_);
+            break;
+        case MUL:
+            result = OPR_(ADD, OPR_(MUL, dL_, right),
+                               OPR_(MUL, left, dR_));
+            break;
+        case DIV:
+            result = OPR_(DIV, OPR_(SUB, OPR_(MUL, dL_, right),
+                                         OPR_(MUL, left, dR_)),
+                               OPR_(POW, right, NUM_(2)));
+            break;
+        case POW:
+        {
+            bool noVarBase  = !hasVariable(left, variable);
+            bool noVarPower = !hasVariable(right, variable);
+
+            if (noVarPower) {
+                // d(f^n) = d(f)*n*f^(n-1)
+                result = OPR_(MUL, OPR_(MUL, dL_, right),
+                                   OPR_(POW, left, OPR_(SUB, right, NUM_(1))));
+            } else if (noVarBase) {
+                //d(a^f) = a^f * ln(a) * d(f)
+                result = OPR_(MUL, OPR_(MUL, expr, dR_),
+                                   OPR_(LOGN, left, NULL));
+            } else {
+                //d(g^f) = g^f * (df*ln(g) + f*dg/g)
+                result = OPR_(MUL, expr, OPR_(ADD, OPR_(MUL, dR_, OPR_(LOGN, left, NULL)),
+                                                   OPR_(DIV, OPR_(MUL, right, dL_), left)));
+            }
+            break;
+        }
+        case SIN:
+            result = OPR_(MUL, OPR_(COS, left, NULL), dL_);
+            break;
+        case COS:
+            result = OPR_(MUL, OPR_(SIN, left, NULL),
+                               OPR_(MUL, NUM_(-1), dL_));
+            break;
+        case SINH:
+            result = OPR_(MUL, OPR_(COSH, left, NULL), dL_);
+            break;
+        case COSH:
+            result = OPR_(MUL, OPR_(SINH, left, NULL), dL_);
+            break;
+        case TAN:
+            result = OPR_(MUL, dL_, OPR_(POW, OPR_(COS, left, NULL), NUM_(-2)));
+            break;
+        case CTG:
+            result = OPR_(MUL, OPR_(MUL, NUM_(-1), dL_),
+                               OPR_(POW, OPR_(SIN, left, NULL), NUM_(-2)));
+            break;
+        case LOG:
+            result = OPR_(DIV, dR_, OPR_(MUL, right, OPR_(LOGN, left, NULL)));
+            break;
+        case LOGN:
+            result = OPR_(DIV, dL_, left);
+            break;
+        default:
+            logPrint(L_ZERO, 1, "Unknown operator type %d\n", expr->value.op);
+            break;
+    }
+
+    return result;
+}
+
+#undef OPR_
+#undef NUM_
+#undef dL_
+#undef dR_
+
+/// @brief Make memo array of variable at least dag->size long
+static TungstenStatus_t dagReserveDerivatives(ExprDag_t *dag, int variable) {
+    size_t oldSize = dag->derivativesSize[variable];
+    if (oldSize >= dag->size)
+        return TA_SUCCESS;
+
+    size_t newSize = (oldSize) ? oldSize : DAG_CHUNK_SIZE;
+    while (newSize < dag->size)
+        newSize *= 2;
+
+    Node_t **newMemo = (Node_t **) realloc(dag->derivatives[variable], newSize * sizeof(Node_t *));
+    if (!newMemo)
+        return TA_MEMORY_ERROR;
+
+    memset(newMemo + oldSize, 0, (newSize - oldSize) * sizeof(Node_t *));
+    dag->derivatives[variable] = newMemo;
+    dag->derivativesSize[variable] = newSize;
+    return TA_SUCCESS;
+}
+
+/// @brief Whether derivative of node is known: it is memoized or node doesn't depend on variable
+static bool dagDerivativeReady(const ExprDag_t *dag, const Node_t *node, int variable) {
+    return !hasVariable(node, variable) || dag->derivatives[variable][dagCast(node)->id];
+}
+
+Node_t *dagDerivative(ExprDag_t *dag, Node_t *expr, int variable) {
+    assert(dag);
+    assert(expr);
+    assert(0 <= variable && (size_t) variable < VARIABLE_TABLE_SIZE);
+
+    if (!hasVariable(expr, variable))
+        return dagNumber(dag, 0);
+
+    if (dagReserveDerivatives(dag, variable) != TA_SUCCESS)
+        return NULL;
+
+    if (dag->derivatives[variable][dagCast(expr)->id])
+        return dag->derivatives[variable][dagCast(expr)->id];
+
+    Node_t *buffer[TREE_STACK_MIN_CAPACITY] = {};
+    DagStack_t stack = DagStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+    bool ok = DagStackPush(&stack, expr);
+
+    // operands are differentiated before their parent, so every rule finds them in memo.
+    // Only nodes existing before the call are pushed, memo has room for their ids
+    while (stack.size && ok) {
+        Node_t *node = *DagStackTop(&stack);
+        if (dagDerivativeReady(dag, node, variable)) {
+            DagStackPop(&stack);
+            continue;
+        }
+
+        if (node->left && !dagDerivativeReady(dag, node->left, variable)) {
+            ok = DagStackPush(&stack, node->left);
+            continue;
+        }
+        if (node->right && !dagDerivativeReady(dag, node->right, variable)) {
+            ok = DagStackPush(&stack, node->right);
+            continue;
+        }
+
+        Node_t *result = (node->type == VARIABLE) ? dagNumber(dag, 1) : dagDerivativeOperator(dag, node, variable);
+        // memo could be reallocated while derivative nodes were interned
+        ok = result && dagReserveDerivatives(dag, variable) == TA_SUCCESS;
+        if (ok)
+            dag->derivatives[variable][dagCast(node)->id] = result;
+        DagStackPop(&stack);
+    }
+
+    DagStackDtor(&stack);
+    if (!ok) {
+        logPrint(L_ZERO, 1, "DAG[%p]: not enough memory for derivative\n", dag);
+        return NULL;
+    }
+    return dag->derivatives[variable][dagCast(expr)->id];
+}
+
+/// @brief Interned node by id
+static Node_t *dagNodeById(ExprDag_t *dag, size_t id) {
+    return &dag->chunks[id / DAG_CHUNK_SIZE][id % DAG_CHUNK_SIZE].node;
+}
+
+/// @brief Mark nodes reachable from exprs, marks are indexed by node id
+static TungstenStatus_t dagMarkReachable(Node_t *const *exprs, size_t count, bool *reachable) {
+    Node_t *buffer[TREE_STACK_MIN_CAPACITY] = {};
+    DagStack_t stack = DagStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+
+    bool memoryOk = true;
+    for (size_t idx = 0; idx < count && memoryOk; idx++) {
+        memoryOk = DagStackPush(&stack, exprs[idx]);
+        while (stack.size && memoryOk) {
+            Node_t *node = DagStackPop(&stack);
+            size_t id = dagCast(node)->id;
+            if (reachable[id])
+                continue;
+
+            reachable[id] = true;
+            if (node->left)
+                memoryOk = DagStackPush(&stack, node->left);
+            if (node->right && memoryOk)
+                memoryOk = DagStackPush(&stack, node->right);
+        }
+    }
+
+    DagStackDtor(&stack);
+    return (memoryOk) ? TA_SUCCESS : TA_MEMORY_ERROR;
+}
+
+TungstenStatus_t dagJacobian(ExprDag_t *dag, Node_t *const *exprs, size_t exprsCount,
+                             const int *variables, size_t variablesCount, Node_t **partials) {
+    assert(dag);
+    assert(exprs);
+    assert(variables);
+    assert(partials);
+
+    // derivatives add nodes, only nodes existing now are visited
+    size_t size = dag->size;
+    bool *reachable = (bool *) calloc(size, sizeof(bool));
+    if (!reachable)
+        return TA_MEMORY_ERROR;
+
+    TungstenStatus_t status = dagMarkReachable(exprs, exprsCount, reachable);
+
+    // children have smaller ids, so derivatives of operands are always memoized before their parent
+    // needs them and dagDerivative() never goes deeper than one level
+    for (size_t id = 0; id < size && status == TA_SUCCESS; id++) {
+        if (!reachable[id]) continue;
+
+        Node_t *node = dagNodeById(dag, id);
+        for (size_t varIdx = 0; varIdx < variablesCount && status == TA_SUCCESS; varIdx++) {
+            if (hasVariable(node, variables[varIdx]) && !dagDerivative(dag, node, variables[varIdx]))
+                status = TA_MEMORY_ERROR;
+        }
+    }
+    free(reachable);
+
+    for (size_t exprIdx = 0; exprIdx < exprsCount && status == TA_SUCCESS; exprIdx++) {
+        for (size_t varIdx = 0; varIdx < variablesCount && status == TA_SUCCESS; varIdx++) {
+            Node_t *partial = dagDerivative(dag, exprs[exprIdx], variables[varIdx]);
+            partials[exprIdx * variablesCount + varIdx] = partial;
+            if (!partial)
+                status = TA_MEMORY_ERROR;
+        }
+    }
+
+    if (status != TA_SUCCESS)
+        logPrint(L_ZERO, 1, "DAG[%p]: not enough memory for Jacobian\n", dag);
+    return status;
+}
+
+TungstenStatus_t dagGradient(ExprDag_t *dag, Node_t *expr, const int *variables, size_t variablesCount,
+                             Node_t **partials) {
+    assert(expr);
+
+    return dagJacobian(dag, &expr, 1, variables, variablesCount, partials);
+}
+
+TungstenStatus_t dagHessian(ExprDag_t *dag, Node_t *expr, const int *variables, size_t variablesCount,
+                            Node_t **gradient, Node_t **hessian) {
+    assert(hessian);
+
+    Node_t **partials = (gradient) ? gradient : (Node_t **) calloc(variablesCount, sizeof(Node_t *));
+    if (!partials)
+        return TA_MEMORY_ERROR;
+
+    TungstenStatus_t status = dagGradient(dag, expr, variables, variablesCount, partials);
+    if (status == TA_SUCCESS)
+        status = dagJacobian(dag, partials, variablesCount, variables, variablesCount, hessian);
+
+    if (partials != gradient)
+        free(partials);
+    return status;
+}
+
+static bool dagEvaluated(const ExprDag_t *dag, const Node_t *node) {
+    return dag->valueStamps[dagCast(node)->id] == dag->evalStamp;
+}
+
+/// @brief Evaluate interned expression with values memoized in current stamp
+/// @return false if memory for traversal has run out
+static bool dagEvaluateNode(ExprDag_t *dag, TungstenContext_t *context, Node_t *expr) {
+    Node_t *buffer[TREE_STACK_MIN_CAPACITY] = {};
+    DagStack_t stack = DagStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+    bool memoryOk = DagStackPush(&stack, expr);
+
+    // node is computed when values of its operands are stamped
+    while (stack.size && memoryOk) {
+        Node_t *node = *DagStackTop(&stack);
+        if (dagEvaluated(dag, node)) {
+            DagStackPop(&stack);
+            continue;
+        }
+
+        double value = 0;
+        switch(node->type) {
+            case NUMBER:
+                value = node->value.number;
+                break;
+            case VARIABLE:
+                value = getVariable(context, node->value.var);
+                break;
+            case OPERATOR:
+            {
+                if (!dagEvaluated(dag, node->left)) {
+                    memoryOk = DagStackPush(&stack, node->left);
+                    continue;
+                }
+                bool binary = operators[node->value.op].binary;
+                if (binary && !dagEvaluated(dag, node->right)) {
+                    memoryOk = DagStackPush(&stack, node->right);
+                    continue;
+                }
+
+                double leftValue  = dag->values[dagCast(node->left)->id],
+                       rightValue = (binary) ? dag->values[dagCast(node->right)->id] : 0;
+                value = calculateOperation(node->value.op, leftValue, rightValue);
+                break;
+            }
+            default:
+                assert(0);
+                break;
+        }
+
+        size_t id = dagCast(node)->id;
+        dag->values[id] = value;
+        dag->valueStamps[id] = dag->evalStamp;
+        DagStackPop(&stack);
+    }
+
+    DagStackDtor(&stack);
+    if (!memoryOk)
+        logPrint(L_ZERO, 1, "DAG[%p]: not enough memory to evaluate expression[%p]\n", dag, expr);
+    return memoryOk;
+}
+
+/// @brief Make memo of values at least dag->size long
+static TungstenStatus_t dagReserveValues(ExprDag_t *dag) {
+    if (dag->valuesSize >= dag->size)
+        return TA_SUCCESS;
+
+    double *newValues = (double *) realloc(dag->values, dag->size * sizeof(double));
+    size_t *newStamps = (size_t *) realloc(dag->valueStamps, dag->size * sizeof(size_t));
+    if (newValues) dag->values = newValues;
+    if (newStamps) dag->valueStamps = newStamps;
+    if (!newValues || !newStamps) {
+        logPrint(L_ZERO, 1, "DAG[%p]: not enough memory for evaluation\n", dag);
+        return TA_MEMORY_ERROR;
+    }
+
+    memset(dag->valueStamps + dag->valuesSize, 0, (dag->size - dag->valuesSize) * sizeof(size_t));
+    dag->valuesSize = dag->size;
+    return TA_SUCCESS;
+}
+
+double dagEvaluate(ExprDag_t *dag, TungstenContext_t *context, Node_t *expr) {
+    assert(dag);
+    assert(context);
+    assert(expr);
+
+    dag->evalStamp++;
+    if (dagReserveValues(dag) != TA_SUCCESS || !dagEvaluateNode(dag, context, expr))
+        return evaluate(context, expr);
+
+    return dag->values[dagCast(expr)->id];
+}
+
+TungstenStatus_t dagEvaluateMany(ExprDag_t *dag, TungstenContext_t *context, Node_t *const *exprs, size_t count,
+                                 double *values) {
+    assert(dag);
+    assert(context);
+    assert(exprs);
+    assert(values);
+
+    TungstenStatus_t status = dagReserveValues(dag);
+    if (status != TA_SUCCESS)
+        return status;
+
+    // one stamp for all expressions: values of shared nodes stay valid between them
+    dag->evalStamp++;
+    for (size_t idx = 0; idx < count; idx++) {
+        if (!dagEvaluateNode(dag, context, exprs[idx]))
+            return TA_MEMORY_ERROR;
+        values[idx] = dag->values[dagCast(exprs[idx])->id];
+    }
+    return TA_SUCCESS;
+}
@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "exprCompiler.h"
+#include "exprDual.h"
+#include "treeStack.h"
+
+/// @brief Exact zero test: only derivatives that are exactly zero may be skipped
+static bool isZero(double a) {
+    return fpclassify(a) == FP_ZERO;
+}
+
+Dual_t dualOperation(enum OperatorType op, Dual_t left, Dual_t right) {
+    double a = left.value,  da = left.derivative,
+           b = right.value, db = right.derivative;
+
+    Dual_t result = {calculateOperation(op, a, b), 0};
+    switch(op) {
+        case ADD:
+            result.derivative = da + db;
+            break;
+        case SUB:
+            result.derivative = da - db;
+            break;
+        case MUL:
+            result.derivative = da * b + a * db;
+            break;
+        case DIV:
+            result.derivative = (da * b - a * db) / (b * b);
+            break;
+        case POW:
+            // terms with zero derivative are skipped, so negative base with constant power is fine
+            if (!isZero(da))
+                result.derivative += b * pow(a, b - 1) * da;
+            if (!isZero(db))
+                result.derivative += result.value * log(a) * db;
+            break;
+        case SIN:
+            result.derivative = cos(a) * da;
+            break;
+        case COS:
+            result.derivative = -sin(a) * da;
+            break;
+        case SINH:
+            result.derivative = cosh(a) * da;
+            break;
+        case COSH:
+            result.derivative = sinh(a) * da;
+            break;
+        case TAN:
+            result.derivative = da * (1 + result.value * result.value);
+            break;
+        case CTG:
+            result.derivative = -da * (1 + result.value * result.value);
+            break;
+        case LOG:
+        {
+            // log_a(b) = ln(b) / ln(a)
+            double logBase = log(a);
+            result.derivative = (db / b - result.value * da / a) / logBase;
+            break;
+        }
+        case LOGN:
+            result.derivative = da / a;
+            break;
+        default:
+            LOG_PRINT(L_ZERO, 1, "Operation %d is not implemented\n", op);
+            break;
+    }
+
+    return result;
+}
+
+/// @brief Operator node and number of its evaluated arguments
+typedef struct {
+    const Node_t *node;
+    unsigned evaluatedArgs;
+} DualFrame_t;
+
+TREE_STACK_DEFINE(DualFrameStack, DualFrame_t)
+TREE_STACK_DEFINE(DualStack, Dual_t)
+
+Dual_t evaluateDual(TungstenContext_t *context, const Node_t *expr, int variable) {
+    assert(context);
+    assert(expr);
+
+    DualFrame_t framesBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    Dual_t stackBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    DualFrameStack_t frames = DualFrameStackCtor(framesBuffer, TREE_STACK_MIN_CAPACITY);
+    DualStack_t stack = DualStackCtor(stackBuffer, TREE_STACK_MIN_CAPACITY);
+
+    DualFrame_t root = {expr, 0};
+    bool memoryOk = DualFrameStackPush(&frames, root);
+
+    // post-order traversal, the same as evaluate()
+    while (frames.size && memoryOk) {
+        DualFrame_t *frame = DualFrameStackTop(&frames);
+        const Node_t *current = frame->node;
+
+        switch(current->type) {
+            case VARIABLE:
+            {
+                Dual_t var = {context->variables[current->value.var].number,
+                              (current->value.var == variable) ? 1.0 : 0.0};
+                memoryOk = DualStackPush(&stack, var);
+                DualFrameStackPop(&frames);
+                break;
+            }
+            case NUMBER:
+            {
+                Dual_t number = {current->value.number, 0};
+                memoryOk = DualStackPush(&stack, number);
+                DualFrameStackPop(&frames);
+                break;
+            }
+            case OPERATOR:
+            {
+                if (current->operandsCount) {
+                    if (frame->evaluatedArgs >= 2) {
+                        Dual_t right = DualStackPop(&stack);
+                        Dual_t left  = DualStackPop(&stack);
+                        DualStackPush(&stack, dualOperation(current->value.op, left, right));
+                    }
+
+                    if (frame->evaluatedArgs < current->operandsCount) {
+                        DualFrame_t child = {current->operands[frame->evaluatedArgs++], 0};
+                        memoryOk = DualFrameStackPush(&frames, child);
+                    } else
+                        DualFrameStackPop(&frames);
+                    break;
+                }
+
+                bool binary = operators[current->value.op].binary;
+                if (frame->evaluatedArgs < 1u + binary) {
+                    DualFrame_t child = {(frame->evaluatedArgs == 0) ? current->left : current->right, 0};
+                    frame->evaluatedArgs++;
+                    memoryOk = DualFrameStackPush(&frames, child);
+                    break;
+                }
+
+                Dual_t right = {};
+                if (binary)
+                    right = DualStackPop(&stack);
+                Dual_t left = DualStackPop(&stack);
+                DualStackPush(&stack, dualOperation(current->value.op, left, right));
+                DualFrameStackPop(&frames);
+                break;
+            }
+            default:
+                assert(0);
+                break;
+        }
+    }
+
+    Dual_t result = {};
+    if (memoryOk)
+        result = DualStackPop(&stack);
+    else
+        logPrint(L_ZERO, 1, "Not enough memory to evaluate dual numbers of tree[%p]\n", expr);
+
+    DualFrameStackDtor(&frames);
+    DualStackDtor(&stack);
+    return result;
+}
+
+/*=====================Batch evaluation=============================*/
+
+/// @brief Evaluate program for one block of count <= BATCH_BLOCK_SIZE points
+/// @param stack Values of stack slots, every slot is followed by slot of derivatives
+static void evaluateDualBlock(TungstenContext_t *context, const CompiledExpr_t *compiled, int variable,
+                              const double **varInputs, size_t offset, double *stack,
+                              double *values, double *derivatives, size_t count) {
+    //top points to values of the block on top of stack, derivatives are BATCH_BLOCK_SIZE after them
+    double *top = stack - 2 * BATCH_BLOCK_SIZE;
+    const Instruction_t *instr = compiled->code,
+                        *end   = compiled->code + compiled->size;
+
+    for (; instr < end; instr++) {
+        switch(instr->code) {
+            case INSTR_NUMBER:
+                top += 2 * BATCH_BLOCK_SIZE;
+                for (size_t idx = 0; idx < count; idx++) {
+                    top[idx] = instr->arg.number;
+                    top[idx + BATCH_BLOCK_SIZE] = 0;
+                }
+                break;
+            case INSTR_VARIABLE:
+            {
+                top += 2 * BATCH_BLOCK_SIZE;
+                const double *inputValues = varInputs[instr->arg.var];
+                double seed = (instr->arg.var == variable) ? 1.0 : 0.0;
+                for (size_t idx = 0; idx < count; idx++) {
+                    top[idx] = (inputValues) ? inputValues[offset + idx] : context->variables[instr->arg.var].number;
+                    top[idx + BATCH_BLOCK_SIZE] = seed;
+                }
+                break;
+            }
+            case INSTR_ADD:  case INSTR_SUB:  case INSTR_MUL: case INSTR_DIV:
+            case INSTR_POW:  case INSTR_SIN:  case INSTR_COS: case INSTR_SINH:
+            case INSTR_COSH: case INSTR_TAN:  case INSTR_CTG: case INSTR_LOG:
+            case INSTR_LOGN:
+            default:
+            {
+                enum OperatorType op = (enum OperatorType) instr->code;
+                double *left = top, *right = top;
+                if (operators[op].binary) {
+                    top -= 2 * BATCH_BLOCK_SIZE;
+                    left = top;
+                }
+
+                for (size_t idx = 0; idx < count; idx++) {
+                    Dual_t leftDual  = {left[idx],  left[idx + BATCH_BLOCK_SIZE]},
+                           rightDual = {right[idx], right[idx + BATCH_BLOCK_SIZE]};
+                    Dual_t result = dualOperation(op, leftDual, rightDual);
+                    top[idx] = result.value;
+                    top[idx + BATCH_BLOCK_SIZE] = result.derivative;
+                }
+                break;
+            }
+        }
+    }
+
+    memcpy(values, top, count * sizeof(double));
+    memcpy(derivatives, top + BATCH_BLOCK_SIZE, count * sizeof(double));
+}
+
+TungstenStatus_t evaluateBatchDual(TungstenContext_t *context, const CompiledExpr_t *compiled, int variable,
+                                   const BatchVariable_t *inputs, size_t inputsCount,
+                                   double *values, double *derivatives, size_t pointsCount) {
+    assert(context);
+    assert(compiled);
+    assert(values);
+    assert(derivatives);
+    assert(inputs || inputsCount == 0);
+
+    //resolving variables once for whole batch
+    const double *varInputs[VARIABLE_TABLE_SIZE] = {};
+    for (size_t inputIdx = 0; inputIdx < inputsCount; inputIdx++) {
+        int var = inputs[inputIdx].var;
+        if (var < 0 || (size_t) var >= context->variablesCount) {
+            logPrint(L_ZERO, 1, "Dual batch evaluation: unknown variable %d\n", var);
+            return TA_NULL_PTR;
+        }
+        varInputs[var] = inputs[inputIdx].values;
+    }
+
+    double *stack = (double *) calloc(2 * compiled->stackSize * BATCH_BLOCK_SIZE, sizeof(double));
+    if (!stack)
+        return TA_MEMORY_ERROR;
+
+    for (size_t offset = 0; offset < pointsCount; offset += BATCH_BLOCK_SIZE) {
+        size_t count = pointsCount - offset;
+        if (count > BATCH_BLOCK_SIZE)
+            count = BATCH_BLOCK_SIZE;
+
+        evaluateDualBlock(context, compiled, variable, varInputs, offset, stack,
+                          values + offset, derivatives + offset, count);
+    }
+
+    free(stack);
+    return TA_SUCCESS;
+}
@@ -0,0 +1,798 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "treeStack.h"
+#include "exprEgraph.h"
+
+static const uint32_t EGRAPH_NONE = UINT32_MAX;
+static const size_t EGRAPH_TIME_CHECK_PERIOD = 256;    ///< E-nodes processed between checks of time
+
+TREE_STACK_DEFINE(NodeStack, Node_t *)
+TREE_STACK_DEFINE(ConstNodeStack, const Node_t *)
+TREE_STACK_DEFINE(ClassStack, uint32_t)
+
+/// @brief Operator or leaf applied to classes
+typedef struct {
+    enum ElemType type;
+    union NodeValue value;
+    uint32_t children[2];
+    uint32_t childrenCount;
+    uint32_t eclass;        ///< Class at creation, findClass() gives current one
+    bool duplicate;         ///< Became equal to other e-node after merge of classes, skipped
+} ENode_t;
+
+typedef struct {
+    double constant;
+    bool isConstant;
+} EClassInfo_t;
+
+typedef struct {
+    ENode_t *nodes;
+    uint32_t *unionFind;        ///< Parent of class, class is named by its first e-node
+    EClassInfo_t *info;         ///< Valid for roots of union-find
+    size_t nodesCount;
+    size_t capacity;
+
+    uint32_t *table;            ///< Hashcons: e-nodes by canonical form, EGRAPH_NONE if empty
+    size_t tableCapacity;
+    size_t tableCount;
+
+    uint32_t *classStart;       ///< E-nodes of class c are classNodes[classStart[c]..classStart[c + 1])
+    uint32_t *classNodes;
+    size_t indexedCount;        ///< Classes in index, newer ones have no e-nodes there
+
+    size_t unions;
+    EgraphLimits_t limits;
+    double startTime;
+    bool memoryError;
+    bool limitReached;
+} EGraph_t;
+
+static double egraphTimeMs() {
+    struct timespec time = {};
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double) time.tv_sec * 1000.0 + (double) time.tv_nsec / 1e6;
+}
+
+static bool timeIsOver(const EGraph_t *egraph) {
+    return egraphTimeMs() - egraph->startTime > egraph->limits.maxTimeMs;
+}
+
+static uint32_t findClass(EGraph_t *egraph, uint32_t eclass) {
+    // path halving
+    while (egraph->unionFind[eclass] != eclass) {
+        egraph->unionFind[eclass] = egraph->unionFind[egraph->unionFind[eclass]];
+        eclass = egraph->unionFind[eclass];
+    }
+    return eclass;
+}
+
+static bool classConstant(EGraph_t *egraph, uint32_t eclass, double *value) {
+    EClassInfo_t info = egraph->info[findClass(egraph, eclass)];
+    if (info.isConstant && value)
+        *value = info.constant;
+    return info.isConstant;
+}
+
+static bool classIsNumber(EGraph_t *egraph, uint32_t eclass, double number) {
+    double value = 0;
+    return classConstant(egraph, eclass, &value) && fpclassify(value - number) == FP_ZERO;
+}
+
+/// @brief Merge classes, the older one stays root
+static void uniteClasses(EGraph_t *egraph, uint32_t first, uint32_t second) {
+    if (first == EGRAPH_NONE || second == EGRAPH_NONE)
+        return;
+
+    first = findClass(egraph, first);
+    second = findClass(egraph, second);
+    if (first == second)
+        return;
+
+    uint32_t root = (first < second) ? first : second, other = (first < second) ? second : first;
+    egraph->unionFind[other] = root;
+    if (!egraph->info[root].isConstant)
+        egraph->info[root] = egraph->info[other];
+    egraph->unions++;
+}
+
+static uint64_t enodeHash(const ENode_t *enode) {
+    uint64_t hash = hashMix((uint64_t) enode->type, nodeValueBits(enode->type, enode->value));
+    for (uint32_t idx = 0; idx < enode->childrenCount; idx++)
+        hash = hashMix(hash, enode->children[idx]);
+
+    // spread all bits over low ones that index table
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCD;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static bool enodesEqual(const ENode_t *first, const ENode_t *second) {
+    if (first->type != second->type || first->childrenCount != second->childrenCount ||
+        nodeValueBits(first->type, first->value) != nodeValueBits(second->type, second->value))
+        return false;
+
+    for (uint32_t idx = 0; idx < first->childrenCount; idx++) {
+        if (first->children[idx] != second->children[idx])
+            return false;
+    }
+    return true;
+}
+
+/// @brief Find e-node with the same canonical form
+static uint32_t tableFind(const EGraph_t *egraph, const ENode_t *enode) {
+    if (!egraph->tableCapacity)
+        return EGRAPH_NONE;
+
+    size_t mask = egraph->tableCapacity - 1;
+    for (size_t idx = enodeHash(enode) & mask; egraph->table[idx] != EGRAPH_NONE; idx = (idx + 1) & mask) {
+        if (enodesEqual(egraph->nodes + egraph->table[idx], enode))
+            return egraph->table[idx];
+    }
+    return EGRAPH_NONE;
+}
+
+static void tablePlace(EGraph_t *egraph, uint32_t id) {
+    size_t mask = egraph->tableCapacity - 1;
+    size_t idx = enodeHash(egraph->nodes + id) & mask;
+    while (egraph->table[idx] != EGRAPH_NONE)
+        idx = (idx + 1) & mask;
+    egraph->table[idx] = id;
+    egraph->tableCount++;
+}
+
+/// @brief Make table empty with room for capacity of e-graph at load factor 1/2
+static bool tableClear(EGraph_t *egraph) {
+    size_t capacity = (egraph->tableCapacity) ? egraph->tableCapacity : 2 * EGRAPH_START_CAPACITY;
+    while (capacity < 2 * egraph->capacity)
+        capacity *= 2;
+
+    if (capacity != egraph->tableCapacity) {
+        uint32_t *table = (uint32_t *) realloc(egraph->table, capacity * sizeof(uint32_t));
+        if (!table)
+            return false;
+        egraph->table = table;
+        egraph->tableCapacity = capacity;
+    }
+
+    memset(egraph->table, 0xFF, egraph->tableCapacity * sizeof(uint32_t));
+    egraph->tableCount = 0;
+    return true;
+}
+
+static bool reserveNode(EGraph_t *egraph) {
+    if (egraph->nodesCount < egraph->capacity)
+        return true;
+
+    size_t capacity = (egraph->capacity) ? 2 * egraph->capacity : EGRAPH_START_CAPACITY;
+    ENode_t *nodes = (ENode_t *) realloc(egraph->nodes, capacity * sizeof(ENode_t));
+    if (nodes) egraph->nodes = nodes;
+    uint32_t *unionFind = (uint32_t *) realloc(egraph->unionFind, capacity * sizeof(uint32_t));
+    if (unionFind) egraph->unionFind = unionFind;
+    EClassInfo_t *info = (EClassInfo_t *) realloc(egraph->info, capacity * sizeof(EClassInfo_t));
+    if (info) egraph->info = info;
+    if (!nodes || !unionFind || !info)
+        return false;
+
+    egraph->capacity = capacity;
+
+    // table keeps load factor below 1/2 of capacity
+    uint32_t *oldTable = egraph->table;
+    size_t oldCapacity = egraph->tableCapacity;
+    egraph->table = NULL;
+    egraph->tableCapacity = 0;
+    if (!tableClear(egraph)) {
+        egraph->table = oldTable;
+        egraph->tableCapacity = oldCapacity;
+        return false;
+    }
+    for (size_t idx = 0; idx < oldCapacity; idx++) {
+        if (oldTable[idx] != EGRAPH_NONE)
+            tablePlace(egraph, oldTable[idx]);
+    }
+    free(oldTable);
+    return true;
+}
+
+static uint32_t addNumber(EGraph_t *egraph, double number);
+
+/// @brief Add e-node or find existing one
+/// @return Its class or EGRAPH_NONE if limit of nodes is reached or there is no memory
+static uint32_t addNode(EGraph_t *egraph, enum ElemType type, union NodeValue value,
+                        uint32_t left, uint32_t right, uint32_t childrenCount) {
+    if ((childrenCount > 0 && left == EGRAPH_NONE) || (childrenCount > 1 && right == EGRAPH_NONE))
+        return EGRAPH_NONE;
+
+    ENode_t enode = {type, value, {0, 0}, childrenCount, 0, false};
+    if (childrenCount > 0) enode.children[0] = findClass(egraph, left);
+    if (childrenCount > 1) enode.children[1] = findClass(egraph, right);
+
+    uint32_t found = tableFind(egraph, &enode);
+    if (found != EGRAPH_NONE)
+        return findClass(egraph, egraph->nodes[found].eclass);
+
+    if (egraph->nodesCount >= egraph->limits.maxNodes) {
+        egraph->limitReached = true;
+        return EGRAPH_NONE;
+    }
+    if (!reserveNode(egraph)) {
+        egraph->memoryError = true;
+        return EGRAPH_NONE;
+    }
+
+    uint32_t id = (uint32_t) egraph->nodesCount++;
+    enode.eclass = id;
+    egraph->nodes[id] = enode;
+    egraph->unionFind[id] = id;
+    egraph->info[id] = {};
+    tablePlace(egraph, id);
+
+    if (type == NUMBER) {
+        egraph->info[id] = {value.number, true};
+        return id;
+    }
+
+    // constant folding: class of 2 + 3 gets number 5
+    double leftValue = 0, rightValue = 0;
+    bool constant = type == OPERATOR && childrenCount > 0 && classConstant(egraph, left, &leftValue) &&
+                    (childrenCount == 1 || classConstant(egraph, right, &rightValue));
+    if (constant) {
+        double result = calculateOperation(value.op, leftValue, rightValue);
+        if (isfinite(result))
+            uniteClasses(egraph, id, addNumber(egraph, result));
+    }
+    return findClass(egraph, id);
+}
+
+static uint32_t addNumber(EGraph_t *egraph, double number) {
+    union NodeValue value = {};
+    value.number = number + 0.0;    // -0 is 0
+    return addNode(egraph, NUMBER, value, EGRAPH_NONE, EGRAPH_NONE, 0);
+}
+
+static uint32_t addOperation(EGraph_t *egraph, enum OperatorType op, uint32_t left, uint32_t right) {
+    union NodeValue value = {};
+    value.op = op;
+    return addNode(egraph, OPERATOR, value, left, right, (operators[op].binary) ? 2 : 1);
+}
+
+/// @brief Restore invariants after merges: children of e-nodes are roots of classes and
+/// congruent e-nodes (same operator of the same classes) are in one class
+static void rebuild(EGraph_t *egraph) {
+    size_t unionsBefore = 0;
+    do {
+        unionsBefore = egraph->unions;
+        if (!tableClear(egraph)) {
+            egraph->memoryError = true;
+            return;
+        }
+
+        for (size_t id = 0; id < egraph->nodesCount; id++) {
+            ENode_t *enode = egraph->nodes + id;
+            if (enode->duplicate)
+                continue;
+
+            for (uint32_t idx = 0; idx < enode->childrenCount; idx++)
+                enode->children[idx] = findClass(egraph, enode->children[idx]);
+
+            uint32_t existing = tableFind(egraph, enode);
+            if (existing == EGRAPH_NONE) {
+                tablePlace(egraph, (uint32_t) id);
+                continue;
+            }
+
+            uniteClasses(egraph, existing, enode->eclass);
+            enode->duplicate = true;
+        }
+    } while (egraph->unions != unionsBefore);
+}
+
+/// @brief Group e-nodes by classes for matching of rules
+static bool buildIndex(EGraph_t *egraph) {
+    size_t count = egraph->nodesCount;
+    uint32_t *classStart = (uint32_t *) realloc(egraph->classStart, (count + 1) * sizeof(uint32_t));
+    if (classStart) egraph->classStart = classStart;
+    uint32_t *classNodes = (uint32_t *) realloc(egraph->classNodes, (count + 1) * sizeof(uint32_t));
+    if (classNodes) egraph->classNodes = classNodes;
+    if (!classStart || !classNodes)
+        return false;
+
+    memset(classStart, 0, (count + 1) * sizeof(uint32_t));
+    for (size_t id = 0; id < count; id++) {
+        if (!egraph->nodes[id].duplicate)
+            classStart[findClass(egraph, egraph->nodes[id].eclass) + 1]++;
+    }
+    for (size_t eclass = 0; eclass < count; eclass++)
+        classStart[eclass + 1] += classStart[eclass];
+
+    // counting sort, classStart[c] runs to the end of class and is moved back after
+    for (size_t id = 0; id < count; id++) {
+        if (!egraph->nodes[id].duplicate)
+            classNodes[classStart[findClass(egraph, egraph->nodes[id].eclass)]++] = (uint32_t) id;
+    }
+    for (size_t eclass = count; eclass > 0; eclass--)
+        classStart[eclass] = classStart[eclass - 1];
+    classStart[0] = 0;
+
+    egraph->indexedCount = count;
+    return true;
+}
+
+static const uint32_t *classMembers(const EGraph_t *egraph, uint32_t eclass, size_t *count) {
+    if (eclass >= egraph->indexedCount) {
+        *count = 0;
+        return NULL;
+    }
+    *count = egraph->classStart[eclass + 1] - egraph->classStart[eclass];
+    return egraph->classNodes + egraph->classStart[eclass];
+}
+
+static bool isOperation(const ENode_t *enode, enum OperatorType op) {
+    return enode->type == OPERATOR && enode->value.op == op;
+}
+
+/*
+Rules are applied to e-node of class eclass with children left and right. Rule adds equal
+form and merges it with the class, forms of children are taken from index of classes.
+*/
+typedef void (*PairRule_t)(EGraph_t *egraph, uint32_t eclass, enum OperatorType op, ENode_t first, ENode_t second);
+
+/// @brief Apply rule to every pair of e-nodes with given operators from two classes
+/// @param op Operator of rewritten e-node
+static void applyPairRule(EGraph_t *egraph, uint32_t eclass, enum OperatorType op, uint32_t left,
+                          enum OperatorType leftOp, uint32_t right, enum OperatorType rightOp, PairRule_t rule) {
+    size_t leftCount = 0, rightCount = 0;
+    const uint32_t *leftMembers = classMembers(egraph, left, &leftCount);
+    const uint32_t *rightMembers = classMembers(egraph, right, &rightCount);
+
+    for (size_t leftIdx = 0; leftIdx < leftCount; leftIdx++) {
+        if (!isOperation(egraph->nodes + leftMembers[leftIdx], leftOp))
+            continue;
+
+        for (size_t rightIdx = 0; rightIdx < rightCount; rightIdx++) {
+            // e-nodes are copied, array can move when rule adds new ones
+            ENode_t first = egraph->nodes[leftMembers[leftIdx]], second = egraph->nodes[rightMembers[rightIdx]];
+            if (isOperation(&second, rightOp))
+                rule(egraph, eclass, op, first, second);
+        }
+    }
+}
+
+static bool sameClass(EGraph_t *egraph, uint32_t first, uint32_t second) {
+    return findClass(egraph, first) == findClass(egraph, second);
+}
+
+/// a*b ± a*c = a*(b ± c)
+static void factorSum(EGraph_t *egraph, uint32_t eclass, enum OperatorType op, ENode_t first, ENode_t second) {
+    if (sameClass(egraph, first.children[0], second.children[0])) {
+        uint32_t sum = addOperation(egraph, op, first.children[1], second.children[1]);
+        uniteClasses(egraph, eclass, addOperation(egraph, MUL, first.children[0], sum));
+    }
+}
+
+/// a/c ± b/c = (a ± b)/c
+static void addFractions(EGraph_t *egraph, uint32_t eclass, enum OperatorType op, ENode_t first, ENode_t second) {
+    if (sameClass(egraph, first.children[1], second.children[1])) {
+        uint32_t sum = addOperation(egraph, op, first.children[0], second.children[0]);
+        uniteClasses(egraph, eclass, addOperation(egraph, DIV, sum, first.children[1]));
+    }
+}
+
+/// ln(a) + ln(b) = ln(a*b), ln(a) - ln(b) = ln(a/b)
+static void addLogarithms(EGraph_t *egraph, uint32_t eclass, enum OperatorType op, ENode_t first, ENode_t second) {
+    uint32_t argument = addOperation(egraph, (op == ADD) ? MUL : DIV, first.children[0], second.children[0]);
+    uniteClasses(egraph, eclass, addOperation(egraph, LOGN, argument, EGRAPH_NONE));
+}
+
+/// a^b * a^c = a^(b + c), a^b / a^c = a^(b - c)
+static void mulPowers(EGraph_t *egraph, uint32_t eclass, enum OperatorType op, ENode_t first, ENode_t second) {
+    if (sameClass(egraph, first.children[0], second.children[0])) {
+        uint32_t exponent = addOperation(egraph, (op == MUL) ? ADD : SUB, first.children[1], second.children[1]);
+        uniteClasses(egraph, eclass, addOperation(egraph, POW, first.children[0], exponent));
+    }
+}
+
+/// a*b / a = b
+static void cancelFactor(EGraph_t *egraph, uint32_t eclass, uint32_t left, uint32_t right) {
+    size_t count = 0;
+    const uint32_t *members = classMembers(egraph, left, &count);
+    for (size_t idx = 0; idx < count; idx++) {
+        ENode_t member = egraph->nodes[members[idx]];
+        if (isOperation(&member, MUL) && sameClass(egraph, member.children[0], right))
+            uniteClasses(egraph, eclass, member.children[1]);
+    }
+}
+
+/// sin(a)/cos(a) = tg(a), cos(a)/sin(a) = ctg(a)
+static void divTrigonometry(EGraph_t *egraph, uint32_t eclass, enum OperatorType op, ENode_t first, ENode_t second) {
+    (void) op;
+    if (sameClass(egraph, first.children[0], second.children[0])) {
+        enum OperatorType function = (isOperation(&first, SIN)) ? TAN : CTG;
+        uniteClasses(egraph, eclass, addOperation(egraph, function, first.children[0], EGRAPH_NONE));
+    }
+}
+
+/// (a # b) # c = a # (b # c) and back
+static void associate(EGraph_t *egraph, uint32_t eclass, enum OperatorType op, uint32_t left, uint32_t right) {
+    size_t count = 0;
+    const uint32_t *members = classMembers(egraph, left, &count);
+    for (size_t idx = 0; idx < count; idx++) {
+        ENode_t member = egraph->nodes[members[idx]];
+        if (isOperation(&member, op)) {
+            uint32_t inner = addOperation(egraph, op, member.children[1], right);
+            uniteClasses(egraph, eclass, addOperation(egraph, op, member.children[0], inner));
+        }
+    }
+
+    members = classMembers(egraph, right, &count);
+    for (size_t idx = 0; idx < count; idx++) {
+        ENode_t member = egraph->nodes[members[idx]];
+        if (isOperation(&member, op)) {
+            uint32_t inner = addOperation(egraph, op, left, member.children[0]);
+            uniteClasses(egraph, eclass, addOperation(egraph, op, inner, member.children[1]));
+        }
+    }
+}
+
+/// x^n with small integer n = x^(n-1) * x, x^(-n) = 1/x^n
+static void expandPower(EGraph_t *egraph, uint32_t eclass, uint32_t base, uint32_t exponent) {
+    double number = 0;
+    if (!classConstant(egraph, exponent, &number) || fabs(number - round(number)) >= DOUBLE_EPSILON)
+        return;
+
+    int power = (int) round(number);
+    if (power == 0)
+        uniteClasses(egraph, eclass, addNumber(egraph, 1));
+    else if (power == 1)
+        uniteClasses(egraph, eclass, base);
+    else if (power == 2)
+        uniteClasses(egraph, eclass, addOperation(egraph, MUL, base, base));
+    else if (power > 2 && power <= EGRAPH_MAX_EXPANDED_POWER) {
+        uint32_t lower = addOperation(egraph, POW, base, addNumber(egraph, power - 1));
+        uniteClasses(egraph, eclass, addOperation(egraph, MUL, lower, base));
+    } else if (power < 0 && power >= -EGRAPH_MAX_EXPANDED_POWER) {
+        uint32_t positive = addOperation(egraph, POW, base, addNumber(egraph, -power));
+        uniteClasses(egraph, eclass, addOperation(egraph, DIV, addNumber(egraph, 1), positive));
+    }
+}
+
+static void applyRules(EGraph_t *egraph, uint32_t id) {
+    ENode_t enode = egraph->nodes[id];
+    if (enode.type != OPERATOR || enode.duplicate)
+        return;
+
+    uint32_t eclass = findClass(egraph, enode.eclass);
+    uint32_t left = enode.children[0], right = enode.children[1];
+    double number = 0;
+
+    switch (enode.value.op) {
+        case ADD:
+            if (classIsNumber(egraph, left, 0))
+                uniteClasses(egraph, eclass, right);
+            uniteClasses(egraph, eclass, addOperation(egraph, ADD, right, left));
+            associate(egraph, eclass, ADD, left, right);
+            applyPairRule(egraph, eclass, ADD, left, MUL, right, MUL, factorSum);
+            applyPairRule(egraph, eclass, ADD, left, DIV, right, DIV, addFractions);
+            applyPairRule(egraph, eclass, ADD, left, LOGN, right, LOGN, addLogarithms);
+            break;
+        case MUL:
+            if (classIsNumber(egraph, left, 1))
+                uniteClasses(egraph, eclass, right);
+            if (classIsNumber(egraph, left, 0))
+                uniteClasses(egraph, eclass, left);
+            uniteClasses(egraph, eclass, addOperation(egraph, MUL, right, left));
+            associate(egraph, eclass, MUL, left, right);
+            applyPairRule(egraph, eclass, MUL, left, POW, right, POW, mulPowers);
+            break;
+        case SUB:
+            if (classIsNumber(egraph, right, 0))
+                uniteClasses(egraph, eclass, left);
+            if (sameClass(egraph, left, right))
+                uniteClasses(egraph, eclass, addNumber(egraph, 0));
+            applyPairRule(egraph, eclass, SUB, left, MUL, right, MUL, factorSum);
+            applyPairRule(egraph, eclass, SUB, left, DIV, right, DIV, addFractions);
+            applyPairRule(egraph, eclass, SUB, left, LOGN, right, LOGN, addLogarithms);
+            break;
+        case DIV:
+            // division by constant is multiplication by its inverse
+            if (classConstant(egraph, right, &number) && isfinite(1 / number))
+                uniteClasses(egraph, eclass, addOperation(egraph, MUL, left, addNumber(egraph, 1 / number)));
+            applyPairRule(egraph, eclass, DIV, left, SIN, right, COS, divTrigonometry);
+            applyPairRule(egraph, eclass, DIV, left, COS, right, SIN, divTrigonometry);
+            applyPairRule(egraph, eclass, DIV, left, POW, right, POW, mulPowers);
+            cancelFactor(egraph, eclass, left, right);
+            break;
+        case POW:
+            expandPower(egraph, eclass, left, right);
+            break;
+        case SIN:
+        case COS:
+        case SINH:
+        case COSH:
+        case TAN:
+        case CTG:
+        case LOG:
+        case LOGN:
+        default:
+            break;
+    }
+}
+
+/// @brief Add tree to e-graph, n-ary nodes become chains of binary ones
+/// @return Class of root or EGRAPH_NONE
+static uint32_t importTree(EGraph_t *egraph, const Node_t *node) {
+    const Node_t *buffer[TREE_STACK_MIN_CAPACITY] = {};
+    ConstNodeStack_t stack = ConstNodeStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+    uint32_t classBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    ClassStack_t classes = ClassStackCtor(classBuffer, TREE_STACK_MIN_CAPACITY);
+
+    // post-order, node is pushed twice: before its operands and tagged by NULL after them
+    bool ok = ConstNodeStackPush(&stack, node);
+    while (stack.size && ok) {
+        const Node_t *current = ConstNodeStackPop(&stack);
+        if (current) {
+            ok = ConstNodeStackPush(&stack, current) && ConstNodeStackPush(&stack, NULL);
+            for (size_t idx = current->operandsCount; idx > 0 && ok; idx--)
+                ok = ConstNodeStackPush(&stack, current->operands[idx - 1]);
+            if (current->right && ok)
+                ok = ConstNodeStackPush(&stack, current->right);
+            if (current->left && ok)
+                ok = ConstNodeStackPush(&stack, current->left);
+            continue;
+        }
+
+        current = ConstNodeStackPop(&stack);
+        uint32_t eclass = EGRAPH_NONE;
+        if (current->type != OPERATOR)
+            eclass = addNode(egraph, current->type, current->value, EGRAPH_NONE, EGRAPH_NONE, 0);
+        else if (current->operandsCount) {
+            // operands are on top of stack in their order
+            size_t first = classes.size - current->operandsCount;
+            eclass = classes.data[first];
+            for (size_t idx = first + 1; idx < classes.size; idx++)
+                eclass = addOperation(egraph, current->value.op, eclass, classes.data[idx]);
+            classes.size = first;
+        } else {
+            uint32_t right = (current->right) ? ClassStackPop(&classes) : EGRAPH_NONE;
+            uint32_t left = ClassStackPop(&classes);
+            eclass = addOperation(egraph, current->value.op, left, right);
+        }
+
+        ok = eclass != EGRAPH_NONE && ClassStackPush(&classes, eclass);
+    }
+
+    uint32_t root = (ok && classes.size == 1) ? classes.data[0] : EGRAPH_NONE;
+    ConstNodeStackDtor(&stack);
+    ClassStackDtor(&classes);
+    return root;
+}
+
+/// @brief The cheapest e-node of every class by iterations until costs stop decreasing.
+/// Cost of class is bigger than costs of its children, so best e-nodes never make a cycle
+static void findBestNodes(EGraph_t *egraph, double *costs, uint32_t *best) {
+    for (size_t id = 0; id < egraph->nodesCount; id++) {
+        costs[id] = INFINITY;
+        best[id] = EGRAPH_NONE;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t id = 0; id < egraph->nodesCount; id++) {
+            const ENode_t *enode = egraph->nodes + id;
+            if (enode->duplicate)
+                continue;
+
+            double cost = (enode->type == OPERATOR) ? EGRAPH_OPERATION_COST[enode->value.op] : 0;
+            for (uint32_t idx = 0; idx < enode->childrenCount; idx++)
+                cost += costs[findClass(egraph, enode->children[idx])];
+
+            uint32_t eclass = findClass(egraph, enode->eclass);
+            if (cost < costs[eclass]) {
+                costs[eclass] = cost;
+                best[eclass] = (uint32_t) id;
+                changed = true;
+            }
+        }
+    }
+}
+
+/// @brief Frame of extraction, e-node is expanded after its children are built
+typedef struct {
+    uint32_t eclass;
+    bool childrenDone;
+} ExtractFrame_t;
+
+TREE_STACK_DEFINE(ExtractStack, ExtractFrame_t)
+
+static Node_t *extractTree(EGraph_t *egraph, uint32_t root) {
+    double *costs = (double *) calloc(egraph->nodesCount, sizeof(double));
+    uint32_t *best = (uint32_t *) calloc(egraph->nodesCount, sizeof(uint32_t));
+    if (costs && best)
+        findBestNodes(egraph, costs, best);
+    if (!costs || !best || best[findClass(egraph, root)] == EGRAPH_NONE) {
+        free(costs);
+        free(best);
+        return NULL;
+    }
+
+    ExtractFrame_t buffer[TREE_STACK_MIN_CAPACITY] = {};
+    ExtractStack_t stack = ExtractStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+    Node_t *nodesBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    NodeStack_t built = NodeStackCtor(nodesBuffer, TREE_STACK_MIN_CAPACITY);
+
+    ExtractFrame_t rootFrame = {findClass(egraph, root), false};
+    bool ok = ExtractStackPush(&stack, rootFrame);
+    while (stack.size && ok) {
+        ExtractFrame_t *frame = ExtractStackTop(&stack);
+        const ENode_t *enode = egraph->nodes + best[frame->eclass];
+
+        if (!frame->childrenDone) {
+            frame->childrenDone = true;
+            // the last child is built last and is on top of built nodes
+            for (uint32_t idx = enode->childrenCount; idx > 0 && ok; idx--) {
+                ExtractFrame_t child = {findClass(egraph, enode->children[idx - 1]), false};
+                ok = ExtractStackPush(&stack, child);
+            }
+            continue;
+        }
+        ExtractStackPop(&stack);
+
+        Node_t *right = (enode->childrenCount > 1) ? NodeStackPop(&built) : NULL;
+        Node_t *left  = (enode->childrenCount > 0) ? NodeStackPop(&built) : NULL;
+        Node_t *node = NULL;
+        if (enode->type == OPERATOR)
+            node = createNode(OPERATOR, enode->value.op, 0, left, right);
+        else if (enode->type == VARIABLE)
+            node = createNode(VARIABLE, enode->value.var, 0, NULL, NULL);
+        else
+            node = createNode(NUMBER, 0, enode->value.number, NULL, NULL);
+
+        if (!node) {
+            deleteTree(left);
+            deleteTree(right);
+        }
+        ok = node && NodeStackPush(&built, node);
+        if (node && !ok)
+            deleteTree(node);
+    }
+
+    Node_t *result = (ok && built.size == 1) ? NodeStackPop(&built) : NULL;
+    while (built.size)
+        deleteTree(NodeStackPop(&built));
+
+    ExtractStackDtor(&stack);
+    NodeStackDtor(&built);
+    free(costs);
+    free(best);
+    return result;
+}
+
+static void egraphDtor(EGraph_t *egraph) {
+    free(egraph->nodes);
+    free(egraph->unionFind);
+    free(egraph->info);
+    free(egraph->table);
+    free(egraph->classStart);
+    free(egraph->classNodes);
+    *egraph = {};
+}
+
+/// @brief One pass of all rules over e-nodes that exist before it
+static void applyAllRules(EGraph_t *egraph) {
+    if (!buildIndex(egraph)) {
+        egraph->memoryError = true;
+        return;
+    }
+
+    size_t count = egraph->nodesCount;
+    for (size_t id = 0; id < count && !egraph->memoryError && !egraph->limitReached; id++) {
+        if (id % EGRAPH_TIME_CHECK_PERIOD == 0 && timeIsOver(egraph))
+            break;
+        applyRules(egraph, (uint32_t) id);
+    }
+}
+
+double expressionCost(const Node_t *node) {
+    assert(node);
+
+    const Node_t *buffer[TREE_STACK_MIN_CAPACITY] = {};
+    ConstNodeStack_t stack = ConstNodeStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+
+    double cost = 0;
+    bool ok = ConstNodeStackPush(&stack, node);
+    while (stack.size && ok) {
+        const Node_t *current = ConstNodeStackPop(&stack);
+        if (current->type != OPERATOR)
+            continue;
+
+        size_t operations = (current->operandsCount) ? current->operandsCount - 1 : 1;
+        cost += EGRAPH_OPERATION_COST[current->value.op] * (double) operations;
+
+        for (size_t idx = 0; idx < current->operandsCount && ok; idx++)
+            ok = ConstNodeStackPush(&stack, current->operands[idx]);
+        if (current->left && ok)
+            ok = ConstNodeStackPush(&stack, current->left);
+        if (current->right && ok)
+            ok = ConstNodeStackPush(&stack, current->right);
+    }
+
+    if (!ok)
+        logPrint(L_ZERO, 1, "Not enough memory to count cost of tree[%p]\n", node);
+
+    ConstNodeStackDtor(&stack);
+    return cost;
+}
+
+Node_t *optimizeExpression(Node_t *node, EgraphLimits_t limits, EgraphStats_t *stats) {
+    assert(node);
+
+    EGraph_t egraph = {};
+    egraph.limits = limits;
+    egraph.startTime = egraphTimeMs();
+
+    double costBefore = expressionCost(node);
+    uint32_t root = importTree(&egraph, node);
+
+    size_t iterations = 0;
+    bool saturated = false;
+    if (root != EGRAPH_NONE) {
+        rebuild(&egraph);
+        while (iterations < limits.maxIterations && !egraph.memoryError && !egraph.limitReached &&
+               !timeIsOver(&egraph)) {
+            size_t nodesBefore = egraph.nodesCount, unionsBefore = egraph.unions;
+            applyAllRules(&egraph);
+            rebuild(&egraph);
+            iterations++;
+
+            if (egraph.nodesCount == nodesBefore && egraph.unions == unionsBefore) {
+                saturated = true;
+                break;
+            }
+        }
+    }
+
+    Node_t *result = (root != EGRAPH_NONE) ? extractTree(&egraph, root) : NULL;
+    double costAfter = (result) ? expressionCost(result) : costBefore;
+    if (result && costAfter < costBefore) {
+        result->parent = node->parent;
+        deleteTree(node);
+    } else {
+        // equal cost is not worth changing of tree
+        deleteTree(result);
+        result = node;
+        costAfter = costBefore;
+    }
+
+    size_t classes = 0;
+    for (size_t id = 0; id < egraph.nodesCount; id++)
+        classes += egraph.unionFind[id] == id;
+
+    logPrint(L_DEBUG, 0, "Egraph: %zu iterations, %zu e-nodes, %zu classes, cost %lg -> %lg%s\n",
+             iterations, egraph.nodesCount, classes, costBefore, costAfter, (saturated) ? ", saturated" : "");
+    if (egraph.memoryError)
+        logPrint(L_ZERO, 1, "Not enough memory to optimize tree[%p]\n", node);
+
+    if (stats) {
+        stats->costBefore = costBefore;
+        stats->costAfter = costAfter;
+        stats->iterations = iterations;
+        stats->nodes = egraph.nodesCount;
+        stats->classes = classes;
+        stats->saturated = saturated;
+    }
+
+    egraphDtor(&egraph);
+    return result;
+}
@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "exprCompiler.h"
+#include "threadPool.h"
+#include "exprGrid.h"
+
+/// @brief Bindings of axes variables of one worker
+typedef struct {
+    double *coords[GRID_MAX_AXES];          ///< GRID_TASK_POINTS coordinates for every axis
+    TungstenStatus_t status;
+} GridWorker_t;
+
+typedef struct {
+    TungstenContext_t *context;
+    const CompiledExpr_t *compiled;
+
+    const GridAxis_t *axes;
+    size_t axesCount;
+    double steps[GRID_MAX_AXES];
+
+    size_t pointsCount;
+    double *result;
+
+    GridWorker_t *workers;
+} GridJob_t;
+
+static void gridTask(void *arg, size_t task, size_t worker) {
+    GridJob_t *job = (GridJob_t *) arg;
+    GridWorker_t *own = job->workers + worker;
+
+    size_t offset = task * GRID_TASK_POINTS,
+           count  = job->pointsCount - offset;
+    if (count > GRID_TASK_POINTS)
+        count = GRID_TASK_POINTS;
+
+    // index of the first point along every axis, then moving through points like odometer
+    size_t indices[GRID_MAX_AXES] = {};
+    size_t rest = offset;
+    for (size_t axis = 0; axis < job->axesCount; axis++) {
+        indices[axis] = rest % job->axes[axis].count;
+        rest /= job->axes[axis].count;
+    }
+
+    BatchVariable_t inputs[GRID_MAX_AXES] = {};
+    for (size_t axis = 0; axis < job->axesCount; axis++) {
+        inputs[axis].var = job->axes[axis].var;
+        inputs[axis].values = own->coords[axis];
+    }
+
+    for (size_t point = 0; point < count; point++) {
+        for (size_t axis = 0; axis < job->axesCount; axis++)
+            own->coords[axis][point] = job->axes[axis].min + job->steps[axis] * (double) indices[axis];
+
+        for (size_t axis = 0; axis < job->axesCount; axis++) {
+            if (++indices[axis] < job->axes[axis].count)
+                break;
+            indices[axis] = 0;
+        }
+    }
+
+    TungstenStatus_t status = evaluateBatch(job->context, job->compiled, inputs, job->axesCount,
+                                            job->result + offset, count);
+    if (status != TA_SUCCESS)
+        own->status = status;
+}
+
+TungstenStatus_t evaluateGrid(ThreadPool_t *pool, TungstenContext_t *context, const CompiledExpr_t *compiled,
+                              const GridAxis_t *axes, size_t axesCount, double *result) {
+    assert(pool);
+    assert(context);
+    assert(compiled);
+    assert(axes);
+    assert(result);
+
+    if (axesCount == 0 || axesCount > GRID_MAX_AXES) {
+        logPrint(L_ZERO, 1, "Grid evaluation: %zu axes, supported 1..%zu\n", axesCount, GRID_MAX_AXES);
+        return TA_NULL_PTR;
+    }
+
+    GridJob_t job = {context, compiled, axes, axesCount};
+    job.pointsCount = 1;
+    for (size_t axis = 0; axis < axesCount; axis++) {
+        job.steps[axis] = (axes[axis].max - axes[axis].min) / (double) axes[axis].count;
+        job.pointsCount *= axes[axis].count;
+    }
+    job.result = result;
+
+    if (job.pointsCount == 0)
+        return TA_SUCCESS;
+
+    // coordinates of all workers are in one allocation
+    job.workers = (GridWorker_t *) calloc(pool->threadsCount, sizeof(GridWorker_t));
+    double *coordsMemory = (double *) calloc(pool->threadsCount * axesCount * GRID_TASK_POINTS, sizeof(double));
+    if (!job.workers || !coordsMemory) {
+        free(job.workers);
+        free(coordsMemory);
+        return TA_MEMORY_ERROR;
+    }
+
+    for (size_t worker = 0; worker < pool->threadsCount; worker++) {
+        for (size_t axis = 0; axis < axesCount; axis++)
+            job.workers[worker].coords[axis] = coordsMemory + (worker * axesCount + axis) * GRID_TASK_POINTS;
+    }
+
+    size_t tasksCount = (job.pointsCount + GRID_TASK_POINTS - 1) / GRID_TASK_POINTS;
+    TungstenStatus_t status = threadPoolRun(pool, gridTask, &job, tasksCount);
+
+    for (size_t worker = 0; worker < pool->threadsCount && status == TA_SUCCESS; worker++)
+        status = job.workers[worker].status;
+
+    free(coordsMemory);
+    free(job.workers);
+    return status;
+}
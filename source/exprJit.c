@@ -0,0 +1,337 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "exprCompiler.h"
+#include "exprJit.h"
+
+#if JIT_SUPPORTED
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+Generated code layout:
+    push rbx                ; rbx = variables, callee-saved across libm calls
+    mov  rbx, rdi
+    sub  rsp, frameSize     ; value stack, rsp is 16-byte aligned for calls
+    ...
+    add  rsp, frameSize
+    pop  rbx
+    ret
+Top of value stack is always kept in xmm0, other values are in slots [rsp + 8 * idx]
+*/
+
+typedef struct {
+    uint8_t *bytes;
+    size_t size;
+    size_t capacity;
+    bool failed;
+} CodeBuffer_t;
+
+const size_t JIT_START_CAPACITY = 256;
+
+static void emitBytes(CodeBuffer_t *buf, const void *bytes, size_t count) {
+    if (buf->failed) return;
+
+    if (buf->size + count > buf->capacity) {
+        size_t newCapacity = (buf->capacity) ? buf->capacity * 2 : JIT_START_CAPACITY;
+        while (newCapacity < buf->size + count)
+            newCapacity *= 2;
+
+        uint8_t *newBytes = (uint8_t *) realloc(buf->bytes, newCapacity);
+        if (!newBytes) {
+            buf->failed = true;
+            return;
+        }
+        buf->bytes = newBytes;
+        buf->capacity = newCapacity;
+    }
+
+    memcpy(buf->bytes + buf->size, bytes, count);
+    buf->size += count;
+}
+
+// opcodes are static, so emitting functions have no small local arrays
+#define EMIT_(...)                                          \
+    do {                                                    \
+        static const uint8_t code_[] = {__VA_ARGS__};       \
+        emitBytes(buf, code_, sizeof(code_));               \
+    } while (0)
+
+static void emitImm32(CodeBuffer_t *buf, uint32_t imm) {
+    emitBytes(buf, &imm, sizeof(imm));
+}
+
+/// movsd [rsp + 8 * slot], xmm0
+static void emitStoreSlot(CodeBuffer_t *buf, size_t slot) {
+    EMIT_(0xF2, 0x0F, 0x11, 0x84, 0x24);
+    emitImm32(buf, (uint32_t) (slot * sizeof(double)));
+}
+
+/// movsd xmm0, [rsp + 8 * slot]
+static void emitLoadSlot(CodeBuffer_t *buf, size_t slot) {
+    EMIT_(0xF2, 0x0F, 0x10, 0x84, 0x24);
+    emitImm32(buf, (uint32_t) (slot * sizeof(double)));
+}
+
+/// mov rax, number; movq xmm0, rax
+static void emitLoadNumber(CodeBuffer_t *buf, double number) {
+    EMIT_(0x48, 0xB8);
+    emitBytes(buf, &number, sizeof(number));
+    EMIT_(0x66, 0x48, 0x0F, 0x6E, 0xC0);
+}
+
+/// movsd xmm0, [rbx + sizeof(variable_t) * var]
+static void emitLoadVariable(CodeBuffer_t *buf, int var) {
+    EMIT_(0xF2, 0x0F, 0x10, 0x83);
+    emitImm32(buf, (uint32_t) ((size_t) var * sizeof(variable_t) + offsetof(variable_t, number)));
+}
+
+typedef double (*UnaryFunction_t)(double);
+typedef double (*BinaryFunction_t)(double, double);
+
+/// mov rax, address; call rax
+static void emitCallAddress(CodeBuffer_t *buf, uint64_t address) {
+    EMIT_(0x48, 0xB8);
+    emitBytes(buf, &address, sizeof(address));
+    EMIT_(0xFF, 0xD0);
+}
+
+// function pointers are copied bytewise: casts between them and integers are conditionally-supported
+static void emitCallUnary(CodeBuffer_t *buf, UnaryFunction_t function) {
+    uint64_t address = 0;
+    static_assert(sizeof(function) == sizeof(address), "Function pointer must fit in imm64");
+    memcpy(&address, &function, sizeof(function));
+    emitCallAddress(buf, address);
+}
+
+static void emitCallBinary(CodeBuffer_t *buf, BinaryFunction_t function) {
+    uint64_t address = 0;
+    static_assert(sizeof(function) == sizeof(address), "Function pointer must fit in imm64");
+    memcpy(&address, &function, sizeof(function));
+    emitCallAddress(buf, address);
+}
+
+/// xmm1 = xmm0 (right operand), xmm0 = left operand from slot
+static void emitBinaryOperands(CodeBuffer_t *buf, size_t leftSlot) {
+    EMIT_(0x66, 0x0F, 0x28, 0xC8);
+    emitLoadSlot(buf, leftSlot);
+}
+
+static UnaryFunction_t unaryFunction(enum InstrCode code) {
+    UnaryFunction_t function = NULL;
+    switch(code) {
+        case INSTR_SIN:  function = sin;  break;
+        case INSTR_COS:  function = cos;  break;
+        case INSTR_SINH: function = sinh; break;
+        case INSTR_COSH: function = cosh; break;
+        case INSTR_TAN:  function = tan;  break;
+        case INSTR_CTG:  function = tan;  break;
+        case INSTR_LOGN: function = log;  break;
+        case INSTR_ADD:
+        case INSTR_SUB:
+        case INSTR_MUL:
+        case INSTR_DIV:
+        case INSTR_POW:
+        case INSTR_LOG:
+        case INSTR_NUMBER:
+        case INSTR_VARIABLE:
+        default:
+            break;
+    }
+    return function;
+}
+
+/// @brief Translate postfix program into machine code
+/// @return false if program contains unsupported instruction
+static bool emitProgram(CodeBuffer_t *buf, const CompiledExpr_t *compiled, size_t frameSize) {
+    BinaryFunction_t powFunction = pow;
+    UnaryFunction_t  logFunction = log;
+
+    EMIT_(0x53);                            // push rbx
+    EMIT_(0x48, 0x89, 0xFB);                // mov rbx, rdi
+    EMIT_(0x48, 0x81, 0xEC);                // sub rsp, frameSize
+    emitImm32(buf, (uint32_t) frameSize);
+
+    size_t depth = 0;
+    for (size_t idx = 0; idx < compiled->size; idx++) {
+        const Instruction_t *instr = compiled->code + idx;
+        switch(instr->code) {
+            case INSTR_NUMBER:
+            case INSTR_VARIABLE:
+                if (depth > 0)
+                    emitStoreSlot(buf, depth - 1);
+
+                if (instr->code == INSTR_NUMBER)
+                    emitLoadNumber(buf, instr->arg.number);
+                else
+                    emitLoadVariable(buf, instr->arg.var);
+
+                depth++;
+                break;
+            case INSTR_ADD:
+                emitBinaryOperands(buf, depth - 2);
+                EMIT_(0xF2, 0x0F, 0x58, 0xC1);  // addsd xmm0, xmm1
+                depth--;
+                break;
+            case INSTR_SUB:
+                emitBinaryOperands(buf, depth - 2);
+                EMIT_(0xF2, 0x0F, 0x5C, 0xC1);  // subsd xmm0, xmm1
+                depth--;
+                break;
+            case INSTR_MUL:
+                emitBinaryOperands(buf, depth - 2);
+                EMIT_(0xF2, 0x0F, 0x59, 0xC1);  // mulsd xmm0, xmm1
+                depth--;
+                break;
+            case INSTR_DIV:
+                emitBinaryOperands(buf, depth - 2);
+                EMIT_(0xF2, 0x0F, 0x5E, 0xC1);  // divsd xmm0, xmm1
+                depth--;
+                break;
+            case INSTR_POW:
+                emitBinaryOperands(buf, depth - 2);
+                emitCallBinary(buf, powFunction);
+                depth--;
+                break;
+            case INSTR_LOG:
+                // log(right) / log(left): right goes to its own slot while log(left) is computed
+                emitStoreSlot(buf, depth - 1);
+                emitLoadSlot(buf, depth - 2);
+                emitCallUnary(buf, logFunction);
+                emitStoreSlot(buf, depth - 2);
+                emitLoadSlot(buf, depth - 1);
+                emitCallUnary(buf, logFunction);
+                EMIT_(0xF2, 0x0F, 0x5E, 0x84, 0x24);    // divsd xmm0, [rsp + 8 * (depth - 2)]
+                emitImm32(buf, (uint32_t) ((depth - 2) * sizeof(double)));
+                depth--;
+                break;
+            case INSTR_CTG:
+                emitCallUnary(buf, unaryFunction(instr->code));
+                EMIT_(0x66, 0x0F, 0x28, 0xC8);  // movapd xmm1, xmm0
+                emitLoadNumber(buf, 1.0);
+                EMIT_(0xF2, 0x0F, 0x5E, 0xC1);  // divsd xmm0, xmm1
+                break;
+            case INSTR_SIN:
+            case INSTR_COS:
+            case INSTR_SINH:
+            case INSTR_COSH:
+            case INSTR_TAN:
+            case INSTR_LOGN:
+                emitCallUnary(buf, unaryFunction(instr->code));
+                break;
+            default:
+                logPrint(L_ZERO, 1, "JIT: instruction %d is not supported\n", instr->code);
+                return false;
+        }
+    }
+
+    EMIT_(0x48, 0x81, 0xC4);                // add rsp, frameSize
+    emitImm32(buf, (uint32_t) frameSize);
+    EMIT_(0x5B);                            // pop rbx
+    EMIT_(0xC3);                            // ret
+
+    return !buf->failed;
+}
+
+#undef EMIT_
+
+static TungstenStatus_t mapCode(JitExpr_t *jit, const CodeBuffer_t *buf) {
+    size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+    size_t mapSize = (buf->size + pageSize - 1) / pageSize * pageSize;
+
+    void *code = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+        return TA_MEMORY_ERROR;
+
+    memcpy(code, buf->bytes, buf->size);
+    if (mprotect(code, mapSize, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, mapSize);
+        return TA_MEMORY_ERROR;
+    }
+
+    jit->code = code;
+    jit->codeSize = mapSize;
+    static_assert(sizeof(jit->function) == sizeof(code), "Code pointer must fit in function pointer");
+    memcpy(&jit->function, &code, sizeof(jit->function));
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t compileJit(const Node_t *expr, JitExpr_t *jit) {
+    assert(expr);
+    assert(jit);
+
+    *jit = {};
+    jit->expr = expr;
+
+    CompiledExpr_t compiled = {};
+    if (compileExpression(expr, &compiled) != TA_SUCCESS) {
+        logPrint(L_ZERO, 1, "JIT: failed to compile expression[%p], using evaluate()\n", expr);
+        return TA_SUCCESS;
+    }
+
+    //each slot is 8 bytes, rsp must stay 16-byte aligned
+    size_t frameSize = (compiled.stackSize * sizeof(double) + 15) / 16 * 16;
+    CodeBuffer_t buf = {};
+
+    if (!emitProgram(&buf, &compiled, frameSize) || mapCode(jit, &buf) != TA_SUCCESS) {
+        logPrint(L_ZERO, 1, "JIT: failed to generate code for expression[%p], using evaluate()\n", expr);
+        jit->function = NULL;
+    } else {
+        logPrint(L_DEBUG, 0, "JIT: expression[%p] -> %zu bytes of code\n", expr, buf.size);
+    }
+
+    free(buf.bytes);
+    deleteCompiled(&compiled);
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t deleteJit(JitExpr_t *jit) {
+    if (!jit) return TA_NULL_PTR;
+
+    if (jit->code)
+        munmap(jit->code, jit->codeSize);
+    *jit = {};
+
+    return TA_SUCCESS;
+}
+
+#else
+
+TungstenStatus_t compileJit(const Node_t *expr, JitExpr_t *jit) {
+    assert(expr);
+    assert(jit);
+
+    *jit = {};
+    jit->expr = expr;
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t deleteJit(JitExpr_t *jit) {
+    if (!jit) return TA_NULL_PTR;
+
+    *jit = {};
+    return TA_SUCCESS;
+}
+
+#endif
+
+double evaluateJit(TungstenContext_t *context, const JitExpr_t *jit) {
+    assert(context);
+    assert(jit);
+
+    if (jit->function)
+        return jit->function(context->variables);
+
+    return evaluate(context, jit->expr);
+}
@@ -4,12 +4,14 @@
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
 
 #include "tex.h"
 #include "hashTable.h"
 #include "logger.h"
 #include "exprTree.h"
 #include "exprParser.h"
+#include "treeStack.h"
 
 static Node_t *GetGrammar(ParseContext_t *context, TungstenContext_t *tungstenContext);
 
@@ -20,12 +22,7 @@ Node_t *parseExpression(TungstenContext_t *tungstenContext, const char *expressi
 }
 
 static Node_t *GetExpr(ParseContext_t *context, TungstenContext_t *tungstenContext);
-static Node_t *GetMulPr(ParseContext_t *context, TungstenContext_t *tungstenContext);
-static Node_t *GetPowPr(ParseContext_t *context, TungstenContext_t *tungstenContext);
 
-static Node_t *GetPrimary(ParseContext_t *context, TungstenContext_t *tungstenContext);
-
-static Node_t *GetFunc(ParseContext_t *context, TungstenContext_t *tungstenContext, const char *buffer);
 static Node_t *GetVar(ParseContext_t *context, TungstenContext_t *tungstenContext, const char *buffer);
 
 static Node_t *GetNum(ParseContext_t *context, TungstenContext_t *tungstenContext);
@@ -61,67 +58,6 @@ Node_t *GetGrammar(ParseContext_t *context, TungstenContext_t *tungstenContext)
     }
 }
 
-Node_t *GetExpr(ParseContext_t *context, TungstenContext_t *tungstenContext) {
-    logPrint(L_EXTRA, 0, "%s: %s\n\n", __PRETTY_FUNCTION__, context->pointer);
-
-    Node_t *left = GetMulPr(context, tungstenContext);
-    if (context->status != PARSE_SUCCESS)
-        return left;
-
-    while (*context->pointer == '+' || *context->pointer == '-') {
-        char op = *context->pointer;
-        movePointer(context);
-        Node_t *right = GetMulPr(context, tungstenContext);
-
-        if (context->status != PARSE_SUCCESS)
-            return left;
-
-        left = createNode(OPERATOR, (op == '+') ? ADD : SUB, 0, left, right);
-    }
-
-    return left;
-}
-
-Node_t *GetMulPr(ParseContext_t *context, TungstenContext_t *tungstenContext) {
-    logPrint(L_EXTRA, 0, "%s: %s\n\n", __PRETTY_FUNCTION__, context->pointer);
-
-    Node_t *left = GetPowPr(context, tungstenContext);
-    if (context->status != PARSE_SUCCESS)
-        return left;
-
-    while (*context->pointer == '*' || *context->pointer == '/') {
-        char op = *context->pointer;
-        movePointer(context);
-        Node_t *right = GetPowPr(context, tungstenContext);
-
-        if (context->status != PARSE_SUCCESS)
-            return left;
-
-        left = createNode(OPERATOR, (op == '*') ? MUL : DIV, 0, left, right);
-    }
-
-    return left;
-}
-
-Node_t *GetPowPr(ParseContext_t *context, TungstenContext_t *tungstenContext) {
-    logPrint(L_EXTRA, 0, "%s: %s\n\n", __PRETTY_FUNCTION__, context->pointer);
-
-    Node_t *left = GetPrimary(context, tungstenContext);
-    if (context->status != PARSE_SUCCESS)
-        return left;
-
-    if (*context->pointer == '^') {
-        movePointer(context);
-        Node_t *right = GetPowPr(context, tungstenContext);
-        if (context->status != PARSE_SUCCESS)
-            return left;
-
-        left = createNode(OPERATOR, POW, 0, left, right);
-    }
-
-    return left;
-}
-
 static size_t GetId(char *buffer, const char *str) {
     assert(buffer);
     assert(str);
@@ -141,90 +77,219 @@ static size_t GetId(char *buffer, const char *str) {
     return buffer - startPos;
 }
 
-Node_t *GetPrimary(ParseContext_t *context, TungstenContext_t *tungstenContext) {
-    logPrint(L_EXTRA, 0, "%s: %s\n\n", __PRETTY_FUNCTION__, context->pointer);
-
-    if (*context->pointer == '(') {
-        movePointer(context);
-        Node_t *val = GetExpr(context, tungstenContext);
-        if (context->status != PARSE_SUCCESS)
-            return val;
+enum ParseMarker {
+    PARSE_BINARY,           ///< Binary operator waiting for its right operand
+    PARSE_BRACKET,          ///< '(' of primary expression
+    PARSE_FUNCTION,         ///< Function name with its '('
+};
+
+/// @brief Entry of operator stack of parser
+typedef struct {
+    enum ParseMarker marker;
+    enum OperatorType op;
+} ParseOperator_t;
+
+TREE_STACK_DEFINE(ParseOperStack, ParseOperator_t)
+TREE_STACK_DEFINE(ParseNodeStack, Node_t *)
+
+/// @brief Binding power of binary operator, see grammar in exprParser.h
+static int binaryPrecedence(enum OperatorType op) {
+    switch(op) {
+        case ADD: case SUB: return 0;
+        case MUL: case DIV: return 1;
+        case POW:           return 2;
+        case SIN: case COS: case SINH: case COSH:
+        case TAN: case CTG: case LOG:  case LOGN:
+        default:            return -1;
+    }
+}
 
+static bool binaryFromChar(char symbol, enum OperatorType *op) {
+    switch(symbol) {
+        case '+': *op = ADD; return true;
+        case '-': *op = SUB; return true;
+        case '*': *op = MUL; return true;
+        case '/': *op = DIV; return true;
+        case '^': *op = POW; return true;
+        default:             return false;
+    }
+}
 
-        if (*context->pointer != ')')
-            SyntaxError(context, val, "GetPrimary: expected ')', got %c\n", *context->pointer);
-        else {
-            movePointer(context);
-            return val;
+static bool findFunction(const char *buffer, enum OperatorType *op) {
+    for (unsigned idx = 0; idx < sizeof(operators) / sizeof(operators[0]); idx++) {
+        if (!operators[idx].binary && strcmp(buffer, operators[idx].str) == 0) {
+            *op = operators[idx].opCode;
+            return true;
         }
     }
+    return false;
+}
 
-    Node_t *val = GetNum(context, tungstenContext);
-
-    if (context->status == PARSE_SUCCESS) return val;
-    else context->status = PARSE_SUCCESS;
-
-    char buffer[PARSER_BUFFER_SIZE] = "";
-    size_t idLength = GetId(buffer, context->pointer);
+/// @brief Pop operator and its operands, push resulting node
+static bool reduceOperator(ParseOperStack_t *operStack, ParseNodeStack_t *nodeStack) {
+    ParseOperator_t oper = ParseOperStackPop(operStack);
+
+    Node_t *left = NULL, *right = NULL;
+    if (oper.marker == PARSE_BINARY)
+        right = ParseNodeStackPop(nodeStack);
+    left = ParseNodeStackPop(nodeStack);
+
+    Node_t *node = NULL;
+    if (oper.marker == PARSE_BINARY && operators[oper.op].commutative) {
+        // chain a + b + c is collected into one n-ary node, operands are still evaluated from left to right
+        if (left->type == OPERATOR && left->value.op == oper.op && left->operandsCount) {
+            if (appendOperand(left, right) == TA_SUCCESS)
+                return ParseNodeStackPush(nodeStack, left);
+        } else {
+            Node_t *operands[] = {left, right};
+            node = createNaryNode(oper.op, operands, 2);
+        }
+    } else
+        node = createNode(OPERATOR, oper.op, 0, left, right);
 
-    context->pointer += idLength;
+    if (!node) {
+        deleteTree(left);
+        deleteTree(right);
+        return false;
+    }
 
-    val = GetFunc(context, tungstenContext, buffer);
+    return ParseNodeStackPush(nodeStack, node);
+}
 
-    if (context->status != SOFT_ERROR) return val;
-    else context->status = PARSE_SUCCESS;
+/// @brief Reduce binary operators which bind stronger than next operator
+/// @param precedence Precedence of next operator or -1 to reduce all binary operators
+static bool reduceBinary(ParseOperStack_t *operStack, ParseNodeStack_t *nodeStack, int precedence, bool rightAssoc) {
+    while (operStack->size) {
+        ParseOperator_t *top = ParseOperStackTop(operStack);
+        if (top->marker != PARSE_BINARY)
+            break;
 
-    val = GetVar(context, tungstenContext, buffer);
+        int topPrecedence = binaryPrecedence(top->op);
+        if (topPrecedence < precedence || (topPrecedence == precedence && rightAssoc))
+            break;
 
-    if (context->status != PARSE_SUCCESS)
-        SyntaxError(context, val, "GetPrimary: expected (expr), function(), Variable or Number, got neither\n");
+        if (!reduceOperator(operStack, nodeStack))
+            return false;
+    }
+    return true;
+}
 
-    return val;
+static void clearParserStacks(ParseOperStack_t *operStack, ParseNodeStack_t *nodeStack) {
+    for (size_t idx = 0; idx < nodeStack->size; idx++)
+        deleteTree(nodeStack->data[idx]);
 
+    ParseNodeStackDtor(nodeStack);
+    ParseOperStackDtor(operStack);
 }
 
+#define ParserError(...)                                    \
+    do {                                                    \
+        clearParserStacks(&operStack, &nodeStack);          \
+        SyntaxError(context, NULL, __VA_ARGS__);            \
+    } while(0)
 
-Node_t *GetFunc(ParseContext_t *context, TungstenContext_t *tungstenContext, const char *buffer) {
-    logPrint(L_EXTRA, 0, "%s: %s\nBuffer: %s\n", __PRETTY_FUNCTION__, context->pointer, buffer);
+/// @brief Operator precedence parser with explicit stacks, so nesting depth of expression is unlimited.
+/// Builds the same trees as recursive descent over the grammar in exprParser.h
+Node_t *GetExpr(ParseContext_t *context, TungstenContext_t *tungstenContext) {
+    logPrint(L_EXTRA, 0, "%s: %s\n\n", __PRETTY_FUNCTION__, context->pointer);
 
+    ParseOperator_t operBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    Node_t *nodeBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    ParseOperStack_t operStack = ParseOperStackCtor(operBuffer, TREE_STACK_MIN_CAPACITY);
+    ParseNodeStack_t nodeStack = ParseNodeStackCtor(nodeBuffer, TREE_STACK_MIN_CAPACITY);
+
+    bool expectOperand = true;
+    while (true) {
+        if (expectOperand) {
+            // Primary::= '(' Expr ')' | Func | Var | Num
+            if (*context->pointer == '(') {
+                ParseOperator_t bracket = {PARSE_BRACKET};
+                if (!ParseOperStackPush(&operStack, bracket))
+                    ParserError("GetExpr: not enough memory\n");
+
+                movePointer(context);
+                continue;
+            }
+
+            Node_t *val = GetNum(context, tungstenContext);
+            if (context->status != PARSE_SUCCESS) {
+                context->status = PARSE_SUCCESS;
+
+                char buffer[PARSER_BUFFER_SIZE] = "";
+                size_t idLength = GetId(buffer, context->pointer);
+                context->pointer += idLength;
+
+                ParseOperator_t function = {PARSE_FUNCTION};
+                if (findFunction(buffer, &function.op)) {
+                    logPrint(L_EXTRA, 0, "%s: found operator %s\n\n", __PRETTY_FUNCTION__, buffer);
+                    if (*context->pointer != '(')
+                        ParserError("GetFunc: expected '(' but found '%c'\n", *context->pointer);
+
+                    if (!ParseOperStackPush(&operStack, function))
+                        ParserError("GetExpr: not enough memory\n");
+
+                    movePointer(context);
+                    continue;
+                }
+
+                val = GetVar(context, tungstenContext, buffer);
+                if (context->status != PARSE_SUCCESS)
+                    ParserError("GetPrimary: expected (expr), function(), Variable or Number, got neither\n");
+            }
+
+            if (!val || !ParseNodeStackPush(&nodeStack, val)) {
+                deleteTree(val);
+                ParserError("GetExpr: not enough memory\n");
+            }
+            expectOperand = false;
+            continue;
+        }
 
-    Operator_t op = {};
+        enum OperatorType op = ADD;
+        if (binaryFromChar(*context->pointer, &op)) {
+            // only '^' is right associative
+            if (!reduceBinary(&operStack, &nodeStack, binaryPrecedence(op), op == POW))
+                ParserError("GetExpr: not enough memory\n");
 
-    bool foundOperator = false;
-    for (unsigned idx = 0; idx < sizeof(operators) / sizeof(operators[0]); idx++) {
-        if (strcmp(buffer, operators[idx].str) == 0) {
-            op = operators[idx];
-            foundOperator = true;
-            break;
+            ParseOperator_t binary = {PARSE_BINARY, op};
+            if (!ParseOperStackPush(&operStack, binary))
+                ParserError("GetExpr: not enough memory\n");
+
+            movePointer(context);
+            expectOperand = true;
+            continue;
         }
-    }
 
+        if (!reduceBinary(&operStack, &nodeStack, -1, false))
+            ParserError("GetExpr: not enough memory\n");
 
-    if (!foundOperator) {
-        logPrint(L_EXTRA, 0, "%s: no operators \n\n", __PRETTY_FUNCTION__);
-        context->status = SOFT_ERROR;
-        return NULL;
-    }
+        // ')' closes the innermost bracket or function, otherwise expression ends here
+        if (*context->pointer != ')' || operStack.size == 0)
+            break;
 
-    logPrint(L_EXTRA, 0, "%s: found operator %s\n\n", __PRETTY_FUNCTION__, op.str);
+        if (ParseOperStackTop(&operStack)->marker == PARSE_BRACKET)
+            ParseOperStackPop(&operStack);
+        else if (!reduceOperator(&operStack, &nodeStack))
+            ParserError("GetExpr: not enough memory\n");
 
-    if (*context->pointer != '(') {
-        SyntaxError(context, NULL, "GetFunc: expected '(' but found '%c'\n", *context->pointer);
+        movePointer(context);
     }
-    movePointer(context);
-    Node_t *val = GetExpr(context, tungstenContext);
-
-    if (context->status != PARSE_SUCCESS)
-        return val;
 
-    if (*context->pointer != ')') {
-        SyntaxError(context, NULL, "GetFunc: expected ')' but found '%c'\n", *context->pointer);
+    if (operStack.size) {
+        if (ParseOperStackTop(&operStack)->marker == PARSE_FUNCTION)
+            ParserError("GetFunc: expected ')' but found '%c'\n", *context->pointer);
+        else
+            ParserError("GetPrimary: expected ')', got %c\n", *context->pointer);
     }
-    movePointer(context);
 
-    return createNode(OPERATOR, op.opCode, 0, val, NULL);
+    assert(nodeStack.size == 1);
+    Node_t *result = ParseNodeStackPop(&nodeStack);
+    clearParserStacks(&operStack, &nodeStack);
+    return result;
 }
 
+#undef ParserError
+
 Node_t *GetVar(ParseContext_t *context, TungstenContext_t *tungstenContext, const char *buffer) {
     logPrint(L_EXTRA, 0, "%s: %s\nBuffer: '%s'\n", __PRETTY_FUNCTION__, context->pointer, buffer);
 
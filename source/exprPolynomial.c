@@ -0,0 +1,437 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "exprPolynomial.h"
+#include "treeStack.h"
+
+#include "treeDSL.h"
+
+static TungstenStatus_t reservePolynomial(Polynomial_t *poly, size_t degree) {
+    if (degree < poly->capacity)
+        return TA_SUCCESS;
+
+    size_t newCapacity = (poly->capacity * 2 > degree + 1) ? poly->capacity * 2 : degree + 1;
+    double *newCoefficients = (double *) realloc(poly->coefficients, newCapacity * sizeof(double));
+    if (!newCoefficients)
+        return TA_MEMORY_ERROR;
+
+    poly->coefficients = newCoefficients;
+    poly->capacity = newCapacity;
+    return TA_SUCCESS;
+}
+
+static void swapPolynomials(Polynomial_t *first, Polynomial_t *second) {
+    Polynomial_t temp = *first;
+    *first = *second;
+    *second = temp;
+}
+
+/// @brief Drop zero leading coefficients
+static void trimPolynomial(Polynomial_t *poly) {
+    while (poly->degree > 0 && isZero(poly->coefficients[poly->degree]))
+        poly->degree--;
+}
+
+static TungstenStatus_t setConstant(Polynomial_t *poly, double constant) {
+    TungstenStatus_t status = reservePolynomial(poly, 0);
+    if (status != TA_SUCCESS)
+        return status;
+
+    poly->coefficients[0] = constant;
+    poly->degree = 0;
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t polynomialCtor(Polynomial_t *poly, int variable, size_t capacityDegree) {
+    assert(poly);
+
+    *poly = {};
+    poly->variable = variable;
+    poly->coefficients = (double *) calloc(capacityDegree + 1, sizeof(double));
+    if (!poly->coefficients)
+        return TA_MEMORY_ERROR;
+
+    poly->capacity = capacityDegree + 1;
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t polynomialDtor(Polynomial_t *poly) {
+    if (!poly)
+        return TA_NULL_PTR;
+
+    free(poly->coefficients);
+    *poly = {};
+    return TA_SUCCESS;
+}
+
+double polynomialEvaluate(const Polynomial_t *poly, double x) {
+    assert(poly);
+    assert(poly->coefficients);
+
+    double value = poly->coefficients[poly->degree];
+    for (size_t power = poly->degree; power > 0; power--)
+        value = value * x + poly->coefficients[power - 1];
+    return value;
+}
+
+/// @brief result = first + sign * second, result can be one of arguments
+static TungstenStatus_t addScaled(const Polynomial_t *first, const Polynomial_t *second, double sign,
+                                  Polynomial_t *result) {
+    size_t firstDegree = first->degree, secondDegree = second->degree;
+    size_t degree = (firstDegree > secondDegree) ? firstDegree : secondDegree;
+    int variable = first->variable;
+
+    TungstenStatus_t status = reservePolynomial(result, degree);
+    if (status != TA_SUCCESS)
+        return status;
+
+    // coefficients are read through arguments after reservation, result can share them
+    for (size_t power = 0; power <= degree; power++) {
+        double firstCoef  = (power <= firstDegree)  ? first->coefficients[power]  : 0;
+        double secondCoef = (power <= secondDegree) ? second->coefficients[power] : 0;
+        result->coefficients[power] = firstCoef + sign * secondCoef;
+    }
+
+    result->variable = variable;
+    result->degree = degree;
+    trimPolynomial(result);
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t polynomialAdd(const Polynomial_t *first, const Polynomial_t *second, Polynomial_t *result) {
+    assert(first);
+    assert(second);
+    assert(result);
+
+    return addScaled(first, second, 1, result);
+}
+
+TungstenStatus_t polynomialMul(const Polynomial_t *first, const Polynomial_t *second, Polynomial_t *result) {
+    assert(first);
+    assert(second);
+    assert(result);
+    assert(result != first && result != second);
+
+    size_t degree = first->degree + second->degree;
+    if (degree > POLYNOMIAL_MAX_DEGREE)
+        return TA_SYNTAX_ERROR;
+
+    TungstenStatus_t status = reservePolynomial(result, degree);
+    if (status != TA_SUCCESS)
+        return status;
+
+    memset(result->coefficients, 0, (degree + 1) * sizeof(double));
+    for (size_t firstPower = 0; firstPower <= first->degree; firstPower++) {
+        double coef = first->coefficients[firstPower];
+        if (isZero(coef)) continue;
+        for (size_t secondPower = 0; secondPower <= second->degree; secondPower++)
+            result->coefficients[firstPower + secondPower] += coef * second->coefficients[secondPower];
+    }
+
+    result->variable = first->variable;
+    result->degree = degree;
+    trimPolynomial(result);
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t polynomialDerivative(const Polynomial_t *poly, Polynomial_t *result) {
+    assert(poly);
+    assert(result);
+
+    size_t degree = poly->degree;
+    TungstenStatus_t status = reservePolynomial(result, (degree) ? degree - 1 : 0);
+    if (status != TA_SUCCESS)
+        return status;
+
+    // ascending order: c[k] is read before it is overwritten when result is poly
+    for (size_t power = 1; power <= degree; power++)
+        result->coefficients[power - 1] = (double) power * poly->coefficients[power];
+
+    if (degree == 0)
+        result->coefficients[0] = 0;
+    result->variable = poly->variable;
+    result->degree = (degree) ? degree - 1 : 0;
+    return TA_SUCCESS;
+}
+
+/// @brief base = base ^ power by repeated squaring
+static TungstenStatus_t powerPolynomial(Polynomial_t *base, size_t power) {
+    if (base->degree * power > POLYNOMIAL_MAX_DEGREE)
+        return TA_SYNTAX_ERROR;
+
+    // c * x^k is raised directly, it is the most common base
+    bool monomial = true;
+    for (size_t idx = 0; idx < base->degree && monomial; idx++)
+        monomial = isZero(base->coefficients[idx]);
+    if (monomial) {
+        double coef = pow(base->coefficients[base->degree], (double) power);
+        size_t degree = base->degree * power;
+        TungstenStatus_t status = reservePolynomial(base, degree);
+        if (status != TA_SUCCESS)
+            return status;
+
+        memset(base->coefficients, 0, degree * sizeof(double));
+        base->coefficients[degree] = coef;
+        base->degree = degree;
+        return TA_SUCCESS;
+    }
+
+    Polynomial_t result = {}, square = {};
+    TungstenStatus_t status = polynomialCtor(&result, base->variable, base->degree * power);
+    if (status == TA_SUCCESS)
+        status = polynomialCtor(&square, base->variable, base->degree * power);
+    if (status == TA_SUCCESS)
+        result.coefficients[0] = 1;
+
+    for (; power && status == TA_SUCCESS; power >>= 1) {
+        if (power & 1) {
+            status = polynomialMul(&result, base, &square);
+            swapPolynomials(&result, &square);
+        }
+        if (power > 1 && status == TA_SUCCESS) {
+            status = polynomialMul(base, base, &square);
+            swapPolynomials(base, &square);
+        }
+    }
+
+    if (status == TA_SUCCESS)
+        swapPolynomials(base, &result);
+    polynomialDtor(&result);
+    polynomialDtor(&square);
+    return status;
+}
+
+/// @brief Combine polynomials of operands of node, result replaces the first operand
+/// @param operands Polynomials of operands, all but the first are left to caller
+static TungstenStatus_t combineOperands(const Node_t *node, Polynomial_t *operands, size_t count) {
+    Polynomial_t *result = operands;
+    TungstenStatus_t status = TA_SUCCESS;
+
+    switch (node->value.op) {
+        case ADD:
+            for (size_t idx = 1; idx < count && status == TA_SUCCESS; idx++)
+                status = addScaled(result, operands + idx, 1, result);
+            return status;
+        case SUB:
+            return addScaled(result, operands + 1, -1, result);
+        case MUL:
+        {
+            Polynomial_t product = {};
+            for (size_t idx = 1; idx < count && status == TA_SUCCESS; idx++) {
+                status = polynomialMul(result, operands + idx, &product);
+                swapPolynomials(result, &product);
+            }
+            polynomialDtor(&product);
+            return status;
+        }
+        case DIV:
+        {
+            // only division by nonzero constant keeps polynomial
+            double divisor = operands[1].coefficients[0];
+            if (operands[1].degree != 0 || isZero(divisor))
+                return TA_SYNTAX_ERROR;
+
+            for (size_t power = 0; power <= result->degree; power++)
+                result->coefficients[power] /= divisor;
+            return TA_SUCCESS;
+        }
+        case POW:
+        {
+            double exponent = operands[1].coefficients[0];
+            if (operands[1].degree != 0)
+                return TA_SYNTAX_ERROR;
+            if (result->degree == 0)
+                return setConstant(result, calculateOperation(POW, result->coefficients[0], exponent));
+            if (exponent < 0 || !isZero(exponent - floor(exponent)) || exponent > (double) POLYNOMIAL_MAX_DEGREE)
+                return TA_SYNTAX_ERROR;
+
+            return powerPolynomial(result, (size_t) exponent);
+        }
+        case SIN:
+        case COS:
+        case SINH:
+        case COSH:
+        case TAN:
+        case CTG:
+        case LOG:
+        case LOGN:
+        default:
+            return TA_SYNTAX_ERROR;
+    }
+}
+
+static bool isPolynomialOperator(enum OperatorType op) {
+    return op == ADD || op == SUB || op == MUL || op == DIV || op == POW;
+}
+
+TREE_STACK_DEFINE(PolyNodeStack, const Node_t *)
+TREE_STACK_DEFINE(PolyStack, Polynomial_t)
+
+TungstenStatus_t polynomialFromTree(const Node_t *node, int variable, Polynomial_t *poly) {
+    assert(node);
+    assert(poly);
+
+    const Node_t *nodeBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    PolyNodeStack_t stack = PolyNodeStackCtor(nodeBuffer, TREE_STACK_MIN_CAPACITY);
+    Polynomial_t polyBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    PolyStack_t values = PolyStackCtor(polyBuffer, TREE_STACK_MIN_CAPACITY);
+
+    TungstenStatus_t status = (PolyNodeStackPush(&stack, node)) ? TA_SUCCESS : TA_MEMORY_ERROR;
+    // post-order, operator is pushed twice: before its operands and tagged by NULL after them
+    while (stack.size && status == TA_SUCCESS) {
+        const Node_t *current = PolyNodeStackPop(&stack);
+        Polynomial_t value = {};
+
+        if (current) {
+            if (current->type == OPERATOR && current->varMask) {
+                if (!isPolynomialOperator(current->value.op)) {
+                    status = TA_SYNTAX_ERROR;
+                    break;
+                }
+
+                bool ok = PolyNodeStackPush(&stack, current) && PolyNodeStackPush(&stack, NULL);
+                for (size_t idx = current->operandsCount; idx > 0 && ok; idx--)
+                    ok = PolyNodeStackPush(&stack, current->operands[idx - 1]);
+                if (current->right && ok)
+                    ok = PolyNodeStackPush(&stack, current->right);
+                if (current->left && ok)
+                    ok = PolyNodeStackPush(&stack, current->left);
+                status = (ok) ? TA_SUCCESS : TA_MEMORY_ERROR;
+                continue;
+            }
+
+            if (current->type == VARIABLE && current->value.var != variable) {
+                status = TA_SYNTAX_ERROR;
+                break;
+            }
+
+            status = polynomialCtor(&value, variable, 1);
+            if (status != TA_SUCCESS)
+                break;
+
+            if (current->type == VARIABLE) {
+                value.coefficients[1] = 1;
+                value.degree = 1;
+            } else {
+                // subtree without variables is a number
+                double noValues = 0;
+                value.coefficients[0] = evaluateWith(current, &noValues);
+            }
+        } else {
+            current = PolyNodeStackPop(&stack);
+            size_t count = (current->operandsCount) ? current->operandsCount : 2;
+            Polynomial_t *operands = values.data + values.size - count;
+
+            status = combineOperands(current, operands, count);
+            for (size_t idx = 1; idx < count; idx++)
+                polynomialDtor(operands + idx);
+            values.size -= count;
+            value = operands[0];
+        }
+
+        if (status == TA_SUCCESS && !PolyStackPush(&values, value))
+            status = TA_MEMORY_ERROR;
+        if (status != TA_SUCCESS)
+            polynomialDtor(&value);
+    }
+
+    if (status == TA_SUCCESS) {
+        assert(values.size == 1);
+        polynomialDtor(poly);
+        *poly = values.data[0];
+        values.size = 0;
+    }
+
+    for (size_t idx = 0; idx < values.size; idx++)
+        polynomialDtor(values.data + idx);
+    PolyStackDtor(&values);
+    PolyNodeStackDtor(&stack);
+    return status;
+}
+
+/// @brief c * x^power, factor 1 is omitted
+static Node_t *termTree(double coef, int variable, size_t power) {
+    if (power == 0)
+        return NUM_(coef);
+
+    Node_t *monomial = VAR_(variable);
+    if (power > 1)
+        monomial = JOIN_(POW, monomial, NUM_((double) power));
+    if (isZero(coef - 1))
+        return monomial;
+    return JOIN_(MUL, NUM_(coef), monomial);
+}
+
+/// @brief Nodes of polynomialToTree() result
+static size_t treeNodes(const Polynomial_t *poly) {
+    size_t nodes = 0, terms = 0;
+    for (size_t power = 0; power <= poly->degree; power++) {
+        double coef = poly->coefficients[power];
+        if (isZero(coef)) continue;
+
+        terms++;
+        nodes += (power == 0) ? 1 : (power == 1) ? 1 : 3;
+        if (power > 0 && !isZero(coef - 1))
+            nodes += 2;
+    }
+    return (terms > 1) ? nodes + 1 : (terms) ? nodes : 1;
+}
+
+Node_t *polynomialToTree(const Polynomial_t *poly) {
+    assert(poly);
+    assert(poly->coefficients);
+
+    Node_t **terms = (Node_t **) calloc(poly->degree + 1, sizeof(Node_t *));
+    if (!terms)
+        return NULL;
+
+    size_t count = 0;
+    bool memoryOk = true;
+    for (size_t power = poly->degree + 1; power > 0 && memoryOk; power--) {
+        double coef = poly->coefficients[power - 1];
+        if (isZero(coef)) continue;
+
+        terms[count] = termTree(coef, poly->variable, power - 1);
+        memoryOk = terms[count++];
+    }
+
+    Node_t *result = NULL;
+    if (memoryOk) {
+        if (count == 0)
+            result = NUM_(0);
+        else if (count == 1)
+            result = terms[0];
+        else
+            result = createNaryNode(ADD, terms, count);
+    }
+
+    if (!result) {
+        logPrint(L_ZERO, 1, "Not enough memory to build tree of polynomial[%p]\n", poly);
+        for (size_t idx = 0; idx < count; idx++)
+            deleteTree(terms[idx]);
+    }
+    free(terms);
+    return result;
+}
+
+Node_t *polynomialDerivativeTree(const Node_t *node, int variable, size_t maxNodes) {
+    assert(node);
+
+    Polynomial_t poly = {};
+    Node_t *result = NULL;
+    if (polynomialFromTree(node, variable, &poly) == TA_SUCCESS &&
+        polynomialDerivative(&poly, &poly) == TA_SUCCESS && treeNodes(&poly) <= maxNodes)
+        result = polynomialToTree(&poly);
+
+    polynomialDtor(&poly);
+    return result;
+}
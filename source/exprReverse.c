@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "exprCompiler.h"
+#include "exprReverse.h"
+#include "treeStack.h"
+
+TREE_STACK_DEFINE(TapeFrameStack, TapeFrame_t)
+
+ReverseTape_t reverseTapeCtor() {
+    ReverseTape_t tape = {};
+    return tape;
+}
+
+TungstenStatus_t reverseTapeDtor(ReverseTape_t *tape) {
+    if (!tape) return TA_NULL_PTR;
+
+    free(tape->entries);
+    free(tape->frames);
+    *tape = {};
+    return TA_SUCCESS;
+}
+
+static bool reverseTapeReserve(ReverseTape_t *tape, size_t capacity) {
+    if (capacity <= tape->capacity)
+        return true;
+    if (capacity > UINT32_MAX)
+        return false;
+
+    TapeEntry_t *newEntries = (TapeEntry_t *) realloc(tape->entries, capacity * sizeof(TapeEntry_t));
+    if (!newEntries) return false;
+
+    tape->entries = newEntries;
+    tape->capacity = capacity;
+    return true;
+}
+
+/// @brief Append entry to tape
+/// @return Index of entry or UINT32_MAX if memory has run out
+static uint32_t reverseTapePush(ReverseTape_t *tape, uint8_t code, double value, uint32_t left, uint32_t right, bool active) {
+    if (tape->size == tape->capacity && !reverseTapeReserve(tape, 2 * tape->capacity + TREE_STACK_MIN_CAPACITY))
+        return UINT32_MAX;
+
+    TapeEntry_t entry = {value, 0, left, right, code, active};
+    tape->entries[tape->size] = entry;
+    return (uint32_t) tape->size++;
+}
+
+/// @brief Record operator on entries left and right
+static uint32_t reverseTapeOperation(ReverseTape_t *tape, enum OperatorType op, uint32_t left, uint32_t right) {
+    const TapeEntry_t *entries = tape->entries;
+    double value = calculateOperation(op, entries[left].value, entries[right].value);
+    return reverseTapePush(tape, (uint8_t) op, value, left, right, entries[left].active || entries[right].active);
+}
+
+/// @brief Forward sweep: evaluate tree and record it on empty tape, the same traversal as evaluate()
+static bool recordTape(ReverseTape_t *tape, const TungstenContext_t *context, const double *values, const Node_t *expr) {
+    // frames stay on heap of tape, so they aren't freed after traversal
+    TapeFrameStack_t frames = {tape->frames, 0, tape->framesCapacity, tape->frames != NULL};
+
+    TapeFrame_t root = {expr, 0, 0};
+    bool memoryOk = TapeFrameStackPush(&frames, root);
+    uint32_t last = 0;  // entry of last finished subtree
+
+    while (frames.size && memoryOk) {
+        TapeFrame_t *frame = TapeFrameStackTop(&frames);
+        const Node_t *current = frame->node;
+
+        switch(current->type) {
+            case VARIABLE:
+            {
+                int var = current->value.var;
+                double value = (values) ? values[var] : context->variables[var].number;
+                last = reverseTapePush(tape, INSTR_VARIABLE, value, (uint32_t) var, (uint32_t) var, true);
+                TapeFrameStackPop(&frames);
+                break;
+            }
+            case NUMBER:
+                last = reverseTapePush(tape, INSTR_NUMBER, current->value.number, 0, 0, false);
+                TapeFrameStackPop(&frames);
+                break;
+            case OPERATOR:
+            {
+                enum OperatorType op = current->value.op;
+                if (frame->evaluatedArgs == 1)
+                    frame->accumulated = last;
+
+                if (current->operandsCount) {
+                    if (frame->evaluatedArgs >= 2)
+                        frame->accumulated = last = reverseTapeOperation(tape, op, frame->accumulated, last);
+
+                    if (last == UINT32_MAX)
+                        memoryOk = false;
+                    else if (frame->evaluatedArgs < current->operandsCount) {
+                        TapeFrame_t child = {current->operands[frame->evaluatedArgs++], 0, 0};
+                        memoryOk = TapeFrameStackPush(&frames, child);
+                    } else {
+                        last = frame->accumulated;
+                        TapeFrameStackPop(&frames);
+                    }
+                    break;
+                }
+
+                bool binary = operators[op].binary;
+                if (frame->evaluatedArgs < 1u + binary) {
+                    TapeFrame_t child = {(frame->evaluatedArgs == 0) ? current->left : current->right, 0, 0};
+                    frame->evaluatedArgs++;
+                    memoryOk = TapeFrameStackPush(&frames, child);
+                    break;
+                }
+
+                last = reverseTapeOperation(tape, op, frame->accumulated, (binary) ? last : frame->accumulated);
+                TapeFrameStackPop(&frames);
+                break;
+            }
+            default:
+                assert(0);
+                break;
+        }
+
+        if (last == UINT32_MAX)
+            memoryOk = false;
+    }
+
+    tape->frames = frames.data;
+    tape->framesCapacity = frames.capacity;
+    return memoryOk;
+}
+
+/// @brief Backward sweep: adjoints of arguments from adjoint of every active entry, last entry is result
+static void sweepTape(ReverseTape_t *tape, double *gradient) {
+    TapeEntry_t *entries = tape->entries;
+    entries[tape->size - 1].adjoint = 1;
+
+    for (size_t idx = tape->size; idx-- > 0;) {
+        const TapeEntry_t *entry = entries + idx;
+        if (!entry->active)
+            continue;
+
+        double adjoint = entry->adjoint;
+        if (entry->code == INSTR_VARIABLE) {
+            gradient[entry->left] += adjoint;
+            continue;
+        }
+
+        TapeEntry_t *left = entries + entry->left, *right = entries + entry->right;
+        double a = left->value, b = right->value, result = entry->value;
+
+        // partial derivatives of the same rules as dualOperation()
+        switch((enum OperatorType) entry->code) {
+            case ADD:
+                left->adjoint  += adjoint;
+                right->adjoint += adjoint;
+                break;
+            case SUB:
+                left->adjoint  += adjoint;
+                right->adjoint -= adjoint;
+                break;
+            case MUL:
+                left->adjoint  += adjoint * b;
+                right->adjoint += adjoint * a;
+                break;
+            case DIV:
+                left->adjoint  += adjoint / b;
+                right->adjoint -= adjoint * result / b;
+                break;
+            case POW:
+                // constant arguments are skipped, so negative base with constant power is fine
+                if (left->active)
+                    left->adjoint  += adjoint * b * pow(a, b - 1);
+                if (right->active)
+                    right->adjoint += adjoint * result * log(a);
+                break;
+            case SIN:
+                left->adjoint += adjoint * cos(a);
+                break;
+            case COS:
+                left->adjoint -= adjoint * sin(a);
+                break;
+            case SINH:
+                left->adjoint += adjoint * cosh(a);
+                break;
+            case COSH:
+                left->adjoint += adjoint * sinh(a);
+                break;
+            case TAN:
+                left->adjoint += adjoint * (1 + result * result);
+                break;
+            case CTG:
+                left->adjoint -= adjoint * (1 + result * result);
+                break;
+            case LOG:
+            {
+                // log_a(b) = ln(b) / ln(a)
+                double logBase = log(a);
+                left->adjoint  -= adjoint * result / (a * logBase);
+                right->adjoint += adjoint / (b * logBase);
+                break;
+            }
+            case LOGN:
+                left->adjoint += adjoint / a;
+                break;
+            default:
+                LOG_PRINT(L_ZERO, 1, "Operation %d is not implemented\n", entry->code);
+                break;
+        }
+    }
+}
+
+static TungstenStatus_t evaluateGradientTree(ReverseTape_t *tape, const TungstenContext_t *context, const double *values,
+                                             size_t variablesCount, const Node_t *expr, double *value, double *gradient) {
+    tape->size = 0;
+    if (!reverseTapeReserve(tape, expr->size) || !recordTape(tape, context, values, expr)) {
+        logPrint(L_ZERO, 1, "Not enough memory to record tape of tree[%p]\n", expr);
+        return TA_MEMORY_ERROR;
+    }
+
+    memset(gradient, 0, variablesCount * sizeof(double));
+    sweepTape(tape, gradient);
+    *value = tape->entries[tape->size - 1].value;
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t evaluateGradient(ReverseTape_t *tape, TungstenContext_t *context, const Node_t *expr,
+                                  double *value, double *gradient) {
+    assert(tape);
+    assert(context);
+    assert(expr);
+    assert(value);
+    assert(gradient);
+
+    return evaluateGradientTree(tape, context, NULL, context->variablesCount, expr, value, gradient);
+}
+
+TungstenStatus_t evaluateGradientWith(ReverseTape_t *tape, const Node_t *expr, const double *values,
+                                      size_t variablesCount, double *value, double *gradient) {
+    assert(tape);
+    assert(expr);
+    assert(values);
+    assert(value);
+    assert(gradient);
+
+    return evaluateGradientTree(tape, NULL, values, variablesCount, expr, value, gradient);
+}
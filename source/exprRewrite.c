@@ -0,0 +1,736 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "nodeArena.h"
+#include "exprRewrite.h"
+
+static const char * const WILDCARD_NAMES[REWRITE_MAX_WILDCARDS] = {"a", "b", "c", "d"};
+static const char * const DEFAULT_TEX_COMMENT = "Как сказано в трудах Знаменской Л. Н.,";
+
+static bool isInteger(double number) {
+    return fabs(number - round(number)) < DOUBLE_EPSILON;
+}
+
+static bool isIntegerC(Node_t *const *wildcards) {
+    return wildcards[2]->type == NUMBER && isInteger(wildcards[2]->value.number);
+}
+
+/// ln(x^3) = 3*ln(x) on the same domain, even exponent would need |x|
+static bool isOddIntegerB(Node_t *const *wildcards) {
+    return wildcards[1]->type == NUMBER && isInteger(wildcards[1]->value.number) &&
+           fabs(fmod(round(wildcards[1]->value.number), 2)) > 0.5;
+}
+
+/// Order of table is priority: x^0 = 1 even for x = 0
+static const RewriteRule_t DEFAULT_REWRITE_RULES[] = {
+    {"a + 0",   "a",        NULL, NULL},
+    {"a - 0",   "a",        NULL, NULL},
+    {"a - a",   "0",        NULL, NULL},
+    {"0 - a",   "(-1) * a", NULL, NULL},
+    {"a * 1",   "a",        NULL, NULL},
+    {"a * 0",   "0",        NULL, NULL},
+    {"a / 1",   "a",        NULL, NULL},
+    {"0 / a",   "0",        NULL, NULL},
+    {"a / a",   "1",        NULL, NULL},
+    {"a ^ 1",   "a",        NULL, NULL},
+    {"a ^ 0",   "1",        NULL, NULL},
+    {"0 ^ a",   "0",        NULL, NULL},
+    {"1 ^ a",   "1",        NULL, NULL},
+    {"(a ^ b) ^ c", "a ^ (b * c)", isIntegerC, "Перемножим показатели степеней:"},
+
+    {"sin(a)^2 + cos(a)^2", "1",            NULL, "Вспомним основное тригонометрическое тождество:"},
+    {"1 + tg(a)^2",         "cos(a)^(-2)",  NULL, "Вспомним основное тригонометрическое тождество:"},
+    {"ch(a)^2 - sh(a)^2",   "1",            NULL, "Вспомним основное тождество гиперболических функций:"},
+    {"sin(a) / cos(a)",     "tg(a)",        NULL, "По определению тангенса"},
+    {"cos(a) / sin(a)",     "ctg(a)",       NULL, "По определению котангенса"},
+    {"tg(a) * ctg(a)",      "1",            NULL, "По определению тангенса и котангенса"},
+    {"ln(a ^ b)",           "b * ln(a)",    isOddIntegerB, "Вынесем показатель степени из-под логарифма:"},
+};
+
+static RewriteRules_t defaultRules = {};
+static thread_local const RewriteRules_t *currentRules = NULL;
+
+/// @brief Key of pattern node or subject node in discrimination tree
+typedef struct {
+    enum ElemType type;
+    uint64_t value;
+    size_t arity;
+} RewriteKey_t;
+
+static size_t nodeArity(const Node_t *node) {
+    if (node->operandsCount)
+        return node->operandsCount;
+    return (size_t) (node->left != NULL) + (size_t) (node->right != NULL);
+}
+
+/// @brief Operand of binary, unary or n-ary node by index
+static Node_t **operandSlot(Node_t *node, size_t idx) {
+    if (node->operandsCount)
+        return node->operands + idx;
+    return (idx == 0) ? &node->left : &node->right;
+}
+
+static const Node_t *operandAt(const Node_t *node, size_t idx) {
+    if (node->operandsCount)
+        return node->operands[idx];
+    return (idx == 0) ? node->left : node->right;
+}
+
+/// @brief Numbers close to integer are keyed by that integer, so 1 - 1e-15 finds pattern with 1
+static RewriteKey_t nodeKey(const Node_t *node) {
+    RewriteKey_t key = {node->type, nodeValueBits(node->type, node->value), nodeArity(node)};
+    if (node->type == NUMBER && isInteger(node->value.number)) {
+        union NodeValue rounded = {};
+        rounded.number = round(node->value.number) + 0.0;  // -0 becomes 0
+        key.value = nodeValueBits(NUMBER, rounded);
+    }
+    return key;
+}
+
+/// @brief Edges table is indexed by low bits of hash, but low bits of integer numbers are zeros,
+/// so hash is finalized to spread all bits of key over them
+static uint64_t edgeHash(uint32_t parent, RewriteKey_t key) {
+    uint64_t hash = hashMix(hashMix(hashMix(parent, (uint64_t) key.type), key.value), key.arity);
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCD;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+static bool edgeHasKey(const RewriteEdge_t *edge, uint32_t parent, RewriteKey_t key) {
+    return edge->parent == parent && edge->type == key.type && edge->value == key.value && edge->arity == key.arity;
+}
+
+static uint32_t findEdge(const RewriteRules_t *rules, uint32_t parent, RewriteKey_t key) {
+    if (!rules->edgesCapacity)
+        return 0;
+
+    size_t mask = rules->edgesCapacity - 1;
+    for (size_t idx = edgeHash(parent, key) & mask; rules->edges[idx].child; idx = (idx + 1) & mask) {
+        if (edgeHasKey(rules->edges + idx, parent, key))
+            return rules->edges[idx].child;
+    }
+    return 0;
+}
+
+static void placeEdge(RewriteEdge_t *edges, size_t capacity, RewriteEdge_t edge) {
+    RewriteKey_t key = {edge.type, edge.value, edge.arity};
+    size_t mask = capacity - 1;
+    size_t idx = edgeHash(edge.parent, key) & mask;
+    while (edges[idx].child)
+        idx = (idx + 1) & mask;
+    edges[idx] = edge;
+}
+
+/// @brief Keep load factor of edges table below 1/2
+static TungstenStatus_t reserveEdge(RewriteRules_t *rules) {
+    if (2 * (rules->edgesCount + 1) <= rules->edgesCapacity)
+        return TA_SUCCESS;
+
+    size_t capacity = (rules->edgesCapacity) ? 2 * rules->edgesCapacity : REWRITE_START_EDGES_CAPACITY;
+    RewriteEdge_t *edges = (RewriteEdge_t *) calloc(capacity, sizeof(RewriteEdge_t));
+    if (!edges)
+        return TA_MEMORY_ERROR;
+
+    for (size_t idx = 0; idx < rules->edgesCapacity; idx++) {
+        if (rules->edges[idx].child)
+            placeEdge(edges, capacity, rules->edges[idx]);
+    }
+    free(rules->edges);
+    rules->edges = edges;
+    rules->edgesCapacity = capacity;
+    return TA_SUCCESS;
+}
+
+/// @brief Make room for one more element of array growing twice
+static bool reserveItem(void **array, size_t count, size_t *capacity, size_t itemSize) {
+    if (count < *capacity)
+        return true;
+
+    size_t newCapacity = (*capacity) ? 2 * (*capacity) : REWRITE_START_EDGES_CAPACITY;
+    void *newArray = realloc(*array, newCapacity * itemSize);
+    if (!newArray)
+        return false;
+
+    *array = newArray;
+    *capacity = newCapacity;
+    return true;
+}
+
+/// @return Index of new state or 0 if there is no memory
+static uint32_t addState(RewriteRules_t *rules) {
+    if (!reserveItem((void **) &rules->states, rules->statesCount, &rules->statesCapacity, sizeof(RewriteState_t)))
+        return 0;
+
+    rules->states[rules->statesCount] = {};
+    return (uint32_t) rules->statesCount++;
+}
+
+static uint32_t edgeChild(RewriteRules_t *rules, uint32_t parent, RewriteKey_t key) {
+    uint32_t child = findEdge(rules, parent, key);
+    if (child)
+        return child;
+
+    if (reserveEdge(rules) != TA_SUCCESS)
+        return 0;
+    child = addState(rules);
+    if (!child)
+        return 0;
+
+    RewriteEdge_t edge = {parent, child, key.type, key.value, key.arity};
+    placeEdge(rules->edges, rules->edgesCapacity, edge);
+    rules->edgesCount++;
+    return child;
+}
+
+static uint32_t wildcardChild(RewriteRules_t *rules, uint32_t parent) {
+    if (!rules->states[parent].wildcard) {
+        uint32_t child = addState(rules);
+        if (!child)
+            return 0;
+        rules->states[parent].wildcard = child;
+    }
+    return rules->states[parent].wildcard;
+}
+
+/// @brief Add path of pattern in pre-order to discrimination tree
+/// @return State after the last node of pattern or 0 if there is no memory
+static uint32_t insertPattern(RewriteRules_t *rules, uint32_t state, const Node_t *pattern) {
+    if (pattern->type == VARIABLE)
+        return wildcardChild(rules, state);
+
+    state = edgeChild(rules, state, nodeKey(pattern));
+    for (size_t idx = 0; idx < nodeArity(pattern) && state; idx++)
+        state = insertPattern(rules, state, operandAt(pattern, idx));
+    return state;
+}
+
+static TungstenStatus_t addVariant(RewriteRules_t *rules, size_t rule, Node_t *pattern, Node_t *replacement) {
+    // x + x is the same in both orders, variants of rule are the last ones
+    for (size_t idx = rules->variantsCount; idx > 0 && rules->variants[idx - 1].rule == rule; idx--) {
+        if (equalTrees(rules->variants[idx - 1].pattern, pattern))
+            return TA_SUCCESS;
+    }
+
+    uint32_t state = insertPattern(rules, 0, pattern);
+    if (!state)
+        return TA_MEMORY_ERROR;
+
+    if (!reserveItem((void **) &rules->variants, rules->variantsCount, &rules->variantsCapacity,
+                     sizeof(RewriteVariant_t)))
+        return TA_MEMORY_ERROR;
+    // matches[0] is never used, so 0 ends list
+    if (!rules->matchesCount)
+        rules->matchesCount = 1;
+    if (!reserveItem((void **) &rules->matches, rules->matchesCount, &rules->matchesCapacity, sizeof(RewriteMatch_t)))
+        return TA_MEMORY_ERROR;
+
+    RewriteVariant_t variant = {rule, pattern, replacement};
+    rules->variants[rules->variantsCount] = variant;
+
+    // list is kept in order of table, so candidates are found sorted by priority
+    RewriteMatch_t match = {(uint32_t) rules->variantsCount++, 0};
+    uint32_t *link = &rules->states[state].firstMatch;
+    while (*link)
+        link = &rules->matches[*link].next;
+    rules->matches[rules->matchesCount] = match;
+    *link = (uint32_t) rules->matchesCount++;
+    return TA_SUCCESS;
+}
+
+/// @brief Collect commutative nodes with two operands in pre-order
+static void findCommutative(Node_t *node, Node_t **found, size_t *count) {
+    if (node->type != OPERATOR)
+        return;
+
+    if (operators[node->value.op].commutative && nodeArity(node) == 2 && *count < REWRITE_MAX_COMMUTATIVE_NODES)
+        found[(*count)++] = node;
+    for (size_t idx = 0; idx < nodeArity(node); idx++)
+        findCommutative(*operandSlot(node, idx), found, count);
+}
+
+static void updatePatternInfo(Node_t *node) {
+    for (size_t idx = 0; idx < nodeArity(node); idx++)
+        updatePatternInfo(*operandSlot(node, idx));
+    updateNodeInfo(node);
+}
+
+/// @brief Add pattern with every combination of orders of its commutative operands
+static TungstenStatus_t addVariants(RewriteRules_t *rules, size_t rule, Node_t *pattern, Node_t *replacement) {
+    Node_t *commutative[REWRITE_MAX_COMMUTATIVE_NODES] = {};
+    size_t commutativeCount = 0;
+    findCommutative(pattern, commutative, &commutativeCount);
+
+    TungstenStatus_t status = addVariant(rules, rule, pattern, replacement);
+    for (size_t swaps = 1; swaps < ((size_t) 1 << commutativeCount) && status == TA_SUCCESS; swaps++) {
+        Node_t *variant = copyTree(pattern);
+        if (!variant)
+            return TA_MEMORY_ERROR;
+
+        Node_t *swapped[REWRITE_MAX_COMMUTATIVE_NODES] = {};
+        size_t swappedCount = 0;
+        findCommutative(variant, swapped, &swappedCount);
+        for (size_t idx = 0; idx < swappedCount; idx++) {
+            if (!(swaps & ((size_t) 1 << idx)))
+                continue;
+
+            Node_t **first = operandSlot(swapped[idx], 0), **second = operandSlot(swapped[idx], 1);
+            Node_t *temp = *first;
+            *first = *second;
+            *second = temp;
+        }
+        updatePatternInfo(variant);
+        status = addVariant(rules, rule, variant, replacement);
+    }
+    return status;
+}
+
+/// @brief Parse pattern and check that it uses only wildcards a, b, c, d
+static Node_t *parsePattern(TungstenContext_t *context, const char *pattern, uint64_t allowedVariables) {
+    Node_t *node = parseExpression(context, pattern);
+    if (!node) {
+        logPrint(L_ZERO, 1, "RewriteRules: can't parse pattern '%s'\n", pattern);
+        return NULL;
+    }
+
+    if (node->varMask & ~allowedVariables) {
+        logPrint(L_ZERO, 1, "RewriteRules: unknown wildcard in '%s'\n", pattern);
+        return NULL;
+    }
+    if (node->size > REWRITE_MAX_PATTERN_NODES) {
+        logPrint(L_ZERO, 1, "RewriteRules: pattern '%s' has more than %zu nodes\n", pattern,
+                 REWRITE_MAX_PATTERN_NODES);
+        return NULL;
+    }
+    return node;
+}
+
+static TungstenStatus_t compileRule(RewriteRules_t *rules, TungstenContext_t *context, size_t rule) {
+    const uint64_t wildcardsMask = ((uint64_t) 1 << REWRITE_MAX_WILDCARDS) - 1;
+
+    Node_t *pattern = parsePattern(context, rules->table[rule].pattern, wildcardsMask);
+    if (!pattern)
+        return TA_SYNTAX_ERROR;
+    if (pattern->type != OPERATOR) {
+        logPrint(L_ZERO, 1, "RewriteRules: pattern '%s' is not an operation\n", rules->table[rule].pattern);
+        return TA_SYNTAX_ERROR;
+    }
+
+    // replacement can use only wildcards matched by pattern
+    Node_t *replacement = parsePattern(context, rules->table[rule].replacement, pattern->varMask);
+    if (!replacement)
+        return TA_SYNTAX_ERROR;
+
+    return addVariants(rules, rule, pattern, replacement);
+}
+
+static uint64_t hashString(uint64_t hash, const char *str) {
+    for (; *str; str++)
+        hash = hashMix(hash, (unsigned char) *str);
+    return hashMix(hash, 0);
+}
+
+/// @brief Rule sets with equal patterns, replacements and conditions simplify trees equally, so they have equal hashes
+static uint64_t rulesHash(const RewriteRule_t *table, size_t count) {
+    static_assert(sizeof(RewriteCondition_t) <= sizeof(uint64_t), "condition doesn't fit in hash");
+
+    uint64_t hash = hashMix(0, count);
+    for (size_t rule = 0; rule < count; rule++) {
+        uint64_t condition = 0;
+        memcpy(&condition, &table[rule].condition, sizeof(RewriteCondition_t));
+
+        hash = hashString(hash, table[rule].pattern);
+        hash = hashString(hash, table[rule].replacement);
+        hash = hashMix(hash, condition);
+    }
+    // 0 is key of operations without rules in memo cache
+    return hash | 1;
+}
+
+TungstenStatus_t rewriteRulesCtor(RewriteRules_t *rules, const RewriteRule_t *table, size_t count) {
+    if (!rules || !table) return TA_NULL_PTR;
+
+    *rules = {};
+    rules->table = table;
+    rules->rulesCount = count;
+    rules->hash = rulesHash(table, count);
+
+    NodeArena_t *previousArena = nodeArenaSelect(&rules->arena);
+    TungstenContext_t context = TungstenCtor();
+
+    // wildcard is index of variable in context
+    for (size_t idx = 0; idx < REWRITE_MAX_WILDCARDS; idx++)
+        insertVariable(&context, WILDCARD_NAMES[idx]);
+
+    addState(rules);    // root
+    TungstenStatus_t status = (rules->statesCount) ? TA_SUCCESS : TA_MEMORY_ERROR;
+
+    for (size_t rule = 0; rule < count && status == TA_SUCCESS; rule++)
+        status = compileRule(rules, &context, rule);
+
+    TungstenDtor(&context);
+    nodeArenaSelect(previousArena);
+
+    if (status != TA_SUCCESS) {
+        logPrint(L_ZERO, 1, "RewriteRules[%p]: failed to compile %zu rules\n", rules, count);
+        rewriteRulesDtor(rules);
+        return status;
+    }
+
+    logPrint(L_DEBUG, 0, "RewriteRules[%p]: %zu rules, %zu variants, %zu states, %zu edges\n",
+             rules, count, rules->variantsCount, rules->statesCount, rules->edgesCount);
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t rewriteRulesDtor(RewriteRules_t *rules) {
+    if (!rules) return TA_NULL_PTR;
+
+    if (currentRules == rules)
+        currentRules = NULL;
+
+    free(rules->variants);
+    free(rules->states);
+    free(rules->edges);
+    free(rules->matches);
+    nodeArenaDtor(&rules->arena);
+
+    *rules = {};
+    return TA_SUCCESS;
+}
+
+const RewriteRules_t *defaultRewriteRules() {
+    // compiled once, initialization of static is thread safe
+    static const TungstenStatus_t status = rewriteRulesCtor(&defaultRules, DEFAULT_REWRITE_RULES,
+                                                            sizeof(DEFAULT_REWRITE_RULES) / sizeof(RewriteRule_t));
+    (void) status;
+    return &defaultRules;
+}
+
+const RewriteRules_t *rewriteRulesSelect(const RewriteRules_t *rules) {
+    const RewriteRules_t *previous = rewriteRulesCurrent();
+    currentRules = rules;
+    return previous;
+}
+
+const RewriteRules_t *rewriteRulesCurrent() {
+    return (currentRules) ? currentRules : defaultRewriteRules();
+}
+
+typedef struct {
+    uint32_t variants[REWRITE_MAX_CANDIDATES];
+    size_t count;
+} RewriteCandidates_t;
+
+/// @brief Walk discrimination tree over subtrees waiting for match, the next one is on top
+static void findCandidates(const RewriteRules_t *rules, uint32_t state, Node_t *const *pending, size_t pendingCount,
+                           RewriteCandidates_t *found) {
+    if (!pendingCount) {
+        for (uint32_t match = rules->states[state].firstMatch; match; match = rules->matches[match].next) {
+            if (found->count < REWRITE_MAX_CANDIDATES)
+                found->variants[found->count++] = rules->matches[match].variant;
+        }
+        return;
+    }
+
+    Node_t *node = pending[pendingCount - 1];
+    if (rules->states[state].wildcard)
+        findCandidates(rules, rules->states[state].wildcard, pending, pendingCount - 1, found);
+
+    RewriteKey_t key = nodeKey(node);
+    uint32_t child = findEdge(rules, state, key);
+    // edge exists only if some pattern has the same operands here, so subtrees to match fit in pattern size
+    if (!child || pendingCount - 1 + key.arity > REWRITE_MAX_PATTERN_NODES)
+        return;
+
+    Node_t *next[REWRITE_MAX_PATTERN_NODES] = {};
+    memcpy(next, pending, (pendingCount - 1) * sizeof(Node_t *));
+    for (size_t idx = 0; idx < key.arity; idx++)
+        next[pendingCount - 1 + idx] = *operandSlot(node, key.arity - 1 - idx);
+    findCandidates(rules, child, next, pendingCount - 1 + key.arity, found);
+}
+
+/// @brief Check pattern exactly and remember slots of subtrees matched by wildcards
+static bool matchPattern(const Node_t *pattern, Node_t **slot, Node_t **matched[]) {
+    Node_t *node = *slot;
+    if (pattern->type == VARIABLE) {
+        Node_t **first = matched[pattern->value.var];
+        if (first)
+            return (*first)->hash == node->hash && equalTrees(*first, node);
+
+        matched[pattern->value.var] = slot;
+        return true;
+    }
+
+    if (pattern->type != node->type)
+        return false;
+    if (pattern->type == NUMBER)
+        return fpclassify(pattern->value.number - node->value.number) == FP_ZERO;
+    if (pattern->value.op != node->value.op || nodeArity(pattern) != nodeArity(node))
+        return false;
+
+    for (size_t idx = 0; idx < nodeArity(pattern); idx++) {
+        if (!matchPattern(operandAt(pattern, idx), operandSlot(node, idx), matched))
+            return false;
+    }
+    return true;
+}
+
+/*
+Replacement is built in two steps, so running out of memory leaves subject untouched.
+The first one creates all new nodes: first occurrence of wildcard is a hole (one of local
+placeholder nodes), other occurrences are copies of matched subtree. The second one moves
+matched subtrees into holes and simplifies new nodes bottom-up.
+*/
+static bool isHole(const Node_t *node, const Node_t *holes) {
+    return (uintptr_t) node >= (uintptr_t) holes && (uintptr_t) node < (uintptr_t) (holes + REWRITE_MAX_WILDCARDS);
+}
+
+/// @brief Delete new nodes of replacement built before failure, holes are not nodes of arena
+static void deleteReplacement(const Node_t *pattern, Node_t *node, const Node_t *holes) {
+    if (isHole(node, holes))
+        return;
+
+    if (pattern->type == OPERATOR) {
+        for (size_t idx = 0; idx < nodeArity(pattern); idx++) {
+            Node_t **slot = operandSlot(node, idx);
+            deleteReplacement(operandAt(pattern, idx), *slot, holes);
+            *slot = NULL;
+        }
+    }
+    deleteTree(node);
+}
+
+static Node_t *buildReplacement(const Node_t *pattern, Node_t **const *matched, bool *used, Node_t *holes) {
+    if (pattern->type == VARIABLE) {
+        int var = pattern->value.var;
+        if (used[var])
+            return copyTree(*matched[var]);
+
+        used[var] = true;
+        return holes + var;
+    }
+    if (pattern->type == NUMBER)
+        return createNode(NUMBER, 0, pattern->value.number, NULL, NULL);
+
+    size_t arity = nodeArity(pattern);
+    Node_t *operands[REWRITE_MAX_PATTERN_NODES] = {};
+    size_t built = 0;
+    for (; built < arity; built++) {
+        operands[built] = buildReplacement(operandAt(pattern, built), matched, used, holes);
+        if (!operands[built])
+            break;
+    }
+
+    Node_t *node = NULL;
+    if (built == arity && pattern->operandsCount)
+        node = createNaryNode(pattern->value.op, operands, arity);
+    else if (built == arity)
+        node = createNode(OPERATOR, pattern->value.op, 0, operands[0], operands[1]);
+
+    if (!node) {
+        for (size_t idx = 0; idx < built; idx++)
+            deleteReplacement(operandAt(pattern, idx), operands[idx], holes);
+    }
+    return node;
+}
+
+static Node_t *linkReplacement(TungstenContext_t *context, const Node_t *pattern, Node_t *node,
+                               Node_t **const *matched, const Node_t *holes, RewriteFinish_t finish) {
+    if (isHole(node, holes)) {
+        Node_t **slot = matched[node - holes];
+        Node_t *subtree = *slot;
+        *slot = NULL;
+        return subtree;
+    }
+    if (pattern->type != OPERATOR)
+        return node;
+
+    for (size_t idx = 0; idx < nodeArity(pattern); idx++) {
+        Node_t **slot = operandSlot(node, idx);
+        *slot = linkReplacement(context, operandAt(pattern, idx), *slot, matched, holes, finish);
+        (*slot)->parent = node;
+    }
+    updateNodeInfo(node);
+    return (finish) ? finish(NULL, context, node, 0, NULL) : node;
+}
+
+/// @brief Find the first rule of table that matches node exactly
+/// @param matched Slots of subtrees matched by wildcards
+static const RewriteVariant_t *findRule(const RewriteRules_t *rules, Node_t *node, Node_t **matched[]) {
+    RewriteCandidates_t found = {};
+    Node_t *pending[1] = {node};
+    findCandidates(rules, 0, pending, 1, &found);
+
+    // variants of one state are sorted already, but wildcard and exact edges give separate lists
+    for (size_t idx = 1; idx < found.count; idx++) {
+        uint32_t variant = found.variants[idx];
+        size_t insertIdx = idx;
+        for (; insertIdx > 0 && found.variants[insertIdx - 1] > variant; insertIdx--)
+            found.variants[insertIdx] = found.variants[insertIdx - 1];
+        found.variants[insertIdx] = variant;
+    }
+
+    for (size_t idx = 0; idx < found.count; idx++) {
+        const RewriteVariant_t *variant = rules->variants + found.variants[idx];
+        memset(matched, 0, REWRITE_MAX_WILDCARDS * sizeof(Node_t **));
+
+        Node_t *root = node;
+        if (!matchPattern(variant->pattern, &root, matched))
+            continue;
+
+        RewriteCondition_t condition = rules->table[variant->rule].condition;
+        Node_t *wildcards[REWRITE_MAX_WILDCARDS] = {};
+        for (size_t var = 0; var < REWRITE_MAX_WILDCARDS; var++)
+            wildcards[var] = (matched[var]) ? *matched[var] : NULL;
+        if (!condition || condition(wildcards))
+            return variant;
+    }
+    return NULL;
+}
+
+/// @brief Find two operands of n-ary node with more operands that match the first rule, e.g. sin(x)^2 and
+/// cos(x)^2 in sin(x)^2 + y + cos(x)^2. Only operands that have own edge after root of pattern start
+/// a pair, so sum of products without rules for products is scanned in one pass
+/// @param pair Matched operands, pair view points to them
+static const RewriteVariant_t *findOperandsRule(const RewriteRules_t *rules, Node_t *node, Node_t *view, Node_t **pair,
+                                                size_t *firstIdx, size_t *secondIdx, Node_t **matched[]) {
+    RewriteKey_t pairKey = {OPERATOR, nodeValueBits(OPERATOR, node->value), 2};
+    uint32_t pairState = findEdge(rules, 0, pairKey);
+    if (!pairState || node->operandsCount > REWRITE_MAX_PAIRED_OPERANDS)
+        return NULL;
+
+    *view = *node;
+    view->operands = pair;
+    view->operandsCount = 2;
+
+    for (size_t first = 0; first < node->operandsCount; first++) {
+        if (!findEdge(rules, pairState, nodeKey(node->operands[first])))
+            continue;
+
+        for (size_t second = 0; second < node->operandsCount; second++) {
+            if (second == first)
+                continue;
+
+            pair[0] = node->operands[first];
+            pair[1] = node->operands[second];
+            const RewriteVariant_t *variant = findRule(rules, view, matched);
+            if (variant) {
+                *firstIdx = first;
+                *secondIdx = second;
+                return variant;
+            }
+        }
+    }
+    return NULL;
+}
+
+/// @brief Replace two operands of n-ary node by replacement of rule, operands are simplified together then
+static Node_t *rewriteOperands(TexContext_t *tex, TungstenContext_t *context, const RewriteRules_t *rules,
+                               Node_t *node, size_t depth, bool *changedTree, RewriteFinish_t finish) {
+    Node_t view = {};
+    Node_t *pair[2] = {};
+    size_t firstIdx = 0, secondIdx = 0;
+    Node_t **matched[REWRITE_MAX_WILDCARDS] = {};
+    const RewriteVariant_t *variant = findOperandsRule(rules, node, &view, pair, &firstIdx, &secondIdx, matched);
+    if (!variant)
+        return node;
+
+    bool used[REWRITE_MAX_WILDCARDS] = {};
+    Node_t holes[REWRITE_MAX_WILDCARDS] = {};
+    Node_t *result = buildReplacement(variant->replacement, matched, used, holes);
+    if (!result) {
+        logPrint(L_ZERO, 1, "Not enough memory to rewrite node[%p]\n", node);
+        return node;
+    }
+
+    if (changedTree)
+        *changedTree = true;
+
+    bool narrate = texStep(tex, depth);
+    if (narrate) {
+        const char *comment = rules->table[variant->rule].texComment;
+        exprTexDefine(tex, context, node);
+        texPrintf(tex, "%s $", (comment) ? comment : DEFAULT_TEX_COMMENT);
+        exprTexDumpRecursive(tex, context, node);
+        texPrintf(tex, " = ");
+    }
+
+    result = linkReplacement(context, variant->replacement, result, matched, holes, finish);
+    deleteTree(pair[0]);
+    deleteTree(pair[1]);
+
+    node->operands[firstIdx] = result;
+    result->parent = node;
+    for (size_t idx = secondIdx + 1; idx < node->operandsCount; idx++)
+        node->operands[idx - 1] = node->operands[idx];
+    node->operandsCount--;
+    updateNodeInfo(node);
+
+    // replacement is folded with other operands, other pairs are found there too
+    if (finish)
+        node = finish(NULL, context, node, 0, NULL);
+
+    if (narrate) {
+        exprTexDumpRecursive(tex, context, node);
+        texPrintf(tex, "$\n\n");
+        exprTexFlush(tex, context);
+    }
+    return node;
+}
+
+Node_t *rewriteNode(TexContext_t *tex, TungstenContext_t *context, const RewriteRules_t *rules, Node_t *node,
+                    size_t depth, bool *changedTree, RewriteFinish_t finish) {
+    assert(rules);
+    assert(node);
+
+    if (node->type != OPERATOR || !rules->statesCount)
+        return node;
+
+    if (node->operandsCount > 2)
+        return rewriteOperands(tex, context, rules, node, depth, changedTree, finish);
+
+    Node_t **matched[REWRITE_MAX_WILDCARDS] = {};
+    const RewriteVariant_t *variant = findRule(rules, node, matched);
+    if (!variant)
+        return node;
+
+    bool used[REWRITE_MAX_WILDCARDS] = {};
+    Node_t holes[REWRITE_MAX_WILDCARDS] = {};
+    Node_t *result = buildReplacement(variant->replacement, matched, used, holes);
+    if (!result) {
+        logPrint(L_ZERO, 1, "Not enough memory to rewrite node[%p]\n", node);
+        return node;
+    }
+
+    if (changedTree)
+        *changedTree = true;
+
+    bool narrate = texStep(tex, depth);
+    if (narrate) {
+        const char *comment = rules->table[variant->rule].texComment;
+        exprTexDefine(tex, context, node);
+        texPrintf(tex, "%s $", (comment) ? comment : DEFAULT_TEX_COMMENT);
+        exprTexDumpRecursive(tex, context, node);
+        texPrintf(tex, " = ");
+    }
+
+    result = linkReplacement(context, variant->replacement, result, matched, holes, finish);
+    result->parent = node->parent;
+    deleteTree(node);
+
+    if (narrate) {
+        exprTexDumpRecursive(tex, context, result);
+        texPrintf(tex, "$\n\n");
+        exprTexFlush(tex, context);
+    }
+    return result;
+}
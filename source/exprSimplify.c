@@ -3,15 +3,45 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <math.h>
+#include <string.h>
+#include <stdint.h>
 
 #include "hashTable.h"
 #include "logger.h"
 #include "tex.h"
 #include "exprTree.h"
+#include "nodeArena.h"
+#include "exprCache.h"
 #include "treeDSL.h"
+#include "treeStack.h"
+#include "exprRewrite.h"
 /*===========Tree simplification================================*/
 
-Node_t *foldConstants(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool *changedTree) {
+TREE_STACK_DEFINE(NodeStack, Node_t *)
+
+/// @brief Push operands of node to stack, so the first operand is on top
+static bool pushOperands(NodeStack_t *stack, Node_t *node) {
+    bool pushed = true;
+    for (size_t idx = node->operandsCount; idx > 0 && pushed; idx--)
+        pushed = NodeStackPush(stack, node->operands[idx - 1]);
+
+    if (node->right)
+        pushed = pushed && NodeStackPush(stack, node->right);
+    if (node->left)
+        pushed = pushed && NodeStackPush(stack, node->left);
+    return pushed;
+}
+
+static thread_local SimplifyStats_t simplifyCounters = {};
+
+SimplifyStats_t *simplifyStats() {
+    return &simplifyCounters;
+}
+
+/// @brief Fold constants in node
+/// @param recursive Fold operands first, otherwise they must be already folded
+static Node_t *foldConstantsNode(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool *changedTree,
+                                 bool recursive) {
     if (node->type == NUMBER || node->type == VARIABLE) {
         return node;
     }
@@ -22,17 +52,21 @@ Node_t *foldConstants(TexContext_t *tex, TungstenContext_t *context, Node_t *nod
         Node_t *left = NULL, *right = NULL;
         bool binary = operators[node->value.op].binary;
 
-        left = foldConstants(tex, context, node->left, changedTree);
+        left  = (recursive) ? foldConstants(tex, context, node->left, changedTree) : node->left;
         if (binary)
-            right = foldConstants(tex, context, node->right, changedTree);
+            right = (recursive) ? foldConstants(tex, context, node->right, changedTree) : node->right;
 
         if (left->type == NUMBER && (!binary ||  right->type == NUMBER) ) {
             if (changedTree)
                 *changedTree = true;
+            simplifyCounters.rewrites++;
 
-            texPrintf(tex, "Заметим, что $");
-            exprTexDumpRecursive(tex, context, node);
-            texPrintf(tex, " = ");
+            bool narrate = texStep(tex, 0);
+            if (narrate) {
+                texPrintf(tex, "Заметим, что $");
+                exprTexDumpRecursive(tex, context, node);
+                texPrintf(tex, " = ");
+            }
 
             node->value.number = calculateOperation(node->value.op, left->value.number,
                                                                     (right) ? (right->value.number) : 0);
@@ -41,80 +75,91 @@ Node_t *foldConstants(TexContext_t *tex, TungstenContext_t *context, Node_t *nod
                 deleteTree(node->right); node->right = NULL;
             }
             node->type = NUMBER;
-            exprTexDumpRecursive(tex, context, node);
-            texPrintf(tex, "$\n\n");
 
+            if (narrate) {
+                exprTexDumpRecursive(tex, context, node);
+                texPrintf(tex, "$\n\n");
+            }
         }
+        updateNodeInfo(node);
     } else {
         enum OperatorType op = node->value.op;
 
         bool localChanges = false;
-        //array with leafs of current commutative operation (e.g. + or *)
-        Node_t *operLeafs[EXPR_TREE_MAX_LIST_COUNT] = {0};
-        size_t leafsCount = 0;
-
-        //array to find lists using depth-first search
-        Node_t *listsStack[EXPR_TREE_MAX_LIST_COUNT] = {0};
-        size_t stackSize = 0;
-
-        //array with nodes of type operator
-        Node_t *operNodes[EXPR_TREE_MAX_LIST_COUNT] = {0};
-        operNodes[0] = node;
-        size_t operNodesCount = 1;
-
-        // Depth-first search
-        listsStack[0] = node->right;
-        listsStack[1] = node->left;
-        stackSize = 2;
-
-        while (stackSize > 0) {
-            stackSize--;
-            Node_t *current = listsStack[stackSize];
-            logPrint(L_EXTRA, 0, "StackSize = %d, current = %p\n", stackSize, current);
-
-            if (current->type != OPERATOR || current->value.op != op) {
-                logPrint(L_EXTRA, 0, "Calling foldConstants for %p: type = %d\n", current->type);
+        bool narrateChanges = false;
+        //leafs of current commutative operation (e.g. + or *), they become operands of n-ary node
+        Node_t *leafsBuffer[TREE_STACK_MIN_CAPACITY] = {};
+        NodeStack_t leafs = NodeStackCtor(leafsBuffer, TREE_STACK_MIN_CAPACITY);
+
+        //nodes to search for leafs using depth-first search
+        Node_t *listsBuffer[TREE_STACK_MIN_CAPACITY] = {};
+        NodeStack_t lists = NodeStackCtor(listsBuffer, TREE_STACK_MIN_CAPACITY);
+
+        //inner nodes of the same operator, they are freed after flattening
+        Node_t *operBuffer[TREE_STACK_MIN_CAPACITY] = {};
+        NodeStack_t opers = NodeStackCtor(operBuffer, TREE_STACK_MIN_CAPACITY);
+
+        bool memoryOk = pushOperands(&lists, node);
+
+        while (lists.size > 0 && memoryOk) {
+            Node_t *current = NodeStackPop(&lists);
+            logPrint(L_EXTRA, 0, "StackSize = %zu, current = %p\n", lists.size, current);
+
+            if (recursive && (current->type != OPERATOR || current->value.op != op)) {
+                logPrint(L_EXTRA, 0, "Calling foldConstants for %p: type = %d\n", current, current->type);
                 current = foldConstants(tex, context, current, changedTree);
             }
 
             if (current->type == OPERATOR && current->value.op == op) {
-                logPrint(L_EXTRA, 0, "Added = %p\n", current->right);
-                logPrint(L_EXTRA, 0, "Added = %p\n", current->left);
-
-                listsStack[stackSize] = current->right;
-                stackSize++;
-                listsStack[stackSize] = current->left;
-                stackSize++;
-
-                operNodes[operNodesCount++] = current;
+                memoryOk = pushOperands(&lists, current) && NodeStackPush(&opers, current);
             } else {
                 logPrint(L_EXTRA, 0, "Pushed %p to leafs array\n", current);
-                //! FIRST ELEMENT IS RESERVED FOR NUMBER NODE
-                operLeafs[1 + leafsCount++] = current;
+                memoryOk = NodeStackPush(&leafs, current);
             }
+        }
 
-            logPrint(L_EXTRA, 0, "~StackSize = %d, current = %p\n", stackSize, current);
+        // array of operands is resized before changing tree, so tree is never left half-changed
+        Node_t **operands = NULL;
+        if (memoryOk) {
+            operands = (operandsCapacity(node->operands) >= leafs.size) ? node->operands
+                                                                        : operandsRealloc(node, leafs.size);
+            memoryOk = operands;
+        }
 
+        if (!memoryOk) {
+            // tree is not changed yet, only operands of this operator could be folded
+            logPrint(L_ZERO, 1, "Not enough memory to fold constants in node[%p]\n", node);
+            NodeStackDtor(&leafs);
+            NodeStackDtor(&lists);
+            NodeStackDtor(&opers);
+            return node;
         }
+        node->operands = operands;
 
-        // simplifying constants and rearranging tree
-        //? NOTE: starting from 1 in operLeafs[...] because first element is reserved for numberNode
+        // merging numbers into the first of them, which is moved to the beginning
+        Node_t **operLeafs = leafs.data;
+        size_t leafsCount = leafs.size;
         Node_t *numberNode = NULL;
 
-        size_t writeIdx = 1;
-        for (size_t readIdx = 1; readIdx < leafsCount + 1; readIdx++) {
+        size_t writeIdx = 0;
+        for (size_t readIdx = 0; readIdx < leafsCount; readIdx++) {
             if (operLeafs[readIdx]->type == NUMBER) {
                 if (!numberNode) {
                     numberNode = operLeafs[readIdx];
                 } else {
-                    if (!localChanges) {
+                    if (!localChanges)
+                        narrateChanges = texStep(tex, 0);
+                    if (!localChanges && narrateChanges) {
+                        exprTexDefine(tex, context, node);
                         texPrintf(tex, "Каждый школьник знает, что \n$$");
                         exprTexDumpRecursive(tex, context, node);
                         texPrintf(tex, " = ");
                     }
                     localChanges = true;
 
-                    *changedTree = true;
+                    if (changedTree)
+                        *changedTree = true;
+                    simplifyCounters.rewrites++;
                     numberNode->value.number = calculateOperation(op,
                                                                   numberNode->value.number,
                                                                   operLeafs[readIdx]->value.number);
@@ -125,184 +170,638 @@ Node_t *foldConstants(TexContext_t *tex, TungstenContext_t *context, Node_t *nod
                 operLeafs[writeIdx++] = operLeafs[readIdx];
             }
         }
+        leafsCount = writeIdx;
 
+        for (size_t operIdx = 0; operIdx < opers.size; operIdx++)
+            nodeFree(opers.data[operIdx]);
 
-        size_t operCounter = 0;
-        Node_t *current = operNodes[0];
-        size_t leafStartIdx = 1;
-        if (numberNode) {
-            operLeafs[0] = numberNode;
-            leafStartIdx = 0;
-        }
-        leafsCount = writeIdx - leafStartIdx;
-
-        // if all nodes were numbers
-        if (leafsCount == 1) {
+        node->left = node->right = NULL;
+        if (numberNode && leafsCount == 0) {
+            // all leafs were numbers
+            operandsFree(node->operands);
+            node->operands = NULL;
+            node->operandsCount = 0;
             node->type = NUMBER;
             node->value.number = numberNode->value.number;
-            node->left = NULL;
-            node->right = NULL;
             deleteTree(numberNode);
         } else {
-            logPrint(L_EXTRA, 0, "Operator leafs: total = %d\n", leafsCount);
-            for (int i = leafStartIdx; (i - leafStartIdx) < leafsCount; i++) {
-                logPrint(L_EXTRA, 0, "i=%d : %p : type = %d\n", i, operLeafs[i], operLeafs[i]->type);
-            }
-
-            logPrint(L_EXTRA, 0, "Rearranging tree\n");
+            logPrint(L_EXTRA, 0, "Operator leafs: total = %zu\n", leafsCount + (numberNode != NULL));
 
-            for (size_t idx = 0; idx < leafsCount - 1; idx++) {
-                current->left = operLeafs[leafStartIdx + idx];
-                operLeafs[leafStartIdx + idx]->parent = current;
-                if (idx == (leafsCount - 2) )
-                    current->right = operLeafs[leafStartIdx + idx + 1];
-                else if (operCounter < operNodesCount)
-                    current->right = operNodes[++operCounter];
-                else
-                    current->right = OPR_(op, NULL, NULL);
-
-                current->right->parent = current;
-                current = current->right;
+            size_t operandIdx = 0;
+            if (numberNode) {
+                updateNodeInfo(numberNode);
+                node->operands[operandIdx++] = numberNode;
             }
-        }
+            for (size_t idx = 0; idx < leafsCount; idx++)
+                node->operands[operandIdx++] = operLeafs[idx];
 
-        for (size_t operIdx = operCounter + 1; operIdx < operNodesCount; operIdx++) {
-            free(operNodes[operIdx]);
+            node->operandsCount = operandIdx;
+            for (size_t idx = 0; idx < node->operandsCount; idx++)
+                node->operands[idx]->parent = node;
         }
+        updateNodeInfo(node);
 
-        if (localChanges) {
+        if (narrateChanges) {
+            // flattened node is new, its big subtrees are defined after formula
             exprTexDumpRecursive(tex, context, node);
             texPrintf(tex, "$$\n\n");
+            exprTexFlush(tex, context);
         }
+
+        NodeStackDtor(&leafs);
+        NodeStackDtor(&lists);
+        NodeStackDtor(&opers);
     }
 
     return node;
 }
 
+Node_t *foldConstants(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool *changedTree) {
+    return foldConstantsNode(tex, context, node, changedTree, true);
+}
+
+/// @brief Exact comparison: operand 1e-13 is neither zero nor neutral
 static bool isEqualDouble(double a, double b) {
-    return fabs(b-a) < DOUBLE_EPSILON;
+    return isZero(b - a);
 }
 
-Node_t *removeNeutralOperations(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool *changedTree) {
+/// @brief Remove neutral operands of n-ary sum or product, product with zero becomes zero
+static Node_t *removeNeutralOperands(TexContext_t *tex, TungstenContext_t *context, Node_t *node, size_t depth,
+                                     bool *changedTree) {
+    bool product = node->value.op == MUL;
+    double neutral = (product) ? 1 : 0;
+
+    Node_t *zero = NULL;
+    size_t neutralCount = 0;
+    for (size_t idx = 0; idx < node->operandsCount; idx++) {
+        Node_t *operand = node->operands[idx];
+        if (operand->type != NUMBER)
+            continue;
+
+        if (product && !zero && isEqualDouble(operand->value.number, 0))
+            zero = operand;
+        else if (isEqualDouble(operand->value.number, neutral))
+            neutralCount++;
+    }
+
+    if (!zero && !neutralCount)
+        return node;
+
+    if (changedTree)
+        *changedTree = true;
+    simplifyCounters.rewrites++;
+
+    bool narrate = texStep(tex, depth);
+    if (narrate) {
+        exprTexDefine(tex, context, node);
+        texPrintf(tex, "Как сказано в трудах Знаменской Л. Н., $");
+        exprTexDumpRecursive(tex, context, node);
+        texPrintf(tex, " = ");
+    }
+
+    Node_t *result = node;
+    if (zero) {
+        // x * 0 * y = 0
+        for (size_t idx = 0; idx < node->operandsCount; idx++) {
+            if (node->operands[idx] == zero)
+                node->operands[idx] = NULL;
+        }
+        zero->parent = node->parent;
+        result = zero;
+        deleteTree(node);
+    } else {
+        // at least one operand is kept: 0 + 0 = 0
+        size_t writeIdx = 0;
+        for (size_t readIdx = 0; readIdx < node->operandsCount; readIdx++) {
+            Node_t *operand = node->operands[readIdx];
+            bool isNeutral = operand->type == NUMBER && isEqualDouble(operand->value.number, neutral);
+            bool lastChance = writeIdx == 0 && readIdx == node->operandsCount - 1;
+
+            if (isNeutral && !lastChance)
+                deleteTree(operand);
+            else
+                node->operands[writeIdx++] = operand;
+        }
+        node->operandsCount = writeIdx;
+
+        if (writeIdx == 1) {
+            result = node->operands[0];
+            result->parent = node->parent;
+            nodeFree(node);
+        } else
+            updateNodeInfo(node);
+    }
+
+    if (narrate) {
+        exprTexDumpRecursive(tex, context, result);
+        texPrintf(tex, "$\n\n");
+        exprTexFlush(tex, context);
+    }
+
+    return result;
+}
+
+static Node_t *simplifyNode(TexContext_t *tex, TungstenContext_t *context, Node_t *node, size_t depth,
+                            bool *changedTree);
+
+/// @brief Remove neutral operations and apply identities of current rewrite rules to node,
+/// operands must be already processed
+/// @param depth Depth of node in tree for narration budget
+static Node_t *removeNeutralNode(TexContext_t *tex, TungstenContext_t *context, Node_t *node, size_t depth,
+                                 bool *changedTree) {
     assert(node);
 
     if (node->type == NUMBER || node->type == VARIABLE)
         return node;
 
-    if (node->left)
-        node->left = removeNeutralOperations(tex, context, node->left, changedTree);
+    // operands could be replaced by their simplified forms
+    updateNodeInfo(node);
+    if (node->operandsCount) {
+        node = removeNeutralOperands(tex, context, node, depth, changedTree);
+        if (node->type != OPERATOR || !node->operandsCount)
+            return node;
+    }
 
-    if (node->right)
-        node->right = removeNeutralOperations(tex, context, node->right, changedTree);
+    // new nodes of replacement are simplified on the spot: (x^2)^3 = x^(2*3) = x^6
+    Node_t *result = rewriteNode(tex, context, rewriteRulesCurrent(), node, depth, changedTree, simplifyNode);
+    if (result != node)
+        simplifyCounters.rewrites++;
+    return result;
+}
 
-    Node_t *result = node;
-    bool leftIsNumber  = (node->left->type == NUMBER);
-    bool rightIsNumber = (node->right && node->right->type == NUMBER);
-
-    bool leftIsZero    = leftIsNumber && isEqualDouble(node->left->value.number, 0);
-    bool leftIsOne     = leftIsNumber && isEqualDouble(node->left->value.number, 1);
-
-    bool rightIsZero   = rightIsNumber && isEqualDouble(node->right->value.number, 0);
-    bool rightIsOne    = rightIsNumber && isEqualDouble(node->right->value.number, 1);
-
-    if (node->type == OPERATOR) {
-        if (node->value.op == ADD) {
-        /*ADDITION*/
-            if (leftIsZero) {
-            // 0 + x = x
-                node->right->parent = node->parent;
-                result = node->right;
-            } else if (rightIsZero) {
-            // x + 0 = 0
-                node->left->parent = node->parent;
-                result = node->left;
-            }
+/*
+Like terms are collected in n-ary sums and products. Operand of sum is split into numeric
+coefficient and term (3*x*y -> 3 and x*y), operand of product into base and exponent (x^2 -> x and 2).
+Operands are sorted by their terms with compareTrees(), so like terms become neighbours and are
+collected in one scan. Sorted order is canonical: a*b and b*a become equal trees with equal hashes.
+*/
+
+/// @brief Operand of sum or product split into term and its coefficient or exponent
+typedef struct {
+    Node_t *node;           ///< Operand, NULL if it was collected into another operand
+    Node_t **factors;       ///< Term of sum without coefficient or base of power
+    size_t factorsCount;    ///< 0 for number, it is never collected
+    Node_t *factor;         ///< Coefficient or exponent node, NULL if it is implicit 1
+    double number;          ///< Value of coefficient or exponent, 0 for not numeric exponent
+} LikeTerm_t;
+
+/// @brief Split operand of n-ary node with operator op
+static LikeTerm_t splitOperand(enum OperatorType op, Node_t **slot) {
+    Node_t *node = *slot;
+    LikeTerm_t term = {node, slot, 1, NULL, 1};
+
+    if (node->type == NUMBER) {
+        term.factorsCount = 0;
+        term.number = node->value.number;
+    } else if (node->type != OPERATOR) {
+        return term;
+    } else if (op == ADD && node->value.op == MUL) {
+        bool withNumber = (node->operandsCount) ? node->operands[0]->type == NUMBER : node->left->type == NUMBER;
+        if (withNumber)
+            term.factor = (node->operandsCount) ? node->operands[0] : node->left;
+
+        if (node->operandsCount) {
+            term.factors = node->operands + withNumber;
+            term.factorsCount = node->operandsCount - withNumber;
+        } else if (withNumber)
+            term.factors = &node->right;
+
+        if (term.factor)
+            term.number = term.factor->value.number;
+    } else if (op == MUL && node->value.op == POW) {
+        term.factors = &node->left;
+        term.factor = node->right;
+        term.number = (node->right->type == NUMBER) ? node->right->value.number : 0;
+    }
+    return term;
+}
+
+/// @brief Order of terms in sum or bases in product, numbers go first
+static int compareLikeTerms(const void *first, const void *second) {
+    const LikeTerm_t *firstTerm = (const LikeTerm_t *) first, *secondTerm = (const LikeTerm_t *) second;
 
-        } else if (node->value.op == SUB) {
-        /*SUBSTRACTION*/
-            if (rightIsZero) {
-            // x - 0 = x
-                node->left->parent = node->parent;
-                result = node->left;
+    size_t count = (firstTerm->factorsCount < secondTerm->factorsCount) ? firstTerm->factorsCount
+                                                                        : secondTerm->factorsCount;
+    for (size_t idx = 0; idx < count; idx++) {
+        int result = compareTrees(firstTerm->factors[idx], secondTerm->factors[idx]);
+        if (result)
+            return result;
+    }
+
+    return (firstTerm->factorsCount > secondTerm->factorsCount) - (firstTerm->factorsCount < secondTerm->factorsCount);
+}
+
+/// @brief Collect like terms of sum into one of them: 2*x + x = 3*x
+static TungstenStatus_t collectSumTerms(LikeTerm_t *group, size_t count, Node_t **result) {
+    // operand with coefficient node is changed in place
+    LikeTerm_t *collected = group;
+    double coefficient = 0;
+    for (size_t idx = 0; idx < count; idx++) {
+        coefficient += group[idx].number;
+        if (!collected->factor && group[idx].factor)
+            collected = group + idx;
+    }
+
+    Node_t *node = collected->node;
+    if (isEqualDouble(coefficient, 0)) {
+        node = NULL;
+    } else if (!collected->factor) {
+        // all terms are without coefficient, so it is at least 2
+        Node_t *number = NUM_(coefficient);
+        if (!number)
+            return TA_MEMORY_ERROR;
+
+        if (node->type == OPERATOR && node->value.op == MUL && node->operandsCount) {
+            if (appendOperand(node, number) != TA_SUCCESS) {
+                deleteTree(number);
+                return TA_MEMORY_ERROR;
             }
-        } else if (node->value.op == MUL) {
-        /*MULTIPLICATION*/
-            if (leftIsOne) {
-                node->right->parent = node->parent;
-                result = node->right;
-            } else if (leftIsZero) {
-                node->left->parent = node->parent;
-                result = node->left;
-            } else if (rightIsOne) {
-                node->left->parent = node->parent;
-                result = node->left;
-            } else if (rightIsZero) {
-                node->right->parent = node->parent;
-                result = node->right;
+            memmove(node->operands + 1, node->operands, (node->operandsCount - 1) * sizeof(Node_t *));
+            node->operands[0] = number;
+            updateNodeInfo(node);
+        } else {
+            Node_t *operands[] = {number, node};
+            node = createNaryNode(MUL, operands, 2);
+            if (!node) {
+                deleteTree(number);
+                return TA_MEMORY_ERROR;
             }
+        }
+    } else if (isEqualDouble(coefficient, 1) && collected->factorsCount == 1) {
+        // 1 * x = x
+        node = collected->factors[0];
+        collected->factors[0] = NULL;
+        deleteTree(collected->node);
+    } else if (isEqualDouble(coefficient, 1)) {
+        deleteTree(node->operands[0]);
+        memmove(node->operands, node->operands + 1, (node->operandsCount - 1) * sizeof(Node_t *));
+        node->operandsCount--;
+        updateNodeInfo(node);
+    } else {
+        collected->factor->value.number = coefficient;
+        updateNodeInfo(collected->factor);
+        updateNodeInfo(node);
+    }
 
-        } else if (node->value.op == POW) {
-        /*POWER*/
-            if (rightIsOne) {
-            // x ^ 1 = x
-                node->left->parent = node->parent;
-                result = node->left;
-            } else if (rightIsZero) {
-            // x ^ 0 = 1
-                node->right->parent = node->parent;
-                node->right->value.number = 1;
-                result = node->right;
-            } else if (leftIsZero) {
-            //0 ^ x = 0
-                node->left->parent = node->parent;
-                result = node->left;
-            }
+    for (size_t idx = 0; idx < count; idx++) {
+        if (group + idx != collected || !node)
+            deleteTree(group[idx].node);
+    }
+    *result = node;
+    return TA_SUCCESS;
+}
+
+/// @brief Collect powers of the same base in product into one of them: x^a * x^2 * x = x^(a+3)
+static TungstenStatus_t collectProductTerms(TungstenContext_t *context, LikeTerm_t *group, size_t count,
+                                            Node_t **result) {
+    // power is changed in place
+    LikeTerm_t *collected = group;
+    double exponent = 0;
+    size_t symbolicCount = 0;
+    for (size_t idx = 0; idx < count; idx++) {
+        exponent += group[idx].number;
+        symbolicCount += group[idx].factor && group[idx].factor->type != NUMBER;
+        if (!collected->factor && group[idx].factor)
+            collected = group + idx;
+    }
+
+    Node_t *node = collected->node;
+    if (symbolicCount) {
+        Node_t **exponents = (Node_t **) calloc(symbolicCount + 1, sizeof(Node_t *));
+        if (!exponents)
+            return TA_MEMORY_ERROR;
+
+        size_t exponentsCount = 0;
+        for (size_t idx = 0; idx < count; idx++) {
+            if (group[idx].factor && group[idx].factor->type != NUMBER)
+                exponents[exponentsCount++] = group[idx].factor;
+        }
+
+        Node_t *number = (isEqualDouble(exponent, 0)) ? NULL : NUM_(exponent);
+        if (number)
+            exponents[exponentsCount++] = number;
+
+        Node_t *sum = NULL;
+        if (exponentsCount == 1)
+            sum = exponents[0];
+        else if (number || isEqualDouble(exponent, 0))
+            sum = createNaryNode(ADD, exponents, exponentsCount);
+        free(exponents);
+        if (!sum) {
+            deleteTree(number);
+            return TA_MEMORY_ERROR;
+        }
+
+        // exponents are moved to sum, collected power gets it instead of its own exponent
+        for (size_t idx = 0; idx < count; idx++) {
+            if (group[idx].factor && group[idx].factor->type != NUMBER)
+                group[idx].node->right = NULL;
         }
+        deleteTree(node->right);
+        node->right = simplifyNode(NULL, context, sum, 0, NULL);
+        node->right->parent = node;
+        updateNodeInfo(node);
+        node = removeNeutralNode(NULL, context, node, 0, NULL);
+    } else if (isEqualDouble(exponent, 0)) {
+        node = NULL;
+    } else if (!collected->factor) {
+        // all operands are bases without exponent, so it is at least 2
+        Node_t *number = NUM_(exponent);
+        Node_t *power = (number) ? OPR_(POW, node, number) : NULL;
+        if (!power) {
+            deleteTree(number);
+            return TA_MEMORY_ERROR;
+        }
+        node = power;
+    } else if (isEqualDouble(exponent, 1)) {
+        // x^2 * x^(-1) = x
+        node = node->left;
+        collected->node->left = NULL;
+        deleteTree(collected->node);
+    } else {
+        collected->factor->value.number = exponent;
+        updateNodeInfo(collected->factor);
+        updateNodeInfo(node);
     }
 
-    if (result != node) {
-        if (changedTree)
-            *changedTree = true;
-        //unlinking result subtree from node to use deleteTree() function
+    for (size_t idx = 0; idx < count; idx++) {
+        if (group + idx != collected || !node)
+            deleteTree(group[idx].node);
+    }
+    *result = node;
+    return TA_SUCCESS;
+}
 
+/// @brief Sort operands of n-ary sum or product in canonical order and collect like terms,
+/// operands must be already processed and numbers folded
+/// @param depth Depth of node in tree for narration budget
+static Node_t *collectLikeTermsNode(TexContext_t *tex, TungstenContext_t *context, Node_t *node, size_t depth,
+                                    bool *changedTree) {
+    assert(node);
 
-        texPrintf(tex, "Как сказано в трудах Знаменской Л. Н., $");
+    if (node->type != OPERATOR || !node->operandsCount || (node->value.op != ADD && node->value.op != MUL))
+        return node;
 
+    enum OperatorType op = node->value.op;
+    size_t count = node->operandsCount;
+    LikeTerm_t *terms = (LikeTerm_t *) calloc(count, sizeof(LikeTerm_t));
+    if (!terms) {
+        logPrint(L_ZERO, 1, "Not enough memory to collect like terms of node[%p]\n", node);
+        return node;
+    }
 
-        exprTexDumpRecursive(tex, context, node);
+    for (size_t idx = 0; idx < count; idx++)
+        terms[idx] = splitOperand(op, node->operands + idx);
+    qsort(terms, count, sizeof(LikeTerm_t), compareLikeTerms);
+
+    bool collected = false, narrate = false;
+    size_t groupStart = 0;
+    for (size_t idx = 1; idx <= count; idx++) {
+        if (idx < count && terms[idx].factorsCount && !compareLikeTerms(terms + groupStart, terms + idx))
+            continue;
+
+        size_t groupSize = idx - groupStart;
+        if (groupSize > 1) {
+            if (!collected) {
+                // report is started before the first change of operands
+                collected = true;
+                narrate = texStep(tex, depth);
+                if (narrate) {
+                    exprTexDefine(tex, context, node);
+                    texPrintf(tex, (op == ADD) ? "Приведём подобные слагаемые: $"
+                                               : "Соберём степени одинаковых множителей: $");
+                    exprTexDumpRecursive(tex, context, node);
+                    texPrintf(tex, " = ");
+                }
+            }
 
-        texPrintf(tex, " = ");
+            Node_t *result = NULL;
+            TungstenStatus_t status = (op == ADD) ? collectSumTerms(terms + groupStart, groupSize, &result)
+                                                  : collectProductTerms(context, terms + groupStart, groupSize, &result);
+            if (status == TA_SUCCESS) {
+                for (size_t termIdx = groupStart; termIdx < idx; termIdx++)
+                    terms[termIdx].node = NULL;
+                terms[groupStart].node = result;
+                simplifyCounters.rewrites++;
+            } else
+                logPrint(L_ZERO, 1, "Not enough memory to collect like terms of node[%p]\n", node);
+        }
+        groupStart = idx;
+    }
+
+    bool reordered = false;
+    size_t writeIdx = 0;
+    for (size_t idx = 0; idx < count; idx++) {
+        if (!terms[idx].node)
+            continue;
+
+        reordered = reordered || node->operands[writeIdx] != terms[idx].node;
+        node->operands[writeIdx++] = terms[idx].node;
+        terms[idx].node->parent = node;
+    }
+    free(terms);
+
+    if ((collected || reordered) && changedTree)
+        *changedTree = true;
+
+    Node_t *result = node;
+    if (writeIdx == 0) {
+        // all terms cancelled out: x + (-1)*x or x^2 * x^(-2)
+        operandsFree(node->operands);
+        node->operands = NULL;
+        node->operandsCount = 0;
+        node->type = NUMBER;
+        node->value.number = (op == MUL) ? 1 : 0;
+        updateNodeInfo(node);
+    } else if (writeIdx == 1) {
+        result = node->operands[0];
+        result->parent = node->parent;
+        nodeFree(node);
+    } else {
+        node->operandsCount = writeIdx;
+        updateNodeInfo(node);
+    }
+
+    if (narrate) {
         exprTexDumpRecursive(tex, context, result);
         texPrintf(tex, "$\n\n");
+        exprTexFlush(tex, context);
+    }
 
-        if (result == node->left)
-            node->left = NULL;
-        else
-            node->right = NULL;
+    return result;
+}
 
-        deleteTree(node);
+/// @brief Slot in parent which holds subtree
+typedef struct {
+    Node_t **slot;
+    size_t depth;               ///< Depth of subtree root, root of tree has depth 0
+    bool operandsDone;
+} NeutralFrame_t;
+
+TREE_STACK_DEFINE(NeutralStack, NeutralFrame_t)
+
+/// @brief Push slots of operands of node, so the first operand is on top
+static bool pushOperandFrames(NeutralStack_t *stack, Node_t *node, size_t depth) {
+    bool pushed = true;
+    for (size_t idx = node->operandsCount; idx > 0 && pushed; idx--) {
+        NeutralFrame_t operand = {node->operands + idx - 1, depth + 1, false};
+        pushed = NeutralStackPush(stack, operand);
     }
-    return result;
+
+    NeutralFrame_t left = {&node->left, depth + 1, false}, right = {&node->right, depth + 1, false};
+    if (node->right)
+        pushed = pushed && NeutralStackPush(stack, right);
+    if (node->left)
+        pushed = pushed && NeutralStackPush(stack, left);
+    return pushed;
+}
+
+/// @brief Rule applied to node after its operands
+typedef Node_t *(*SimplifyRule_t)(TexContext_t *tex, TungstenContext_t *context, Node_t *node, size_t depth,
+                                  bool *changedTree);
+
+/// @brief Apply rule to every operator node of tree in post-order
+static Node_t *applyRule(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool *changedTree,
+                         SimplifyRule_t rule) {
+    assert(node);
+
+    NeutralFrame_t buffer[TREE_STACK_MIN_CAPACITY] = {};
+    NeutralStack_t stack = NeutralStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+
+    // post-order traversal, result of every node is written to the slot of its parent
+    NeutralFrame_t root = {&node, 0, false};
+    bool memoryOk = NeutralStackPush(&stack, root);
+    while (stack.size && memoryOk) {
+        NeutralFrame_t *frame = NeutralStackTop(&stack);
+        Node_t *current = *frame->slot;
+
+        if (current->type != OPERATOR) {
+            NeutralStackPop(&stack);
+            continue;
+        }
+
+        if (!frame->operandsDone) {
+            frame->operandsDone = true;
+
+            memoryOk = pushOperandFrames(&stack, current, frame->depth);
+            continue;
+        }
+
+        NeutralFrame_t done = NeutralStackPop(&stack);
+        *done.slot = rule(tex, context, current, done.depth, changedTree);
+    }
+
+    if (!memoryOk)
+        logPrint(L_ZERO, 1, "Not enough memory to simplify tree[%p]\n", node);
+
+    NeutralStackDtor(&stack);
+    return node;
+}
+
+Node_t *removeNeutralOperations(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool *changedTree) {
+    return applyRule(tex, context, node, changedTree, removeNeutralNode);
+}
+
+Node_t *collectLikeTerms(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool *changedTree) {
+    return applyRule(tex, context, node, changedTree, collectLikeTermsNode);
+}
+
+/// @brief All rules of simplifier for one node, its operands must be already simplified
+static Node_t *simplifyNode(TexContext_t *tex, TungstenContext_t *context, Node_t *node, size_t depth,
+                            bool *changedTree) {
+    node = foldConstantsNode(tex, context, node, changedTree, false);
+    node = collectLikeTermsNode(tex, context, node, depth, changedTree);
+    return removeNeutralNode(tex, context, node, depth, changedTree);
+}
+
+/*
+One post-order pass simplifies tree completely. Every rule replaces node by its own subtree
+or by a number, so it never creates new work below the node, and all nodes above it are
+visited later. Collection of like terms is the only rule that builds nodes (3*x, x^2, x^(a+b)),
+their operands are already simplified and new sum of exponents is simplified on the spot.
+Inner nodes of commutative chain are skipped: the top node of chain flattens it
+after all its operands are simplified, including operands that became nodes of the same
+operator (e.g. (a + b) * 1), and puts the only number first, where removeNeutralNode() sees it.
+*/
+static Node_t *simplifyTree(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool *changedTree) {
+    assert(node);
+
+    NeutralFrame_t buffer[TREE_STACK_MIN_CAPACITY] = {};
+    NeutralStack_t stack = NeutralStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+
+    NeutralFrame_t root = {&node, 0, false};
+    bool memoryOk = NeutralStackPush(&stack, root);
+    while (stack.size && memoryOk) {
+        NeutralFrame_t *frame = NeutralStackTop(&stack);
+        Node_t *current = *frame->slot;
+
+        if (current->type != OPERATOR) {
+            NeutralStackPop(&stack);
+            simplifyCounters.visited++;
+            continue;
+        }
+
+        if (!frame->operandsDone) {
+            frame->operandsDone = true;
+
+            memoryOk = pushOperandFrames(&stack, current, frame->depth);
+            continue;
+        }
+
+        NeutralFrame_t done = NeutralStackPop(&stack);
+        simplifyCounters.visited++;
+
+        bool chainNode = done.slot != &node && operators[current->value.op].commutative &&
+                         current->parent->value.op == current->value.op;
+        if (chainNode)
+            continue;
+
+        *done.slot = simplifyNode(tex, context, current, done.depth, changedTree);
+    }
+
+    if (!memoryOk)
+        logPrint(L_ZERO, 1, "Not enough memory to simplify tree[%p]\n", node);
+
+    NeutralStackDtor(&stack);
+    return node;
 }
 
 Node_t *simplifyExpression(TexContext_t *tex, TungstenContext_t *context, Node_t *node) {
-    bool changedTree = false;
     bool anyChangesMade = false;
-    Node_t *copy = copyTree(node);
+    bool narrate = texNarrating(tex);
+
+    ExprCache_t *cache = exprCacheCurrent();
+    // result depends on rewrite rules, so they are part of key
+    uint64_t rules = rewriteRulesCurrent()->hash;
+    Node_t *cached = exprCacheFind(cache, CACHE_SIMPLIFY, NULL_VARIABLE, rules, node);
 
-    do {
-        changedTree = false;
-        node = foldConstants(tex, context, node, &changedTree);
-        node = removeNeutralOperations(tex, context, node, &changedTree);
-        anyChangesMade = anyChangesMade || changedTree;
-    } while (changedTree);
+    // tree is simplified in place, so it is copied only for report and cache
+    Node_t *copy = NULL;
+    if (narrate || (!cached && exprCacheAdmit(cache, CACHE_SIMPLIFY, NULL_VARIABLE, rules, node)))
+        copy = copyTree(node);
+
+    if (cached) {
+        anyChangesMade = !equalTrees(node, cached);
+        deleteTree(node);
+        node = cached;
+    } else {
+        simplifyCounters.calls++;
+        node = simplifyTree(tex, context, node, &anyChangesMade);
+
+        if (copy)
+            exprCacheInsert(cache, CACHE_SIMPLIFY, NULL_VARIABLE, rules, copy, node);
+    }
 
-    if (anyChangesMade) {
+    texSummary(tex);
+    if (anyChangesMade && narrate && copy) {
+        exprTexDefine(tex, context, copy);
+        exprTexDefine(tex, context, node);
         texPrintf(tex, "В результате получаем:\n\n$");
         exprTexDumpRecursive(tex, context, copy);
         texPrintf(tex, " = ");
         exprTexDumpRecursive(tex, context, node);
         texPrintf(tex, "$\n\n");
+        exprTexFlush(tex, context);
     }
 
     deleteTree(copy);
@@ -12,6 +12,9 @@
 #include "hashTable.h"
 #include "tex.h"
 #include "exprTree.h"
+#include "exprCompiler.h"
+#include "nodeArena.h"
+#include "treeStack.h"
 
 #include "treeDSL.h"
 
@@ -65,7 +68,10 @@ TungstenStatus_t TungstenDtor(TungstenContext_t *context) {
 Node_t *createNode(enum ElemType type, int iVal, double dVal, Node_t *left, Node_t *right) {
     logPrint(L_EXTRA, 0, "ExprTree:Creating node\n");
 
-    Node_t *newNode = CALLOC(1, Node_t);
+    Node_t *newNode = nodeAlloc();
+    if (!newNode)
+        return NULL;
+
     newNode->type = type;
     newNode->left  = left;
     newNode->right = right;
@@ -89,49 +95,423 @@ Node_t *createNode(enum ElemType type, int iVal, double dVal, Node_t *left, Node
             assert(0);
     }
 
+    updateNodeInfo(newNode);
+
     logPrint(L_EXTRA, 0, "ExprTree:Created node[%p]\n", newNode);
     return newNode;
 }
 
-Node_t *copyTree(Node_t *node) {
-    assert(node);
+Node_t *createNaryNode(enum OperatorType op, Node_t *const *operands, size_t count) {
+    assert(operators[op].commutative);
+    assert(operands);
 
-    logPrint(L_EXTRA, 0, "ExprTree:Copying node[%p]\n", node);
+    Node_t *newNode = nodeAlloc();
+    Node_t **newOperands = (newNode) ? operandsAlloc(newNode, count) : NULL;
+    if (!newNode || !newOperands) {
+        nodeFree(newNode);
+        operandsFree(newOperands);
+        return NULL;
+    }
 
-    Node_t *left  = (node->left)  ? copyTree(node->left)  : NULL,
-           *right = (node->right) ? copyTree(node->right) : NULL;
+    newNode->type = OPERATOR;
+    newNode->value.op = op;
+    newNode->operands = newOperands;
+    newNode->operandsCount = count;
+    for (size_t idx = 0; idx < count; idx++) {
+        newOperands[idx] = operands[idx];
+        operands[idx]->parent = newNode;
+    }
 
-    return createNode(node->type, node->value.var, node->value.number, left, right);
+    updateNodeInfo(newNode);
+    return newNode;
 }
 
-double evaluate(TungstenContext_t *context, const Node_t *node) {
+TungstenStatus_t appendOperand(Node_t *node, Node_t *operand) {
     assert(node);
+    assert(operand);
+    assert(node->operands);
+
+    if (node->operandsCount == operandsCapacity(node->operands)) {
+        Node_t **newOperands = operandsRealloc(node, 2 * node->operandsCount);
+        if (!newOperands)
+            return TA_MEMORY_ERROR;
+        node->operands = newOperands;
+    }
 
-    logPrint(L_EXTRA, 0, "ExprTree:Evaluating node[%p]\n", node);
+    node->operands[node->operandsCount++] = operand;
+    operand->parent = node;
 
-    switch(node->type) {
-        case VARIABLE:
-            return getVariable(context, node->value.var);
-        case NUMBER:
-            return node->value.number;
-        case OPERATOR:
-        {
-            double leftValue = 0, rightValue = 0;
-            leftValue = evaluate(context, node->left);
+    // the same as updateNodeInfo(), but in O(1)
+    node->hash = hashMix(node->hash, operand->hash);
+    node->size += operand->size;
+    node->varMask |= operand->varMask;
+    return TA_SUCCESS;
+}
+
+/// @brief Node to copy and place where its copy must be written
+typedef struct {
+    const Node_t *node;
+    Node_t *parent;
+    Node_t **slot;
+} CopyFrame_t;
+
+TREE_STACK_DEFINE(CopyStack, CopyFrame_t)
+TREE_STACK_DEFINE(ConstNodeStack, const Node_t *)
+TREE_STACK_DEFINE(NodeStack, Node_t *)
+
+Node_t *copyTree(const Node_t *node) {
+    assert(node);
+
+    logPrint(L_EXTRA, 0, "ExprTree:Copying tree[%p]\n", node);
+
+    CopyFrame_t buffer[TREE_STACK_MIN_CAPACITY] = {};
+    CopyStack_t stack = CopyStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+
+    // nodes are copied top-down, every copy is linked to already created parent
+    Node_t *result = NULL;
+    CopyFrame_t root = {node, NULL, &result};
+    CopyStackPush(&stack, root);
+
+    while (stack.size) {
+        CopyFrame_t frame = CopyStackPop(&stack);
+        Node_t *copy = createNode(frame.node->type, frame.node->value.var, frame.node->value.number, NULL, NULL);
+        if (!copy) {
+            logPrint(L_ZERO, 1, "ExprTree:Failed to copy tree[%p]\n", node);
+            break;
+        }
+
+        copy->parent = frame.parent;
+        copy->hash = frame.node->hash;
+        copy->size = frame.node->size;
+        copy->varMask = frame.node->varMask;
+        *frame.slot = copy;
+
+        bool pushed = true;
+        if (frame.node->operandsCount) {
+            copy->operands = operandsAlloc(copy, frame.node->operandsCount);
+            pushed = copy->operands;
+            if (pushed)
+                copy->operandsCount = frame.node->operandsCount;
+
+            for (size_t idx = copy->operandsCount; idx > 0 && pushed; idx--) {
+                CopyFrame_t operand = {frame.node->operands[idx - 1], copy, copy->operands + idx - 1};
+                pushed = CopyStackPush(&stack, operand);
+            }
+        }
+        if (frame.node->right) {
+            CopyFrame_t right = {frame.node->right, copy, &copy->right};
+            pushed = CopyStackPush(&stack, right);
+        }
+        if (frame.node->left) {
+            CopyFrame_t left = {frame.node->left, copy, &copy->left};
+            pushed = pushed && CopyStackPush(&stack, left);
+        }
+
+        if (!pushed) {
+            logPrint(L_ZERO, 1, "ExprTree:Not enough memory to copy tree[%p]\n", node);
+            break;
+        }
+    }
+
+    bool failed = stack.size > 0;
+    CopyStackDtor(&stack);
+    if (failed) {
+        deleteTree(result);
+        return NULL;
+    }
+
+    return result;
+}
+
+size_t countNodes(const Node_t *node) {
+    if (!node) return 0;
+
+    const Node_t *buffer[TREE_STACK_MIN_CAPACITY] = {};
+    ConstNodeStack_t stack = ConstNodeStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+    ConstNodeStackPush(&stack, node);
 
-            if (operators[node->value.op].binary)
-                rightValue = evaluate(context, node->right);
+    size_t count = 0;
+    while (stack.size) {
+        const Node_t *current = ConstNodeStackPop(&stack);
+        count++;
 
-            return calculateOperation(node->value.op, leftValue, rightValue);
+        bool pushed = true;
+        for (size_t idx = 0; idx < current->operandsCount && pushed; idx++)
+            pushed = ConstNodeStackPush(&stack, current->operands[idx]);
+
+        if (!pushed ||
+            (current->left  && !ConstNodeStackPush(&stack, current->left)) ||
+            (current->right && !ConstNodeStackPush(&stack, current->right))) {
+            logPrint(L_ZERO, 1, "ExprTree:Not enough memory to count nodes of tree[%p]\n", node);
             break;
         }
+    }
+
+    ConstNodeStackDtor(&stack);
+    return count;
+}
+
+uint64_t hashMix(uint64_t hash, uint64_t value) {
+    return hash ^ (value + 0x9E3779B97F4A7C15 + (hash << 6) + (hash >> 2));
+}
+
+uint64_t nodeValueBits(enum ElemType type, union NodeValue value) {
+    uint64_t bits = 0;
+    switch(type) {
+        case NUMBER:
+            memcpy(&bits, &value.number, sizeof(double));
+            break;
+        case OPERATOR:
+            bits = (uint64_t) value.op;
+            break;
+        case VARIABLE:
+            bits = (uint64_t) value.var;
+            break;
         default:
             assert(0);
             break;
     }
+    return bits;
+}
+
+void updateNodeInfo(Node_t *node) {
+    assert(node);
+
+    uint64_t hash = hashMix((uint64_t) node->type, nodeValueBits(node->type, node->value));
+
+    if (node->operandsCount) {
+        node->size = 1;
+        node->varMask = 0;
+        for (size_t idx = 0; idx < node->operandsCount; idx++) {
+            const Node_t *operand = node->operands[idx];
+            hash = hashMix(hash, operand->hash);
+            node->size += operand->size;
+            node->varMask |= operand->varMask;
+        }
+        node->hash = hash;
+        return;
+    }
+
+    hash = hashMix(hash, (node->left)  ? node->left->hash  : 0);
+    hash = hashMix(hash, (node->right) ? node->right->hash : 0);
+
+    node->hash = hash;
+    node->size = 1 + ((node->left)  ? node->left->size  : 0)
+                   + ((node->right) ? node->right->size : 0);
+
+    if (node->type == VARIABLE) {
+        assert(0 <= node->value.var && (size_t) node->value.var < VARIABLE_TABLE_SIZE);
+        node->varMask = 1ull << node->value.var;
+    } else
+        node->varMask = ((node->left)  ? node->left->varMask  : 0) |
+                        ((node->right) ? node->right->varMask : 0);
+}
+
+bool hasVariable(const Node_t *node, int variable) {
+    assert(node);
+    return (node->varMask >> variable) & 1;
+}
+
+typedef struct {
+    const Node_t *first;
+    const Node_t *second;
+} NodePair_t;
+
+TREE_STACK_DEFINE(NodePairStack, NodePair_t)
+
+bool equalTrees(const Node_t *first, const Node_t *second) {
+    NodePair_t buffer[TREE_STACK_MIN_CAPACITY] = {};
+    NodePairStack_t stack = NodePairStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+
+    NodePair_t root = {first, second};
+    bool equal = NodePairStackPush(&stack, root);
+    while (stack.size && equal) {
+        NodePair_t pair = NodePairStackPop(&stack);
+        if (!pair.first || !pair.second) {
+            equal = (pair.first == pair.second);
+            continue;
+        }
+
+        equal = pair.first->type == pair.second->type &&
+                pair.first->operandsCount == pair.second->operandsCount &&
+                nodeValueBits(pair.first->type, pair.first->value) ==
+                nodeValueBits(pair.second->type, pair.second->value);
+
+        for (size_t idx = 0; idx < pair.first->operandsCount && equal; idx++) {
+            NodePair_t operands = {pair.first->operands[idx], pair.second->operands[idx]};
+            equal = NodePairStackPush(&stack, operands);
+        }
+
+        NodePair_t left = {pair.first->left, pair.second->left}, right = {pair.first->right, pair.second->right};
+        equal = equal && NodePairStackPush(&stack, right) && NodePairStackPush(&stack, left);
+    }
+
+    NodePairStackDtor(&stack);
+    return equal;
+}
+
+/// @brief Numbers go first, then variables and operators
+static int typeRank(enum ElemType type) {
+    switch(type) {
+        case NUMBER:    return 0;
+        case VARIABLE:  return 1;
+        case OPERATOR:  return 2;
+        default:
+            assert(0);
+            return 0;
+    }
+}
+
+/// @brief Compare values of nodes of the same type, equal or unordered (NaN) numbers are ordered by their bits
+static int compareValues(const Node_t *first, const Node_t *second) {
+    if (first->type == NUMBER && first->value.number < second->value.number) return -1;
+    if (first->type == NUMBER && first->value.number > second->value.number) return  1;
+
+    uint64_t firstBits  = nodeValueBits(first->type, first->value),
+             secondBits = nodeValueBits(second->type, second->value);
+    return (firstBits > secondBits) - (firstBits < secondBits);
+}
+
+int compareTrees(const Node_t *first, const Node_t *second) {
+    NodePair_t buffer[TREE_STACK_MIN_CAPACITY] = {};
+    NodePairStack_t stack = NodePairStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+
+    // first different node in pre-order decides
+    int result = 0;
+    NodePair_t root = {first, second};
+    bool memoryOk = NodePairStackPush(&stack, root);
+    while (stack.size && memoryOk && !result) {
+        NodePair_t pair = NodePairStackPop(&stack);
+        if (!pair.first || !pair.second) {
+            result = (pair.first != NULL) - (pair.second != NULL);
+            continue;
+        }
+        if (pair.first == pair.second)
+            continue;
+
+        result = typeRank(pair.first->type) - typeRank(pair.second->type);
+        if (!result)
+            result = compareValues(pair.first, pair.second);
+        if (!result)
+            result = (pair.first->operandsCount > pair.second->operandsCount) -
+                     (pair.first->operandsCount < pair.second->operandsCount);
+        if (result)
+            continue;
+
+        NodePair_t left = {pair.first->left, pair.second->left}, right = {pair.first->right, pair.second->right};
+        memoryOk = NodePairStackPush(&stack, right) && NodePairStackPush(&stack, left);
+        for (size_t idx = pair.first->operandsCount; idx > 0 && memoryOk; idx--) {
+            NodePair_t operands = {pair.first->operands[idx - 1], pair.second->operands[idx - 1]};
+            memoryOk = NodePairStackPush(&stack, operands);
+        }
+    }
+
+    if (!memoryOk) {
+        logPrint(L_ZERO, 1, "ExprTree:Not enough memory to compare trees, comparing hashes\n");
+        result = (first->hash > second->hash) - (first->hash < second->hash);
+    }
+
+    NodePairStackDtor(&stack);
+    return result;
+}
+
+/// @brief Operator node and number of its evaluated arguments
+typedef struct {
+    const Node_t *node;
+    unsigned evaluatedArgs;
+} EvalFrame_t;
+
+TREE_STACK_DEFINE(EvalStack, EvalFrame_t)
+TREE_STACK_DEFINE(ValueStack, double)
+
+/// @brief Evaluate tree with values of variables from values or from context if values is NULL
+static double evaluateTree(const TungstenContext_t *context, const double *values, const Node_t *node) {
+    assert(node);
+    assert(context || values);
+
+    EvalFrame_t framesBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    double stackBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    EvalStack_t  frames = EvalStackCtor(framesBuffer, TREE_STACK_MIN_CAPACITY);
+    ValueStack_t stack  = ValueStackCtor(stackBuffer, TREE_STACK_MIN_CAPACITY);
+
+    EvalFrame_t root = {node, 0};
+    bool memoryOk = EvalStackPush(&frames, root);
+
+    // post-order traversal: arguments of operator are on top of value stack when it is computed
+    while (frames.size && memoryOk) {
+        EvalFrame_t *frame = EvalStackTop(&frames);
+        const Node_t *current = frame->node;
+
+        switch(current->type) {
+            case VARIABLE:
+                memoryOk = ValueStackPush(&stack, (values) ? values[current->value.var] :
+                                                             context->variables[current->value.var].number);
+                EvalStackPop(&frames);
+                break;
+            case NUMBER:
+                memoryOk = ValueStackPush(&stack, current->value.number);
+                EvalStackPop(&frames);
+                break;
+            case OPERATOR:
+            {
+                if (current->operandsCount) {
+                    // operands are accumulated from left to right as soon as they are evaluated
+                    if (frame->evaluatedArgs >= 2) {
+                        double rightValue = ValueStackPop(&stack);
+                        double leftValue  = ValueStackPop(&stack);
+                        ValueStackPush(&stack, calculateOperation(current->value.op, leftValue, rightValue));
+                    }
+
+                    if (frame->evaluatedArgs < current->operandsCount) {
+                        EvalFrame_t child = {current->operands[frame->evaluatedArgs++], 0};
+                        memoryOk = EvalStackPush(&frames, child);
+                    } else
+                        EvalStackPop(&frames);
+                    break;
+                }
+
+                bool binary = operators[current->value.op].binary;
+                if (frame->evaluatedArgs < 1u + binary) {
+                    EvalFrame_t child = {(frame->evaluatedArgs == 0) ? current->left : current->right, 0};
+                    frame->evaluatedArgs++;
+                    memoryOk = EvalStackPush(&frames, child);
+                    break;
+                }
+
+                double rightValue = (binary) ? ValueStackPop(&stack) : 0;
+                double leftValue  = ValueStackPop(&stack);
+                ValueStackPush(&stack, calculateOperation(current->value.op, leftValue, rightValue));
+                EvalStackPop(&frames);
+                break;
+            }
+            default:
+                assert(0);
+                break;
+        }
+    }
+
+    double result = 0.0;
+    if (memoryOk)
+        result = ValueStackPop(&stack);
+    else
+        logPrint(L_ZERO, 1, "ExprTree:Not enough memory to evaluate tree[%p]\n", node);
+
+    EvalStackDtor(&frames);
+    ValueStackDtor(&stack);
+    return result;
+}
+
+double evaluate(TungstenContext_t *context, const Node_t *node) {
+    assert(context);
+    logPrint(L_EXTRA, 0, "ExprTree:Evaluating tree[%p]\n", node);
+
+    return evaluateTree(context, NULL, node);
+}
+
+double evaluateWith(const Node_t *node, const double *values) {
+    assert(values);
 
-    assert(0);
-    return 0.0;
+    return evaluateTree(NULL, values, node);
 }
 
 TungstenStatus_t verifyTree(Node_t *node) {
@@ -216,6 +596,11 @@ static TungstenStatus_t recursiveDumpTree(TungstenContext_t *context, Node_t *no
         recursiveDumpTree(context, node->right, minified, dotFile);
     }
 
+    for (size_t idx = 0; idx < node->operandsCount; idx++) {
+        fprintf(dotFile, "\tnode%p -> node%p [label = \"%zu\"];\n", node, node->operands[idx], idx);
+        recursiveDumpTree(context, node->operands[idx], minified, dotFile);
+    }
+
     return TA_SUCCESS;
 }
 
@@ -224,19 +609,43 @@ TungstenStatus_t deleteTree(Node_t *node) {
 
     logPrint(L_EXTRA, 0, "ExprTree:Deleting tree[%p]\n", node);
 
-    if (node->left)
-        deleteTree(node->left);
+    Node_t *buffer[TREE_STACK_MIN_CAPACITY] = {};
+    NodeStack_t operands = NodeStackCtor(buffer, TREE_STACK_MIN_CAPACITY);
+
+    // rotating left subtrees to the right until there is no left child,
+    // so binary tree is deleted without any stack, only operands of n-ary nodes wait in it
+    while (node || operands.size) {
+        if (!node) {
+            node = NodeStackPop(&operands);
+            continue;
+        }
 
-    if (node->right)
-        deleteTree(node->right);
+        if (node->left) {
+            Node_t *left = node->left;
+            node->left = left->right;
+            left->right = node;
+            node = left;
+            continue;
+        }
 
-    free(node);
+        for (size_t idx = 0; idx < node->operandsCount; idx++) {
+            // operand is NULL in partially built copy
+            if (node->operands[idx] && !NodeStackPush(&operands, node->operands[idx]))
+                deleteTree(node->operands[idx]);
+        }
 
+        Node_t *right = node->right;
+        nodeFree(node);
+        node = right;
+    }
+
+    NodeStackDtor(&operands);
     return TA_SUCCESS;
 }
 
 int exprTexDump(TexContext_t *tex, TungstenContext_t *context, Node_t *node) {
     assert(node);
+    if (!texNarrating(tex)) return 0;
 
     int result = 0;
 
@@ -247,9 +656,120 @@ int exprTexDump(TexContext_t *tex, TungstenContext_t *context, Node_t *node) {
     return result;
 }
 
-static bool needBrackets(Node_t *node) {
+static int exprTexDumpNode(TexContext_t *tex, TungstenContext_t *context, Node_t *node, const Node_t *root);
+
+/// @brief Whether node is printed as placeholder in formula of root
+static bool texElided(const TexContext_t *tex, const Node_t *node, const Node_t *root) {
+    return tex->budget.maxNodes && node != root && node->size > tex->budget.maxNodes;
+}
+
+static int exprTexDumpDefinition(TexContext_t *tex, TungstenContext_t *context, const char *prefix,
+                                 Node_t *node, size_t name) {
+    int result = 0;
+
+    result += texPrintf(tex, "%s $\\mathcal{E}_{%zu} = ", prefix, name);
+    result += exprTexDumpNode(tex, context, node, node);
+    result += texPrintf(tex, "$\n\n");
+
+    return result;
+}
+
+static void texPushPending(TexContext_t *tex, Node_t *node) {
+    if (tex->pendingCount == tex->pendingCapacity) {
+        size_t newCapacity = (tex->pendingCapacity) ? 2 * tex->pendingCapacity : TEX_START_PLACEHOLDERS_CAPACITY;
+        Node_t **newPending = (Node_t **) realloc(tex->pending, newCapacity * sizeof(Node_t *));
+        if (!newPending) {
+            logPrint(L_ZERO, 1, "Not enough memory to define placeholder of tree[%p]\n", node);
+            return;
+        }
+        tex->pending = newPending;
+        tex->pendingCapacity = newCapacity;
+    }
+    tex->pending[tex->pendingCount++] = node;
+}
+
+static int exprTexDumpPlaceholder(TexContext_t *tex, Node_t *node) {
+    size_t name = texFindPlaceholder(tex, node->hash);
+    if (!name) {
+        name = texAddPlaceholder(tex, node->hash);
+        if (name)
+            texPushPending(tex, node);
+    }
+
+    return texPrintf(tex, "\\mathcal{E}_{%zu}", name);
+}
+
+/// @brief Big subtree whose placeholder is defined after placeholders of its children
+typedef struct {
+    Node_t *node;
+    size_t visitedArgs;
+} TexDefineFrame_t;
+
+TREE_STACK_DEFINE(TexDefineStack, TexDefineFrame_t)
+
+/// @brief Child of node by index: operands of n-ary node, then left and right, NULL after the last one
+static Node_t *texChild(Node_t *node, size_t idx) {
+    if (node->operandsCount)
+        return (idx < node->operandsCount) ? node->operands[idx] : NULL;
+
+    if (idx == 0)
+        return (node->left) ? node->left : node->right;
+    return (idx == 1 && node->left) ? node->right : NULL;
+}
+
+void exprTexDefine(TexContext_t *tex, TungstenContext_t *context, Node_t *node) {
+    assert(node);
+    if (!texNarrating(tex) || !tex->budget.maxNodes || node->size <= tex->budget.maxNodes) return;
+
+    TexDefineFrame_t stackBuffer[TREE_STACK_MIN_CAPACITY] = {};
+    TexDefineStack_t stack = TexDefineStackCtor(stackBuffer, TREE_STACK_MIN_CAPACITY);
+    TexDefineFrame_t root = {node, 0};
+    bool memoryOk = TexDefineStackPush(&stack, root);
+
+    // post-order walk over big subtrees, parent of big subtree is big too.
+    // Placeholder is named when subtree is entered, so equal subtrees and shared nodes of DAG
+    // are visited once, and defined when subtree is left, so after all its children
+    while (stack.size && memoryOk) {
+        TexDefineFrame_t *frame = TexDefineStackTop(&stack);
+        Node_t *current = frame->node;
+
+        Node_t *child = texChild(current, frame->visitedArgs++);
+        if (child) {
+            if (child->size > tex->budget.maxNodes && !texFindPlaceholder(tex, child->hash)) {
+                TexDefineFrame_t childFrame = {child, 0};
+                memoryOk = texAddPlaceholder(tex, child->hash) && TexDefineStackPush(&stack, childFrame);
+            }
+            continue;
+        }
+
+        TexDefineStackPop(&stack);
+        if (current != node)
+            exprTexDumpDefinition(tex, context, "Обозначим", current, texFindPlaceholder(tex, current->hash));
+    }
+
+    if (!memoryOk)
+        logPrint(L_ZERO, 1, "Not enough memory to define placeholders of tree[%p]\n", node);
+
+    TexDefineStackDtor(&stack);
+}
+
+void exprTexFlush(TexContext_t *tex, TungstenContext_t *context) {
+    if (!texNarrating(tex)) {
+        if (tex) tex->pendingCount = 0;
+        return;
+    }
+
+    // definitions may add new pending placeholders, they are printed in the same loop
+    while (tex->pendingCount) {
+        Node_t *node = tex->pending[--tex->pendingCount];
+        exprTexDumpDefinition(tex, context, "Здесь", node, texFindPlaceholder(tex, node->hash));
+    }
+}
+
+/// @brief Whether node needs brackets as operand of parent, parent is passed because DAG nodes have no parent links
+static bool needBrackets(const Node_t *node, const Node_t *parent) {
     assert(node);
-    if (!node->parent)
+    if (!parent)
         return false;
 
     if (node->type == VARIABLE)
@@ -262,9 +782,9 @@ static bool needBrackets(Node_t *node) {
         if (!operators[node->value.op].binary) return false;
 
         unsigned currentPriority = operators[node->value.op].priority;
-        unsigned parentPriority = operators[node->parent->value.op].priority;
+        unsigned parentPriority = operators[parent->value.op].priority;
 
-        return (operators[node->parent->value.op].opCode == POW || parentPriority > currentPriority);
+        return (operators[parent->value.op].opCode == POW || parentPriority > currentPriority);
     }
     return false;
 }
@@ -277,15 +797,16 @@ static size_t getSubtreeSize(Node_t *node) {
     return getSubtreeSize(node->left) + getSubtreeSize(node->right);
 }
 
-static int exprTexDumpWithBrackets(TexContext_t *tex, TungstenContext_t *context, Node_t *node, bool checkBrackets) {
+static int exprTexDumpWithBrackets(TexContext_t *tex, TungstenContext_t *context, Node_t *node,
+                                   const Node_t *parent, const Node_t *root, bool checkBrackets) {
     assert(node);
 
     int result = 0;
-    bool brackets = checkBrackets && needBrackets(node);
+    bool brackets = checkBrackets && !texElided(tex, node, root) && needBrackets(node, parent);
 
     if (brackets)
         result += texPrintf(tex, "(");
-    result += exprTexDumpRecursive(tex, context, node);
+    result += exprTexDumpNode(tex, context, node, root);
     if (brackets)
         result += texPrintf(tex, ")");
 
@@ -294,6 +815,18 @@ static int exprTexDumpWithBrackets(TexContext_t *tex, TungstenContext_t *context
 
 int exprTexDumpRecursive(TexContext_t *tex, TungstenContext_t *context, Node_t *node) {
     assert(node);
+    if (!texNarrating(tex)) return 0;
+
+    return exprTexDumpNode(tex, context, node, node);
+}
+
+/// @brief Print node of formula of root, big subtrees except root are printed as placeholders
+static int exprTexDumpNode(TexContext_t *tex, TungstenContext_t *context, Node_t *node, const Node_t *root) {
+    assert(node);
+
+    if (texElided(tex, node, root))
+        return exprTexDumpPlaceholder(tex, node);
+
     if (node->type == NUMBER)
         return texPrintf(tex, "%.4lg", node->value.number);
     if (node->type == VARIABLE)
@@ -303,33 +836,39 @@ int exprTexDumpRecursive(TexContext_t *tex, TungstenContext_t *context, Node_t *
 
     assert(node->type == OPERATOR);
 
-    if (operators[node->value.op].binary) {
+    if (node->operandsCount) {
+        for (size_t idx = 0; idx < node->operandsCount; idx++) {
+            if (idx)
+                result += texPrintf(tex, "%s ", operators[node->value.op].texStr);
+            result += exprTexDumpWithBrackets(tex, context, node->operands[idx], node, root, true);
+        }
+    } else if (operators[node->value.op].binary) {
         if (node->value.op == DIV) {
 
             result += texPrintf(tex, "\\frac{");
-            result += exprTexDumpRecursive(tex, context, node->left);
+            result += exprTexDumpNode(tex, context, node->left, root);
             result += texPrintf(tex, "}{");
-            result += exprTexDumpRecursive(tex, context, node->right);
+            result += exprTexDumpNode(tex, context, node->right, root);
             result += texPrintf(tex, "}");
 
         } else if (node->value.op == POW) {
 
-            result += exprTexDumpWithBrackets(tex, context, node->left, true);
+            result += exprTexDumpWithBrackets(tex, context, node->left, node, root, true);
             result += texPrintf(tex, "^{");
-            result += exprTexDumpRecursive(tex, context, node->right);
+            result += exprTexDumpNode(tex, context, node->right, root);
             result += texPrintf(tex, "}");
 
         } else {
 
-            result += exprTexDumpWithBrackets(tex, context, node->left, true);
+            result += exprTexDumpWithBrackets(tex, context, node->left, node, root, true);
             result += texPrintf(tex, "%s ", operators[node->value.op].texStr);
-            result += exprTexDumpWithBrackets(tex, context, node->right, true);
+            result += exprTexDumpWithBrackets(tex, context, node->right, node, root, true);
 
         }
     } else {
 
         result += texPrintf(tex, "%s ", operators[node->value.op].texStr);
-        result += exprTexDumpWithBrackets(tex, context, node->left, true);
+        result += exprTexDumpWithBrackets(tex, context, node->left, node, root, true);
     }
 
     return result;
@@ -339,6 +878,11 @@ TungstenStatus_t plotExprGraph(TexContext_t *tex, TungstenContext_t *context,
                                const Node_t *expr, const char *variable, const char *color,
                                double xMin, double xMax, double yMax, unsigned pointsCount) {
 
+    CompiledExpr_t compiled = {};
+    TungstenStatus_t status = compileExpression(expr, &compiled);
+    if (status != TA_SUCCESS)
+        return status;
+
     double *pointsMemory = CALLOC(pointsCount * 2, double);
     double *xCoords = pointsMemory;
     double *yCoords = pointsMemory + pointsCount;
@@ -346,22 +890,28 @@ TungstenStatus_t plotExprGraph(TexContext_t *tex, TungstenContext_t *context,
 
     double step = (xMax - xMin) / pointsCount;
 
-    for (unsigned idx = 0; idx < pointsCount; idx++) {
-        double currentX = xMin + step * idx;
-        setVariable(context, variable, currentX);
-        double yCoord = evaluate(context, expr);
+    for (unsigned idx = 0; idx < pointsCount; idx++)
+        xCoords[idx] = xMin + step * idx;
 
-        if (fabs(yCoord) < yMax) {
-            xCoords[calculatedPoints] = currentX;
-            yCoords[calculatedPoints] = yCoord;
+    BatchVariable_t input = {findVariable(context, variable), xCoords};
+    size_t inputsCount = (input.var != NULL_VARIABLE) ? 1 : 0;
+    status = evaluateBatch(context, &compiled, &input, inputsCount, yCoords, pointsCount);
+
+    // leaving only points with |y| < yMax, write position never overtakes read position
+    for (unsigned idx = 0; idx < pointsCount && status == TA_SUCCESS; idx++) {
+        if (fabs(yCoords[idx]) < yMax) {
+            xCoords[calculatedPoints] = xCoords[idx];
+            yCoords[calculatedPoints] = yCoords[idx];
             calculatedPoints++;
         }
     }
 
-    texAddGraph(tex, color, xCoords, yCoords, calculatedPoints);
+    if (status == TA_SUCCESS)
+        texAddGraph(tex, color, xCoords, yCoords, calculatedPoints);
 
     free(pointsMemory);
-    return TA_SUCCESS;
+    deleteCompiled(&compiled);
+    return status;
 }
 
 
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <math.h>
+#include <stdint.h>
 
 #include "hashTable.h"
 #include "logger.h"
@@ -9,6 +10,7 @@
 #include "tex.h"
 #include "exprTree.h"
 #include "derivative.h"
+#include "benchmark.h"
 #include "treeDSL.h"
 
 
@@ -22,7 +24,19 @@ int main(int argc, const char *argv[]) {
 
     registerFlag(TYPE_INT, "-t", "--taylor", "Compute taylor expansion");
     registerFlag(TYPE_FLOAT, "-p", "--point", "Point where taylor expansion is computed");
+    registerFlag(TYPE_BLANK, "-s", "--series", "Compute taylor coefficients by power series arithmetic");
+    registerFlag(TYPE_BLANK, "-b", "--bench", "Run evaluation benchmarks");
     processArgs(argc, argv);
+
+    if (isFlagSet("-b")) {
+        setLogLevel(L_ZERO);
+        TungstenContext_t benchContext = TungstenCtor();
+        bool passed = runBenchmarks(&benchContext);
+        TungstenDtor(&benchContext);
+        logClose();
+        return (passed) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // logDisableBuffering();
     TexContext_t tex = texInit("textest.tex");
     TungstenContext_t context = TungstenCtor();
@@ -39,6 +53,7 @@ int main(int argc, const char *argv[]) {
     expr = simplifyExpression(&tex, &context, expr);
     DUMP_TREE(&context, expr, false);
 
+    exprTexDefine(&tex, &context, expr);
     texPrintf(&tex, "Дано:");
     exprTexDump(&tex, &context, expr);
     texPrintf(&tex, "\n\n");
@@ -46,20 +61,28 @@ int main(int argc, const char *argv[]) {
     // exprTexDump(&tex, &context, expr);
     Node_t *diff = derivative(&tex, &context, expr, "x");
     DUMP_TREE(&context, diff, 0);
+    exprTexDefine(&tex, &context, diff);
     exprTexDump(&tex, &context, diff);
     texPrintf(&tex, "\n\n");
     diff = simplifyExpression(&tex, &context, diff);
     DUMP_TREE(&context, diff, 0);
 
+    exprTexDefine(&tex, &context, diff);
     texPrintf(&tex, "$$(");
     exprTexDumpRecursive(&tex, &context, expr);
     texPrintf(&tex, ")' = ");
     exprTexDumpRecursive(&tex, &context, diff);
     texPrintf(&tex, "$$\n\n");
 
-    if (isFlagSet("-t")) {
+    if (isFlagSet("-t") && getFlagValue("-t").int_ < 0) {
+        logPrint(L_ZERO, 1, "Order of Taylor expansion must be non-negative\n");
+    } else if (isFlagSet("-t")) {
+        size_t taylorOrder = (size_t) getFlagValue("-t").int_;
         double expansionPoint = (isFlagSet("-p")) ? getFlagValue("-p").float_ : 0;
-        Node_t *taylor = TaylorExpansion(&tex, &context, expr, "x", expansionPoint, getFlagValue("-t").int_);
+        TaylorOptions_t taylorOptions = {};
+        taylorOptions.backend = (isFlagSet("-s")) ? TAYLOR_SERIES : TAYLOR_SYMBOLIC;
+        taylorOptions.form = TAYLOR_HORNER;     // polynomial is only plotted, report keeps sum of powers
+        Node_t *taylor = TaylorExpansion(&tex, &context, expr, "x", expansionPoint, taylorOrder, &taylorOptions);
         // exprTexDump(&tex, &context, taylor);
 
         texBeginGraph(&tex, "x", "y", "График функций");
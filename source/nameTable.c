@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>
 
 #include "hashTable.h"
 #include "tex.h"
@@ -65,3 +66,26 @@ double getVariable(TungstenContext_t *tungsten, int varIdx) {
 
     return tungsten->variables[varIdx].number;
 }
+
+size_t resolveVariables(TungstenContext_t *tungsten, const char *const *names, size_t count, int *indices) {
+    assert(names);
+    assert(indices);
+
+    size_t found = 0;
+    for (size_t idx = 0; idx < count; idx++) {
+        indices[idx] = findVariable(tungsten, names[idx]);
+        if (indices[idx] != NULL_VARIABLE)
+            found++;
+        else
+            logPrint(L_DEBUG, 0, "Variable '%s' is not used in context\n", names[idx]);
+    }
+    return found;
+}
+
+void getVariableValues(const TungstenContext_t *tungsten, double *values) {
+    assert(tungsten);
+    assert(values);
+
+    for (size_t idx = 0; idx < tungsten->variablesCount; idx++)
+        values[idx] = tungsten->variables[idx].number;
+}
@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "nodeArena.h"
+
+/// Nodes are placed right after chunk header
+const size_t NODE_ARENA_CHUNK_NODES = (NODE_ARENA_CHUNK_SIZE - sizeof(NodeChunk_t)) / sizeof(Node_t);
+
+/// @brief Default arena of thread, its chunks are returned to system when thread exits
+typedef struct DefaultArena_t {
+    NodeArena_t arena;
+
+    // log can be closed at thread exit, so arena is released without report
+    ~DefaultArena_t() { nodeArenaRelease(&arena); }
+} DefaultArena_t;
+
+static thread_local DefaultArena_t defaultArena = {};
+static thread_local NodeArena_t *currentArena = NULL;
+
+static inline Node_t *chunkNodes(NodeChunk_t *chunk) {
+    return (Node_t *) (chunk + 1);
+}
+
+static inline NodeChunk_t *nodeChunk(Node_t *node) {
+    return (NodeChunk_t *) ((uintptr_t) node & ~(NODE_ARENA_CHUNK_SIZE - 1));
+}
+
+NodeArena_t nodeArenaCtor() {
+    NodeArena_t arena = {};
+    return arena;
+}
+
+/// @brief Free operand arrays of arena
+static void releaseOperands(NodeArena_t *arena) {
+    OperandsBlock_t *block = arena->operands;
+    while (block) {
+        OperandsBlock_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->operands = NULL;
+}
+
+TungstenStatus_t nodeArenaDtor(NodeArena_t *arena) {
+    if (!arena) return TA_NULL_PTR;
+
+    logPrint(L_DEBUG, 0, "NodeArena[%p]: %zu allocations, %zu releases, %zu chunks, %zu live nodes\n",
+             arena, arena->stats.allocations, arena->stats.releases, arena->stats.chunks, arena->stats.liveNodes);
+
+    return nodeArenaRelease(arena);
+}
+
+TungstenStatus_t nodeArenaRelease(NodeArena_t *arena) {
+    if (!arena) return TA_NULL_PTR;
+
+    if (currentArena == arena)
+        currentArena = NULL;
+
+    releaseOperands(arena);
+
+    NodeChunk_t *chunk = arena->chunks;
+    while (chunk) {
+        NodeChunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    NodeArenaStats_t stats = arena->stats;
+    stats.bulkReleases += stats.liveNodes;
+    stats.liveNodes = 0;
+
+    *arena = {};
+    arena->stats = stats;
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t nodeArenaReset(NodeArena_t *arena) {
+    if (!arena) return TA_NULL_PTR;
+
+    arena->current = arena->chunks;
+    arena->used = 0;
+    arena->freeList = NULL;
+    releaseOperands(arena);
+
+    arena->stats.bulkReleases += arena->stats.liveNodes;
+    arena->stats.liveNodes = 0;
+    return TA_SUCCESS;
+}
+
+NodeArena_t *nodeArenaSelect(NodeArena_t *arena) {
+    NodeArena_t *previous = nodeArenaCurrent();
+    currentArena = arena;
+    return previous;
+}
+
+NodeArena_t *nodeArenaCurrent() {
+    return (currentArena) ? currentArena : &defaultArena.arena;
+}
+
+/// @brief Move to next chunk of arena, allocating it if needed
+static bool nodeArenaGrow(NodeArena_t *arena) {
+    if (arena->current && arena->current->next) {
+        arena->current = arena->current->next;
+        arena->used = 0;
+        return true;
+    }
+
+    NodeChunk_t *chunk = (NodeChunk_t *) aligned_alloc(NODE_ARENA_CHUNK_SIZE, NODE_ARENA_CHUNK_SIZE);
+    if (!chunk) {
+        logPrint(L_ZERO, 1, "NodeArena[%p]: failed to allocate chunk\n", arena);
+        return false;
+    }
+
+    chunk->arena = arena;
+    chunk->next = NULL;
+    arena->stats.chunks++;
+
+    if (arena->current)
+        arena->current->next = chunk;
+    else
+        arena->chunks = chunk;
+
+    arena->current = chunk;
+    arena->used = 0;
+    return true;
+}
+
+Node_t *nodeAlloc() {
+    NodeArena_t *arena = nodeArenaCurrent();
+    Node_t *node = NULL;
+
+    if (arena->freeList) {
+        node = arena->freeList;
+        arena->freeList = node->left;
+    } else {
+        if (!arena->current || arena->used == NODE_ARENA_CHUNK_NODES) {
+            if (!nodeArenaGrow(arena))
+                return NULL;
+        }
+        node = chunkNodes(arena->current) + arena->used++;
+    }
+
+    memset(node, 0, sizeof(Node_t));
+
+    arena->stats.allocations++;
+    arena->stats.liveNodes++;
+    if (arena->stats.liveNodes > arena->stats.peakNodes)
+        arena->stats.peakNodes = arena->stats.liveNodes;
+
+    return node;
+}
+
+void nodeFree(Node_t *node) {
+    if (!node) return;
+
+    operandsFree(node->operands);
+
+    NodeArena_t *arena = nodeChunk(node)->arena;
+    node->left = arena->freeList;
+    arena->freeList = node;
+
+    arena->stats.releases++;
+    arena->stats.liveNodes--;
+}
+
+static inline OperandsBlock_t *operandsBlock(Node_t **operands) {
+    return (OperandsBlock_t *) operands - 1;
+}
+
+static void linkBlock(NodeArena_t *arena, OperandsBlock_t *block) {
+    block->arena = arena;
+    block->prev = NULL;
+    block->next = arena->operands;
+    if (arena->operands)
+        arena->operands->prev = block;
+    arena->operands = block;
+}
+
+static void unlinkBlock(OperandsBlock_t *block) {
+    if (block->prev) block->prev->next   = block->next;
+    else             block->arena->operands = block->next;
+
+    if (block->next) block->next->prev = block->prev;
+}
+
+Node_t **operandsAlloc(Node_t *node, size_t capacity) {
+    assert(node);
+
+    OperandsBlock_t *block = (OperandsBlock_t *) calloc(1, sizeof(OperandsBlock_t) + capacity * sizeof(Node_t *));
+    if (!block)
+        return NULL;
+
+    block->capacity = capacity;
+    linkBlock(nodeChunk(node)->arena, block);
+    return (Node_t **) (block + 1);
+}
+
+Node_t **operandsRealloc(Node_t *node, size_t capacity) {
+    assert(node);
+
+    if (!node->operands)
+        return operandsAlloc(node, capacity);
+
+    OperandsBlock_t *block = operandsBlock(node->operands);
+    NodeArena_t *arena = block->arena;
+    unlinkBlock(block);
+
+    OperandsBlock_t *newBlock = (OperandsBlock_t *) realloc(block, sizeof(OperandsBlock_t) + capacity * sizeof(Node_t *));
+    if (!newBlock) {
+        linkBlock(arena, block);
+        return NULL;
+    }
+
+    newBlock->capacity = capacity;
+    linkBlock(arena, newBlock);
+    return (Node_t **) (newBlock + 1);
+}
+
+size_t operandsCapacity(Node_t **operands) {
+    return (operands) ? operandsBlock(operands)->capacity : 0;
+}
+
+void operandsFree(Node_t **operands) {
+    if (!operands) return;
+
+    OperandsBlock_t *block = operandsBlock(operands);
+    unlinkBlock(block);
+    free(block);
+}
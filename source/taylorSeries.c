@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "exprCompiler.h"
+#include "taylorSeries.h"
+
+/// Series of scratch memory used by one operator
+const size_t SERIES_SCRATCH_COUNT = 3;
+/// Maximum power computed by repeated multiplication when base series starts from zero
+const size_t SERIES_MAX_INTEGER_POWER = 64;
+
+/*
+In all functions len = order + 1, result must not overlap with arguments.
+Zero coefficient of result always matches calculateOperation() of zero coefficients.
+*/
+
+static void seriesMul(const double *a, const double *b, double *out, size_t len) {
+    for (size_t n = 0; n < len; n++) {
+        double sum = 0;
+        for (size_t k = 0; k <= n; k++)
+            sum += a[k] * b[n - k];
+        out[n] = sum;
+    }
+}
+
+static void seriesDiv(const double *a, const double *b, double *out, size_t len) {
+    out[0] = a[0] / b[0];
+    for (size_t n = 1; n < len; n++) {
+        double sum = a[n];
+        for (size_t k = 0; k < n; k++)
+            sum -= out[k] * b[n - k];
+        out[n] = sum / b[0];
+    }
+}
+
+/// @brief out = ln(a): a * out' = a'
+static void seriesLog(const double *a, double *out, size_t len) {
+    out[0] = log(a[0]);
+    for (size_t n = 1; n < len; n++) {
+        double sum = 0;
+        for (size_t k = 1; k < n; k++)
+            sum += (double) k * out[k] * a[n - k];
+        out[n] = (a[n] - sum / (double) n) / a[0];
+    }
+}
+
+/// @brief out = exp(a): out' = a' * out
+static void seriesExp(const double *a, double *out, size_t len) {
+    out[0] = exp(a[0]);
+    for (size_t n = 1; n < len; n++) {
+        double sum = 0;
+        for (size_t k = 1; k <= n; k++)
+            sum += (double) k * a[k] * out[n - k];
+        out[n] = sum / (double) n;
+    }
+}
+
+/// @brief sin and cos (or sinh and cosh) together: s' = a' * c, c' = -+a' * s
+static void seriesSinCos(const double *a, double *sine, double *cosine, size_t len, bool hyperbolic) {
+    sine[0]   = (hyperbolic) ? sinh(a[0]) : sin(a[0]);
+    cosine[0] = (hyperbolic) ? cosh(a[0]) : cos(a[0]);
+    double sign = (hyperbolic) ? 1 : -1;
+
+    for (size_t n = 1; n < len; n++) {
+        double sinSum = 0, cosSum = 0;
+        for (size_t k = 1; k <= n; k++) {
+            sinSum += (double) k * a[k] * cosine[n - k];
+            cosSum += (double) k * a[k] * sine[n - k];
+        }
+        sine[n]   = sinSum / (double) n;
+        cosine[n] = sign * cosSum / (double) n;
+    }
+}
+
+/// @brief t = tan(a) or ctg(a): t' = +-a' * u, where u = 1 + t^2
+static void seriesTan(const double *a, double *out, double *square, size_t len, bool cotangent) {
+    out[0] = (cotangent) ? 1/tan(a[0]) : tan(a[0]);
+    square[0] = 1 + out[0] * out[0];
+    double sign = (cotangent) ? -1 : 1;
+
+    for (size_t n = 1; n < len; n++) {
+        double sum = 0;
+        for (size_t k = 1; k <= n; k++)
+            sum += (double) k * a[k] * square[n - k];
+        out[n] = sign * sum / (double) n;
+
+        double squareSum = 0;
+        for (size_t k = 0; k <= n; k++)
+            squareSum += out[k] * out[n - k];
+        square[n] = squareSum;
+    }
+}
+
+/// @brief Exact zero test: coefficients are divided by a[0], so no epsilon is used
+static bool isZero(double a) {
+    return fpclassify(a) == FP_ZERO;
+}
+
+static bool seriesIsConstant(const double *a, size_t len) {
+    for (size_t n = 1; n < len; n++)
+        if (!isZero(a[n])) return false;
+    return true;
+}
+
+/// @brief out = a ^ power for constant power
+static void seriesPowConst(const double *a, double power, double *out, double *scratch, size_t len) {
+    if (!isZero(a[0])) {
+        // a * out' = power * a' * out
+        out[0] = pow(a[0], power);
+        for (size_t n = 1; n < len; n++) {
+            double sum = 0;
+            for (size_t k = 1; k <= n; k++)
+                sum += ((power + 1) * (double) k - (double) n) * a[k] * out[n - k];
+            out[n] = sum / ((double) n * a[0]);
+        }
+        return;
+    }
+
+    memset(out, 0, len * sizeof(double));
+    if (seriesIsConstant(a, len)) {
+        out[0] = pow(a[0], power);
+        return;
+    }
+
+    if (power >= 0 && isZero(power - floor(power)) && power <= (double) SERIES_MAX_INTEGER_POWER) {
+        // a[0] = 0 and natural power: repeated multiplication
+        out[0] = 1;
+        for (size_t idx = 0; idx < (size_t) power; idx++) {
+            seriesMul(out, a, scratch, len);
+            memcpy(out, scratch, len * sizeof(double));
+        }
+        out[0] = pow(a[0], power);
+        return;
+    }
+
+    // function is not analytic at this point
+    out[0] = pow(a[0], power);
+    for (size_t n = 1; n < len; n++)
+        out[n] = NAN;
+}
+
+TungstenStatus_t taylorSeriesCompiled(TungstenContext_t *context, const CompiledExpr_t *compiled, int variable,
+                                      double point, size_t order, double *coefficients) {
+    assert(context);
+    assert(compiled);
+    assert(coefficients);
+
+    size_t len = order + 1;
+    double *memory = (double *) calloc((compiled->stackSize + SERIES_SCRATCH_COUNT) * len, sizeof(double));
+    if (!memory)
+        return TA_MEMORY_ERROR;
+
+    double *scratch = memory,
+           *first   = scratch + len,
+           *second  = first   + len;
+    //top points to the first coefficient of series on top of stack
+    double *top = memory + (SERIES_SCRATCH_COUNT - 1) * len;
+
+    const Instruction_t *instr = compiled->code,
+                        *end   = compiled->code + compiled->size;
+    for (; instr < end; instr++) {
+        if (instr->code == INSTR_NUMBER || instr->code == INSTR_VARIABLE) {
+            top += len;
+            memset(top, 0, len * sizeof(double));
+
+            if (instr->code == INSTR_NUMBER)
+                top[0] = instr->arg.number;
+            else if (instr->arg.var == variable) {
+                top[0] = point;
+                if (len > 1) top[1] = 1;
+            } else
+                top[0] = context->variables[instr->arg.var].number;
+
+            continue;
+        }
+
+        double *arg = top;
+        if (operators[instr->code].binary)
+            top -= len;
+        double *left = top, *right = arg;
+
+        // result goes to scratch, then replaces operands
+        switch(instr->code) {
+            case INSTR_ADD:
+                for (size_t n = 0; n < len; n++) scratch[n] = left[n] + right[n];
+                break;
+            case INSTR_SUB:
+                for (size_t n = 0; n < len; n++) scratch[n] = left[n] - right[n];
+                break;
+            case INSTR_MUL:
+                seriesMul(left, right, scratch, len);
+                break;
+            case INSTR_DIV:
+                seriesDiv(left, right, scratch, len);
+                break;
+            case INSTR_POW:
+                if (seriesIsConstant(right, len))
+                    seriesPowConst(left, right[0], scratch, first, len);
+                else {
+                    // a ^ b = exp(b * ln(a))
+                    seriesLog(left, first, len);
+                    seriesMul(right, first, second, len);
+                    seriesExp(second, scratch, len);
+                    scratch[0] = pow(left[0], right[0]);
+                }
+                break;
+            case INSTR_LOG:
+                // log_a(b) = ln(b) / ln(a)
+                seriesLog(right, first, len);
+                seriesLog(left, second, len);
+                seriesDiv(first, second, scratch, len);
+                break;
+            case INSTR_SIN:
+                seriesSinCos(arg, scratch, first, len, false);
+                break;
+            case INSTR_COS:
+                seriesSinCos(arg, first, scratch, len, false);
+                break;
+            case INSTR_SINH:
+                seriesSinCos(arg, scratch, first, len, true);
+                break;
+            case INSTR_COSH:
+                seriesSinCos(arg, first, scratch, len, true);
+                break;
+            case INSTR_TAN:
+                seriesTan(arg, scratch, first, len, false);
+                break;
+            case INSTR_CTG:
+                seriesTan(arg, scratch, first, len, true);
+                break;
+            case INSTR_LOGN:
+                seriesLog(arg, scratch, len);
+                break;
+            case INSTR_NUMBER:
+            case INSTR_VARIABLE:
+            default:
+                logPrint(L_ZERO, 1, "Taylor series: instruction %d is not implemented\n", instr->code);
+                free(memory);
+                return TA_SYNTAX_ERROR;
+        }
+
+        memcpy(top, scratch, len * sizeof(double));
+    }
+
+    memcpy(coefficients, top, len * sizeof(double));
+    free(memory);
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t taylorSeries(TungstenContext_t *context, const Node_t *expr, int variable,
+                              double point, size_t order, double *coefficients) {
+    assert(expr);
+
+    CompiledExpr_t compiled = {};
+    TungstenStatus_t status = compileExpression(expr, &compiled);
+    if (status != TA_SUCCESS)
+        return status;
+
+    status = taylorSeriesCompiled(context, &compiled, variable, point, order, coefficients);
+    deleteCompiled(&compiled);
+    return status;
+}
@@ -3,6 +3,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "logger.h"
 #include "tex.h"
@@ -22,6 +23,7 @@ TexContext_t texInit(const char *name) {
         return tex;
     }
     tex.active = true;
+    tex.budget = TEX_DEFAULT_BUDGET;
 
     texPrintf(&tex,
     "\\documentclass[11pt]{article}\n"
@@ -50,19 +52,92 @@ TexContext_t texInit(const char *name) {
     return tex;
 }
 
+bool texNarrating(const TexContext_t *tex) {
+    return tex && tex->active;
+}
+
+bool texStep(TexContext_t *tex, size_t depth) {
+    if (!texNarrating(tex)) return false;
+
+    bool narrate = (!tex->budget.maxSteps || tex->steps < tex->budget.maxSteps) &&
+                   (!tex->budget.maxDepth || depth <= tex->budget.maxDepth);
+    if (narrate)
+        tex->steps++;
+    else
+        tex->skippedSteps++;
+
+    return narrate;
+}
+
+void texSummary(TexContext_t *tex) {
+    if (!texNarrating(tex)) return;
+
+    if (tex->skippedSteps)
+        texPrintf(tex, "Оставшиеся %zu шагов аналогичны и оставляются читателю в качестве упражнения.\n\n",
+                  tex->skippedSteps);
+
+    tex->steps = 0;
+    tex->skippedSteps = 0;
+}
+
+size_t texFindPlaceholder(const TexContext_t *tex, uint64_t hash) {
+    if (!tex->placeholdersCapacity) return 0;
+
+    size_t mask = tex->placeholdersCapacity - 1;
+    for (size_t idx = hash & mask; tex->placeholders[idx].name; idx = (idx + 1) & mask) {
+        if (tex->placeholders[idx].hash == hash)
+            return tex->placeholders[idx].name;
+    }
+    return 0;
+}
+
+static void insertPlaceholder(TexPlaceholder_t *table, size_t capacity, TexPlaceholder_t placeholder) {
+    size_t mask = capacity - 1;
+    size_t idx = placeholder.hash & mask;
+    while (table[idx].name)
+        idx = (idx + 1) & mask;
+    table[idx] = placeholder;
+}
+
+size_t texAddPlaceholder(TexContext_t *tex, uint64_t hash) {
+    // table is kept at most half full
+    if (2 * (tex->placeholdersCount + 1) > tex->placeholdersCapacity) {
+        size_t newCapacity = (tex->placeholdersCapacity) ? 2 * tex->placeholdersCapacity
+                                                         : TEX_START_PLACEHOLDERS_CAPACITY;
+        TexPlaceholder_t *newTable = (TexPlaceholder_t *) calloc(newCapacity, sizeof(TexPlaceholder_t));
+        if (!newTable)
+            return 0;
+
+        for (size_t idx = 0; idx < tex->placeholdersCapacity; idx++) {
+            if (tex->placeholders[idx].name)
+                insertPlaceholder(newTable, newCapacity, tex->placeholders[idx]);
+        }
+
+        free(tex->placeholders);
+        tex->placeholders = newTable;
+        tex->placeholdersCapacity = newCapacity;
+    }
+
+    TexPlaceholder_t placeholder = {hash, ++tex->placeholdersCount};
+    insertPlaceholder(tex->placeholders, tex->placeholdersCapacity, placeholder);
+    return placeholder.name;
+}
+
 int texPrintf(TexContext_t *tex, const char *fmt, ...) {
-    if (!tex->active) return 0;
+    if (!texNarrating(tex)) return 0;
 
     if (!tex->file) return -1;
     va_list args;
     va_start(args, fmt);
     int result = vfprintf(tex->file, fmt, args);
     va_end(args);
+    if (result > 0)
+        tex->written += (size_t) result;
     return result;
 }
 
 int texBeginGraph(TexContext_t *tex, const char *xLabel, const char *yLabel, const char *graphTitle) {
-    if (!tex->active) return 0;
+    if (!texNarrating(tex)) return 0;
 
     if (!tex->file) return -1;
     return texPrintf(tex,
@@ -78,7 +153,7 @@ int texBeginGraph(TexContext_t *tex, const char *xLabel, const char *yLabel, con
 }
 
 int texAddGraph(TexContext_t *tex, const char *color, double *x, double *y, int pointsCount) {
-    if (!tex->active) return 0;
+    if (!texNarrating(tex)) return 0;
     if (!tex->file) return -1;
 
     int result = 0;
@@ -94,14 +169,14 @@ int texAddGraph(TexContext_t *tex, const char *color, double *x, double *y, int
 }
 
 int texEndGraph(TexContext_t *tex) {
-    if (!tex->active) return 0;
+    if (!texNarrating(tex)) return 0;
 
     return texPrintf(tex, "\\end{axis}\n"
                           "\\end{tikzpicture}\n");
 }
 
 int texBeginTable(TexContext_t *tex, unsigned columns) {
-    if (!tex->active) return 0;
+    if (!texNarrating(tex)) return 0;
 
     texPrintf(tex,
     "\\begin{center}\n"
@@ -117,7 +192,7 @@ int texBeginTable(TexContext_t *tex, unsigned columns) {
 }
 
 int texAddTableLine(TexContext_t *tex, bool hLine, unsigned columns, ...) {
-    if (!tex->active) return 0;
+    if (!texNarrating(tex)) return 0;
 
     va_list va;
     va_start(va, columns);
@@ -138,7 +213,7 @@ int texAddTableLine(TexContext_t *tex, bool hLine, unsigned columns, ...) {
 }
 
 int texEndTable(TexContext_t *tex) {
-    if (!tex->active) return 0;
+    if (!texNarrating(tex)) return 0;
     return texPrintf(tex,
     "\\hline\n"
     "\\end{tabular}\n"
@@ -159,5 +234,10 @@ enum TexStatus texClose(TexContext_t *tex) {
     char command[TEX_COMMAND_BUFFER_SIZE] = "";
     sprintf(command, "pdflatex -quiet %s", tex->fileName);
     system(command);
+
+    free(tex->placeholders);
+    free(tex->pending);
+    tex->placeholders = NULL;
+    tex->pending = NULL;
     return TEX_SUCCESS;
 }
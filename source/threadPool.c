@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#include "hashTable.h"
+#include "logger.h"
+#include "tex.h"
+#include "exprTree.h"
+#include "threadPool.h"
+
+size_t threadPoolDefaultThreads() {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return (processors > 0) ? (size_t) processors : 1;
+}
+
+static bool popTask(PoolQueue_t *queue, size_t *task) {
+    pthread_mutex_lock(&queue->lock);
+
+    bool found = (queue->begin < queue->end);
+    if (found)
+        *task = queue->begin++;
+
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+/// @brief Move back half of range of some other worker to own queue
+/// @return false if all other queues are empty
+static bool stealTasks(ThreadPool_t *pool, PoolQueue_t *own) {
+    for (size_t shift = 1; shift < pool->threadsCount; shift++) {
+        PoolQueue_t *victim = pool->queues + (own->worker + shift) % pool->threadsCount;
+
+        pthread_mutex_lock(&victim->lock);
+        size_t remaining = victim->end - victim->begin;
+        size_t begin = victim->end - (remaining + 1) / 2,
+               end   = victim->end;
+        victim->end = begin;
+        pthread_mutex_unlock(&victim->lock);
+
+        if (remaining == 0)
+            continue;
+
+        // own queue is empty, other thieves can only see it empty until it is filled here
+        pthread_mutex_lock(&own->lock);
+        own->begin = begin;
+        own->end = end;
+        pthread_mutex_unlock(&own->lock);
+
+        own->steals++;
+        own->stolen += end - begin;
+        return true;
+    }
+
+    return false;
+}
+
+static void runTasks(ThreadPool_t *pool, PoolQueue_t *own) {
+    size_t task = 0;
+    do {
+        while (popTask(own, &task)) {
+            pool->task(pool->arg, task, own->worker);
+            own->executed++;
+        }
+    } while (stealTasks(pool, own));
+}
+
+static void *poolWorker(void *arg) {
+    PoolQueue_t *own = (PoolQueue_t *) arg;
+    ThreadPool_t *pool = own->pool;
+    size_t seenGeneration = 0;
+
+    while (true) {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->stop && pool->generation == seenGeneration)
+            pthread_cond_wait(&pool->wakeUp, &pool->lock);
+
+        if (pool->stop) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seenGeneration = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        runTasks(pool, own);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busyWorkers == 0)
+            pthread_cond_signal(&pool->finished);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+TungstenStatus_t threadPoolCtor(ThreadPool_t *pool, size_t threadsCount) {
+    assert(pool);
+
+    *pool = {};
+    pool->threadsCount = (threadsCount) ? threadsCount : threadPoolDefaultThreads();
+
+    size_t queuesSize = (pool->threadsCount * sizeof(PoolQueue_t) + THREAD_POOL_CACHE_LINE - 1) /
+                        THREAD_POOL_CACHE_LINE * THREAD_POOL_CACHE_LINE;
+    pool->queues  = (PoolQueue_t *) aligned_alloc(THREAD_POOL_CACHE_LINE, queuesSize);
+    pool->threads = (pthread_t *) calloc(pool->threadsCount, sizeof(pthread_t));
+    if (!pool->queues || !pool->threads) {
+        free(pool->queues);
+        free(pool->threads);
+        *pool = {};
+        return TA_MEMORY_ERROR;
+    }
+
+    memset(pool->queues, 0, queuesSize);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wakeUp, NULL);
+    pthread_cond_init(&pool->finished, NULL);
+
+    for (size_t worker = 0; worker < pool->threadsCount; worker++) {
+        pthread_mutex_init(&pool->queues[worker].lock, NULL);
+        pool->queues[worker].pool = pool;
+        pool->queues[worker].worker = worker;
+    }
+
+    // worker 0 is calling thread
+    for (size_t worker = 1; worker < pool->threadsCount; worker++) {
+        if (pthread_create(pool->threads + worker, NULL, poolWorker, pool->queues + worker) != 0) {
+            logPrint(L_ZERO, 1, "ThreadPool[%p]: failed to start thread %zu\n", pool, worker);
+            pool->threadsCount = worker;
+            threadPoolDtor(pool);
+            return TA_MEMORY_ERROR;
+        }
+    }
+
+    logPrint(L_DEBUG, 0, "ThreadPool[%p]: %zu workers\n", pool, pool->threadsCount);
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t threadPoolDtor(ThreadPool_t *pool) {
+    if (!pool) return TA_NULL_PTR;
+    if (!pool->queues) return TA_SUCCESS;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->wakeUp);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t worker = 1; worker < pool->threadsCount; worker++)
+        pthread_join(pool->threads[worker], NULL);
+
+    for (size_t worker = 0; worker < pool->threadsCount; worker++)
+        pthread_mutex_destroy(&pool->queues[worker].lock);
+
+    pthread_cond_destroy(&pool->finished);
+    pthread_cond_destroy(&pool->wakeUp);
+    pthread_mutex_destroy(&pool->lock);
+
+    free(pool->queues);
+    free(pool->threads);
+    *pool = {};
+    return TA_SUCCESS;
+}
+
+TungstenStatus_t threadPoolRun(ThreadPool_t *pool, PoolTask_t task, void *arg, size_t tasksCount) {
+    assert(pool);
+    assert(task);
+    if (!pool->queues) return TA_NULL_PTR;
+
+    pthread_mutex_lock(&pool->lock);
+
+    // workers are idle, so queues are filled without their locks
+    for (size_t worker = 0; worker < pool->threadsCount; worker++) {
+        PoolQueue_t *queue = pool->queues + worker;
+        queue->begin = tasksCount *  worker      / pool->threadsCount;
+        queue->end   = tasksCount * (worker + 1) / pool->threadsCount;
+        queue->executed = queue->steals = queue->stolen = 0;
+    }
+
+    pool->task = task;
+    pool->arg = arg;
+    pool->busyWorkers = pool->threadsCount - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->wakeUp);
+    pthread_mutex_unlock(&pool->lock);
+
+    runTasks(pool, pool->queues);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busyWorkers)
+        pthread_cond_wait(&pool->finished, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+
+    pool->stats.jobs++;
+    for (size_t worker = 0; worker < pool->threadsCount; worker++) {
+        pool->stats.tasks += pool->queues[worker].executed;
+        pool->stats.steals += pool->queues[worker].steals;
+        pool->stats.stolenTasks += pool->queues[worker].stolen;
+    }
+
+    return TA_SUCCESS;
+}